@@ -28,12 +28,16 @@ tGPIBReadWriteStatus GPIBasyncRead( gint , void *, glong , gint *, gdouble );
 tGPIBReadWriteStatus GPIBasyncWrite( gint , const void *, gint *, gdouble );
 tGPIBReadWriteStatus GPIBasyncWriteBinary( gint, const void *, gint , gint *, gdouble  );
 tGPIBReadWriteStatus GPIBasyncSRQwrite( gint , void *, gint, gint *, gdouble );
+tGPIBReadWriteStatus GPIBasyncSRQwriteTimed( gint , void *, gint, gint *, tTimedOperation, gint, gdouble, gdouble );
 tGPIBReadWriteStatus enableSRQonOPC( gint , gint * );
 
 #define NULL_STR	-1
 #define WAIT_STR	-2
 #define TIMEOUT_SAFETY_FACTOR	1.25
 
+#define GPIB_EOI		TRUE
+#define	GPIB_EOS_NONE	0
+
 #define ERR_TIMEOUT (0x1000)
 #define GPIBfailed(x) (((x) & (ERR | ERR_TIMEOUT)) != 0)
 #define GPIBsucceeded(x) (((x) & (ERR | ERR_TIMEOUT)) == 0)
@@ -41,4 +45,98 @@ tGPIBReadWriteStatus enableSRQonOPC( gint , gint * );
 #define TIMEOUT_RW_1SEC   1.0
 #define TIMEOUT_RW_1MIN  60.0
 
+// Record of each transaction through the async GPIB layer (GPIBtrace.c)
+#define GPIB_TRACE_SIZE			4096	// transactions kept (power of 2)
+#define GPIB_MNEMONIC_SIZE		12
+#define GPIB_HISTOGRAM_BINS		27		// bin n holds latencies of 2^n to 2^(n+1) us
+
+typedef enum { eGPIB_WRITE=0, eGPIB_READ, eGPIB_SRQ_WAIT, eGPIB_CLEAR, eGPIB_NUM_TRANSACTION_TYPES } tGPIBtransactionType;
+
+typedef struct {
+	gint64		start;			// monotonic time (us)
+	gint64		duration;		// us from start to completion
+	gint64		waitTime;		// us waiting for the HP8753 (or for SRQ)
+	glong		nBytes;			// bytes requested
+	glong		nTransferred;	// bytes actually transferred
+	tGPIBtransactionType	type;
+	tGPIBReadWriteStatus	status;
+	gchar		sMnemonic[ GPIB_MNEMONIC_SIZE ];	// last command written (for reads, clears and SRQ waits, the command answered)
+} tGPIBtransaction;
+
+typedef struct {
+	gchar		sMnemonic[ GPIB_MNEMONIC_SIZE ];
+	tGPIBtransactionType	type;
+	guint		nCalls;
+	guint		nTimeouts;
+	guint		nErrors;
+	gint64		nBytes;
+	gint64		totalTime;
+	gint64		maxTime;
+	guint		histogram[ GPIB_HISTOGRAM_BINS ];
+} tGPIBmnemonicStatistics;
+
+void		recordGPIBtransaction( tGPIBtransactionType, const void *, glong, glong, gint64, gint64, tGPIBReadWriteStatus );
+gint		GPIBclear( gint );
+guint		collectGPIBtransactions( void );
+GList *		GPIBtransactionStatistics( void );
+gint64		GPIBstatisticsPercentile( tGPIBmnemonicStatistics *, gdouble );
+void		resetGPIBtransactionStatistics( void );
+gint		exportGPIBtransactions( gchar *, gboolean );
+extern const gchar *GPIBtransactionTypeNames[];
+
+// Record and replay of a GPIB session (GPIBreplay.c)
+gint		startGPIBsessionRecording( gchar * );
+gint		startGPIBsessionReplay( gchar *, gdouble );
+void		endGPIBsession( void );
+void		recordGPIBsessionEvent( tGPIBtransactionType, const void *, glong, glong, gint64, gint64, tGPIBReadWriteStatus );
+tGPIBReadWriteStatus replayGPIBtransaction( tGPIBtransactionType, void *, glong, gint * );
+gboolean	GPIBreplaying( void );
+glong		GPIBasyncCount( void );
+gint		GPIBtmo( gint, gint );
+gint		GPIBask( gint, gint, gint * );
+gint		GPIBloc( gint );
+gint		GPIBsic( gint );
+gint		GPIBonl( gint, gint );
+gint		GPIBfind( const gchar * );
+gint		GPIBdev( gint, gint, gint, gint, gint, gint );
+
+// Service requests of all the devices on the bus (GPIBsrq.c)
+gint		registerSRQdevice( gint );
+void		unregisterSRQdevice( gint );
+void		expectGPIBsrq( gint );
+gboolean	GPIBsrqReceived( gint, guchar * );
+gboolean	GPIBsrqClearESR( gint, gboolean );
+tGPIBReadWriteStatus serviceGPIBsrq( gint, gint * );
+gboolean	GPIBsrqAsserted( gint );
+
+// Resumable tasks run by the GPIB thread while it waits (GPIBtasks.c)
+typedef enum { eTASK_RUNNING, eTASK_DONE } tGPIBtaskState;
+
+typedef struct _GPIBtask tGPIBtask;
+typedef tGPIBtaskState (*tGPIBtaskStep)( tGPIBtask * );
+
+struct _GPIBtask {
+	tGPIBtaskStep	step;
+	gint			resume;			// where the step continues (see TASK_YIELD)
+	gint			index;			// loop counter kept across yields
+	gpointer		pData;
+	GDestroyNotify	freeData;
+	const gchar		*sName;
+};
+
+// A step function is written as:	TASK_BEGIN( pTask ); ... TASK_YIELD( pTask ); ... TASK_END( pTask );
+#define TASK_BEGIN( pTask )		switch( (pTask)->resume ) { case 0:
+#define TASK_YIELD( pTask )		do { (pTask)->resume = __LINE__; return eTASK_RUNNING; case __LINE__: ; } while( 0 )
+#define TASK_END( pTask )		} return eTASK_DONE
+
+#define TASK_SLICE_us			10000	// time given to the tasks on each pass of a wait
+
+void		spawnGPIBtask( tGPIBtaskStep, gpointer, GDestroyNotify, const gchar * );
+gboolean	runGPIBtasks( gint64, gint );
+void		finishGPIBtasks( void );
+gboolean	GPIBtasksPending( void );
+
+#define GPIB_REPLAY_DESCRIPTOR			0	// stands in for the HP8753 when replaying
+#define GPIB_REPLAY_OTHER_DESCRIPTOR	1	// stands in for any other device (the switch matrix)
+
 #endif /* GPIBCOMMS_H_ */
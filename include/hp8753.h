@@ -66,6 +66,7 @@ enum _debug
 
 #define MAX_CAL_ARRAYS	12
 #define HEADER_SIZE		4
+#define FORM1_POINT_SIZE	6
 
 typedef struct {
 	Addr4882_t GPIBaddress;
@@ -133,6 +134,8 @@ typedef enum {
 } eColor;
 
 typedef enum { eDB_CALandSETUP, eDB_TRACE, eDB_CALKIT } tDBtable;
+// what to do with profiles in a project archive that already exist
+typedef enum { eIMPORT_KEEP_EXISTING = 0, eIMPORT_REPLACE_EXISTING = 1, eIMPORT_ABORT_ON_CONFLICT = 2 } tImportPolicy;
 
 typedef enum { eA4 = 0, eLetter = 1, eA3 = 2, eTabloid = 3, eNumPaperSizes = 4 } tPaperSize;
 
@@ -162,13 +165,87 @@ typedef struct {
 #define S11_MEAS  0
 #define S22_MEAS  3
 
+// S-parameter planes of tS2P (in Touchstone version 1 order)
+typedef enum { eS2P_S11 = 0, eS2P_S21, eS2P_S12, eS2P_S22, eS2P_N_PARAMS } tS2Pparameter;
+
+// The frequency and the real / imaginary planes of the S-parameters share one allocation,
+// each plane starting on this boundary
+#define S2P_ALIGNMENT	64
+
 typedef struct {
+	gpointer pBuffer;					// allocation holding all the planes (may be shared with an export)
 	gdouble *freq;
-	tComplex *S11, *S21, *S22, *S12;
+	gdouble *re[ eS2P_N_PARAMS ], *im[ eS2P_N_PARAMS ];
 	gint nPoints;
+	gint nAllocated;					// points each plane can hold
 	enum { S2P, S1P_S11, S1P_S22 } SnPtype;
 }tS2P;
 
+// Quantities derived from a complex trace (see deriveTrace)
+typedef enum {
+	eDERIVED_LOGM = 0,			// dB
+	eDERIVED_PHASE,				// degrees (±180)
+	eDERIVED_UNWRAPPED_PHASE,	// degrees (continuous)
+	eDERIVED_DELAY,				// group delay (s)
+	eDERIVED_LINM,
+	eDERIVED_SWR,
+	eDERIVED_RETURN_LOSS,		// dB
+	eDERIVED_REAL,
+	eDERIVED_IMAG,
+	// these have two results
+	eDERIVED_IMPEDANCE,			// R + jX (Ω)
+	eDERIVED_ADMITTANCE,		// G + jB (S)
+	eDERIVED_SERIES_LC,			// equivalent series L (H) or C (F)
+	eDERIVED_PARALLEL_LC,		// equivalent parallel L (H) or C (F)
+	eDERIVED_N_QUANTITIES
+} tDerivedQuantity;
+
+// A complex trace held as separate real and imaginary arrays or as tComplex
+typedef struct {
+	const gdouble *re, *im;
+	gsize stride;				// between points (in gdoubles)
+	const gdouble *freq;		// frequency of each point (for the delay and L / C)
+	gint nPoints;
+} tComplexTrace;
+
+// Touchstone file options (the option line is "# <unit> S <format> R <impedance>")
+typedef enum { eTS_RI = 0, eTS_MA, eTS_DB, eTS_N_FORMATS } tTouchstoneFormat;
+typedef enum { eTS_HZ = 0, eTS_KHZ, eTS_MHZ, eTS_GHZ, eTS_N_UNITS } tTouchstoneUnit;
+
+typedef struct {
+	tTouchstoneFormat	format;
+	tTouchstoneUnit		frequencyUnit;
+	gdouble				referenceImpedance;
+	gboolean			bVersion2;		// Touchstone 2.0 keywords ([Version], [Network Data] ...)
+} tTouchstoneOptions;
+
+// S-parameters of a device with more than two ports (assembled from 2-port measurements)
+#define MAX_SWITCHED_PORTS	4
+
+typedef struct {
+	gdouble *freq;
+	tComplex *S;			// nPorts x nPorts matrix (row major) for each frequency point
+	gint nPorts;
+	gint nPoints;
+} tSnP;
+
+// A connection made by the switch matrix: two device ports to the analyzer ports
+typedef struct {
+	gint	port1, port2;	// device ports (0 based) connected to analyzer ports 1 and 2
+	gchar	*sCommand;		// GPIB string for the switch or command line to run
+} tSwitchPath;
+
+typedef struct {
+	gint		nPorts;
+	gchar		*sDevice;		// GPIB device name of the switch (gpib.conf) ...
+	gint		address;		// ... or its primary address on the HP8753 controller
+	gboolean	bScript;		// commands are run on this computer rather than sent to the switch
+	gdouble		settleTime;		// seconds allowed for the switch to settle
+	GArray		*paths;			// tSwitchPath in the order measured
+	gchar		*sFilename;		// S3P / S4P file to write
+	tSnP		SnP;			// the assembled S-parameters
+} tSwitchSequence;
+
 typedef enum {
 	eMkrLinear = 0,
 	eMkrLog    = 1,
@@ -196,9 +273,16 @@ typedef struct {
 	guint iNumSegments [2]; // number of segments defined
 } tLearnStringIndexes;
 
+typedef struct {
+	gchar	*sProduct;		// "*" for any product
+	tLearnStringIndexes indexes;
+	gboolean bBuiltIn;		// compiled in (not saved in the database)
+} tLearnStringRegistryEntry;
+
 typedef struct {
 	tComplex *responsePoints;
 	gdouble  *stimulusPoints;
+	tComplex *complexPoints;	// corrected data before formatting (NULL if not retrieved)
 	struct {
 		guint32 bSweepHold      : 1;
 		guint32 bValidData      : 1;
@@ -246,6 +330,34 @@ typedef struct {
 
 typedef enum { eCH_ONE = 0, eCH_SINGLE = 0, eCH_TWO = 1, eNUM_CH = 2, eCH_BOTH = 2 } eChannel;
 #define otherChannel(x)	((x+1) % eNUM_CH)
+
+// Reference data (read from a Touchstone file) drawn with the live traces
+typedef struct {
+	tComplex	*points;		// resampled onto the channel stimulus and in the channel format
+	guint		nPoints;
+	tFormat		format;
+	gint		measurementType;
+	gdouble		stimulusStart, stimulusMiddle, stimulusStop;	// identifies the stimulus the points are for
+} tReferenceCache;
+
+typedef struct {
+	gchar			*sFilename;
+	tS2P			S2P;
+	gdouble			referenceImpedance;
+	tReferenceCache	cache[ eNUM_CH ];
+} tReferenceTrace;
+
+#define NUM_FORMATS	(eFMT_IMAG + 1)
+
+// Views of a channel's complex data formatted on the host (see reformatChannel)
+typedef struct {
+	tComplex	*points[ NUM_FORMATS ];	// formatted traces (the HP8753's own for the acquired format)
+	guint		nPoints;				// 0 if the trace has not been reformatted
+	tFormat		acquiredFormat;			// format of the trace as read from the HP8753 (or database)
+	gdouble		scaleVal, scaleRefPos, scaleRefVal;	// and its scaling
+	guint32		bbMkrs;					// markers (their readouts are only valid in the acquired format)
+	gboolean	bMkrsDelta;
+} tReformatCache;
 typedef enum { eProjectName = 0, eCalibrationName = 1, eTraceName = 2 } tRMCtarget;
 typedef enum { eRename = 0, eMove = 1, eCopy = 2 } tRMCpurpose;
 
@@ -355,6 +467,138 @@ typedef struct {
 	tProjectAndName projectAndName;
 } tHP8753traceAbstract;
 
+// One sweep recovered from the time series trace archive
+// (the pointers are only valid during the query callback)
+typedef struct {
+	gint64			timestamp;		// µs since the epoch
+	eChannel		channel;
+	tFormat			format;
+	tMeasurement	measurementType;
+	guint			nPoints;
+	const tComplex	*responsePoints;
+	const gdouble	*stimulusPoints;
+	gdouble			sweepStart;
+	gdouble			sweepStop;
+	tSweepType		sweepType;
+	gdouble			IFbandwidth;
+	gdouble			CWfrequency;
+} tArchivedSweep;
+
+typedef gboolean (*tArchiveSweepCallback)( const tArchivedSweep *, gpointer );
+
+// Search of the saved profiles (INVALID or 0 in a filter field matches anything)
+typedef struct {
+	gchar			*sText;			// FTS5 match expression for project, name, title & notes (or NULL)
+	gchar			**sWords;		// the words of sText (matched with LIKE if SQLite has no FTS5)
+	gboolean		bTraces;
+	gboolean		bCalibrations;
+	gint			measurementType;	// index into optMeasurementType (S11, S21 ...)
+	gint			format;			// index into optFormat (LOGM, PHAS ...)
+	gint			calType;		// index into optCalType (calibration profiles only)
+	gdouble			minFrequency;		// sweep must overlap this range
+	gdouble			maxFrequency;
+	gdouble			maxIFbandwidth;
+	gint			minPoints;
+	gint			maxPoints;
+} tSearchQuery;
+
+typedef struct {
+	tDBtable		whichTable;		// eDB_TRACE or eDB_CALandSETUP
+	const gchar		*sProject;
+	const gchar		*sName;
+	const gchar		*sTitle;
+	const gchar		*sNote;
+	const gchar		*dateTime;
+	gdouble			sweepStart;
+	gdouble			sweepStop;
+	gdouble			IFbandwidth;
+	gint			nPoints;
+	gint			measurementType;
+	gint			format;
+	gint			calType;
+} tSearchResult;
+
+typedef gboolean (*tSearchResultCallback)( const tSearchResult *, gpointer );
+typedef struct _searchCursor tSearchCursor;
+
+// Database statistics gathered by the maintenance thread (posted to the main loop)
+#define DB_NUM_QUERY_TIMINGS	8
+
+typedef struct {
+	gchar			*sSQL;
+	guint			nCalls;
+	gint64			totalTime;		// ns
+	gint64			maxTime;		// ns
+} tDBqueryTiming;
+
+typedef struct {
+	gint64			fileSize;		// bytes (including the write ahead log)
+	gint64			pageSize;
+	gint64			nPages;
+	gint64			nFreePages;
+	gint64			nPagesReclaimed;	// by the last maintenance
+	gint64			nProjects;
+	gint64			nCalibrations;
+	gint64			nTraces;
+	gint64			nArchivedSweeps;
+	gint64			nCalKits;
+	gchar			*sIntegrity;		// result of the last integrity check (or NULL)
+	gint64			lastMaintenance;	// µs since the epoch (0 if not yet run)
+	gint64			maintenanceTime;	// µs taken by the last maintenance
+	guint			nQueryTimings;
+	tDBqueryTiming	queryTimings[ DB_NUM_QUERY_TIMINGS ];	// slowest statements on the main connection
+} tDBstatistics;
+
+// Phases of a trace capture (the order in which they occur)
+typedef enum {
+	eCAPTURE_CONFIGURATION = 0,		// channel configuration queries
+	eCAPTURE_LEARN_STRING,
+	eCAPTURE_HOLD,
+	eCAPTURE_TRACES,
+	eCAPTURE_HPGL,
+	eCAPTURE_MARKERS,				// markers and list frequency segments
+	eCAPTURE_REDRAW,				// in the main loop
+	eCAPTURE_NUM_PHASES
+} tCapturePhase;
+
+#define CAPTURE_ROLLING_AVERAGE		10		// captures in the rolling average
+#define CAPTURE_HISTORY				100		// captures for the percentiles
+
+typedef struct {
+	gint64			phaseTime[ eCAPTURE_NUM_PHASES ];	// µs (monotonic clock)
+	gint64			phaseStart;			// monotonic time the current phase started
+	tCapturePhase	phase;				// current phase
+	gint64			timestamp;			// µs since the epoch
+	gchar			*sProduct;
+	gint			firmwareVersion;
+	gint			nPoints;
+	gboolean		bDualChannel;
+} tCaptureTiming;
+
+// Operations the HP8753 signals the completion of (by SRQ) whose durations are learned
+typedef enum {
+	eTIMED_PRESET = 0,				// PRES
+	eTIMED_LEARN_STRING,			// processing a learn string (variant: interpolated calibration)
+	eTIMED_CAL_ARRAY,				// loading a calibration array (variant: points)
+	eTIMED_SAVE_CAL,				// SAVC (variant: points, expected: arrays)
+	eTIMED_CLEAN_SWEEP,				// WAIT after a restore (expected: the sweep times reported)
+	eTIMED_SINGLE_SWEEP,			// SING for a measurement (variant: schedule, expected: sweep time)
+	eTIMED_NUM_OPERATIONS
+} tTimedOperation;
+
+#define TIMING_MODEL_MIN_SAMPLES	3		// before the learned timeout replaces the default
+#define TIMING_MODEL_GRACE			2.0		// s added to the learned timeout
+
+typedef struct {
+	gchar			*sProduct;
+	gint			firmwareVersion;
+	tTimedOperation	operation;
+	gint			variant;			// setup that changes the duration (e.g. points)
+	gdouble			mean;				// s per unit of the expected duration (smoothed)
+	gdouble			deviation;			// mean deviation (smoothed)
+	guint			nSamples;
+} tTimingModelEntry;
+
 typedef struct {
 	tHP8753 HP8753;
 	tHP8753cal HP8753cal;
@@ -375,6 +619,9 @@ typedef struct {
 	    guint16 bNoGPIBtimeout			: 1;
 	    guint16 bDoNotRetrieveHPGLdata  : 1;
         guint16 bHPlogo                 : 1;
+	    guint16 bCaptureComplexData     : 1;	// also read the unformatted (OUTPDATA) trace
+	    guint16 bFORM1traces            : 1;	// read traces in the HP8753's internal format
+	    guint16 bArchiveTraces          : 1;	// also append saved traces to the time series archive
 	} flags;
 
 	tRMCtarget RMCdialogTarget;
@@ -389,12 +636,15 @@ typedef struct {
 	GtkPageSetup        *pageSetup;
 	tPaperSize          PDFpaperSize;
 	gchar			    *sLastDirectory;
+	tTouchstoneOptions  touchstoneOptions;
+	tReferenceTrace     referenceTrace;
+	tReformatCache      reformatCache[ eNUM_CH ];
 
 	// names of the currently selected objects
 	tHP8753traceAbstract    *pTraceAbstract;
 	tHP8753cal              *pCalibrationAbstract;
 	gchar			    *sProject;
-	gchar			    *sCalKit;
+	gchar			    *sCalKit;			// calibration kit last sent to the HP8753
 
 	GSource         *messageEventSource;
 	GAsyncQueue     *messageQueueToMain;
@@ -408,6 +658,7 @@ typedef struct {
 	GThread * pGThread;
 	tComplex mousePosition[ eNUM_CH ];
 
+	tCaptureTiming *pPendingCaptureTiming;	// capture waiting for its plot to be drawn
 } tGlobal;
 
 
@@ -511,60 +762,123 @@ extern GHashTable *widgetHashTable;
 #define ESE_USER   64   // User Request
 #define ESE_PWR   128   // Power On
 
-#define SEVER_DIPLOMATIC_RELATIONS -1
 #define THIRTY_MS 0.030
 #define FIVE_SECONDS 5.0
 
 gboolean    addToComboBox( GtkComboBox *, gchar * );
+gint        appendTraceToArchive( tGlobal *, gchar *, gchar *, gint64 );
+void        beginCaptureTiming( tCaptureTiming * );
 void        bezierControlPoints( const tLine *, const tLine *, tComplex *, tComplex * );
+void        binaryTraceToComplex( const guint8 *, gint, gint, tComplex * );
 void        CB_EditableCalibrationProfileName( GtkEditable *, tGlobal * );
 void        CB_EditableProjectName( GtkEditable *, tGlobal * );
 void        CB_EditableTraceProfileName( GtkEditable *, tGlobal * );
 void        CB_Radio_Calibration ( GtkRadioButton *, tGlobal * );
 void        cairo_renderHewlettPackardLogo(cairo_t *, gboolean, gboolean, gdouble, gdouble);
-gint        checkMessageQueue(GAsyncQueue *);
+gint64      capturePhaseMean( tCaptureTiming *, gint, tCapturePhase, gint );
+gint64      capturePhasePercentile( tCaptureTiming *, gint, tCapturePhase, gdouble );
+gint64      captureTimingTotal( tCaptureTiming * );
 void        clearHP8753traces ( tHP8753 * );
 tHP8753cal* cloneCalibrationProfile( tHP8753cal *, gchar * );
 tHP8753traceAbstract*   cloneTraceProfileAbstract( tHP8753traceAbstract *, gchar * );
 void        closeDB ( void );
+void        closeSearchCursor( tSearchCursor * );
 gint        compareCalItemsForFind ( gpointer , gpointer );
 gint        compareCalItemsForSort ( gpointer , gpointer );
 gint        compareCalKitIdentifierItem ( gpointer, gpointer );
 gint        compareTraceItemsForFind ( gpointer , gpointer );
 gint        compareTraceItemsForSort ( gpointer , gpointer );
+void        completeCaptureRedraw( tGlobal * );
+gint        cycleChannelFormat( tGlobal *, eChannel );
 GList*      createIconList( void );
+gint        createSearchIndex( void );
+const gchar* databaseErrorMessage( void );
 guint       deleteDBentry ( tGlobal *, gchar *, gchar *, tDBtable );
 gchar*      doubleToStringWithSpaces( gdouble, gchar * );
 void        drawBezierSpline( cairo_t *, const tComplex *, gint );
 void        drawHPlogo (cairo_t *, gchar *, gdouble , gdouble , gdouble );
 void        drawMarkers( cairo_t *, tGlobal *, tGridParameters *, eChannel , gdouble, gdouble );
+tCaptureTiming* endCaptureTiming( tCaptureTiming *, tHP8753 * );
 gchar*      engNotation ( gdouble, gint, tEngNotation, gchar ** );
+void        exportCSVinBackground( gchar *, tHP8753 * );
+gint        exportProject( gchar *, gchar * );
+gint        exportProjectNumPy( gchar *, GList *, gchar * );
+gint        exportLearnStringIndexes( gchar *, gchar ** );
+void        exportSnPinBackground( gchar *, tSnP *, tTouchstoneOptions * );
+void        exportTouchstoneInBackground( gchar *, tS2P *, tTouchstoneOptions * );
+gint        fetchSearchResults( tSearchCursor *, gint, tSearchResultCallback, gpointer );
+tComplexTrace complexTraceOfPoints( const tComplex *, const gdouble *, gint );
+tComplexTrace complexTraceOfS2P( const tS2P *, tS2Pparameter );
+gint        deriveTrace( tDerivedQuantity, const tComplexTrace *, gdouble, gdouble *, gdouble * );
+gint        derivedQuantityOfFormat( tFormat );
+void        discardStaleReformatCache( tGlobal * );
+void        finishBackgroundExports( void );
 void        flipCairoText( cairo_t * );
+gint        FORM1points( const guint8 * );
+void        FORM1toComplex( const guint8 *, gint, tComplex * );
+gint        formatShortestDouble( gdouble, gchar * );
 gint        getTimeStamp( gchar ** );
 void        freeCalListItem ( gpointer );
+void        freeCaptureTiming( tCaptureTiming * );
+void        freeTimingModelEntry( tTimingModelEntry * );
+void        freeDBstatistics( tDBstatistics * );
+void        freeLearnStringRegistryEntries( GList * );
+void        freeReferenceTrace( tReferenceTrace * );
+void        freeS2P( tS2P * );
+void        freeSwitchSequence( tSwitchSequence * );
 void        freeTraceListItem ( gpointer );
+gint        importLearnStringIndexes( gchar *, gchar ** );
+gint        importProject( gchar *, gchar *, tImportPolicy, gchar ** );
+void        invalidateReformatCache( tGlobal *, eChannel );
+void        initializeDBstatisticsPanel( tGlobal * );
+void        initializeCaptureTimingPanel( tGlobal * );
+void        initializeGPIBtracePanel( tGlobal * );
 void        initializeFORM1exponentTable ( void );
+void        invalidateTraceCache( gchar *, gchar * );
 gint        inventoryProjects ( tGlobal * );
+GList*      inventoryCaptureTimingInstruments( void );
 gint        inventorySavedCalibrationKits ( tGlobal * );
 gint        inventorySavedSetupsAndCal ( tGlobal * );
 guint       inventorySavedTraceNames( tGlobal * );
+gboolean    learnStringIndexesComplete( tLearnStringIndexes * );
+GList*      learnStringRegistryEntries( gboolean );
+gint        loadReferenceTrace( tReferenceTrace *, gchar *, gchar ** );
+tSwitchSequence* loadSwitchSequence( gchar *, gchar ** );
 void        logVersion( void );
+tLearnStringIndexes* lookupLearnStringIndexes( const gchar *, gint );
 gint        openOrCreateDB ( void ) ;
+tSearchCursor* openSearchCursor( tSearchQuery * );
 gboolean    plotA( guint, guint, gdouble, cairo_t *, tGlobal * );
 gboolean    plotB( guint, guint, gdouble, cairo_t *, tGlobal * );
 gint        populateCalComboBoxWidget( tGlobal * );
 gint        populateProjectComboBoxWidget( tGlobal * );
 gint        populateTraceComboBoxWidget( tGlobal * );
+gint        queryTraceArchive( gchar *, gchar *, eChannel, gint64, gint64, tArchiveSweepCallback, gpointer );
+gint        readTouchstone( gchar *, tS2P *, gdouble *, gchar ** );
+gint        rebuildSearchIndex( void );
+gint        reformatChannel( tGlobal *, eChannel, tFormat );
+gboolean    recallTraceFromCache( tHP8753 *, gchar *, gchar * );
 gint        recoverCalibrationAndSetup ( tGlobal *, gchar *, gchar * );
 gint        recoverCalibrationKit ( tGlobal *, gchar * );
+gint        recoverCaptureTimings( gchar *, gint, gint, tCaptureTiming ** );
+gint        recoverLearnStringIndexes( void );
 gint        recoverProgramOptions( tGlobal * );
+gint        recoverTimingModel( void );
 gint        recoverTraceData ( tGlobal *, gchar *, gchar * );
+void        restoreChannelFormats( tGlobal *, tFormat [ eNUM_CH ] );
+tComplex*   referenceTracePoints( tGlobal *, eChannel );
+tLearnStringIndexes* registerLearnStringIndexes( const gchar *, tLearnStringIndexes * );
+void        requestDBmaintenance( gboolean );
 gint        renameMoveCopyDBitems(tGlobal *, tRMCtarget, tRMCpurpose, gchar *, gchar *, gchar *);
+gint        reserveS2P( tS2P *, gint );
 void        rightJustifiedCairoText( cairo_t *, gchar *, gdouble, gdouble );
 gint        saveCalibrationAndSetup ( tGlobal *, gchar *, gchar * );
 gint        saveCalKit ( tGlobal *pGlobal );
+gint        saveCaptureTiming( tCaptureTiming * );
 gint        saveLearnStringAnalysis ( tGlobal *, tLearnStringIndexes * );
+gint        saveLearnStringIndexes( void );
 gint        saveProgramOptions ( tGlobal * );
+gint        saveTimingModel( void );
 tHP8753cal* selectCalibrationProfile( tGlobal *, gchar *, gchar * );
 gint        saveTraceData ( tGlobal *, gchar *, gchar * );
 tHP8753cal* selectFirstCalibrationProfileInProject( tGlobal * );
@@ -576,14 +890,43 @@ void        setCairoColor( cairo_t *, eColor );
 void        setCairoFontSize( cairo_t *, gdouble );
 gboolean    setGtkComboBox( GtkComboBox *, gchar * );
 gint        setNotePageColorButton (tGlobal *, gboolean );
+void        setTraceCacheBudget( gsize );
 void        setUseGPIBcardNoAndPID( tGlobal *, gboolean );
+void        shareS2P( tS2P *, tS2P * );
+void        showAcquiredFormats( tGlobal *, tFormat [ eNUM_CH ] );
 void        showCalInfo( tHP8753cal *, tGlobal * );
+void        showCaptureTimingStatistics( tGlobal *, gchar *, gint );
+void        showDBstatistics( tGlobal *, tDBstatistics * );
+void        showGPIBtransactionStatistics( tGlobal * );
+void        showExportProjectDialog( tGlobal * );
+void        showExportProjectNumPyDialog( tGlobal * );
+void        showExportTraceArchiveDialog( tGlobal * );
+void        showImportProjectDialog( tGlobal * );
+void        showMultiportCaptureDialog( tGlobal * );
+void        showReferenceTraceDialog( tGlobal * );
 void        showRenameMoveCopyDialog( tGlobal * );
+void        showSearchWindow( tGlobal * );
+gint        startDBmaintenance( void );
+void        stopDBmaintenance( void );
 gint        smithHighResPDF( tGlobal *, gchar *, eChannel );
+gint        S2PparameterOfMeasurement( gint );
 gint        splineInterpolate( gint, tComplex [], gdouble, tComplex * );
+void        startCapturePhase( tCaptureTiming *, tCapturePhase );
+GList*      timingModelEntries( void );
+gdouble     timingModelEstimate( tHP8753 *, tTimedOperation, gint, gdouble );
+void        timingModelLearn( tHP8753 *, tTimedOperation, gint, gdouble, gdouble, gboolean );
+void        timingModelRestore( tTimingModelEntry * );
+gdouble     timingModelTimeout( tHP8753 *, tTimedOperation, gint, gdouble, gdouble );
+void        storeTraceInCache( tHP8753 *, guint, gchar *, gchar * );
 gpointer    threadGPIB (gpointer);
 void        updateCalComboBox( gpointer , gpointer );
 void        visibilityFramePlot_B ( tGlobal *, gint );
+gint        writeCSV( gchar *, tHP8753 * );
+gint        writeSnPTouchstone( gchar *, tSnP *, tTouchstoneOptions * );
+gint        writeTouchstone( gchar *, tS2P *, tTouchstoneOptions * );
+gint        writeS2PNumPy( gchar *, tS2P * );
+gint        writeTraceArchiveCSV( gchar *, gchar *, gchar *, gchar ** );
+gint        writeTraceNumPy( gchar *, tHP8753 * );
 
 extern tGlobal globalData;
 
@@ -591,16 +934,17 @@ typedef struct { gchar *code, *desc; } HP8753_option;
 extern const HP8753_option optMeasurementType[];
 extern const HP8753_option optFormat[];
 extern const HP8753_option optCalType[];
+extern const gint nOptMeasurementType, nOptFormat, nOptCalType;
 extern const HP8753_option optSweepType[];
 
 extern const gchar *formatSymbols[];
 extern const gchar *formatSmithOrPolarSymbols[][2];
 extern const gchar *sweepSymbols[];
+extern const gchar *capturePhaseNames[];
 extern const gint numOfCalArrays[];
 
 #define lengthFORM1data(x) (GUINT16_FROM_BE(*(guint16 *)((x)+2)) + 4)
 #define DISCOVERED_LS_INDEXES	0
-extern tLearnStringIndexes learnStringIndexes[];
 
 #undef SINGLE_SWEEP_BEFORE_SAVE
 #define CLEAN_SWEEP_AFTER_RECALL
@@ -633,6 +977,16 @@ extern tLearnStringIndexes learnStringIndexes[];
 #define STIMULUS_LEGEND_FONT "Nimbus Sans"
 #define HPGL_FONT "Noto Sans Mono Light"   // OR "Noto Sans Mono ExtraLight"
 
+#define TRACE_CACHE_BUDGET	(32 * 1024 * 1024)	// memory for recently recalled trace profiles
+
+#define DB_MAINTENANCE_DELAY	120		// s after startup before the first database maintenance
+#define DB_MAINTENANCE_INTERVAL	3600	// s between database maintenance
+#define DB_IDLE_TIME			30		// s without database activity before maintenance may run
+#define DB_VACUUM_STEP			64		// pages released by each incremental vacuum transaction
+#define DB_BUSY_TIMEOUT			2000	// ms to wait for the other connection to release a lock
+#define DB_ANALYSIS_LIMIT		400		// rows of each index sampled by ANALYZE
+#define DB_ARCHIVE_MAX_SWEEPS	10000	// archived sweeps kept for each trace profile and channel
+
 #define TIMEOUT_SWEEP	200		// if 10Hz RBW and 1601 points, it may take a long time to sweep
 #define LOCAL_DELAYms   50		// Delay after going to local from remote
 
@@ -659,7 +1013,7 @@ g_memdup2(gconstpointer mem, gsize byte_size) {
 	if( globalData.flags.bbDebug >= level ) \
 		LOG( G_LOG_LEVEL_DEBUG, message, ## __VA_ARGS__)
 
-#define CURRENT_DB_SCHEMA	2
+#define CURRENT_DB_SCHEMA	6
 // This character separates project name from item name in database
 // ... its more complicated to ensure compatability with older database schemas
 #define ETX 0x03
@@ -17,12 +17,19 @@
 #ifndef HP8753COMMS_H_
 #define HP8753COMMS_H_
 
+typedef struct {
+	gint64	instrumentTime;		// us from command to header
+	gint64	transferTime;		// us to read the data
+	gint	nBytes;				// including the header
+} tTraceTransferTiming;
+
 gboolean askOption( gint descGPIB_HP8753, gchar *option, gint *pGPIBstatus );
 
 gint askHP8753_dbl(gint descGPIB_HP8753, gchar *mnemonic, gdouble *dresult, gint *pGPIBstatus);
 
 gint getHP8753channelListFreqSegments(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel, gint *pGPIBstatus );
 gint getHP8753channelTrace(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel, gint *pGPIBstatus );
+gint benchmarkHP8753traceFormats( gint descGPIB_HP8753, gint *pGPIBstatus );
 gint acquireHPGLplot( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus );
 gint get8753firmwareVersion(gint descGPIB_HP8753, gchar **psProduct, gint *pGPIBstatus);
 
@@ -53,11 +60,14 @@ gint setHP8753channel( gint descGPIB_HP8753, eChannel channel, gint *pGPIBstatus
 
 gint getHP3753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus );
 gint getHP3753_S1P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus );
+gint measureHP8753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal,
+		void (*sweepsComplete)( gpointer ), gpointer pUserData, gint *pGPIBstatus );
+gint getHP8753_SnP( gint descGPIB_HP8753, tGlobal *pGlobal, tSwitchSequence *pSequence, gint *pGPIBstatus );
 
 #define MAX_OUTPCAL_LEN	15
 
 enum { eCALtypeNONE = 0, eCALtypeRESPONSE = 1, eCALtypeRESPONSEandISOLATION = 2, eCALtypeS11onePort = 3,
-	   eCALtypeS22onePort = 4, eCALtypeFullTwoPort = 5, eCALtype1pathTwoPort = 6, eCALtypeTRL_LRM_TwoPort = 8
+	   eCALtypeS22onePort = 4, eCALtypeFullTwoPort = 5, eCALtype1pathTwoPort = 6, eCALtypeTRL_LRM_TwoPort = 7
 };
 
 #endif /* HP8753_H_ */
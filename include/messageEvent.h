@@ -22,6 +22,7 @@ gboolean messageEventCheck (GSource *);
 gboolean messageEventDispatch (GSource *, GSourceFunc, gpointer);
 
 #define MSG_STRING_SIZE 256
+#define MESSAGE_RING_SIZE 128	// messages from the GPIB thread awaiting the main loop (power of 2)
 
 
 enum _threadmessage
@@ -36,6 +37,9 @@ enum _threadmessage
 	TM_SAVE_LEARN_STRING_ANALYSIS,		// save analyzed learn string indexes
 	TM_SAVE_S1P,						// save calibration and setup to database
 	TM_SAVE_S2P,
+	TM_SAVE_SNP,						// save the S3P / S4P from a switch matrix sequence
+	TM_DB_STATISTICS,					// show database statistics on the options page
+	TM_CAPTURE_TIMING,					// phase times of a trace capture (awaiting the redraw)
 	TG_SETUP_GPIB,						// configure GPIB
 	TG_RETRIEVE_SETUPandCAL_from_HP8753,// get current calibration and setup
 	TG_SEND_SETUPandCAL_to_HP8753,		// restore calbration and setup
@@ -43,8 +47,10 @@ enum _threadmessage
 	TG_RETRIEVE_TRACE_from_HP8753,		// get traces
 	TG_MEASURE_and_RETRIEVE_S2P_from_HP8753,	// S2P
 	TG_MEASURE_and_RETRIEVE_S1P_from_HP8753,    // S1P
+	TG_MEASURE_and_RETRIEVE_SNP_from_HP8753,    // S3P / S4P through a switch matrix
 	TG_ANALYZE_LEARN_STRING,			// get learn string and find the indexes to setup data
 	TG_UTILITY,
+	TG_BENCHMARK_TRACE_FORMATS,			// time trace transfers in FORM1/2/3
 	TG_EXPERIMENT,
 	TG_ABORT,
 	TG_END								// end thread
@@ -56,8 +62,29 @@ typedef struct
     gchar *		sMessage;
     void  *		data;
     gint		dataLength;
+    guint		token;		// GPIB job: order of posting (cancelled by a later abort)
+    gint64		posted;		// GPIB job: when it was queued (monotonic us)
+    gboolean	bOverflow;	// to the main loop: posted by the GPIB thread while its ring was full
 } messageEventData;
 
+// GPIB jobs are run in this order (then in the order they were posted)
+typedef enum {
+	eJOB_ABORT,							// abort & end (cancel everything queued before)
+	eJOB_RESTORE,						// GPIB setup and restoring the HP8753
+	eJOB_CAPTURE,						// traces, calibration, learn string & Touchstone measurements
+	eJOB_BACKGROUND,					// utility, benchmark & experiment
+	eJOB_NUM_PRIORITIES
+} tGPIBjobPriority;
+
+typedef struct {
+	guint		nJobs;					// jobs run
+	guint		nCoalesced;				// duplicates dropped while one was queued
+	guint		nCancelled;				// jobs discarded by an abort before they ran
+	guint		maxDepth;				// jobs queued (at the start of a job of this priority)
+	gint64		totalWait, maxWait;		// us between posting and starting
+	gint64		totalRun, maxRun;		// us running
+} tGPIBjobStatistics;
+
 
 extern GSourceFuncs 	messageEventFunctions;
 
@@ -66,6 +93,15 @@ void postMessageToMainLoop (enum _threadmessage Command, gchar *sMessage);
 void postInfoWithCount(gchar *sMessageWithFormat, gint number, gint number2);
 void postDataToMainLoop (enum _threadmessage Command, void *data);
 void postDataToGPIBThread (enum _threadmessage Command, void *data);
+void claimMessageRing( void );
+
+gboolean queueGPIBjob( GAsyncQueue *, messageEventData * );
+messageEventData *nextGPIBjob( GAsyncQueue * );
+void finishGPIBjob( messageEventData * );
+gboolean GPIBjobCancelled( void );
+guint GPIBjobQueueDepth( void );
+void GPIBjobStatistics( tGPIBjobStatistics [ eJOB_NUM_PRIORITIES ] );
+extern const gchar *GPIBjobPriorityNames[ eJOB_NUM_PRIORITIES ];
 
 #define postInfo(x)		postMessageToMainLoop( TM_INFO, (x) )
 #define postError(x)	{ postMessageToMainLoop( TM_ERROR, (x) ); LOG( G_LOG_LEVEL_CRITICAL, (x) ); }
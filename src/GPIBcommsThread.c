@@ -119,40 +119,6 @@ GPIBwriteOneOfN( gint GPIBdescriptor, const void *sData, gint number, gint *GPIB
 }
 #endif
 
-/*!     \brief  See if there are messages on the asynchronous queue
- *
- * If the argument contains a pointer to a queue, set the default queue to it
- *
- * Check the queue and report the number of messages
- *
- * \param asyncQueue  pointer to async queue (or NULL)
- * \return            number of messages in queue
- */
-gint
-checkMessageQueue(GAsyncQueue *asyncQueue) {
-    static GAsyncQueue *queueToCheck = NULL;
-    int queueLength;
-
-    if (asyncQueue)
-        queueToCheck = asyncQueue;
-
-    if (!asyncQueue && queueToCheck) {
-        queueLength = g_async_queue_length(queueToCheck);
-        if (queueLength > 0) {
-            messageEventData *message = g_async_queue_pop(queueToCheck);
-            gint command = message->command;
-            g_async_queue_push_front(queueToCheck, message);
-            if (command == TG_ABORT || command == TG_END)
-                return SEVER_DIPLOMATIC_RELATIONS;
-        } else {
-            return queueLength;
-        }
-        return queueLength;
-    } else {
-        return 0;
-    }
-}
-
 /*!     \brief  Write data from the GPIB device asynchronously
  *
  * Read data from the GPIB device asynchronously while checking for exceptions
@@ -172,18 +138,29 @@ GPIBasyncWriteBinary(gint GPIBdescriptor, const void *sData, gint length, gint *
     gint currentTimeout;
     gdouble waitTime = 0.0;
     tGPIBReadWriteStatus rtn = eRDWT_CONTINUE;
+    gint64 startTime, waitStartTime;
 
     if (GPIBfailed(*pGPIBstatus)) {
         return eRDWT_PREVIOUS_ERROR;
     }
 
-    ibask(GPIBdescriptor, IbaTMO, &currentTimeout);
-    ibtmo(GPIBdescriptor, TNONE);
+    startTime = g_get_monotonic_time();
+    if (GPIBreplaying()) {
+        rtn = replayGPIBtransaction(eGPIB_WRITE, (void *) sData, length, pGPIBstatus);
+        recordGPIBtransaction(eGPIB_WRITE, sData, length, GPIBasyncCount(), startTime,
+                g_get_monotonic_time() - startTime, rtn);
+        return rtn;
+    }
+    GPIBask(GPIBdescriptor, IbaTMO, &currentTimeout);
+    GPIBtmo(GPIBdescriptor, TNONE);
 
     *pGPIBstatus = ibwrta(GPIBdescriptor, sData, length);
 
-    if (GPIBfailed(*pGPIBstatus))
+    if (GPIBfailed(*pGPIBstatus)) {
+        recordGPIBtransaction(eGPIB_WRITE, sData, length, 0, startTime, 0, eRDWT_ERROR);
         return eRDWT_ERROR;
+    }
+    waitStartTime = g_get_monotonic_time();
 #ifdef GPIB_PRE_4_3_6
     //todo - remove when linux GPIB driver fixed
     // a bug in the drive means that the timout used for the ibrda command is not accessed immediatly
@@ -192,19 +169,22 @@ GPIBasyncWriteBinary(gint GPIBdescriptor, const void *sData, gint length, gint *
 #endif
 
     // set the timout for the ibwait to 30ms
-    ibtmo(GPIBdescriptor, T30ms);
+    GPIBtmo(GPIBdescriptor, T30ms);
     do {
         // Wait for read completion or timeout
         *pGPIBstatus = ibwait(GPIBdescriptor, TIMO | CMPL | END);
         if ((*pGPIBstatus & TIMO) == TIMO) {
             // Timeout
             rtn = eRDWT_CONTINUE;
-            waitTime += THIRTY_MS;
+            waitTime = (g_get_monotonic_time() - waitStartTime) / (gdouble)G_USEC_PER_SEC;
             if (waitTime > FIVE_SECONDS && fmod(waitTime, 1.0) < THIRTY_MS) {
                 gchar *sMessage = g_strdup_printf("✍🏻 Waiting for HP8753: %ds", (gint) (waitTime));
                 postInfo(sMessage);
                 g_free(sMessage);
             }
+            // Convert data (etc.) while the HP8753 is busy (the completion is seen after the slice)
+            if (GPIBtasksPending())
+                runGPIBtasks(TASK_SLICE_us, INVALID);
         } else {
             // did we have a read error
             if ((*pGPIBstatus & ERR) == ERR)
@@ -213,8 +193,8 @@ GPIBasyncWriteBinary(gint GPIBdescriptor, const void *sData, gint length, gint *
             else if ((*pGPIBstatus & CMPL) == CMPL || (*pGPIBstatus & END) == END)
                 rtn = eRDWT_OK;
         }
-        // If we get a message on the queue, it is assumed to be an abort
-        if (checkMessageQueue( NULL) == SEVER_DIPLOMATIC_RELATIONS) {
+        // The job has been cancelled (by an abort)
+        if (GPIBjobCancelled()) {
             // This will stop future GPIB commands for this sequence
             *pGPIBstatus |= ERR;
             rtn = eRDWT_ABORT;
@@ -227,6 +207,8 @@ GPIBasyncWriteBinary(gint GPIBdescriptor, const void *sData, gint length, gint *
     *pGPIBstatus = AsyncIbsta();
 
     DBG(eDEBUG_EXTREME, "🖊 HP8753: %d / %d bytes", AsyncIbcnt(), length);
+    recordGPIBtransaction(eGPIB_WRITE, sData, length, AsyncIbcnt(), startTime,
+            g_get_monotonic_time() - waitStartTime, rtn == eRDWT_CONTINUE ? eRDWT_TIMEOUT : rtn);
 
     if ((*pGPIBstatus & CMPL) != CMPL) {
         if (waitTime >= timeoutSecs)
@@ -236,7 +218,7 @@ GPIBasyncWriteBinary(gint GPIBdescriptor, const void *sData, gint length, gint *
             LOG(G_LOG_LEVEL_CRITICAL, "GPIB async write status/error: %04X/%d", *pGPIBstatus,
                     AsyncIberr());
     }
-    ibtmo(GPIBdescriptor, currentTimeout);
+    GPIBtmo(GPIBdescriptor, currentTimeout);
 
     if ( waitTime > FIVE_SECONDS )
     	postInfo("");
@@ -304,18 +286,29 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
     gint currentTimeout;
     gdouble waitTime = 0.0;
     tGPIBReadWriteStatus rtn = eRDWT_CONTINUE;
+    gint64 startTime, waitStartTime;
 
     if (GPIBfailed(*pGPIBstatus)) {
         return eRDWT_PREVIOUS_ERROR;
     }
 
-    ibask(GPIBdescriptor, IbaTMO, &currentTimeout);
+    startTime = g_get_monotonic_time();
+    if (GPIBreplaying()) {
+        rtn = replayGPIBtransaction(eGPIB_READ, readBuffer, maxBytes, pGPIBstatus);
+        recordGPIBtransaction(eGPIB_READ, readBuffer, maxBytes, GPIBasyncCount(), startTime,
+                g_get_monotonic_time() - startTime, rtn);
+        return rtn;
+    }
+    GPIBask(GPIBdescriptor, IbaTMO, &currentTimeout);
     // for the read itself we have no timeout .. we loop using ibwait with short timeout
-    ibtmo(GPIBdescriptor, TNONE);
+    GPIBtmo(GPIBdescriptor, TNONE);
     *pGPIBstatus = ibrda(GPIBdescriptor, readBuffer, maxBytes);
 
-    if (GPIBfailed(*pGPIBstatus))
+    if (GPIBfailed(*pGPIBstatus)) {
+        recordGPIBtransaction(eGPIB_READ, NULL, maxBytes, 0, startTime, 0, eRDWT_ERROR);
         return eRDWT_ERROR;
+    }
+    waitStartTime = g_get_monotonic_time();
 
 #ifdef GPIB_PRE_4_3_6
     //todo - remove when linux GPIB driver fixed
@@ -325,19 +318,22 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
 #endif
 
     // set the timout for the ibwait to 30ms
-    ibtmo(GPIBdescriptor, T30ms);
+    GPIBtmo(GPIBdescriptor, T30ms);
     do {
         // Wait for read completion or timeout
         *pGPIBstatus = ibwait(GPIBdescriptor, TIMO | CMPL | END);
         if ((*pGPIBstatus & TIMO) == TIMO) {
             // Timeout
             rtn = eRDWT_CONTINUE;
-            waitTime += THIRTY_MS;
+            waitTime = (g_get_monotonic_time() - waitStartTime) / (gdouble)G_USEC_PER_SEC;
             if (waitTime > FIVE_SECONDS && fmod(waitTime, 1.0) < THIRTY_MS) {
                 gchar *sMessage = g_strdup_printf("👀 Waiting for HP8753: %ds", (gint) (waitTime));
                 postInfo(sMessage);
                 g_free(sMessage);
             }
+            // Convert data (etc.) while the HP8753 is busy (the completion is seen after the slice)
+            if (GPIBtasksPending())
+                runGPIBtasks(TASK_SLICE_us, INVALID);
         } else {
             // did we have a read error
             if ((*pGPIBstatus & ERR) == ERR)
@@ -346,8 +342,8 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
             else if ((*pGPIBstatus & CMPL) == CMPL || (*pGPIBstatus & END) == END)
                 rtn = eRDWT_OK;
         }
-        // If we get a message on the queue, it is assumed to be an abort
-        if (checkMessageQueue( NULL) == SEVER_DIPLOMATIC_RELATIONS) {
+        // The job has been cancelled (by an abort)
+        if (GPIBjobCancelled()) {
             // This will stop future GPIB commands for this sequence
             *pGPIBstatus |= ERR;
             rtn = eRDWT_ABORT;
@@ -360,6 +356,8 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
     *pGPIBstatus = AsyncIbsta();
 
     DBG(eDEBUG_EXTREME, "👓 HP8753: %d bytes (%d max)", AsyncIbcnt(), maxBytes);
+    recordGPIBtransaction(eGPIB_READ, readBuffer, maxBytes, AsyncIbcnt(), startTime,
+            g_get_monotonic_time() - waitStartTime, rtn == eRDWT_CONTINUE ? eRDWT_TIMEOUT : rtn);
 
     if ((*pGPIBstatus & CMPL) != CMPL) {
         if (waitTime >= timeoutSecs)
@@ -373,7 +371,7 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
     if ( waitTime > FIVE_SECONDS )
     	postInfo("");
 
-    ibtmo(GPIBdescriptor, currentTimeout);
+    GPIBtmo(GPIBdescriptor, currentTimeout);
     if( rtn == eRDWT_CONTINUE ) {
         *pGPIBstatus |= ERR_TIMEOUT;
         return (eRDWT_TIMEOUT);
@@ -394,7 +392,7 @@ GPIBasyncRead(gint GPIBdescriptor, void *readBuffer, long maxBytes, gint *pGPIBs
  */
 int
 GPIBreadConfiguration(gint GPIBdescriptor, gint option, gint *result, gint *pGPIBstatus) {
-    *pGPIBstatus = ibask(GPIBdescriptor, option, result);
+    *pGPIBstatus = GPIBask(GPIBdescriptor, option, result);
 
     if (GPIBfailed(*pGPIBstatus))
         return ERROR;
@@ -429,18 +427,22 @@ pingGPIBdevice(gint descGPIBdevice, gint *pGPIBstatus) {
 
     gshort bFound = FALSE;
 
+    // the recording answers for the HP8753
+    if (GPIBreplaying())
+        return TRUE;
+
     // Get the device PID
-    if ((*pGPIBstatus = ibask(descGPIBdevice, IbaPAD, &PID)) & ERR)
+    if ((*pGPIBstatus = GPIBask(descGPIBdevice, IbaPAD, &PID)) & ERR)
         goto err;
     // Get the board number
-    if ((*pGPIBstatus = ibask(descGPIBdevice, IbaBNA, &descGPIBboard)) & ERR)
+    if ((*pGPIBstatus = GPIBask(descGPIBdevice, IbaBNA, &descGPIBboard)) & ERR)
         goto err;
 
     // save old timeout
-    if ((*pGPIBstatus = ibask(descGPIBboard, IbaTMO, &timeout)) & ERR)
+    if ((*pGPIBstatus = GPIBask(descGPIBboard, IbaTMO, &timeout)) & ERR)
         goto err;
     // set new timeout (for ping purpose only)
-    if ((*pGPIBstatus = ibtmo(descGPIBboard, T3s)) & ERR)
+    if ((*pGPIBstatus = GPIBtmo(descGPIBboard, T3s)) & ERR)
         goto err;
 
     // Actually do the ping
@@ -450,14 +452,11 @@ pingGPIBdevice(gint descGPIBdevice, gint *pGPIBstatus) {
         goto err;
     }
 
-    *pGPIBstatus = ibtmo(descGPIBboard, timeout);
+    *pGPIBstatus = GPIBtmo(descGPIBboard, timeout);
 
     err: return (bFound);
 }
 
-#define GPIB_EOI		TRUE
-#define	GPIB_EOS_NONE	0
-
 /*!     \brief  open the GPIB device
  *
  * Get the device descriptors of the contraller and GPIB device
@@ -482,22 +481,30 @@ findGPIBdescriptors(tGlobal *pGlobal, gint *pDescGPIB_HP8753) {
     // raise(SIGSEGV);
 
     if (*pDescGPIB_HP8753 != INVALID) {
-        ibonl(*pDescGPIB_HP8753, 0);
+        unregisterSRQdevice(*pDescGPIB_HP8753);
+        GPIBonl(*pDescGPIB_HP8753, 0);
     }
 
     *pDescGPIB_HP8753 = INVALID;
 
+    if (GPIBreplaying()) {
+        *pDescGPIB_HP8753 = GPIB_REPLAY_DESCRIPTOR;
+        registerSRQdevice(*pDescGPIB_HP8753);
+        postInfo("Replaying recorded GPIB session");
+        return 0;
+    }
+
     // Look for the HP8753
     if (pGlobal->flags.bGPIB_UseCardNoAndPID) {
         if (pGlobal->GPIBcontrollerIndex >= 0 && pGlobal->GPIBdevicePID >= 0)
-            *pDescGPIB_HP8753 = ibdev(pGlobal->GPIBcontrollerIndex, pGlobal->GPIBdevicePID, 0, T3s,
+            *pDescGPIB_HP8753 = GPIBdev(pGlobal->GPIBcontrollerIndex, pGlobal->GPIBdevicePID, 0, T3s,
                     GPIB_EOI, GPIB_EOS_NONE);
         else {
             postError("Bad GPIB controller or device number");
             return ERROR;
         }
     } else {
-        *pDescGPIB_HP8753 = ibfind(pGlobal->sGPIBdeviceName);
+        *pDescGPIB_HP8753 = GPIBfind(pGlobal->sGPIBdeviceName);
         ibeot(*pDescGPIB_HP8753, GPIB_EOI);
     }
 
@@ -511,7 +518,8 @@ findGPIBdescriptors(tGlobal *pGlobal, gint *pDescGPIB_HP8753) {
         return ERROR;
     } else {
         postInfo("Contact with HP8753 established");
-        ibloc(*pDescGPIB_HP8753);
+        registerSRQdevice(*pDescGPIB_HP8753);
+        GPIBloc(*pDescGPIB_HP8753);
         usleep( LOCAL_DELAYms * 1000);
     }
     return 0;
@@ -529,7 +537,8 @@ GPIBclose(gint *pDescGPIB_HP8753) {
     gint GPIBstatusDevice = 0;
 
     if (*pDescGPIB_HP8753 != INVALID) {
-        GPIBstatusDevice = ibonl(*pDescGPIB_HP8753, 0);
+        unregisterSRQdevice(*pDescGPIB_HP8753);
+        GPIBstatusDevice = GPIBonl(*pDescGPIB_HP8753, 0);
         *pDescGPIB_HP8753 = INVALID;
     }
 
@@ -570,6 +579,7 @@ threadGPIB(gpointer _pGlobal) {
     gboolean bRunning = TRUE;
     gulong __attribute__((unused)) datum = 0;
     static guchar *pHP8753_learn = NULL;
+    tCaptureTiming captureTiming;
 
     // The HP8753 formats numbers like 3.141 not, the continental European way 3,14159
     setlocale(LC_NUMERIC, "C");
@@ -595,10 +605,11 @@ threadGPIB(gpointer _pGlobal) {
 
     // loop waiting for messages from the main loop
 
-    // Set the default queue to check for interruptions to async GPIB reads
-    checkMessageQueue(pGlobal->messageQueueToGPIB);
+    // Messages to the main loop from this thread go through the (allocation free) message ring
+    claimMessageRing();
 
-    while (bRunning && (message = g_async_queue_pop(pGlobal->messageQueueToGPIB))) {
+    // jobs are taken by priority (jobs cancelled by an abort are skipped)
+    while (bRunning && (message = nextGPIBjob(pGlobal->messageQueueToGPIB))) {
 
         // Reset the status ..  GPIB_AsyncRead & GBIPwrte will not proceed if this
         // shows an error
@@ -620,30 +631,30 @@ threadGPIB(gpointer _pGlobal) {
             }
             break;
         }
-#define IBLOC(x, y, z) { z = ibloc( x ); y = now_milliSeconds(); usleep( ms( LOCAL_DELAYms ) ); }
+#define IBLOC(x, y, z) { z = GPIBloc( x ); y = now_milliSeconds(); usleep( ms( LOCAL_DELAYms ) ); }
         // Most but not all commands require the GBIB
         if (descGPIB_HP8753 == INVALID) {
             postError("Cannot obtain HP8753 descriptor");
         } else if (!pingGPIBdevice(descGPIB_HP8753, &GPIBstatus)) {
             postError("HP8753 is not responding");
-            ibtmo(descGPIB_HP8753, T1s);
-            GPIBstatus = ibclr(descGPIB_HP8753);
+            GPIBtmo(descGPIB_HP8753, T1s);
+            GPIBstatus = GPIBclear(descGPIB_HP8753);
             usleep(ms(250));
         } else {
             pGlobal->flags.bGPIBcommsActive = TRUE;
-            GPIBstatus = ibask(descGPIB_HP8753, IbaTMO, &timeoutHP8753); /* Remember old timeout */
-            ibtmo(descGPIB_HP8753, T30s);
+            GPIBstatus = GPIBask(descGPIB_HP8753, IbaTMO, &timeoutHP8753); /* Remember old timeout */
+            GPIBtmo(descGPIB_HP8753, T30s);
 #ifdef USE_PRECAUTIONARY_DEVICE_IBCLR
 			// send a clear command to HP8753 ..
 			if( now_milliSeconds() - datum > 2000 )
-			    GPIBstatus = ibclr( descGPIB_HP8753 );
+			    GPIBstatus = GPIBclear( descGPIB_HP8753 );
 #endif
             if (!pGlobal->HP8753.firmwareVersion) {
                 if ((pGlobal->HP8753.firmwareVersion = get8753firmwareVersion(descGPIB_HP8753,
                         &pGlobal->HP8753.sProduct, &GPIBstatus)) == INVALID) {
                     postError("Cannot query identity - cannot proceed");
                     postMessageToMainLoop(TM_COMPLETE_GPIB, NULL);
-                    ibtmo(descGPIB_HP8753, timeoutHP8753);
+                    GPIBtmo(descGPIB_HP8753, timeoutHP8753);
                     continue;
                 }
                 selectLearningStringIndexes(pGlobal);
@@ -653,7 +664,7 @@ threadGPIB(gpointer _pGlobal) {
                 postError("Not an HP8753 - cannot proceed");
                 postMessageToMainLoop(TM_COMPLETE_GPIB, NULL);
                 pGlobal->HP8753.firmwareVersion = 0;
-                ibtmo(descGPIB_HP8753, timeoutHP8753);
+                GPIBtmo(descGPIB_HP8753, timeoutHP8753);
                 continue;
             }
 
@@ -671,10 +682,10 @@ threadGPIB(gpointer _pGlobal) {
                     postError("Could not get setup/cal from HP8753");
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -689,7 +700,7 @@ threadGPIB(gpointer _pGlobal) {
                 // now send it to the network analyzer
 
                 // This can take some time
-                GPIBstatus = ibtmo(descGPIB_HP8753, T30s);
+                GPIBstatus = GPIBtmo(descGPIB_HP8753, T30s);
                 postInfo("Restore setup and calibration");
                 clearHP8753traces(&pGlobal->HP8753);
                 postDataToMainLoop(TM_REFRESH_TRACE, (void*) eCH_ONE);
@@ -700,10 +711,10 @@ threadGPIB(gpointer _pGlobal) {
                 } else {
                     postError("Setup and Calibration failed");
                 }
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -715,6 +726,7 @@ threadGPIB(gpointer _pGlobal) {
                 break;
 
             case TG_RETRIEVE_TRACE_from_HP8753:
+                beginCaptureTiming(&captureTiming);
                 GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
                 // Clear the drawing areas
                 clearHP8753traces(&pGlobal->HP8753);
@@ -747,6 +759,7 @@ threadGPIB(gpointer _pGlobal) {
                     break;
                 }
 
+                startCapturePhase(&captureTiming, eCAPTURE_LEARN_STRING);
                 if (get8753learnString(descGPIB_HP8753, &pHP8753_learn,
                         &GPIBstatus) != 0) {
                     LOG(G_LOG_LEVEL_CRITICAL, "retrieve learn string");
@@ -754,6 +767,7 @@ threadGPIB(gpointer _pGlobal) {
                 }
                 process8753learnString(descGPIB_HP8753, pHP8753_learn, pGlobal, &GPIBstatus);
 
+                startCapturePhase(&captureTiming, eCAPTURE_HOLD);
                 // Hold this channel & see if we need to restart later
                 // We stop sweeping so that the trace and markers give the same data
                 // If the source is coupled, then a single hold works for both channels, if not, we
@@ -761,6 +775,7 @@ threadGPIB(gpointer _pGlobal) {
                 pGlobal->HP8753.channels[ pGlobal->HP8753.activeChannel ].chFlags.bSweepHold = getHP8753switchOnOrOff(descGPIB_HP8753, "HOLD", &GPIBstatus);
                 GPIBasyncWrite(descGPIB_HP8753, "HOLD;", &GPIBstatus, 10.0);
 
+                startCapturePhase(&captureTiming, eCAPTURE_TRACES);
                 postInfo("Get trace data channel");
                 // if dual channel, then get both channels
                 // otherwise just get the active channel
@@ -789,11 +804,13 @@ threadGPIB(gpointer _pGlobal) {
                 if (pGlobal->flags.bDoNotRetrieveHPGLdata) {
                     pGlobal->HP8753.flags.bHPGLdataValid = FALSE;
                 } else {
+                    startCapturePhase(&captureTiming, eCAPTURE_HPGL);
                     postInfo("Acquire HPGL screen plot");
                     if (acquireHPGLplot(descGPIB_HP8753, pGlobal, &GPIBstatus) != 0)
                         postError("Cannot acquire HPGL plot");
                 }
 
+                startCapturePhase(&captureTiming, eCAPTURE_MARKERS);
                 postInfo("Get marker data");
                 getHP8753markersAndSegments(descGPIB_HP8753, pGlobal, &GPIBstatus);
                 // timestamp this plot
@@ -802,6 +819,8 @@ threadGPIB(gpointer _pGlobal) {
                 if (GPIBfailed(GPIBstatus))
                     break;
 
+                // the capture is complete when the plot has been drawn
+                postDataToMainLoop(TM_CAPTURE_TIMING, endCaptureTiming(&captureTiming, &pGlobal->HP8753));
                 // Display the new data
                 if( !pGlobal->HP8753.flags.bShowHPGLplot )
                     postDataToMainLoop(TM_REFRESH_TRACE, eCH_ONE);
@@ -826,10 +845,10 @@ threadGPIB(gpointer _pGlobal) {
                     }
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -845,7 +864,7 @@ threadGPIB(gpointer _pGlobal) {
                 GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
                 postInfo("Measure and retrieve S2P");
                 // This can take some time
-                GPIBstatus = ibtmo(descGPIB_HP8753, T30s);
+                GPIBstatus = GPIBtmo(descGPIB_HP8753, T30s);
 
                 if ( getHP3753_S2P(descGPIB_HP8753, pGlobal, &GPIBstatus) == OK ) {
                     postInfo("Saving S2P to file");
@@ -853,10 +872,10 @@ threadGPIB(gpointer _pGlobal) {
                     message->data = NULL;
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -870,7 +889,7 @@ threadGPIB(gpointer _pGlobal) {
                 GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
                 postInfo("Measure and retrieve S1P");
                 // This can take some time
-                GPIBstatus = ibtmo(descGPIB_HP8753, T30s);
+                GPIBstatus = GPIBtmo(descGPIB_HP8753, T30s);
 
                 if ( getHP3753_S1P(descGPIB_HP8753, pGlobal, &GPIBstatus) == OK ) {
                     postInfo("Saving S1P to file");
@@ -878,10 +897,10 @@ threadGPIB(gpointer _pGlobal) {
                     message->data = NULL;
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -891,23 +910,67 @@ threadGPIB(gpointer _pGlobal) {
                 IBLOC(descGPIB_HP8753, datum, GPIBstatus);
                 break;
 
-            case TG_ANALYZE_LEARN_STRING:
+            case TG_MEASURE_and_RETRIEVE_SNP_from_HP8753:
                 GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
-                postInfo("Discovering Learn String indexes");
+                postInfo("Measure and retrieve S-parameters through switch matrix");
+                // This can take some time
+                GPIBstatus = GPIBtmo(descGPIB_HP8753, T30s);
+
+                if ( getHP8753_SnP(descGPIB_HP8753, pGlobal, (tSwitchSequence *)message->data, &GPIBstatus) == OK ) {
+                    postInfo("Saving S-parameters to file");
+                    postDataToMainLoop(TM_SAVE_SNP, message->data);
+                } else {
+                    freeSwitchSequence( (tSwitchSequence *)message->data );
+                }
+                message->data = NULL;
+
+                GPIBtmo(descGPIB_HP8753, T1s);
+                // clear errors
+                if (GPIBfailed(GPIBstatus)) {
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
+                    usleep(ms(250));
+                } else {
+                    // beep
+                    GPIBasyncWrite(descGPIB_HP8753, "EMIB;CLES;", &GPIBstatus, 1.0);
+                }
+                // local
+                IBLOC(descGPIB_HP8753, datum, GPIBstatus);
+                break;
+
+            case TG_ANALYZE_LEARN_STRING:
+                // The analysis presets the HP8753 .. so only look for what is not yet known
+                {
+                    tLearnStringIndexes *pKnown = lookupLearnStringIndexes(pGlobal->HP8753.sProduct,
+                            pGlobal->HP8753.firmwareVersion);
 
-                if (analyze8753learnString(descGPIB_HP8753, &pGlobal->HP8753.analyzedLSindexes,
-                        &GPIBstatus) == 0) {
-                    postDataToMainLoop(TM_SAVE_LEARN_STRING_ANALYSIS,
-                            &pGlobal->HP8753.analyzedLSindexes);
+                    if (pKnown)
+                        pGlobal->HP8753.analyzedLSindexes = *pKnown;
+                    else
+                        pGlobal->HP8753.analyzedLSindexes = (tLearnStringIndexes){ .version = pGlobal->HP8753.firmwareVersion };
+                }
+
+                if (learnStringIndexesComplete(&pGlobal->HP8753.analyzedLSindexes)) {
+                    postInfo("Learn String indexes for this firmware are known");
                     selectLearningStringIndexes(pGlobal);
                 } else {
-                    postError("Cannot analyze Learn String");
+                    GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
+                    postInfo("Discovering Learn String indexes");
+
+                    if (analyze8753learnString(descGPIB_HP8753, &pGlobal->HP8753.analyzedLSindexes,
+                            &GPIBstatus) == 0) {
+                        registerLearnStringIndexes(pGlobal->HP8753.sProduct, &pGlobal->HP8753.analyzedLSindexes);
+                        postDataToMainLoop(TM_SAVE_LEARN_STRING_ANALYSIS,
+                                &pGlobal->HP8753.analyzedLSindexes);
+                        selectLearningStringIndexes(pGlobal);
+                    } else {
+                        postError("Cannot analyze Learn String");
+                    }
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
                     // beep
@@ -945,15 +1008,21 @@ threadGPIB(gpointer _pGlobal) {
                 }
                 IBLOC(descGPIB_HP8753, datum, GPIBstatus);
                 break;
+            case TG_BENCHMARK_TRACE_FORMATS:
+                postInfo("Timing trace transfers");
+                if( benchmarkHP8753traceFormats( descGPIB_HP8753, &GPIBstatus ) != OK ) {
+                    postError("Trace transfer benchmark failed");
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
+                    usleep(ms(250));
+                }
+                IBLOC(descGPIB_HP8753, datum, GPIBstatus);
+                break;
             case TG_EXPERIMENT:
                 {
                     gint OUTPFORMsize = 0;
                     guint16 OUTPFORMheaderAndSize[2];
                     guint8 *pOUTPFORM = 0;
-                    gdouble real, imag;
-
-                    void
-                    FORM1toDouble( guint8 *, gdouble *, gdouble *, gboolean );
+                    tComplex *pPoints;
 
                     GPIBasyncWrite(descGPIB_HP8753, "FORM1;OUTPFORM;", &GPIBstatus, 1.0);
                     GPIBasyncRead(descGPIB_HP8753, &OUTPFORMheaderAndSize, HEADER_SIZE, &GPIBstatus,
@@ -965,11 +1034,12 @@ threadGPIB(gpointer _pGlobal) {
                     GPIBasyncRead(descGPIB_HP8753, pOUTPFORM, OUTPFORMsize, &GPIBstatus,
                             10 * TIMEOUT_RW_1SEC);
 
-                    for( gint n=0; n < OUTPFORMsize / 6; n++ ) {
-                        FORM1toDouble( pOUTPFORM + (n * 6), &real, &imag, FALSE );
-                        g_printerr( "%20.8lf\n", real );
-                    }
+                    pPoints = g_new( tComplex, OUTPFORMsize / FORM1_POINT_SIZE );
+                    FORM1toComplex( pOUTPFORM, OUTPFORMsize / FORM1_POINT_SIZE, pPoints );
+                    for( gint n=0; n < OUTPFORMsize / FORM1_POINT_SIZE; n++ )
+                        g_printerr( "%20.8lf\n", pPoints[ n ].r );
 
+                    g_free( pPoints );
                     g_free( pOUTPFORM );
                 }
                 IBLOC(descGPIB_HP8753, datum, GPIBstatus);
@@ -984,14 +1054,14 @@ threadGPIB(gpointer _pGlobal) {
                     postError("Cal kit transfer error");
                 }
 
-                ibtmo(descGPIB_HP8753, T1s);
+                GPIBtmo(descGPIB_HP8753, T1s);
                 // clear errors
                 if (GPIBfailed(GPIBstatus)) {
-                    GPIBstatus = ibtmo(descGPIB_HP8753, T1s);
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBstatus = GPIBtmo(descGPIB_HP8753, T1s);
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     usleep(ms(250));
                 } else {
-                    GPIBstatus = ibtmo(descGPIB_HP8753, T1s);
+                    GPIBstatus = GPIBtmo(descGPIB_HP8753, T1s);
                 }
 
                 GPIBasyncWrite(descGPIB_HP8753, "EMIB;CLES;", &GPIBstatus, 1.0);
@@ -1001,9 +1071,9 @@ threadGPIB(gpointer _pGlobal) {
                 postError("Communication Aborted");
                 {   // Clear the interface
                     gint boardIndex = 0;
-                    ibask( descGPIB_HP8753, IbaBNA, &boardIndex);
-                    ibsic( boardIndex );
-                    GPIBstatus = ibclr(descGPIB_HP8753);
+                    GPIBask( descGPIB_HP8753, IbaBNA, &boardIndex);
+                    GPIBsic( boardIndex );
+                    GPIBstatus = GPIBclear(descGPIB_HP8753);
                     GPIBasyncWrite(descGPIB_HP8753, "CLES;", &GPIBstatus,  10 * TIMEOUT_RW_1SEC);
                     IBLOC(descGPIB_HP8753, datum, GPIBstatus);
                 }
@@ -1014,11 +1084,14 @@ threadGPIB(gpointer _pGlobal) {
         }
 
         // restore timeout
-        ibtmo(descGPIB_HP8753, timeoutHP8753);
+        GPIBtmo(descGPIB_HP8753, timeoutHP8753);
 
         if (GPIBfailed(GPIBstatus)) {
             postError("GPIB error or timeout");
         }
+        // complete the host side of the job
+        finishGPIBtasks();
+        finishGPIBjob(message);
         postMessageToMainLoop(TM_COMPLETE_GPIB, NULL);
 
         g_free(message->sMessage);
@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+#include "messageEvent.h"
+
+/*
+ * Jobs for the GPIB thread are kept on its queue sorted by priority (abort,
+ * restore, capture and then background work) and then by the order they were posted.
+ *
+ * Each job is given a token (its place in the posting order). An abort cancels
+ * every job posted before it: the job running sees GPIBjobCancelled() while it
+ * waits for the HP8753 and those still queued are discarded unrun.
+ *
+ * A capture without data (e.g. "Get trace") is not queued again while one is
+ * already waiting.
+ */
+
+const gchar *GPIBjobPriorityNames[ eJOB_NUM_PRIORITIES ] = { "abort", "restore", "capture", "background" };
+
+// protected by the lock of the GPIB queue
+static guint lastToken = 0;
+static guint nPending[ TG_END + 1 ] = { 0 };
+
+static guint cancelBefore = 0;		// jobs with a lower token are cancelled (atomic)
+static guint runningToken = 0;		// GPIB thread only
+static guint queueDepth = 0;		// (atomic)
+
+static GMutex statisticsMutex;
+static tGPIBjobStatistics statistics[ eJOB_NUM_PRIORITIES ];
+
+/*!     \brief  Priority of a GPIB thread command
+ *
+ * \param command       command to the GPIB thread
+ * \return              job priority
+ */
+static tGPIBjobPriority
+jobPriority( enum _threadmessage command ) {
+	switch( command ) {
+	case TG_ABORT:
+	case TG_END:
+		return eJOB_ABORT;
+	case TG_SETUP_GPIB:
+	case TG_SEND_SETUPandCAL_to_HP8753:
+	case TG_SEND_CALKIT_to_HP8753:
+		return eJOB_RESTORE;
+	case TG_UTILITY:
+	case TG_BENCHMARK_TRACE_FORMATS:
+	case TG_EXPERIMENT:
+		return eJOB_BACKGROUND;
+	default:
+		return eJOB_CAPTURE;
+	}
+}
+
+/*!     \brief  Can a second request for the same command be dropped while one is queued
+ *
+ * \param message       job to be queued
+ * \return              TRUE if the job duplicates a queued one
+ */
+static gboolean
+coalescable( messageEventData *message ) {
+	switch( message->command ) {
+	case TG_SETUP_GPIB:
+	case TG_RETRIEVE_TRACE_from_HP8753:
+	case TG_ANALYZE_LEARN_STRING:
+		return message->data == NULL;
+	default:
+		return FALSE;
+	}
+}
+
+/*!     \brief  Order jobs on the GPIB queue
+ *
+ * \param a             job
+ * \param b             job
+ * \param unused        unused
+ * \return              negative if a runs first
+ */
+static gint
+compareJobs( gconstpointer a, gconstpointer b, gpointer unused ) {
+	const messageEventData *pA = a, *pB = b;
+	tGPIBjobPriority priorityA = jobPriority( pA->command ), priorityB = jobPriority( pB->command );
+
+	if( priorityA != priorityB )
+		return priorityA < priorityB ? -1 : 1;
+	return pA->token < pB->token ? -1 : (pA->token > pB->token ? 1 : 0);
+}
+
+/*!     \brief  Free a job that will not be run
+ *
+ * \param message       job
+ */
+static void
+freeJob( messageEventData *message ) {
+	if( message->command == TG_MEASURE_and_RETRIEVE_SNP_from_HP8753 )
+		freeSwitchSequence( (tSwitchSequence *)message->data );
+	else
+		g_free( message->data );
+	g_free( message->sMessage );
+	g_free( message );
+}
+
+/*!     \brief  Queue a job for the GPIB thread
+ *
+ * Called by postDataToGPIBThread.
+ *
+ * \param queue         queue to the GPIB thread
+ * \param message       job (ownership passes to the queue)
+ * \return              TRUE if queued or FALSE if dropped as a duplicate
+ */
+gboolean
+queueGPIBjob( GAsyncQueue *queue, messageEventData *message ) {
+	tGPIBjobPriority priority = jobPriority( message->command );
+
+	g_async_queue_lock( queue );
+	if( coalescable( message ) && nPending[ message->command ] > 0 ) {
+		g_async_queue_unlock( queue );
+		g_mutex_lock( &statisticsMutex );
+		statistics[ priority ].nCoalesced++;
+		g_mutex_unlock( &statisticsMutex );
+		freeJob( message );
+		return FALSE;
+	}
+
+	message->token = ++lastToken;
+	message->posted = g_get_monotonic_time();
+	// stop what the GPIB thread is doing now (before it can take the abort from the queue)
+	if( priority == eJOB_ABORT )
+		g_atomic_int_set( &cancelBefore, message->token );
+	nPending[ message->command ]++;
+	g_async_queue_push_sorted_unlocked( queue, message, compareJobs, NULL );
+	g_atomic_int_set( &queueDepth, g_async_queue_length_unlocked( queue ) );
+	g_async_queue_unlock( queue );
+	return TRUE;
+}
+
+/*!     \brief  Wait for the next job for the GPIB thread
+ *
+ * Jobs cancelled by an abort posted after them are discarded.
+ *
+ * \param queue         queue to the GPIB thread
+ * \return              job to run (freed by the GPIB thread)
+ */
+messageEventData *
+nextGPIBjob( GAsyncQueue *queue ) {
+	messageEventData *message;
+
+	for( ;; ) {
+		guint depth;
+		tGPIBjobPriority priority;
+
+		g_async_queue_lock( queue );
+		message = g_async_queue_pop_unlocked( queue );
+		nPending[ message->command ]--;
+		depth = g_async_queue_length_unlocked( queue );
+		g_atomic_int_set( &queueDepth, depth );
+		g_async_queue_unlock( queue );
+
+		priority = jobPriority( message->command );
+		g_mutex_lock( &statisticsMutex );
+		if( message->token < (guint)g_atomic_int_get( &cancelBefore ) ) {
+			statistics[ priority ].nCancelled++;
+			g_mutex_unlock( &statisticsMutex );
+			DBG( eDEBUG_INFO, "GPIB %s job %u cancelled before it ran", GPIBjobPriorityNames[ priority ], message->token );
+			freeJob( message );
+			continue;
+		}
+
+		gint64 wait = g_get_monotonic_time() - message->posted;
+		statistics[ priority ].nJobs++;
+		statistics[ priority ].totalWait += wait;
+		statistics[ priority ].maxWait = MAX( statistics[ priority ].maxWait, wait );
+		statistics[ priority ].maxDepth = MAX( statistics[ priority ].maxDepth, depth + 1 );
+		g_mutex_unlock( &statisticsMutex );
+
+		runningToken = message->token;
+		// restart the clock to time the job itself
+		message->posted += wait;
+		DBG( eDEBUG_INFO, "GPIB %s job %u waited %.1f ms (%u queued behind it)",
+				GPIBjobPriorityNames[ priority ], message->token, wait / 1.0e3, depth );
+		return message;
+	}
+}
+
+/*!     \brief  The GPIB thread has finished a job
+ *
+ * \param message       job (before it is freed)
+ */
+void
+finishGPIBjob( messageEventData *message ) {
+	tGPIBjobPriority priority = jobPriority( message->command );
+	gint64 run = g_get_monotonic_time() - message->posted;
+
+	g_mutex_lock( &statisticsMutex );
+	statistics[ priority ].totalRun += run;
+	statistics[ priority ].maxRun = MAX( statistics[ priority ].maxRun, run );
+	g_mutex_unlock( &statisticsMutex );
+	DBG( eDEBUG_INFO, "GPIB %s job %u ran %.1f ms%s", GPIBjobPriorityNames[ priority ], message->token,
+			run / 1.0e3, GPIBjobCancelled() ? " (cancelled)" : "" );
+}
+
+/*!     \brief  Has the running job been cancelled by a later abort (or the end of the program)
+ *
+ * Polled by the GPIB thread while it waits for the HP8753.
+ *
+ * \return              TRUE if the current job should be abandoned
+ */
+gboolean
+GPIBjobCancelled( void ) {
+	return runningToken < (guint)g_atomic_int_get( &cancelBefore );
+}
+
+/*!     \brief  Number of jobs waiting for the GPIB thread
+ *
+ * \return              queue depth
+ */
+guint
+GPIBjobQueueDepth( void ) {
+	return g_atomic_int_get( &queueDepth );
+}
+
+/*!     \brief  Copy the job statistics
+ *
+ * \param jobStatistics statistics of each job priority
+ */
+void
+GPIBjobStatistics( tGPIBjobStatistics jobStatistics[ eJOB_NUM_PRIORITIES ] ) {
+	g_mutex_lock( &statisticsMutex );
+	memcpy( jobStatistics, statistics, sizeof( statistics ) );
+	g_mutex_unlock( &statisticsMutex );
+}
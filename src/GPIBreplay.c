@@ -0,0 +1,372 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-2.0/glib.h>
+#include <gpib/ib.h>
+#include "hp8753.h"
+#include "GPIBcomms.h"
+#include "messageEvent.h"
+
+/*
+ * A GPIB session (every write, read, SRQ wait and clear through the async GPIB
+ * layer with the data transferred and the time taken) can be recorded to a file
+ * (--record-gpib). The file can then be replayed (--replay-gpib) in place of the
+ * HP8753: the GPIB thread runs as usual but each transaction is answered from the
+ * recording after the time it originally took (divided by --replay-speed).
+ *
+ * The file is a header followed by the events, each with the bytes written or read.
+ * All values are little endian.
+ */
+
+#define GPIB_SESSION_MAGIC		"HP8753 GPIB log"	// 15 characters and the null
+#define GPIB_SESSION_VERSION	1
+#define REPLAY_SLICE_us			30000				// check for an abort this often while pacing
+
+typedef struct {
+	gchar	magic[ 16 ];
+	guint32	version;
+	guint32	reserved;
+	gint64	realTime;			// when the recording started (us since the epoch)
+} __attribute__((packed)) tGPIBsessionHeader;
+
+typedef struct {
+	guint8	type;				// tGPIBtransactionType
+	guint8	status;				// tGPIBReadWriteStatus
+	guint16	reserved;
+	guint32	nBytes;				// bytes requested
+	guint32	nTransferred;		// bytes transferred (and following this event for writes and reads)
+	guint32	duration;			// us
+	gint64	start;				// us from the start of the recording
+} __attribute__((packed)) tGPIBsessionEvent;
+
+// used only by the GPIB thread once the session is opened
+static FILE *fpRecording = NULL;
+static gint64 recordingStart = 0;
+
+static guint8 *pReplay = NULL;
+static gsize replaySize = 0, replayOffset = 0;
+static gdouble replaySpeed = 1.0;
+static glong replayCount = 0;
+static guint nReplayed = 0;
+static gboolean bReplaying = FALSE;
+
+/*!     \brief  Start recording the GPIB session to a file
+ *
+ * \param sFilename     file to record to
+ * \return              OK or ERROR
+ */
+gint
+startGPIBsessionRecording( gchar *sFilename ) {
+	tGPIBsessionHeader header = { GPIB_SESSION_MAGIC, GUINT32_TO_LE( GPIB_SESSION_VERSION ), 0,
+			GINT64_TO_LE( g_get_real_time() ) };
+
+	if( bReplaying || (fpRecording = fopen( sFilename, "wb" )) == NULL )
+		return ERROR;
+	if( fwrite( &header, sizeof( header ), 1, fpRecording ) != 1 ) {
+		fclose( fpRecording );
+		fpRecording = NULL;
+		return ERROR;
+	}
+	recordingStart = g_get_monotonic_time();
+	LOG( G_LOG_LEVEL_INFO, "Recording GPIB session to %s", sFilename );
+	return OK;
+}
+
+/*!     \brief  Add a transaction to the GPIB session recording
+ *
+ * Called (by recordGPIBtransaction) at the end of each GPIB transaction.
+ *
+ * \param type          write, read, SRQ wait or clear
+ * \param pData         data written or read (or NULL)
+ * \param nBytes        bytes requested
+ * \param nTransferred  bytes transferred
+ * \param start         monotonic time the transaction started
+ * \param duration      us
+ * \param status        result of the transaction
+ */
+void
+recordGPIBsessionEvent( tGPIBtransactionType type, const void *pData, glong nBytes, glong nTransferred,
+		gint64 start, gint64 duration, tGPIBReadWriteStatus status ) {
+	tGPIBsessionEvent event;
+
+	if( fpRecording == NULL )
+		return;
+	if( pData == NULL || nTransferred < 0 )
+		nTransferred = 0;
+
+	event.type = type;
+	event.status = status;
+	event.reserved = 0;
+	event.nBytes = GUINT32_TO_LE( (guint32)MAX( nBytes, 0 ) );
+	event.nTransferred = GUINT32_TO_LE( (guint32)nTransferred );
+	event.duration = GUINT32_TO_LE( (guint32)CLAMP( duration, 0, G_MAXUINT32 ) );
+	event.start = GINT64_TO_LE( start - recordingStart );
+
+	if( fwrite( &event, sizeof( event ), 1, fpRecording ) != 1
+			|| (nTransferred && fwrite( pData, nTransferred, 1, fpRecording ) != 1) ) {
+		LOG( G_LOG_LEVEL_CRITICAL, "GPIB session recording failed ... stopped" );
+		fclose( fpRecording );
+		fpRecording = NULL;
+	}
+}
+
+/*!     \brief  Open a recorded GPIB session to replay
+ *
+ * \param sFilename     recorded session
+ * \param speed         1.0 to replay at the original pace, 10.0 ten times faster or 0 without waiting
+ * \return              OK or ERROR
+ */
+gint
+startGPIBsessionReplay( gchar *sFilename, gdouble speed ) {
+	tGPIBsessionHeader *pHeader;
+	gchar *pContents = NULL;
+	gsize size = 0;
+
+	if( fpRecording || !g_file_get_contents( sFilename, &pContents, &size, NULL ) )
+		return ERROR;
+
+	pHeader = (tGPIBsessionHeader *)pContents;
+	if( size < sizeof( tGPIBsessionHeader )
+			|| memcmp( pHeader->magic, GPIB_SESSION_MAGIC, sizeof( GPIB_SESSION_MAGIC ) ) != 0
+			|| GUINT32_FROM_LE( pHeader->version ) != GPIB_SESSION_VERSION ) {
+		g_free( pContents );
+		return ERROR;
+	}
+
+	pReplay = (guint8 *)pContents;
+	replaySize = size;
+	replayOffset = sizeof( tGPIBsessionHeader );
+	replaySpeed = MAX( speed, 0.0 );
+	nReplayed = 0;
+	bReplaying = TRUE;
+	LOG( G_LOG_LEVEL_INFO, "Replaying GPIB session from %s (speed %g)", sFilename, replaySpeed );
+	return OK;
+}
+
+/*!     \brief  Stop recording or replaying the GPIB session
+ */
+void
+endGPIBsession( void ) {
+	if( fpRecording )
+		fclose( fpRecording );
+	fpRecording = NULL;
+
+	g_free( pReplay );
+	pReplay = NULL;
+	replaySize = replayOffset = 0;
+	bReplaying = FALSE;
+}
+
+/*!     \brief  Is a recorded GPIB session being replayed in place of the HP8753
+ *
+ * \return              TRUE if replaying
+ */
+gboolean
+GPIBreplaying( void ) {
+	return bReplaying;
+}
+
+/*!     \brief  Number of bytes transferred by the last asynchronous read or write
+ *
+ * \return              byte count
+ */
+glong
+GPIBasyncCount( void ) {
+	return bReplaying ? replayCount : AsyncIbcnt();
+}
+
+/*!     \brief  Wait for the time a transaction took when it was recorded
+ *
+ * \param duration      us (before scaling by the replay speed)
+ * \return              TRUE if we have been asked to abort
+ */
+static gboolean
+paceReplay( gint64 duration ) {
+	gint64 remaining = replaySpeed > 0.0 ? (gint64)(duration / replaySpeed) : 0;
+
+	while( remaining > 0 ) {
+		g_usleep( MIN( remaining, REPLAY_SLICE_us ) );
+		remaining -= REPLAY_SLICE_us;
+		if( GPIBjobCancelled() )
+			return TRUE;
+	}
+	return FALSE;
+}
+
+/*!     \brief  Answer a GPIB transaction from the recorded session
+ *
+ * The next recorded event must be of the same type. Data written is compared
+ * with the recording (a difference is only logged) and data read is copied from it.
+ * The GPIB status is set as the hardware would have set it.
+ *
+ * \param type          write, read, SRQ wait or clear
+ * \param pData         data written or the buffer for the data read (or NULL)
+ * \param nBytes        bytes to write or maximum to read
+ * \param pGPIBstatus   pointer to GPIB status
+ * \return              the recorded result (or eRDWT_ERROR if the session has diverged from the recording)
+ */
+tGPIBReadWriteStatus
+replayGPIBtransaction( tGPIBtransactionType type, void *pData, glong nBytes, gint *pGPIBstatus ) {
+	tGPIBsessionEvent event;
+	guint8 *pRecorded;
+	guint32 nRecorded;
+
+	replayCount = 0;
+	if( replayOffset + sizeof( tGPIBsessionEvent ) > replaySize ) {
+		LOG( G_LOG_LEVEL_CRITICAL, "GPIB replay: end of the recording after %u transactions", nReplayed );
+		postError( "GPIB replay: end of the recording" );
+		*pGPIBstatus |= ERR;
+		return eRDWT_ERROR;
+	}
+	memcpy( &event, pReplay + replayOffset, sizeof( tGPIBsessionEvent ) );
+	nRecorded = GUINT32_FROM_LE( event.nTransferred );
+	pRecorded = pReplay + replayOffset + sizeof( tGPIBsessionEvent );
+
+	if( event.type != type || pRecorded + nRecorded > pReplay + replaySize ) {
+		LOG( G_LOG_LEVEL_CRITICAL, "GPIB replay: transaction %u is a %s but a %s was recorded",
+				nReplayed, GPIBtransactionTypeNames[ type ],
+				event.type < eGPIB_NUM_TRANSACTION_TYPES ? GPIBtransactionTypeNames[ event.type ] : "?" );
+		postError( "GPIB replay: the session differs from the recording" );
+		*pGPIBstatus |= ERR;
+		return eRDWT_ERROR;
+	}
+	replayOffset += sizeof( tGPIBsessionEvent ) + nRecorded;
+	nReplayed++;
+
+	switch( type ) {
+	case eGPIB_WRITE:
+		if( pData && (nBytes != GUINT32_FROM_LE( event.nBytes ) || memcmp( pData, pRecorded, MIN( nBytes, nRecorded ) ) != 0) )
+			DBG( eDEBUG_INFO, "GPIB replay: transaction %u writes \"%.*s\" but \"%.*s\" was recorded", nReplayed - 1,
+					(gint)MIN( nBytes, 40 ), (gchar *)pData, (gint)MIN( nRecorded, 40 ), (gchar *)pRecorded );
+		replayCount = nRecorded;
+		break;
+	case eGPIB_READ:
+	case eGPIB_SRQ_WAIT:		// (status byte)
+		replayCount = MIN( nRecorded, (guint32)MAX( nBytes, 0 ) );
+		if( pData )
+			memcpy( pData, pRecorded, replayCount );
+		break;
+	default:
+		break;
+	}
+
+	if( paceReplay( GUINT32_FROM_LE( event.duration ) ) ) {
+		*pGPIBstatus |= ERR;
+		return eRDWT_ABORT;
+	}
+
+	switch( (tGPIBReadWriteStatus)event.status ) {
+	case eRDWT_OK:
+		*pGPIBstatus = CMPL | (type == eGPIB_READ ? END : 0);
+		break;
+	case eRDWT_TIMEOUT:
+		*pGPIBstatus |= ERR_TIMEOUT;
+		break;
+	default:
+		*pGPIBstatus |= ERR;
+		break;
+	}
+	return event.status;
+}
+
+/*
+ * The linux-gpib calls that go to the bus rather than through the async layer.
+ * When a recorded session is replayed there is no GPIB hardware, so these
+ * succeed without doing anything (and the devices opened are stand-ins).
+ */
+
+/*!     \brief  Set the timeout of a device or board (ibtmo)
+ *
+ * \param ud            GPIB descriptor
+ * \param timeout       linux-gpib timeout (TNONE ... T1000s)
+ * \return              GPIB status
+ */
+gint
+GPIBtmo( gint ud, gint timeout ) {
+	return bReplaying ? CMPL : ibtmo( ud, timeout );
+}
+
+/*!     \brief  Read a configuration option of a device or board (ibask)
+ *
+ * \param ud            GPIB descriptor
+ * \param option        the option (IbaPAD, IbaTMO ...)
+ * \param pValue        pointer to the value (unchanged when replaying)
+ * \return              GPIB status
+ */
+gint
+GPIBask( gint ud, gint option, gint *pValue ) {
+	return bReplaying ? CMPL : ibask( ud, option, pValue );
+}
+
+/*!     \brief  Return a device to local control (ibloc)
+ *
+ * \param ud            GPIB descriptor
+ * \return              GPIB status
+ */
+gint
+GPIBloc( gint ud ) {
+	return bReplaying ? CMPL : ibloc( ud );
+}
+
+/*!     \brief  Assert interface clear on a board (ibsic)
+ *
+ * \param ud            GPIB board descriptor
+ * \return              GPIB status
+ */
+gint
+GPIBsic( gint ud ) {
+	return bReplaying ? CMPL : ibsic( ud );
+}
+
+/*!     \brief  Take a device or board on or off line (ibonl)
+ *
+ * \param ud            GPIB descriptor
+ * \param online        0 to close the descriptor
+ * \return              GPIB status
+ */
+gint
+GPIBonl( gint ud, gint online ) {
+	return bReplaying ? CMPL : ibonl( ud, online );
+}
+
+/*!     \brief  Open a device by its name in gpib.conf (ibfind)
+ *
+ * \param sName         device name
+ * \return              GPIB descriptor (or ERROR)
+ */
+gint
+GPIBfind( const gchar *sName ) {
+	return bReplaying ? GPIB_REPLAY_OTHER_DESCRIPTOR : ibfind( sName );
+}
+
+/*!     \brief  Open a device by its address (ibdev)
+ *
+ * \param board         board index
+ * \param pad           primary address
+ * \param sad           secondary address
+ * \param timeout       linux-gpib timeout
+ * \param eot           assert EOI with the last byte written
+ * \param eos           end of string mode
+ * \return              GPIB descriptor (or ERROR)
+ */
+gint
+GPIBdev( gint board, gint pad, gint sad, gint timeout, gint eot, gint eos ) {
+	return bReplaying ? GPIB_REPLAY_OTHER_DESCRIPTOR : ibdev( board, pad, sad, timeout, eot, eos );
+}
@@ -0,0 +1,293 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib-2.0/glib.h>
+#include <gpib/ib.h>
+#include "hp8753.h"
+#include "GPIBcomms.h"
+
+/*
+ * Service requests for all the devices on the bus that we talk to are handled
+ * here. Each device opened is registered and, before it is sent a command that
+ * will end with an SRQ (OPC), it is told to expect one.
+ *
+ * Whoever is waiting calls serviceGPIBsrq(), which waits (briefly) for the SRQ
+ * line and then serial polls every registered device (with AllSpoll if there
+ * is more than one). Each device requesting service has its status byte noted:
+ * it completes the wait of that device whether or not that device is the one
+ * being waited for now. So an SRQ from one device that arrives while we wait
+ * for another is not lost, and the later wait for it returns at once.
+ *
+ * Used only by the GPIB thread.
+ */
+
+#define MAX_SRQ_DEVICES		8
+#define MAX_GPIB_PAD		30		// primary addresses are 0 to 30
+
+typedef struct {
+	gint		descriptor;
+	Addr4882_t	address;
+	gboolean	bExpecting;			// waiting for an SRQ (OPC)
+	gboolean	bComplete;			// the SRQ has been received
+	guchar		statusByte;			// from the serial poll that found the SRQ
+	gboolean	bClearESR;			// the ESR still holds the OPC that caused the last SRQ
+} tSRQdevice;
+
+static tSRQdevice SRQdevices[ MAX_SRQ_DEVICES ];
+static gint nSRQdevices = 0;
+
+/*!     \brief  Find a registered device
+ *
+ * \param descriptor    GPIB device descriptor
+ * \return              pointer to the device or NULL
+ */
+static tSRQdevice *
+findSRQdevice( gint descriptor ) {
+	for( gint i = 0; i < nSRQdevices; i++ )
+		if( SRQdevices[ i ].descriptor == descriptor )
+			return &SRQdevices[ i ];
+	return NULL;
+}
+
+/*!     \brief  Register a device whose service requests are to be handled
+ *
+ * \param descriptor    GPIB device descriptor
+ * \return              OK or ERROR
+ */
+gint
+registerSRQdevice( gint descriptor ) {
+	gint pad = 0, sad = 0;
+	tSRQdevice *pDevice;
+
+	if( descriptor == INVALID )
+		return ERROR;
+	if( (pDevice = findSRQdevice( descriptor )) == NULL ) {
+		if( nSRQdevices == MAX_SRQ_DEVICES )
+			return ERROR;
+		pDevice = &SRQdevices[ nSRQdevices++ ];
+	}
+
+	// (when replaying there is no bus .. only the state of the ESR is kept)
+	GPIBask( descriptor, IbaPAD, &pad );
+	GPIBask( descriptor, IbaSAD, &sad );
+	*pDevice = (tSRQdevice){ .descriptor = descriptor, .address = MakeAddr( pad, sad ) };
+	return OK;
+}
+
+/*!     \brief  Stop handling the service requests of a device (before it is closed)
+ *
+ * \param descriptor    GPIB device descriptor
+ */
+void
+unregisterSRQdevice( gint descriptor ) {
+	tSRQdevice *pDevice = findSRQdevice( descriptor );
+
+	if( pDevice ) {
+		*pDevice = SRQdevices[ --nSRQdevices ];
+	}
+}
+
+/*!     \brief  A device is about to be sent a command that will end with an SRQ
+ *
+ * The device is registered if it has not been already.
+ *
+ * \param descriptor    GPIB device descriptor
+ */
+void
+expectGPIBsrq( gint descriptor ) {
+	tSRQdevice *pDevice = findSRQdevice( descriptor );
+
+	if( pDevice == NULL && registerSRQdevice( descriptor ) == OK )
+		pDevice = findSRQdevice( descriptor );
+	if( pDevice ) {
+		pDevice->bExpecting = TRUE;
+		pDevice->bComplete = FALSE;
+		pDevice->statusByte = 0;
+	}
+}
+
+/*!     \brief  Has the SRQ expected from a device been received
+ *
+ * \param descriptor    GPIB device descriptor
+ * \param pStatusByte   status byte from the serial poll (or NULL)
+ * \return              TRUE if received
+ */
+gboolean
+GPIBsrqReceived( gint descriptor, guchar *pStatusByte ) {
+	tSRQdevice *pDevice = findSRQdevice( descriptor );
+
+	if( pDevice == NULL || !pDevice->bComplete )
+		return FALSE;
+	pDevice->bExpecting = pDevice->bComplete = FALSE;
+	if( pStatusByte )
+		*pStatusByte = pDevice->statusByte;
+	return TRUE;
+}
+
+/*!     \brief  Note (or ask) whether the ESR of a device still holds the OPC of the last SRQ
+ *
+ * \param descriptor    GPIB device descriptor
+ * \param bPending      TRUE if the ESR has not been cleared, FALSE once it has
+ * \return              the previous state
+ */
+gboolean
+GPIBsrqClearESR( gint descriptor, gboolean bPending ) {
+	tSRQdevice *pDevice = findSRQdevice( descriptor );
+	gboolean bWasPending;
+
+	if( pDevice == NULL )
+		return FALSE;
+	bWasPending = pDevice->bClearESR;
+	pDevice->bClearESR = bPending;
+	return bWasPending;
+}
+
+/*!     \brief  Note the status byte of a device that has requested service
+ *
+ * \param pDevice       pointer to the device
+ * \param status        status byte
+ */
+static void
+serviceRequested( tSRQdevice *pDevice, guchar status ) {
+	if( pDevice->bExpecting ) {
+		pDevice->bComplete = TRUE;
+		pDevice->statusByte = status;
+	} else {
+		DBG( eDEBUG_INFO, "Unexpected SRQ from GPIB address %d (status %02X)",
+				GetPAD( pDevice->address ), status );
+	}
+}
+
+/*!     \brief  Is the SRQ line asserted (without waiting)
+ *
+ * \param GPIBcontrollerIndex  board index of the controller
+ * \return              TRUE if a device is requesting service
+ */
+gboolean
+GPIBsrqAsserted( gint GPIBcontrollerIndex ) {
+	short lines = 0;
+
+	if( GPIBreplaying() || (iblines( GPIBcontrollerIndex, &lines ) & ERR) )
+		return FALSE;
+	return (lines & ValidSRQ) && (lines & BusSRQ);
+}
+
+/*!     \brief  Serial poll every device on the bus to clear an SRQ none of ours asserted
+ *
+ * The listeners are found (all primary addresses other than the controller's)
+ * and polled at once.
+ *
+ * \param GPIBcontrollerIndex  board index of the controller
+ * \param pGPIBstatus          pointer to GPIB status
+ * \return              eRDWT_OK or eRDWT_ERROR
+ */
+static tGPIBReadWriteStatus
+serviceUnregisteredSRQ( gint GPIBcontrollerIndex, gint *pGPIBstatus ) {
+	Addr4882_t addresses[ MAX_GPIB_PAD + 2 ], listeners[ MAX_GPIB_PAD + 1 ];
+	short results[ MAX_GPIB_PAD + 1 ];
+	gint controllerPAD = 0, nAddresses = 0, nListeners;
+
+	GPIBask( GPIBcontrollerIndex, IbaPAD, &controllerPAD );
+	for( gint pad = 0; pad <= MAX_GPIB_PAD; pad++ )
+		if( pad != controllerPAD )
+			addresses[ nAddresses++ ] = MakeAddr( pad, 0 );
+	addresses[ nAddresses ] = NOADDR;
+
+	FindLstn( GPIBcontrollerIndex, addresses, listeners, MAX_GPIB_PAD );
+	if( ThreadIbsta() & ERR ) {
+		LOG( G_LOG_LEVEL_CRITICAL, "HPIB search for listeners fail %04X/%d", ThreadIbsta(), ThreadIberr() );
+		*pGPIBstatus |= ERR;
+		return eRDWT_ERROR;
+	}
+	if( (nListeners = ThreadIbcnt()) == 0 )
+		return eRDWT_OK;
+	listeners[ nListeners ] = NOADDR;
+
+	AllSpoll( GPIBcontrollerIndex, listeners, results );
+	if( ThreadIbsta() & ERR ) {
+		LOG( G_LOG_LEVEL_CRITICAL, "HPIB serial poll of the bus fail %04X/%d", ThreadIbsta(), ThreadIberr() );
+		*pGPIBstatus |= ERR;
+		return eRDWT_ERROR;
+	}
+	for( gint i = 0; i < nListeners; i++ )
+		if( results[ i ] & ST_SRQ )
+			DBG( eDEBUG_INFO, "SRQ from unregistered GPIB address %d (status %02X)",
+					GetPAD( listeners[ i ] ), (guchar)results[ i ] );
+	return eRDWT_OK;
+}
+
+/*!     \brief  Wait for the SRQ line and serial poll the devices that may have asserted it
+ *
+ * The wait is limited by the timeout of the controller. If none of the registered
+ * devices was requesting service, the rest of the bus is polled so that the SRQ
+ * line is released.
+ *
+ * \param GPIBcontrollerIndex  board index of the controller
+ * \param pGPIBstatus          pointer to GPIB status
+ * \return              eRDWT_OK if a device was polled, eRDWT_CONTINUE if the wait timed out or eRDWT_ERROR
+ */
+tGPIBReadWriteStatus
+serviceGPIBsrq( gint GPIBcontrollerIndex, gint *pGPIBstatus ) {
+	Addr4882_t addresses[ MAX_SRQ_DEVICES + 1 ];
+	short results[ MAX_SRQ_DEVICES ];
+	short waitResult = 0;
+	char status = 0;
+	gboolean bFound = FALSE;
+
+	// This will timeout every 30ms (the timeout we set for the controller)
+	WaitSRQ( GPIBcontrollerIndex, &waitResult );
+	if( !waitResult )
+		return eRDWT_CONTINUE;
+
+	switch( nSRQdevices ) {
+	case 0:
+		break;
+	case 1:
+		// Serial poll for status to reset SRQ and find out if it was our device
+		if( (*pGPIBstatus = ibrsp( SRQdevices[ 0 ].descriptor, &status )) & ERR ) {
+			LOG( G_LOG_LEVEL_CRITICAL, "HPIB serial poll fail %04X/%d", *pGPIBstatus, ThreadIberr() );
+			return eRDWT_ERROR;
+		}
+		if( status & ST_SRQ ) {
+			serviceRequested( &SRQdevices[ 0 ], (guchar)status );
+			bFound = TRUE;
+		}
+		break;
+	default:
+		// poll them all at once
+		for( gint i = 0; i < nSRQdevices; i++ )
+			addresses[ i ] = SRQdevices[ i ].address;
+		addresses[ nSRQdevices ] = NOADDR;
+		AllSpoll( GPIBcontrollerIndex, addresses, results );
+		if( ThreadIbsta() & ERR ) {
+			LOG( G_LOG_LEVEL_CRITICAL, "HPIB serial poll of all devices fail %04X/%d", ThreadIbsta(), ThreadIberr() );
+			*pGPIBstatus |= ERR;
+			return eRDWT_ERROR;
+		}
+		for( gint i = 0; i < nSRQdevices; i++ )
+			if( results[ i ] & ST_SRQ ) {
+				serviceRequested( &SRQdevices[ i ], (guchar)results[ i ] );
+				bFound = TRUE;
+			}
+		break;
+	}
+	if( !bFound )
+		return serviceUnregisteredSRQ( GPIBcontrollerIndex, pGPIBstatus );
+	return eRDWT_OK;
+}
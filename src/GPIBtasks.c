@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib-2.0/glib.h>
+#include <gpib/ib.h>
+#include "hp8753.h"
+#include "GPIBcomms.h"
+
+/*
+ * Work the GPIB thread does on the host (converting traces, progress ...) can be
+ * run as resumable tasks while the thread waits for the HP8753 to sweep (SRQ),
+ * rather than after it.
+ *
+ * A task is a step function that does a short piece of the work and returns
+ * eTASK_RUNNING to be resumed later or eTASK_DONE. With TASK_BEGIN, TASK_YIELD
+ * and TASK_END (GPIBcomms.h) the step is written as one sequence that continues
+ * after the TASK_YIELD it last returned from. Local variables do not survive a
+ * yield .. anything needed after it must be kept in the task.
+ *
+ * Tasks are stepped in turn by runGPIBtasks() from the SRQ wait and from the
+ * waits for asynchronous reads and writes to complete. Their results
+ * may only be used after finishGPIBtasks(), which runs them to completion.
+ *
+ * Used only by the GPIB thread.
+ */
+
+static GQueue runnableTasks = G_QUEUE_INIT;
+
+/*!     \brief  Start a task
+ *
+ * \param step          step function of the task
+ * \param pData         data of the task (ownership passes to the task)
+ * \param freeData      function to free pData when the task is done (or NULL)
+ * \param sName         name of the task (for debugging)
+ */
+void
+spawnGPIBtask( tGPIBtaskStep step, gpointer pData, GDestroyNotify freeData, const gchar *sName ) {
+	tGPIBtask *pTask = g_new0( tGPIBtask, 1 );
+
+	pTask->step = step;
+	pTask->pData = pData;
+	pTask->freeData = freeData;
+	pTask->sName = sName;
+	g_queue_push_tail( &runnableTasks, pTask );
+}
+
+/*!     \brief  Run one step of a task
+ *
+ * \param pTask         pointer to the task
+ * \return              TRUE if the task is to be resumed or FALSE if it is done (and freed)
+ */
+static gboolean
+stepGPIBtask( tGPIBtask *pTask ) {
+	if( pTask->step( pTask ) == eTASK_RUNNING )
+		return TRUE;
+
+	DBG( eDEBUG_EXTENSIVE, "GPIB task \"%s\" done", pTask->sName );
+	if( pTask->freeData )
+		pTask->freeData( pTask->pData );
+	g_free( pTask );
+	return FALSE;
+}
+
+/*!     \brief  Step the tasks in turn for a while
+ *
+ * Called while waiting for the HP8753. When waiting for an SRQ the tasks
+ * stop as soon as the SRQ line is asserted, so that it is noticed (and timed)
+ * within a step rather than after the whole slice.
+ *
+ * \param budget        us to spend (at least one step is run)
+ * \param GPIBboard     board whose SRQ line ends the slice (or INVALID)
+ * \return              TRUE if tasks remain
+ */
+gboolean
+runGPIBtasks( gint64 budget, gint GPIBboard ) {
+	gint64 deadline = g_get_monotonic_time() + budget;
+	tGPIBtask *pTask;
+
+	do {
+		if( (pTask = g_queue_pop_head( &runnableTasks )) == NULL )
+			return FALSE;
+		if( stepGPIBtask( pTask ) )
+			g_queue_push_tail( &runnableTasks, pTask );
+		if( GPIBboard != INVALID && GPIBsrqAsserted( GPIBboard ) )
+			break;
+	} while( g_get_monotonic_time() < deadline );
+
+	return !g_queue_is_empty( &runnableTasks );
+}
+
+/*!     \brief  Run all the tasks to completion
+ *
+ * Called before the results of the tasks are used (and at the end of each job).
+ */
+void
+finishGPIBtasks( void ) {
+	tGPIBtask *pTask;
+
+	while( (pTask = g_queue_pop_head( &runnableTasks )) != NULL )
+		while( stepGPIBtask( pTask ) )
+			;
+}
+
+/*!     \brief  Are there tasks to run
+ *
+ * \return              TRUE if tasks are waiting to be resumed
+ */
+gboolean
+GPIBtasksPending( void ) {
+	return !g_queue_is_empty( &runnableTasks );
+}
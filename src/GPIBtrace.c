@@ -0,0 +1,350 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-2.0/glib.h>
+#include <gpib/ib.h>
+#include "hp8753.h"
+#include "GPIBcomms.h"
+
+/*
+ * Every transaction through the async GPIB layer is recorded by the GPIB thread
+ * in a ring buffer. The main loop collects the new records (there is no lock; each
+ * slot carries a sequence number that is odd while it is being written) and adds
+ * them to the statistics for the command (mnemonic) and type of transaction.
+ * The ring keeps the last GPIB_TRACE_SIZE transactions for export.
+ */
+
+const gchar *GPIBtransactionTypeNames[] = { "write", "read", "SRQ wait", "clear" };
+
+typedef struct {
+	guint				sequence;		// 2n+1 while transaction n is written, 2n+2 when it is complete
+	tGPIBtransaction	transaction;
+} tGPIBtraceSlot;
+
+static tGPIBtraceSlot traceRing[ GPIB_TRACE_SIZE ];
+static guint traceHead = 0;			// number of transactions recorded (written only by the GPIB thread)
+static gchar sLastMnemonic[ GPIB_MNEMONIC_SIZE ] = "-";	// GPIB thread only
+
+// main loop only
+static guint traceTail = 0;			// next transaction to collect
+static guint nLost = 0;				// overwritten before they were collected
+static GHashTable *statisticsTable = NULL;
+
+/*!     \brief  Find the mnemonic of the last command in a string sent to the HP8753
+ *
+ * "FORM2;OUTPFORM;" gives OUTPFORM, "POIN?;" gives POIN?, "CHAN1;" gives CHAN.
+ * Binary data (learn strings and calibration arrays) is called "binary".
+ *
+ * \param pData         data written
+ * \param nBytes        number of bytes written
+ * \param sMnemonic     GPIB_MNEMONIC_SIZE buffer for the mnemonic
+ */
+static void
+mnemonicOfCommand( const guchar *pData, glong nBytes, gchar *sMnemonic ) {
+	glong i, start, end;
+	gint n = 0;
+
+	for( i = 0; i < nBytes; i++ ) {
+		if( !g_ascii_isprint( pData[ i ] ) && !g_ascii_isspace( pData[ i ] ) ) {
+			g_strlcpy( sMnemonic, "binary", GPIB_MNEMONIC_SIZE );
+			return;
+		}
+	}
+	// skip the terminators after the last command
+	for( end = nBytes; end > 0 && (pData[ end-1 ] == ';' || g_ascii_isspace( pData[ end-1 ] )); end-- )
+		;
+	for( start = end; start > 0 && pData[ start-1 ] != ';'; start-- )
+		;
+	for( i = start; i < end && g_ascii_isspace( pData[ i ] ); i++ )
+		;
+	for( ; i < end && g_ascii_isalpha( pData[ i ] ) && n < GPIB_MNEMONIC_SIZE - 2; i++ )
+		sMnemonic[ n++ ] = g_ascii_toupper( pData[ i ] );
+	if( i < end && pData[ i ] == '?' )
+		sMnemonic[ n++ ] = '?';
+	sMnemonic[ n ] = 0;
+	if( n == 0 )
+		g_strlcpy( sMnemonic, "-", GPIB_MNEMONIC_SIZE );
+}
+
+/*!     \brief  Record a GPIB transaction
+ *
+ * Called by the GPIB thread at the end of each transaction.
+ *
+ * \param type          write, read, SRQ wait or clear
+ * \param pData         data written (for a write), read (for a read) or NULL
+ * \param nBytes        bytes to transfer
+ * \param nTransferred  bytes transferred
+ * \param start         monotonic time the transaction started
+ * \param waitTime      time waiting for the HP8753 (us)
+ * \param status        result of the transaction
+ */
+void
+recordGPIBtransaction( tGPIBtransactionType type, const void *pData, glong nBytes, glong nTransferred,
+		gint64 start, gint64 waitTime, tGPIBReadWriteStatus status ) {
+	guint n = traceHead;
+	tGPIBtraceSlot *pSlot = &traceRing[ n % GPIB_TRACE_SIZE ];
+	tGPIBtransaction *pTransaction = &pSlot->transaction;
+
+	// reads, SRQ waits and clears are charged to the command that caused them
+	if( type == eGPIB_WRITE && pData )
+		mnemonicOfCommand( pData, nBytes, sLastMnemonic );
+
+	g_atomic_int_set( &pSlot->sequence, 2 * n + 1 );
+	pTransaction->start = start;
+	pTransaction->duration = g_get_monotonic_time() - start;
+	pTransaction->waitTime = waitTime;
+	pTransaction->nBytes = nBytes;
+	pTransaction->nTransferred = nTransferred;
+	pTransaction->type = type;
+	pTransaction->status = status;
+	g_strlcpy( pTransaction->sMnemonic, sLastMnemonic, GPIB_MNEMONIC_SIZE );
+	g_atomic_int_set( &pSlot->sequence, 2 * n + 2 );
+
+	g_atomic_int_set( &traceHead, n + 1 );
+
+	recordGPIBsessionEvent( type, pData, nBytes, nTransferred, start, pTransaction->duration, status );
+}
+
+/*!     \brief  Clear the GPIB device (and record it)
+ *
+ * A clear follows a failed or abandoned transaction, so the count of
+ * clears shows the retries needed for each command.
+ *
+ * \param GPIBdescriptor GPIB device descriptor
+ * \return               GPIB status
+ */
+gint
+GPIBclear( gint GPIBdescriptor ) {
+	gint64 start = g_get_monotonic_time();
+	gint GPIBstatus = 0;
+
+	if( GPIBreplaying() )
+		replayGPIBtransaction( eGPIB_CLEAR, NULL, 0, &GPIBstatus );
+	else
+		GPIBstatus = ibclr( GPIBdescriptor );
+
+	recordGPIBtransaction( eGPIB_CLEAR, NULL, 0, 0, start, 0,
+			GPIBfailed( GPIBstatus ) ? eRDWT_ERROR : eRDWT_OK );
+	return GPIBstatus;
+}
+
+/*!     \brief  Copy a transaction from the ring
+ *
+ * \param n             transaction number
+ * \param pTransaction  pointer to the copy
+ * \return              TRUE if copied or FALSE if it has been overwritten
+ */
+static gboolean
+copyGPIBtransaction( guint n, tGPIBtransaction *pTransaction ) {
+	tGPIBtraceSlot *pSlot = &traceRing[ n % GPIB_TRACE_SIZE ];
+	guint sequence = g_atomic_int_get( &pSlot->sequence );
+
+	if( sequence != 2 * n + 2 )
+		return FALSE;
+	*pTransaction = pSlot->transaction;
+	return g_atomic_int_get( &pSlot->sequence ) == sequence;
+}
+
+/*!     \brief  Histogram bin for a latency
+ *
+ * \param microSeconds  latency
+ * \return              bin (log2 of the latency in us)
+ */
+static gint
+histogramBin( gint64 microSeconds ) {
+	gint bin = 0;
+
+	while( microSeconds > 1 && bin < GPIB_HISTOGRAM_BINS - 1 ) {
+		microSeconds >>= 1;
+		bin++;
+	}
+	return bin;
+}
+
+/*!     \brief  Add the transactions recorded since the last call to the statistics
+ *
+ * Called from the main loop.
+ *
+ * \return      number of transactions collected
+ */
+guint
+collectGPIBtransactions( void ) {
+	guint head = g_atomic_int_get( &traceHead ), nCollected = 0;
+	tGPIBtransaction transaction;
+
+	if( statisticsTable == NULL )
+		statisticsTable = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, g_free );
+
+	if( head - traceTail > GPIB_TRACE_SIZE ) {
+		nLost += head - traceTail - GPIB_TRACE_SIZE;
+		traceTail = head - GPIB_TRACE_SIZE;
+	}
+
+	for( ; traceTail != head; traceTail++ ) {
+		tGPIBmnemonicStatistics *pStats;
+		gchar *sKey;
+
+		if( !copyGPIBtransaction( traceTail, &transaction ) ) {
+			nLost++;
+			continue;
+		}
+		sKey = g_strdup_printf( "%s/%d", transaction.sMnemonic, transaction.type );
+		if( (pStats = g_hash_table_lookup( statisticsTable, sKey )) == NULL ) {
+			pStats = g_new0( tGPIBmnemonicStatistics, 1 );
+			g_strlcpy( pStats->sMnemonic, transaction.sMnemonic, GPIB_MNEMONIC_SIZE );
+			pStats->type = transaction.type;
+			g_hash_table_insert( statisticsTable, sKey, pStats );
+		} else {
+			g_free( sKey );
+		}
+		pStats->nCalls++;
+		if( transaction.status == eRDWT_TIMEOUT )
+			pStats->nTimeouts++;
+		else if( transaction.status != eRDWT_OK )
+			pStats->nErrors++;
+		pStats->nBytes += transaction.nTransferred;
+		pStats->totalTime += transaction.duration;
+		pStats->maxTime = MAX( pStats->maxTime, transaction.duration );
+		pStats->histogram[ histogramBin( transaction.duration ) ]++;
+		nCollected++;
+	}
+	return nCollected;
+}
+
+/*!     \brief  Compare statistics by total time (longest first)
+ */
+static gint
+compareTotalTime( gconstpointer a, gconstpointer b ) {
+	const tGPIBmnemonicStatistics *pA = a, *pB = b;
+
+	return (pA->totalTime < pB->totalTime) - (pA->totalTime > pB->totalTime);
+}
+
+/*!     \brief  The statistics for each command and type of transaction
+ *
+ * \return      list of tGPIBmnemonicStatistics (owned by this module) with the most time first.
+ *              Free the list with g_list_free.
+ */
+GList *
+GPIBtransactionStatistics( void ) {
+	collectGPIBtransactions();
+	return g_list_sort( g_hash_table_get_values( statisticsTable ), compareTotalTime );
+}
+
+/*!     \brief  Estimate a percentile of the latency from the histogram
+ *
+ * \param pStats        pointer to the statistics
+ * \param fraction      0.5 for the median, 0.95 ...
+ * \return              latency (us) at the geometric center of the bin holding the percentile
+ */
+gint64
+GPIBstatisticsPercentile( tGPIBmnemonicStatistics *pStats, gdouble fraction ) {
+	guint count = 0, target = (guint)(fraction * pStats->nCalls + 0.5);
+
+	for( gint bin = 0; bin < GPIB_HISTOGRAM_BINS; bin++ ) {
+		count += pStats->histogram[ bin ];
+		if( count >= MAX( target, 1 ) )
+			return MIN( (gint64)((1 << bin) * G_SQRT2), pStats->maxTime );
+	}
+	return pStats->maxTime;
+}
+
+/*!     \brief  Discard the statistics collected so far
+ *
+ * Called from the main loop. The ring is left intact for export.
+ */
+void
+resetGPIBtransactionStatistics( void ) {
+	collectGPIBtransactions();
+	g_hash_table_remove_all( statisticsTable );
+	nLost = 0;
+}
+
+/*!     \brief  Export the recorded transactions and their statistics
+ *
+ * The JSON format holds the transactions still in the ring and the statistics
+ * (with histograms) for each command. The Chrome trace format (chrome://tracing,
+ * Perfetto) shows each transaction as a slice on a timeline.
+ *
+ * \param sFilename     file name
+ * \param bChromeTrace  Chrome trace event format rather than JSON
+ * \return              number of transactions exported or ERROR
+ */
+gint
+exportGPIBtransactions( gchar *sFilename, gboolean bChromeTrace ) {
+	guint head, first;
+	gint nExported = 0;
+	GString *sJSON = g_string_new( NULL );
+	tGPIBtransaction transaction;
+	GList *statisticsList;
+	gboolean bWritten;
+
+	statisticsList = GPIBtransactionStatistics();
+	head = g_atomic_int_get( &traceHead );
+	first = head > GPIB_TRACE_SIZE ? head - GPIB_TRACE_SIZE : 0;
+
+	g_string_append( sJSON, bChromeTrace ? "{\"traceEvents\":[\n" : "{\"transactions\":[\n" );
+	for( guint n = first; n != head; n++ ) {
+		if( !copyGPIBtransaction( n, &transaction ) )
+			continue;
+		if( nExported++ )
+			g_string_append( sJSON, ",\n" );
+		if( bChromeTrace ) {
+			g_string_append_printf( sJSON, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%" G_GINT64_FORMAT
+					",\"dur\":%" G_GINT64_FORMAT ",\"pid\":1,\"tid\":1,\"args\":{\"bytes\":%ld,\"wait_us\":%" G_GINT64_FORMAT
+					",\"status\":%d}}",
+					transaction.sMnemonic, GPIBtransactionTypeNames[ transaction.type ],
+					transaction.start, MAX( transaction.duration, 1 ), transaction.nTransferred,
+					transaction.waitTime, transaction.status );
+		} else {
+			g_string_append_printf( sJSON, "{\"mnemonic\":\"%s\",\"type\":\"%s\",\"start_us\":%" G_GINT64_FORMAT
+					",\"duration_us\":%" G_GINT64_FORMAT ",\"wait_us\":%" G_GINT64_FORMAT
+					",\"bytes\":%ld,\"transferred\":%ld,\"status\":%d}",
+					transaction.sMnemonic, GPIBtransactionTypeNames[ transaction.type ],
+					transaction.start, transaction.duration, transaction.waitTime,
+					transaction.nBytes, transaction.nTransferred, transaction.status );
+		}
+	}
+
+	if( bChromeTrace ) {
+		g_string_append( sJSON, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+	} else {
+		g_string_append_printf( sJSON, "\n],\"lost\":%u,\"histogram_bins_us\":\"2^n to 2^(n+1)\",\"statistics\":[\n", nLost );
+		for( GList *l = statisticsList; l != NULL; l = l->next ) {
+			tGPIBmnemonicStatistics *pStats = l->data;
+			g_string_append_printf( sJSON, "{\"mnemonic\":\"%s\",\"type\":\"%s\",\"calls\":%u,\"timeouts\":%u,\"errors\":%u,"
+					"\"bytes\":%" G_GINT64_FORMAT ",\"total_us\":%" G_GINT64_FORMAT ",\"max_us\":%" G_GINT64_FORMAT
+					",\"p50_us\":%" G_GINT64_FORMAT ",\"p95_us\":%" G_GINT64_FORMAT ",\"histogram\":[",
+					pStats->sMnemonic, GPIBtransactionTypeNames[ pStats->type ], pStats->nCalls, pStats->nTimeouts,
+					pStats->nErrors, pStats->nBytes, pStats->totalTime, pStats->maxTime,
+					GPIBstatisticsPercentile( pStats, 0.50 ), GPIBstatisticsPercentile( pStats, 0.95 ) );
+			for( gint bin = 0; bin < GPIB_HISTOGRAM_BINS; bin++ )
+				g_string_append_printf( sJSON, bin ? ",%u" : "%u", pStats->histogram[ bin ] );
+			g_string_append( sJSON, l->next ? "]},\n" : "]}\n" );
+		}
+		g_string_append( sJSON, "]}\n" );
+	}
+	g_list_free( statisticsList );
+
+	bWritten = g_file_set_contents( sFilename, sJSON->str, sJSON->len, NULL );
+	g_string_free( sJSON, TRUE );
+
+	return bWritten ? nExported : ERROR;
+}
@@ -979,7 +979,10 @@ gboolean CB_DrawingArea_A_Draw (GtkWidget *widget, cairo_t *cr, tGlobal *pGlobal
 	cairo_set_source_rgba (cr, 1.0, 1.0, 1.0, 1.0 );
 	cairo_paint( cr );
 
-    return plotA ( areaWidth,  areaHeight, 0, cr, pGlobal);
+    gboolean rtn = plotA ( areaWidth,  areaHeight, 0, cr, pGlobal);
+    // a newly captured trace has now been drawn
+    completeCaptureRedraw( pGlobal );
+    return rtn;
 }
 
 /*!     \brief  Plot the second channel
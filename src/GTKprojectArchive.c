@@ -0,0 +1,310 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+#include "calibrationKit.h"
+#include "messageEvent.h"
+
+/*!     \brief  Add the project archive filters to a file chooser
+ *
+ * \param chooser       pointer to the file chooser
+ */
+static void
+addProjectArchiveFilters( GtkFileChooser *chooser ) {
+    GtkFileFilter *filter;
+
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, ".hp8753project" );
+    gtk_file_filter_add_pattern (filter, "*.hp8753project");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+}
+
+/*!     \brief  Export the current project to an archive file
+ *
+ * Save all of the calibration and trace profiles of the current project (and the
+ * calibration kits) to a file that can be imported on another machine.
+ * This is initiated by pressing F5
+ *
+ * \ingroup Project archive
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+showExportProjectDialog( tGlobal *pGlobal ) {
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    gchar *sSuggestedName, *sMessage;
+    gint nRows;
+
+    if( pGlobal->sProject == NULL ) {
+        postInfo( "Select a project to export" );
+        return;
+    }
+
+    dialog = gtk_file_chooser_dialog_new ("Export Project",
+                    GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+                    GTK_FILE_CHOOSER_ACTION_SAVE,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Export", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
+    addProjectArchiveFilters( chooser );
+    if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+    sSuggestedName = g_strdup_printf( "%s.hp8753project", pGlobal->sProject );
+    gtk_file_chooser_set_current_name (chooser, sSuggestedName);
+    g_free( sSuggestedName );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+        if( (nRows = exportProject( pGlobal->sProject, sChosenFilename )) != ERROR ) {
+            sMessage = g_strdup_printf( "Exported project \"%s\" (%d records)", pGlobal->sProject, nRows );
+            postInfo( sMessage );
+            g_free( sMessage );
+        }
+        g_free( sChosenFilename );
+    }
+
+    gtk_widget_destroy (dialog);
+}
+
+/*!     \brief  Export the trace profiles of the current project to a NumPy archive
+ *
+ * Write the stimulus, response, markers, segments and setup of every trace profile
+ * in the current project to a single .npz file for analysis.
+ * This is initiated by pressing F6
+ *
+ * \ingroup Project archive
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+showExportProjectNumPyDialog( tGlobal *pGlobal ) {
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    GtkFileFilter *filter;
+    gchar *sSuggestedName, *sMessage;
+    gint nTraces;
+
+    if( pGlobal->sProject == NULL ) {
+        postInfo( "Select a project to export" );
+        return;
+    }
+
+    dialog = gtk_file_chooser_dialog_new ("Export Project Traces to NumPy Archive",
+                    GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+                    GTK_FILE_CHOOSER_ACTION_SAVE,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Export", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, ".npz" );
+    gtk_file_filter_add_pattern (filter, "*.[nN][pP][zZ]");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+    if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+    sSuggestedName = g_strdup_printf( "%s.npz", pGlobal->sProject );
+    gtk_file_chooser_set_current_name (chooser, sSuggestedName);
+    g_free( sSuggestedName );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+        if( (nTraces = exportProjectNumPy( pGlobal->sProject, pGlobal->pTraceList, sChosenFilename )) != ERROR ) {
+            sMessage = g_strdup_printf( "Exported %d trace profiles of \"%s\"", nTraces, pGlobal->sProject );
+            postInfo( sMessage );
+        } else {
+            sMessage = g_strdup_printf( "Cannot write: %s (%s)", sChosenFilename, g_strerror( errno ) );
+            postError( sMessage );
+        }
+        g_free( sMessage );
+        g_free( sChosenFilename );
+    }
+
+    gtk_widget_destroy (dialog);
+}
+
+/*!     \brief  Export the archived sweeps of the selected trace profile to a CSV file
+ *
+ * Every save of a trace profile also appends its sweeps to the time series archive.
+ * This writes all of them (oldest first) so drift can be studied.
+ * This is initiated by pressing Shift-F6
+ *
+ * \ingroup Project archive
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+showExportTraceArchiveDialog( tGlobal *pGlobal ) {
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    GtkFileFilter *filter;
+    tProjectAndName *pProjectAndName;
+    gchar *sSuggestedName, *sMessage, *sError;
+    gint nSweeps;
+
+    if( pGlobal->pTraceAbstract == NULL ) {
+        postInfo( "Select a trace profile to export its archive" );
+        return;
+    }
+    pProjectAndName = &pGlobal->pTraceAbstract->projectAndName;
+
+    dialog = gtk_file_chooser_dialog_new ("Export Archived Sweeps of Trace Profile",
+                    GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+                    GTK_FILE_CHOOSER_ACTION_SAVE,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Export", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, ".csv" );
+    gtk_file_filter_add_pattern (filter, "*.[cC][sS][vV]");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+    if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+    sSuggestedName = g_strdup_printf( "%s archive.csv", pProjectAndName->sName );
+    gtk_file_chooser_set_current_name (chooser, sSuggestedName);
+    g_free( sSuggestedName );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+        if( (nSweeps = writeTraceArchiveCSV( sChosenFilename,
+                pProjectAndName->sProject, pProjectAndName->sName, &sError )) != ERROR ) {
+            sMessage = g_strdup_printf( "Exported %d archived sweeps of \"%s\"", nSweeps, pProjectAndName->sName );
+            postInfo( sMessage );
+        } else {
+            sMessage = g_strdup_printf( "Cannot write: %s (%s)", sChosenFilename, sError );
+            postError( sMessage );
+            g_free( sError );
+        }
+        g_free( sMessage );
+        g_free( sChosenFilename );
+    }
+
+    gtk_widget_destroy (dialog);
+}
+
+/*!     \brief  Import a project from an archive file
+ *
+ * Add the calibration and trace profiles (and calibration kits) from a project
+ * archive to the database, then select the imported project.
+ * This is initiated by pressing Shift-F5
+ *
+ * \ingroup Project archive
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+showImportProjectDialog( tGlobal *pGlobal ) {
+    static const gchar *policyIDs[] = { "keep", "replace", "abort", NULL };
+    static const gchar *policyLabels[] = { "keep the existing profile", "replace the existing profile",
+                                           "do not import anything", NULL };
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    tImportPolicy policy = eIMPORT_KEEP_EXISTING;
+    gchar *sProject = NULL, *sMessage;
+    const gchar *sPolicy;
+    gint nRows;
+
+    dialog = gtk_file_chooser_dialog_new ("Import Project",
+                    GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Import", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    addProjectArchiveFilters( chooser );
+    gtk_file_chooser_add_choice( chooser, "policy", "If a profile already exists:",
+            (const gchar **)policyIDs, (const gchar **)policyLabels );
+    gtk_file_chooser_set_choice( chooser, "policy", "keep" );
+    if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+        sPolicy = gtk_file_chooser_get_choice( chooser, "policy" );
+        for( gint i = 0; policyIDs[ i ]; i++ )
+            if( g_strcmp0( sPolicy, policyIDs[ i ] ) == 0 )
+                policy = (tImportPolicy)i;
+
+        if( (nRows = importProject( sChosenFilename, NULL, policy, &sProject )) != ERROR ) {
+            GtkComboBoxText *wComboBoxProject = GTK_COMBO_BOX_TEXT(
+                    g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Combo_Project") );
+            GtkComboBoxText *wComboBoxCalKit = GTK_COMBO_BOX_TEXT(
+                    g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Combo_CalKit") );
+
+            // the lists (and the selected profiles) are rebuilt from the database
+            inventoryProjects( pGlobal );
+            inventorySavedSetupsAndCal( pGlobal );
+            inventorySavedTraceNames( pGlobal );
+            inventorySavedCalibrationKits( pGlobal );
+
+            populateProjectComboBoxWidget( pGlobal );
+            setGtkComboBox( GTK_COMBO_BOX( wComboBoxProject ), sProject );
+
+            gtk_list_store_clear (GTK_LIST_STORE( gtk_combo_box_get_model(GTK_COMBO_BOX(wComboBoxCalKit))));
+            for( GList *l = pGlobal->pCalKitList; l != NULL; l = l->next )
+                gtk_combo_box_text_append_text( wComboBoxCalKit, ((tCalibrationKitIdentifier *)l->data)->sLabel );
+            if( pGlobal->pCalKitList )
+                gtk_combo_box_set_active ( GTK_COMBO_BOX(wComboBoxCalKit), 0 );
+
+            sMessage = g_strdup_printf( "Imported project \"%s\" (%d records)", sProject, nRows );
+            postInfo( sMessage );
+            g_free( sMessage );
+            g_free( sProject );
+        }
+        g_free( sChosenFilename );
+    }
+
+    gtk_widget_destroy (dialog);
+}
@@ -0,0 +1,615 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <gtk/gtk.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * Search of the saved trace and calibration profiles (F4).
+ *
+ * The search string is free text matched against the project, name, title and notes
+ * with filters recognized in it, for example:
+ *      S21 traces 1-2 GHz with IFBW<=100 Hz
+ *      bandpass LOGM points=1601
+ *      cal:FUL2 amplifier
+ */
+
+#define SEARCH_BATCH    50      // results added to the list on each idle call
+
+enum { SR_COL_TYPE, SR_COL_PROJECT, SR_COL_NAME, SR_COL_TITLE, SR_COL_SWEEP, SR_COL_POINTS,
+        SR_COL_IFBW, SR_COL_MEASUREMENT, SR_COL_DATE, SR_COL_TABLE, SR_N_COLUMNS };
+
+typedef struct {
+    GtkWidget       *wWindow;
+    GtkSearchEntry  *wEntry;
+    GtkListStore    *wStore;
+    GtkLabel        *wStatus;
+    tSearchCursor   *pCursor;
+    guint           idleSource;
+    gint            nResults;
+    tGlobal         *pGlobal;
+} tSearchWindow;
+
+static tSearchWindow searchWindow = { 0 };
+
+/*!     \brief  Parse a frequency unit
+ *
+ * \param sUnit         pointer to the (lower case) unit
+ * \param pMultiplier   pointer to the multiplier for the unit
+ * \return              number of characters in the unit (0 if none)
+ */
+static gint
+parseFrequencyUnit( const gchar *sUnit, gdouble *pMultiplier ) {
+    static const struct { gchar *sUnit; gdouble multiplier; } units[] = {
+            { "ghz", 1.0e9 }, { "mhz", 1.0e6 }, { "khz", 1.0e3 }, { "hz", 1.0 } };
+
+    for( gint i = 0; i < sizeof( units ) / sizeof( units[0] ); i++ ) {
+        if( g_str_has_prefix( sUnit, units[i].sUnit ) ) {
+            *pMultiplier = units[i].multiplier;
+            return strlen( units[i].sUnit );
+        }
+    }
+    return 0;
+}
+
+/*!     \brief  Parse a frequency with an optional unit
+ *
+ * \param sToken        pointer to the (lower case) text
+ * \param pFrequency    pointer to the frequency (in the unit given or the default)
+ * \param pMultiplier   pointer to the multiplier of the unit (unchanged if no unit)
+ * \return              pointer to the character following, or NULL if not a number
+ */
+static const gchar *
+parseFrequency( const gchar *sToken, gdouble *pFrequency, gdouble *pMultiplier ) {
+    gchar *sEnd;
+
+    // a number must start with a digit (g_ascii_strtod() also takes signs, "nan" and "inf")
+    if( !g_ascii_isdigit( sToken[0] ) && !(sToken[0] == '.' && g_ascii_isdigit( sToken[1] )) )
+        return NULL;
+    *pFrequency = g_ascii_strtod( sToken, &sEnd );
+    if( sEnd == sToken || !isfinite( *pFrequency ) )
+        return NULL;
+    return sEnd + parseFrequencyUnit( sEnd, pMultiplier );
+}
+
+/*!     \brief  Parse a comparison operator
+ *
+ * \param sToken        pointer to the text
+ * \param pOperator     pointer to the operator found ('<' for <=, '>' for >=, 'l' for <, 'g' for > or '=')
+ * \return              pointer to the character following, or NULL if not an operator
+ */
+static const gchar *
+parseComparison( const gchar *sToken, gchar *pOperator ) {
+    if( g_str_has_prefix( sToken, "<=" ) ) {
+        *pOperator = '<';
+        return sToken + 2;
+    } else if( g_str_has_prefix( sToken, ">=" ) ) {
+        *pOperator = '>';
+        return sToken + 2;
+    } else if( *sToken == '<' ) {
+        *pOperator = 'l';
+    } else if( *sToken == '>' ) {
+        *pOperator = 'g';
+    } else if( *sToken == '=' || *sToken == ':' ) {
+        *pOperator = '=';
+    } else {
+        return NULL;
+    }
+    return sToken + 1;
+}
+
+/*!     \brief  Normalize the search string so that each term is a single token
+ *
+ * Substitute ASCII for the typographic dash and comparison symbols and remove the
+ * spaces around operators and between a number and its unit ("1 – 2 GHz" becomes "1-2ghz").
+ *
+ * \param sSearch       search string
+ * \return              g_malloced lower case string
+ */
+static gchar *
+normalizeSearchString( const gchar *sSearch ) {
+    static const struct { gchar *sFrom, *sTo; } substitutions[] = {
+            { "–", "-" }, { "—", "-" }, { "≤", "<=" }, { "≥", ">=" } };
+    GString *sNormal = g_string_new( NULL );
+    gchar *sLower = g_utf8_strdown( sSearch, -1 );
+    gchar *sSubstituted;
+    const gchar *s;
+    gdouble multiplier;
+
+    for( s = sLower; *s; ) {
+        gboolean bSubstituted = FALSE;
+
+        for( gint i = 0; i < sizeof( substitutions ) / sizeof( substitutions[0] ); i++ ) {
+            if( g_str_has_prefix( s, substitutions[i].sFrom ) ) {
+                g_string_append( sNormal, substitutions[i].sTo );
+                s += strlen( substitutions[i].sFrom );
+                bSubstituted = TRUE;
+                break;
+            }
+        }
+        if( !bSubstituted )
+            g_string_append_c( sNormal, *s++ );
+    }
+    g_free( sLower );
+    sSubstituted = g_string_free( sNormal, FALSE );
+
+    sNormal = g_string_new( NULL );
+    for( s = sSubstituted; *s; ) {
+        if( g_ascii_isspace( *s ) ) {
+            const gchar *sNext = s;
+            gchar previous = sNormal->len ? sNormal->str[ sNormal->len - 1 ] : ' ';
+            gint unitLength;
+
+            while( g_ascii_isspace( *sNext ) )
+                sNext++;
+            unitLength = parseFrequencyUnit( sNext, &multiplier );
+            // drop the space if it separates an operator or a unit from what it applies to
+            if( !( strchr( "-<>=:", previous ) != NULL || (*sNext && strchr( "-<>=", *sNext ) != NULL)
+                    || (g_ascii_isdigit( previous ) && unitLength != 0 && !g_ascii_isalnum( sNext[ unitLength ] )) ) )
+                g_string_append_c( sNormal, ' ' );
+            s = sNext;
+        } else {
+            g_string_append_c( sNormal, *s++ );
+        }
+    }
+
+    g_free( sSubstituted );
+    return g_string_free( sNormal, FALSE );
+}
+
+/*!     \brief  Compare a search term with the code of an HP8753 option
+ *
+ * The code is compared without the query suffix ("LOGM?;" is matched by "logm").
+ *
+ * \param sTerm         lower case search term
+ * \param sCode         option code
+ * \return              TRUE if the term matches the code
+ */
+static gboolean
+matchOptionCode( const gchar *sTerm, const gchar *sCode ) {
+    gsize length = strcspn( sCode, "?;" );
+    return strlen( sTerm ) == length && g_ascii_strncasecmp( sTerm, sCode, length ) == 0;
+}
+
+/*!     \brief  Parse the search string into a query
+ *
+ * Recognized filters are removed from the string; the remaining words are
+ * searched for (as prefixes) in the project, name, title and notes.
+ *
+ * \param sSearch       search string typed by the user
+ * \param pQuery        pointer to the query to fill in (the sText member is g_malloced)
+ */
+static void
+parseSearchString( const gchar *sSearch, tSearchQuery *pQuery ) {
+    static const gchar *stopWords[] = { "all", "with", "and", "in", "of", "profiles", NULL };
+    gchar *sNormal = normalizeSearchString( sSearch );
+    gchar **tokens = g_strsplit( sNormal, " ", -1 );
+    GString *sText = g_string_new( NULL );
+    GPtrArray *words = g_ptr_array_new();
+    gboolean bTracesOnly = FALSE, bCalibrationsOnly = FALSE;
+
+    memset( pQuery, 0, sizeof( tSearchQuery ) );
+    pQuery->measurementType = INVALID;
+    pQuery->format = INVALID;
+    pQuery->calType = INVALID;
+
+    for( gchar **pToken = tokens; *pToken; pToken++ ) {
+        const gchar *sToken = *pToken, *s;
+        gdouble value, value2, multiplier;
+        gchar operator;
+        gboolean bFilter = FALSE;
+
+        if( *sToken == 0 || g_strv_contains( stopWords, sToken ) )
+            continue;
+
+        if( g_strcmp0( sToken, "traces" ) == 0 || g_strcmp0( sToken, "trace" ) == 0 ) {
+            bTracesOnly = TRUE;
+            continue;
+        }
+        if( g_strcmp0( sToken, "calibrations" ) == 0 || g_strcmp0( sToken, "calibration" ) == 0 ) {
+            bCalibrationsOnly = TRUE;
+            continue;
+        }
+
+        // measurement (S21, A/R ...) but not the single letter inputs that are too easily confused with text
+        for( gint i = 0; i < nOptMeasurementType && !bFilter; i++ ) {
+            if( strlen( optMeasurementType[ i ].desc ) > 1
+                    && g_ascii_strcasecmp( sToken, optMeasurementType[ i ].desc ) == 0 ) {
+                pQuery->measurementType = i;
+                bFilter = TRUE;
+            }
+        }
+        // format (LOGM, PHAS ...)
+        for( gint i = 0; i < nOptFormat && !bFilter; i++ ) {
+            if( matchOptionCode( sToken, optFormat[ i ].code ) ) {
+                pQuery->format = i;
+                bFilter = TRUE;
+            }
+        }
+        if( bFilter )
+            continue;
+
+        // calibration type (cal:FUL2, cal:S111 ...)
+        if( g_str_has_prefix( sToken, "cal:" ) ) {
+            for( gint i = 0; i < nOptCalType; i++ ) {
+                const gchar *sCode = optCalType[ i ].code;
+                sCode += g_str_has_prefix( sCode, "CALI" ) ? 4 : 3;
+                if( matchOptionCode( sToken + 4, sCode ) ) {
+                    pQuery->calType = i;
+                    bFilter = TRUE;
+                }
+            }
+            if( bFilter )
+                continue;
+        }
+
+        // IF bandwidth (IFBW<=100Hz)
+        if( g_str_has_prefix( sToken, "ifbw" )
+                && (s = parseComparison( sToken + 4, &operator )) != NULL && operator != 'g' && operator != '>' ) {
+            multiplier = 1.0;
+            if( (s = parseFrequency( s, &value, &multiplier )) != NULL && *s == 0 ) {
+                pQuery->maxIFbandwidth = value * multiplier;
+                continue;
+            }
+        }
+
+        // number of points (points=1601, pts>=201)
+        if( g_str_has_prefix( sToken, "points" ) || g_str_has_prefix( sToken, "pts" ) ) {
+            s = sToken + (g_str_has_prefix( sToken, "points" ) ? 6 : 3);
+            if( (s = parseComparison( s, &operator )) != NULL && g_ascii_isdigit( *s ) ) {
+                gint nPoints = atoi( s );
+                switch( operator ) {
+                case '=': pQuery->minPoints = pQuery->maxPoints = nPoints; break;
+                case '<': pQuery->maxPoints = nPoints;     break;
+                case 'l': pQuery->maxPoints = nPoints - 1; break;
+                case '>': pQuery->minPoints = nPoints;     break;
+                case 'g': pQuery->minPoints = nPoints + 1; break;
+                }
+                continue;
+            }
+        }
+
+        // frequency or frequency range (1-2ghz, 900mhz) ... the default unit is MHz
+        multiplier = 1.0e6;
+        if( (s = parseFrequency( sToken, &value, &multiplier )) != NULL ) {
+            if( *s == 0 ) {
+                pQuery->minFrequency = pQuery->maxFrequency = value * multiplier;
+                continue;
+            } else if( *s == '-' ) {
+                gdouble multiplier2 = multiplier;
+                gboolean bFirstUnit = !g_ascii_isdigit( s[-1] ) && s[-1] != '.';
+                if( (s = parseFrequency( s + 1, &value2, &multiplier2 )) != NULL && *s == 0 ) {
+                    // "1-2ghz" ... the unit applies to both
+                    pQuery->minFrequency = value * (bFirstUnit ? multiplier : multiplier2);
+                    pQuery->maxFrequency = value2 * multiplier2;
+                    continue;
+                }
+            }
+        }
+
+        // anything else is text (as a quoted prefix so that FTS syntax characters are harmless)
+        if( sText->len )
+            g_string_append_c( sText, ' ' );
+        g_string_append_c( sText, '"' );
+        for( s = sToken; *s; s++ ) {
+            if( *s == '"' )
+                g_string_append_c( sText, '"' );
+            g_string_append_c( sText, *s );
+        }
+        g_string_append( sText, "\"*" );
+        g_ptr_array_add( words, g_strdup( sToken ) );
+    }
+    g_ptr_array_add( words, NULL );
+
+    // asking for neither is the same as asking for both
+    pQuery->bTraces = bTracesOnly || !bCalibrationsOnly;
+    pQuery->bCalibrations = bCalibrationsOnly || !bTracesOnly;
+    pQuery->sText = g_string_free( sText, sText->len == 0 );
+    pQuery->sWords = (gchar **)g_ptr_array_free( words, FALSE );
+
+    g_strfreev( tokens );
+    g_free( sNormal );
+}
+
+/*!     \brief  Add a search result to the list
+ *
+ * \param pResult       pointer to the search result
+ * \param pSearch       pointer to the search window data
+ * \return              TRUE to continue the search
+ */
+static gboolean
+addSearchResult( const tSearchResult *pResult, gpointer pSearch ) {
+    tSearchWindow *pSearchWindow = (tSearchWindow *)pSearch;
+    gchar *sStart = engNotation( pResult->sweepStart, 3, eENG_NORMAL, NULL );
+    gchar *sStop = engNotation( pResult->sweepStop, 3, eENG_NORMAL, NULL );
+    gchar *sSweep = g_strdup_printf( "%sHz – %sHz", sStart, sStop );
+    gchar *sIFBW = engNotation( pResult->IFbandwidth, 0, eENG_NORMAL, NULL );
+    gchar *sIFBWunit = g_strdup_printf( "%sHz", sIFBW );
+    const gchar *sMeasurement = "";
+    GtkTreeIter iter;
+
+    if( pResult->whichTable == eDB_TRACE ) {
+        if( pResult->measurementType >= 0 && pResult->measurementType < nOptMeasurementType )
+            sMeasurement = optMeasurementType[ pResult->measurementType ].desc;
+    } else if( pResult->calType >= 0 && pResult->calType < nOptCalType ) {
+        sMeasurement = optCalType[ pResult->calType ].desc;
+    }
+
+    gtk_list_store_insert_with_values( pSearchWindow->wStore, &iter, -1,
+            SR_COL_TYPE, pResult->whichTable == eDB_TRACE ? "📈" : "⚙︎",
+            SR_COL_PROJECT, pResult->sProject,
+            SR_COL_NAME, pResult->sName,
+            SR_COL_TITLE, pResult->sTitle ? pResult->sTitle : "",
+            SR_COL_SWEEP, sSweep,
+            SR_COL_POINTS, pResult->nPoints,
+            SR_COL_IFBW, sIFBWunit,
+            SR_COL_MEASUREMENT, sMeasurement,
+            SR_COL_DATE, pResult->dateTime ? pResult->dateTime : "",
+            SR_COL_TABLE, pResult->whichTable,
+            -1 );
+    pSearchWindow->nResults++;
+
+    g_free( sStart );
+    g_free( sStop );
+    g_free( sSweep );
+    g_free( sIFBW );
+    g_free( sIFBWunit );
+    return TRUE;
+}
+
+/*!     \brief  Stop any search in progress
+ *
+ * \param pSearchWindow pointer to the search window data
+ */
+static void
+cancelSearch( tSearchWindow *pSearchWindow ) {
+    if( pSearchWindow->idleSource ) {
+        g_source_remove( pSearchWindow->idleSource );
+        pSearchWindow->idleSource = 0;
+    }
+    closeSearchCursor( pSearchWindow->pCursor );
+    pSearchWindow->pCursor = NULL;
+}
+
+/*!     \brief  Show the next batch of search results (idle callback)
+ *
+ * The results are added in batches from the idle loop so that the first
+ * matches appear at once and the window stays responsive on large databases.
+ *
+ * \param pSearch       pointer to the search window data
+ * \return              G_SOURCE_CONTINUE until the search is complete
+ */
+static gboolean
+fillSearchResults( gpointer pSearch ) {
+    tSearchWindow *pSearchWindow = (tSearchWindow *)pSearch;
+    gint nFetched = fetchSearchResults( pSearchWindow->pCursor, SEARCH_BATCH, addSearchResult, pSearchWindow );
+    gchar *sStatus;
+
+    if( nFetched > 0 ) {
+        sStatus = g_strdup_printf( "%d profiles found … searching", pSearchWindow->nResults );
+        gtk_label_set_text( pSearchWindow->wStatus, sStatus );
+        g_free( sStatus );
+        return G_SOURCE_CONTINUE;
+    }
+
+    if( nFetched == ERROR )
+        sStatus = g_strdup( "Search failed" );
+    else if( pSearchWindow->nResults == 0 )
+        sStatus = g_strdup( "No matching profiles" );
+    else
+        sStatus = g_strdup_printf( "%d profile%s found", pSearchWindow->nResults,
+                pSearchWindow->nResults == 1 ? "" : "s" );
+    gtk_label_set_text( pSearchWindow->wStatus, sStatus );
+    g_free( sStatus );
+
+    pSearchWindow->idleSource = 0;
+    closeSearchCursor( pSearchWindow->pCursor );
+    pSearchWindow->pCursor = NULL;
+    return G_SOURCE_REMOVE;
+}
+
+/*!     \brief  Callback when the search text changes
+ *
+ * Start a new search (abandoning any in progress).
+ *
+ * \ingroup Search dialog widget callback
+ *
+ * \param wEntry        pointer to the search entry widget
+ * \param pSearchWindow pointer to the search window data
+ */
+static void
+CB_SearchChanged( GtkSearchEntry *wEntry, tSearchWindow *pSearchWindow ) {
+    tSearchQuery query;
+
+    cancelSearch( pSearchWindow );
+    gtk_list_store_clear( pSearchWindow->wStore );
+    pSearchWindow->nResults = 0;
+
+    parseSearchString( gtk_entry_get_text( GTK_ENTRY( wEntry ) ), &query );
+    pSearchWindow->pCursor = openSearchCursor( &query );
+    g_free( query.sText );
+    g_strfreev( query.sWords );
+
+    if( pSearchWindow->pCursor == NULL ) {
+        gtk_label_set_text( pSearchWindow->wStatus, "Search failed" );
+        return;
+    }
+    pSearchWindow->idleSource = g_idle_add( fillSearchResults, pSearchWindow );
+}
+
+/*!     \brief  Callback when a search result is activated (double click or enter)
+ *
+ * Select the project and the profile in the main window. A trace profile is recalled;
+ * a calibration profile is only selected because restoring it sends it to the analyzer.
+ *
+ * \ingroup Search dialog widget callback
+ *
+ * \param wTreeView     pointer to the tree view widget
+ * \param path          path of the activated row
+ * \param column        activated column
+ * \param pSearchWindow pointer to the search window data
+ */
+static void
+CB_SearchResultActivated( GtkTreeView *wTreeView, GtkTreePath *path,
+        GtkTreeViewColumn *column, tSearchWindow *pSearchWindow ) {
+    tGlobal *pGlobal = pSearchWindow->pGlobal;
+    GtkTreeModel *model = gtk_tree_view_get_model( wTreeView );
+    GtkTreeIter iter;
+    gchar *sProject = NULL, *sName = NULL;
+    gint whichTable;
+    gboolean bFound;
+
+    if( !gtk_tree_model_get_iter( model, &iter, path ) )
+        return;
+    gtk_tree_model_get( model, &iter, SR_COL_PROJECT, &sProject, SR_COL_NAME, &sName,
+            SR_COL_TABLE, &whichTable, -1 );
+
+    GtkComboBox *wComboProject = GTK_COMBO_BOX( g_hash_table_lookup( pGlobal->widgetHashTable,
+            (gconstpointer)"WID_Combo_Project" ) );
+    GtkComboBox *wComboProfile = GTK_COMBO_BOX( g_hash_table_lookup( pGlobal->widgetHashTable,
+            whichTable == eDB_TRACE ? (gconstpointer)"WID_Combo_TraceProfile"
+                                    : (gconstpointer)"WID_Combo_CalibrationProfile" ) );
+    GtkToggleButton *wRadio = GTK_TOGGLE_BUTTON( g_hash_table_lookup( pGlobal->widgetHashTable,
+            whichTable == eDB_TRACE ? (gconstpointer)"WID_RadioTraces" : (gconstpointer)"WID_RadioCal" ) );
+
+    // changing the project repopulates the profile combo boxes
+    if( g_strcmp0( sProject, pGlobal->sProject ) != 0 )
+        setGtkComboBox( wComboProject, sProject );
+    gtk_toggle_button_set_active( wRadio, TRUE );
+    bFound = setGtkComboBox( wComboProfile, sName );
+
+    if( bFound && whichTable == eDB_TRACE )
+        gtk_button_clicked( GTK_BUTTON( g_hash_table_lookup( pGlobal->widgetHashTable,
+                (gconstpointer)"WID_Btn_Recall" ) ) );
+
+    gtk_window_present( GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable,
+            (gconstpointer)"WID_hp8753c_main" ) ) );
+
+    g_free( sProject );
+    g_free( sName );
+}
+
+/*!     \brief  Callback when the search window is closed
+ *
+ * The window is hidden (not destroyed) so that the last search is still there when reopened.
+ *
+ * \ingroup Search dialog widget callback
+ *
+ * \param wWindow       pointer to the search window
+ * \param event         delete event
+ * \param pSearchWindow pointer to the search window data
+ * \return              TRUE (the event has been handled)
+ */
+static gboolean
+CB_SearchWindowDelete( GtkWidget *wWindow, GdkEvent *event, tSearchWindow *pSearchWindow ) {
+    cancelSearch( pSearchWindow );
+    gtk_widget_hide( wWindow );
+    return TRUE;
+}
+
+/*!     \brief  Create the search window
+ *
+ * \param pSearchWindow pointer to the search window data
+ * \param pGlobal       pointer to global data
+ */
+static void
+createSearchWindow( tSearchWindow *pSearchWindow, tGlobal *pGlobal ) {
+    static const struct { gchar *sTitle; gint column; gboolean bExpand; } columns[] = {
+            { "",            SR_COL_TYPE,        FALSE },
+            { "Project",     SR_COL_PROJECT,     FALSE },
+            { "Name",        SR_COL_NAME,        TRUE  },
+            { "Title",       SR_COL_TITLE,       TRUE  },
+            { "Sweep",       SR_COL_SWEEP,       FALSE },
+            { "Points",      SR_COL_POINTS,      FALSE },
+            { "IFBW",        SR_COL_IFBW,        FALSE },
+            { "Measurement", SR_COL_MEASUREMENT, FALSE },
+            { "Saved",       SR_COL_DATE,        FALSE } };
+    GtkWidget *wBox, *wEntry, *wScrolled, *wTreeView;
+
+    pSearchWindow->pGlobal = pGlobal;
+    pSearchWindow->wWindow = gtk_window_new( GTK_WINDOW_TOPLEVEL );
+    gtk_window_set_title( GTK_WINDOW( pSearchWindow->wWindow ), "Search Profiles" );
+    gtk_window_set_transient_for( GTK_WINDOW( pSearchWindow->wWindow ),
+            GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ) );
+    gtk_window_set_default_size( GTK_WINDOW( pSearchWindow->wWindow ), 900, 450 );
+
+    wBox = gtk_box_new( GTK_ORIENTATION_VERTICAL, 6 );
+    gtk_container_set_border_width( GTK_CONTAINER( wBox ), 6 );
+    gtk_container_add( GTK_CONTAINER( pSearchWindow->wWindow ), wBox );
+
+    wEntry = gtk_search_entry_new();
+    gtk_entry_set_placeholder_text( GTK_ENTRY( wEntry ), "e.g.  S21 traces 1-2 GHz with IFBW<=100 Hz" );
+    gtk_box_pack_start( GTK_BOX( wBox ), wEntry, FALSE, FALSE, 0 );
+    pSearchWindow->wEntry = GTK_SEARCH_ENTRY( wEntry );
+
+    pSearchWindow->wStore = gtk_list_store_new( SR_N_COLUMNS,
+            G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+            G_TYPE_INT, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_INT );
+    wTreeView = gtk_tree_view_new_with_model( GTK_TREE_MODEL( pSearchWindow->wStore ) );
+    g_object_unref( pSearchWindow->wStore );    // owned by the tree view
+    for( gint i = 0; i < sizeof( columns ) / sizeof( columns[0] ); i++ ) {
+        GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+        GtkTreeViewColumn *column;
+
+        if( columns[i].bExpand )
+            g_object_set( renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL );
+        column = gtk_tree_view_column_new_with_attributes( columns[i].sTitle, renderer,
+                "text", columns[i].column, NULL );
+        gtk_tree_view_column_set_resizable( column, TRUE );
+        gtk_tree_view_column_set_expand( column, columns[i].bExpand );
+        gtk_tree_view_append_column( GTK_TREE_VIEW( wTreeView ), column );
+    }
+
+    wScrolled = gtk_scrolled_window_new( NULL, NULL );
+    gtk_scrolled_window_set_policy( GTK_SCROLLED_WINDOW( wScrolled ), GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC );
+    gtk_container_add( GTK_CONTAINER( wScrolled ), wTreeView );
+    gtk_box_pack_start( GTK_BOX( wBox ), wScrolled, TRUE, TRUE, 0 );
+
+    pSearchWindow->wStatus = GTK_LABEL( gtk_label_new( "" ) );
+    gtk_widget_set_halign( GTK_WIDGET( pSearchWindow->wStatus ), GTK_ALIGN_START );
+    gtk_box_pack_start( GTK_BOX( wBox ), GTK_WIDGET( pSearchWindow->wStatus ), FALSE, FALSE, 0 );
+
+    g_signal_connect( wEntry, "search-changed", G_CALLBACK( CB_SearchChanged ), pSearchWindow );
+    g_signal_connect( wTreeView, "row-activated", G_CALLBACK( CB_SearchResultActivated ), pSearchWindow );
+    g_signal_connect( pSearchWindow->wWindow, "delete-event", G_CALLBACK( CB_SearchWindowDelete ), pSearchWindow );
+
+    gtk_widget_show_all( wBox );
+}
+
+/*!     \brief  Show the profile search window
+ *
+ * Show the window for searching the saved trace and calibration profiles.
+ * This is initiated by pressing F4
+ *
+ * \ingroup Search dialog widget callback
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+showSearchWindow( tGlobal *pGlobal ) {
+    if( searchWindow.wWindow == NULL ) {
+        createSearchWindow( &searchWindow, pGlobal );
+        // show everything to start with
+        CB_SearchChanged( searchWindow.wEntry, &searchWindow );
+    }
+    gtk_window_present( GTK_WINDOW( searchWindow.wWindow ) );
+}
@@ -610,6 +610,9 @@ CB_BtnSave (GtkButton *wButton, tGlobal *pGlobal)
 				g_free( pGlobal->HP8753.sNote );
 				pGlobal->HP8753.sNote = sNote;
 				int saveStatus = saveTraceData(pGlobal, pGlobal->sProject, sName);
+				// ... and, if enabled, keep every save in the time series archive (the profile only holds the last)
+				if( saveStatus == 0 && pGlobal->flags.bArchiveTraces )
+					appendTraceToArchive(pGlobal, pGlobal->sProject, sName, 0);
 				// add to the list
 				GList *liTraceAbstract = g_list_find_custom( pGlobal->pTraceList, &projectAndName,
 						(GCompareFunc)compareTraceItemsForFind );
@@ -1222,6 +1225,9 @@ CB_Notebook_Select( GtkNotebook *wNotebook,   GtkWidget* wPage,
 
 		GtkEntry *wEntryTitle = GTK_ENTRY(g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_EntryTitle"));
         gtk_entry_grab_focus_without_selecting (wEntryTitle);
+	} else if ( nPage == NPAGE_OPTIONS ) {
+		// refresh the database statistics
+		requestDBmaintenance( FALSE );
 	}
 }
 
@@ -18,6 +18,7 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
+#include <string.h>
 
 #include <glib-2.0/glib.h>
 #include <gpib/ib.h>
@@ -28,70 +29,310 @@
 
 #include "messageEvent.h"
 
-gint
-getSparam( gint descGPIB_HP8753, tGlobal *pGlobal, tComplex *Sparam[], gint *nPoints, gint *pGPIBstatus )
+// Acquisition schedule for the four S-parameters
+typedef enum {
+	eS2P_PAIRED_SWEEPS = 0,	// S11 / S21 on channels 1 / 2 then a second sweep for S22 / S12
+	eS2P_SINGLE_SWEEP		// full 2-port correction already sweeps both directions
+} tS2Pschedule;
+#define S1P_SWEEP	(eS2P_SINGLE_SWEEP + 1)	// timing model variant of an S1P sweep
+
+/*!     \brief  Choose how the four S-parameters are measured
+ *
+ * With a full 2-port (or TRL*) correction active, every sweep measures the
+ * forward and reverse directions to calculate the corrected data. All four
+ * S-parameters are therefore available after one sweep and can be read by
+ * changing the measured parameter without sweeping again.
+ * Otherwise a forward sweep (S11 / S21) and a reverse sweep (S22 / S12) are needed.
+ *
+ * \param  calType          calibration type of channel 1 (index into optCalType)
+ * \return the acquisition schedule
+ */
+static tS2Pschedule
+selectS2Pschedule( gint calType )
+{
+	switch( calType ) {
+	case eCALtypeFullTwoPort:
+	case eCALtypeTRL_LRM_TwoPort:
+		return eS2P_SINGLE_SWEEP;
+	default:
+		return eS2P_PAIRED_SWEEPS;
+	}
+}
+
+/*!     \brief  Add an HP8753 command to a command string
+ *
+ * The option table entries are queries (like "S11?;"); remove the '?' to make the command.
+ *
+ * \param  sCommands        command string to add to
+ * \param  sQuery           query from an option table
+ */
+static void
+appendHP8753command( GString *sCommands, const gchar *sQuery )
+{
+	for( const gchar *pChar = sQuery; *pChar; pChar++ )
+		if( *pChar != '?' )
+			g_string_append_c( sCommands, *pChar );
+}
+
+/*!     \brief  Read the formatted trace of the active channel
+ *
+ * Request the formatted trace (the format must already be FORM2) and read it.
+ * The data is not converted here, so that the reads of several parameters follow each other
+ * on the bus without the instrument waiting for us.
+ * Once the size of the trace is known, the header and the data are read in one transfer.
+ *
+ * \param  descGPIB_HP8753  GPIB descriptor for HP8753 device
+ * \param  pSizeF2          pointer to the number of data bytes (0 if not yet known)
+ * \param  pGPIBstatus      pointer to GPIB status
+ * \return malloced FORM2 data (including the 4 byte header) or NULL on error
+ */
+static guint8 *
+readFORM2trace( gint descGPIB_HP8753, guint16 *pSizeF2, gint *pGPIBstatus )
 {
+	guint16 headerAndSize[2];
+	guint8 *pFORM2 = NULL;
+
+	if( GPIBasyncWrite(descGPIB_HP8753, "OUTPFORM;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC) != eRDWT_OK )
+		return NULL;
+
+	if( *pSizeF2 == 0 ) {
+		// first read header and size of data
+		if( GPIBasyncRead(descGPIB_HP8753, headerAndSize, HEADER_SIZE, pGPIBstatus, 20 * TIMEOUT_RW_1SEC) != eRDWT_OK )
+			return NULL;
+		*pSizeF2 = GUINT16_FROM_BE(headerAndSize[1]);
+		pFORM2 = g_malloc( HEADER_SIZE + *pSizeF2 );
+		memcpy( pFORM2, headerAndSize, HEADER_SIZE );
+		if( GPIBasyncRead(descGPIB_HP8753, pFORM2 + HEADER_SIZE, *pSizeF2, pGPIBstatus, 30 * TIMEOUT_RW_1SEC) != eRDWT_OK ) {
+			g_free( pFORM2 );
+			return NULL;
+		}
+	} else {
+		// all traces of the S2P have the same number of points
+		pFORM2 = g_malloc( HEADER_SIZE + *pSizeF2 );
+		if( GPIBasyncRead(descGPIB_HP8753, pFORM2, HEADER_SIZE + *pSizeF2, pGPIBstatus, 30 * TIMEOUT_RW_1SEC) != eRDWT_OK
+				|| GUINT16_FROM_BE( ((guint16 *)pFORM2)[1] ) != *pSizeF2 ) {
+			g_free( pFORM2 );
+			return NULL;
+		}
+	}
+	return pFORM2;
+}
 
-	guint16 sizeF2 = 0, headerAndSize[2];
-	guint8 *pFORM2 = 0;
+/*!     \brief  Number of points in FORM2 data
+ *
+ * \param  pFORM2           FORM2 data (including the 4 byte header)
+ * \return number of points
+ */
+static gint
+FORM2points( guint8 *pFORM2 )
+{
+	return GUINT16_FROM_BE( ((guint16 *)pFORM2)[1] ) / (sizeof(gint32) * 2);
+}
+
+/*!     \brief  Convert FORM2 data to an S-parameter
+ *
+ * The real and imaginary parts are stored in the planes of the S-parameter,
+ * which must already have room for the points (see reserveS2P).
+ *
+ * \param  pFORM2           FORM2 data (including the 4 byte header)
+ * \param  pS2P             pointer to S2P data
+ * \param  sParam           the S-parameter to fill
+ * \param  first            first point to convert
+ * \param  nPoints          number of points to convert
+ */
+static void
+FORM2toS2P( guint8 *pFORM2, tS2P *pS2P, tS2Pparameter sParam, gint first, gint nPoints )
+{
+	guint8 *pData = pFORM2 + HEADER_SIZE;
+	gdouble *re = pS2P->re[ sParam ], *im = pS2P->im[ sParam ];
 	union {
 		float IEEE754;
 		guint32 bytes;
 	} rBits, iBits;
 
-	GPIBasyncWrite(descGPIB_HP8753, "FORM2;OUTPFORM;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-	// first read header and size of data
-	GPIBasyncRead(descGPIB_HP8753, headerAndSize, HEADER_SIZE, pGPIBstatus, 20 * TIMEOUT_RW_1SEC);
-	sizeF2 = GUINT16_FROM_BE(headerAndSize[1]);
-	pFORM2 = g_malloc(sizeF2);
-	GPIBasyncRead(descGPIB_HP8753, pFORM2, sizeF2, pGPIBstatus, 30 * TIMEOUT_RW_1SEC);
-
-	*nPoints = sizeF2 / (sizeof(gint32) * 2);
-	*Sparam = g_realloc( *Sparam, sizeof(tComplex) * sizeF2 );
-
-	for ( int i = 0; i < *nPoints; i++) {
-		rBits.bytes = GUINT32_FROM_BE( *(guint32* )(pFORM2 + i * sizeof(gint32) * 2));
-		iBits.bytes = GUINT32_FROM_BE( *(guint32* )(pFORM2 + i * sizeof(gint32) * 2 + sizeof(gint32)));
-		(*Sparam)[i].r = rBits.IEEE754;
-		(*Sparam)[i].i = iBits.IEEE754;
+	for ( int i = first; i < first + nPoints; i++) {
+		rBits.bytes = GUINT32_FROM_BE( *(guint32* )(pData + i * sizeof(gint32) * 2));
+		iBits.bytes = GUINT32_FROM_BE( *(guint32* )(pData + i * sizeof(gint32) * 2 + sizeof(gint32)));
+		re[i] = rBits.IEEE754;
+		im[i] = iBits.IEEE754;
 	}
+}
+
+#define DECODE_SLICE	401		// points converted before the task yields
+
+typedef struct {
+	guint8			*pFORM2;
+	tS2P			*pS2P;
+	tS2Pparameter	sParam;
+} tFORM2decode;
+
+/*!     \brief  Task converting FORM2 data to an S-parameter a slice at a time
+ *
+ * \param  pTask            pointer to the task
+ * \return eTASK_RUNNING until all the points have been converted
+ */
+static tGPIBtaskState
+decodeFORM2task( tGPIBtask *pTask )
+{
+	tFORM2decode *pDecode = pTask->pData;
+	gint nPoints = FORM2points( pDecode->pFORM2 );
+
+	TASK_BEGIN( pTask );
+	for( pTask->index = 0; pTask->index < nPoints; pTask->index += DECODE_SLICE ) {
+		FORM2toS2P( pDecode->pFORM2, pDecode->pS2P, pDecode->sParam,
+				pTask->index, MIN( DECODE_SLICE, nPoints - pTask->index ) );
+		TASK_YIELD( pTask );
+	}
+	TASK_END( pTask );
+}
+
+/*!     \brief  Convert a trace while the HP8753 goes on to the next sweep
+ *
+ * The conversion is done by a task of the GPIB thread (see GPIBtasks.c) so
+ * it must be completed with finishGPIBtasks() before the data is used
+ * (or the FORM2 data freed).
+ *
+ * \param  pFORM2           FORM2 data (including the 4 byte header) or NULL
+ * \param  pS2P             pointer to S2P data
+ * \param  sParam           the S-parameter to fill
+ * \return pFORM2 or NULL (the data is freed) if there is no room for it
+ */
+static guint8 *
+decodeFORM2inBackground( guint8 *pFORM2, tS2P *pS2P, tS2Pparameter sParam )
+{
+	tFORM2decode *pDecode;
+
+	if( pFORM2 == NULL )
+		return NULL;
+	if( reserveS2P( pS2P, FORM2points( pFORM2 ) ) != OK ) {
+		g_free( pFORM2 );
+		return NULL;
+	}
+
+	pDecode = g_new( tFORM2decode, 1 );
+	*pDecode = (tFORM2decode){ .pFORM2 = pFORM2, .pS2P = pS2P, .sParam = sParam };
+	spawnGPIBtask( decodeFORM2task, pDecode, g_free, "decode FORM2" );
+	return pFORM2;
+}
+
+/*!     \brief  Derive the frequency points of the S2P data
+ *
+ * \param  pS2P             pointer to S2P data
+ * \param  sweepStart       start frequency
+ * \param  sweepStop        stop frequency
+ */
+static void
+linearS2Pfrequencies( tS2P *pS2P, gdouble sweepStart, gdouble sweepStop )
+{
+	for ( int i = 0; i < pS2P->nPoints; i++) {
+		pS2P->freq[i] = sweepStart
+				+ (sweepStop - sweepStart) * ((gdouble) i / ((gdouble)pS2P->nPoints - 1));
+	}
+}
+
+static gint
+getSparam( gint descGPIB_HP8753, tGlobal *pGlobal, tS2Pparameter sParam, gint *pGPIBstatus )
+{
+	tS2P *pS2P = &pGlobal->HP8753.S2P;
+	guint16 sizeF2 = 0;
+	guint8 *pFORM2;
+
+	GPIBasyncWrite(descGPIB_HP8753, "FORM2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+	if( (pFORM2 = readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus )) == NULL )
+		return ERROR;
+
+	if( reserveS2P( pS2P, FORM2points( pFORM2 ) ) != OK ) {
+		g_free(pFORM2);
+		return ERROR;
+	}
+	FORM2toS2P( pFORM2, pS2P, sParam, 0, FORM2points( pFORM2 ) );
+	pS2P->nPoints = FORM2points( pFORM2 );
 	g_free(pFORM2);
 
 	return (GPIBfailed(*pGPIBstatus));
 }
 
+/*!     \brief  Send the learn string back to the HP8753
+ *
+ * Return the analyzer to the configuration saved before the measurement.
+ *
+ * \param  descGPIB_HP8753  GPIB descriptor for HP8753 device
+ * \param  learnString      learn string (FORM1 with header)
+ * \param  pGPIBstatus      pointer to GPIB status
+ */
+static void
+restoreHP8753learnString( gint descGPIB_HP8753, guchar *learnString, gint *pGPIBstatus )
+{
+	GPIBasyncWrite( descGPIB_HP8753, "FORM1;INPULEAS;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC );
+	// Includes the 4 byte header with size in bytes (big endian)
+	GPIBasyncSRQwrite( descGPIB_HP8753, learnString, lengthFORM1data(learnString),
+			pGPIBstatus, 10 * TIMEOUT_RW_1MIN  );
+
+	enableSRQonOPC( descGPIB_HP8753, pGPIBstatus ); // learn string wipes out ESR and SRQ enables
+}
+
 /*!     \brief  Retrieve all four complex S-paramaters data from HP8753
  *
  * Retrieve all four complex S-paramaters data from HP8753.
- * The souces must be coupled because we make the measurements in pairs
+ * If channel 1 has a full 2-port correction, one sweep provides all four parameters
+ * and only channel 1 is used (the sources need not be coupled).
+ * Otherwise the souces must be coupled because we make the measurements in pairs
  * with channel 1 / 2 measuring S11 / S21 then a sweep measuring S22 / S12
  *
+ * Once the analyzer has finished sweeping, the device is no longer needed and
+ * sweepsComplete (if not NULL) is called while the data is still to be read.
+ *
  * \param  descGPIB_HP8753  GPIB descriptor for HP8753 device
  * \param  pGlobal          Gloabl data
+ * \param  sweepsComplete   function called when the sweeps are complete (or NULL)
+ * \param  pUserData        data passed to sweepsComplete
  * \param  pGPIBstatus      pointer to GPIB status
  * \return 0 on success or 1 or -1 on problem
  */
 gint
-getHP3753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
+measureHP8753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal,
+		void (*sweepsComplete)( gpointer ), gpointer pUserData, gint *pGPIBstatus )
 {
+	tS2P *pS2P = &pGlobal->HP8753.S2P;
 	guchar *learnString = NULL;
+	guint8 *pFORM2[ eS2P_N_PARAMS ] = { NULL };
+	guint16 sizeF2 = 0;
 	gdouble sweepStart = 300.0e3, sweepStop=3.0e9;
+	gdouble sweepTime = 0.0;
+	// measure the parameter already selected last, so that it need not be restored (indexes of optMeasurementType)
+	gint order[ eS2P_N_PARAMS ] = { S11_MEAS, eMEAS_S21, eMEAS_S12, S22_MEAS };
+	gint measurement = ERROR, format = ERROR, sweepType = ERROR;
+	gboolean bLearnStringIndexes = (pGlobal->HP8753.pLSindexes != (void *)INVALID);
+	gboolean bCoupled, bContinuous;
+	eChannel activeChannel;
+	tS2Pschedule schedule;
+	tS2Pparameter sParam;
+	gchar *sCommand;
+	gint rtn = ERROR;
 	int i;
 
-    enableSRQonOPC( descGPIB_HP8753, pGPIBstatus );
+	enableSRQonOPC( descGPIB_HP8753, pGPIBstatus );
 
 	postInfo("Determine current configuration");
-	if( !getHP8753switchOnOrOff( descGPIB_HP8753, "COUC", pGPIBstatus ) ) {
-		postError("Source must be coupled for S2P");
-		return ERROR;
-	}
+	bCoupled = (getHP8753switchOnOrOff( descGPIB_HP8753, "COUC", pGPIBstatus ) == TRUE);
+	bContinuous = (getHP8753switchOnOrOff( descGPIB_HP8753, "CONT", pGPIBstatus ) == TRUE);
 	// Request Learn string
 	GPIBasyncWrite(descGPIB_HP8753, "FORM1;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
 	if ( get8753learnString( descGPIB_HP8753, &learnString, pGPIBstatus ))
 		goto err;
+	activeChannel = getActiveChannelFrom8753learnString( learnString, pGlobal );
 
 	GPIBasyncWrite(descGPIB_HP8753, "HOLD;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-	setHP8753channel( descGPIB_HP8753, eCH_ONE, pGPIBstatus );
+	// if we cannot tell which channel is active we must select it
+	if( activeChannel != eCH_ONE || !bLearnStringIndexes )
+		setHP8753channel( descGPIB_HP8753, eCH_ONE, pGPIBstatus );
+
+	schedule = selectS2Pschedule( getHP8753calType( descGPIB_HP8753, pGPIBstatus ) );
+	if( schedule == eS2P_PAIRED_SWEEPS && !bCoupled ) {
+		postError("Source must be coupled for S2P");
+		restoreHP8753learnString( descGPIB_HP8753, learnString, pGPIBstatus );
+		goto err;
+	}
 
 	if( getStartStopOrCenterSpanFrom8753learnString( learnString, pGlobal, eCH_ONE ) ) {
 		askHP8753_dbl(descGPIB_HP8753, "STAR", &sweepStart, pGPIBstatus);
@@ -103,64 +344,151 @@ getHP3753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 		sweepStart = sweepCenter - sweepSpan/2.0;
 		sweepStop = sweepCenter + sweepSpan/2.0;
 	}
-
-	postInfo("Set for S11 + S21");
-	GPIBasyncWrite(descGPIB_HP8753, "S11;SMIC;LINFREQ;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-	// Sweep
-	setHP8753channel( descGPIB_HP8753, eCH_TWO, pGPIBstatus );
-	// Depending upon the settings, a sweep may take a long time
-	if( GPIBasyncSRQwrite( descGPIB_HP8753, "S21;SMIC;SING;", NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
-		*pGPIBstatus = ERR;
-		goto err;
+	// the time the measurement sweeps take is learned relative to this
+	askHP8753_dbl(descGPIB_HP8753, "SWET", &sweepTime, pGPIBstatus);
+
+	if( schedule == eS2P_SINGLE_SWEEP ) {
+		// Note what we change so we can put it back without sending the learn string
+		measurement = getHP8753measurementType( descGPIB_HP8753, pGPIBstatus );
+		format = getHP8753format( descGPIB_HP8753, pGPIBstatus );
+		sweepType = getHP8753sweepType( descGPIB_HP8753, pGPIBstatus );
+		for( i = 0; i < eS2P_N_PARAMS - 1; i++ ) {
+			if( order[ i ] == measurement ) {
+				order[ i ] = order[ eS2P_N_PARAMS - 1 ];
+				order[ eS2P_N_PARAMS - 1 ] = measurement;
+			}
+		}
+
+		postInfo("Measure S11, S21, S12 + S22");
+		// Depending upon the settings, a sweep may take a long time
+		sCommand = g_strdup_printf( "%s;SMIC;LINFREQ;SING;", optMeasurementType[ order[0] ].desc );
+		if( GPIBasyncSRQwriteTimed( descGPIB_HP8753, sCommand, NULL_STR, pGPIBstatus,
+				eTIMED_SINGLE_SWEEP, eS2P_SINGLE_SWEEP, sweepTime, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
+			g_free( sCommand );
+			*pGPIBstatus = ERR;
+			goto err;
+		}
+		g_free( sCommand );
+		if( sweepsComplete )
+			sweepsComplete( pUserData );
+		GPIBasyncWrite(descGPIB_HP8753, "FORM2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+
+		for( i = 0; i < eS2P_N_PARAMS; i++ ) {
+			// The corrected data of the other parameters is calculated from the sweep just made
+			if( i != 0 ) {
+				sCommand = g_strdup_printf( "%s;", optMeasurementType[ order[i] ].desc );
+				GPIBasyncSRQwrite( descGPIB_HP8753, sCommand, NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1MIN );
+				g_free( sCommand );
+			}
+			// (converted while the HP8753 calculates the next parameter)
+			sParam = S2PparameterOfMeasurement( order[i] );
+			pFORM2[ sParam ] = decodeFORM2inBackground(
+					readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus ), pS2P, sParam );
+		}
+	} else {
+		postInfo("Set for S11 + S21");
+		GPIBasyncWrite(descGPIB_HP8753, "S11;SMIC;LINFREQ;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+		// Sweep
+		setHP8753channel( descGPIB_HP8753, eCH_TWO, pGPIBstatus );
+		// Depending upon the settings, a sweep may take a long time
+		if( GPIBasyncSRQwriteTimed( descGPIB_HP8753, "S21;SMIC;SING;", NULL_STR, pGPIBstatus,
+				eTIMED_SINGLE_SWEEP, eS2P_PAIRED_SWEEPS, sweepTime, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
+			*pGPIBstatus = ERR;
+			goto err;
+		}
+		GPIBasyncWrite(descGPIB_HP8753, "FORM2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+		// Read real / imag S21
+		postInfo("Read S21 data");
+		pFORM2[ eS2P_S21 ] = decodeFORM2inBackground(
+				readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus ), pS2P, eS2P_S21 );
+
+		// Next sweep on channel 2 will be S12
+		GPIBasyncWrite(descGPIB_HP8753, "S12;SMIC;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+
+		// ... but first get S11 from channel 1
+		setHP8753channel( descGPIB_HP8753, eCH_ONE, pGPIBstatus );
+		postInfo("Read S11 data");
+		pFORM2[ eS2P_S11 ] = decodeFORM2inBackground(
+				readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus ), pS2P, eS2P_S11 );
+
+		// Set channel 1 to measure S22 and sweep
+		postInfo("Set for S22 + S12");
+		// Depending upon the settings, a sweep may take a long time
+		if( GPIBasyncSRQwriteTimed( descGPIB_HP8753, "S22;SMIC;SING;", NULL_STR, pGPIBstatus,
+				eTIMED_SINGLE_SWEEP, eS2P_PAIRED_SWEEPS, sweepTime, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
+			*pGPIBstatus = ERR;
+			goto err;
+		}
+		if( sweepsComplete )
+			sweepsComplete( pUserData );
+		// collect S22 data
+		postInfo("Read S22 data");
+		pFORM2[ eS2P_S22 ] = decodeFORM2inBackground(
+				readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus ), pS2P, eS2P_S22 );
+
+		// Switch to channel two and get the S12 data
+		setHP8753channel( descGPIB_HP8753, eCH_TWO, pGPIBstatus );
+		postInfo("Read S12 data");
+		pFORM2[ eS2P_S12 ] = decodeFORM2inBackground(
+				readFORM2trace( descGPIB_HP8753, &sizeF2, pGPIBstatus ), pS2P, eS2P_S12 );
 	}
-	// Read real / imag S11
-	postInfo("Read S21 data");
-	getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S21, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
 
-	// Derive the frequency points
-	pGlobal->HP8753.S2P.freq = g_realloc(pGlobal->HP8753.S2P.freq, pGlobal->HP8753.S2P.nPoints * sizeof(gdouble) );
-	for ( i = 0; i < pGlobal->HP8753.S2P.nPoints; i++) {
-		pGlobal->HP8753.S2P.freq[i] = sweepStart
-				+ (sweepStop - sweepStart) * ((gdouble) i / ((gdouble)pGlobal->HP8753.S2P.nPoints - 1));
+	postInfo("Restore setup");
+	if( schedule == eS2P_SINGLE_SWEEP && bLearnStringIndexes
+			&& measurement != ERROR && format != ERROR && sweepType == eSWP_LINFREQ ) {
+		// Only the measurement and format of channel 1 (and the active channel and trigger) were changed
+		GString *sRestore = g_string_new( NULL );
+
+		if( measurement != order[ eS2P_N_PARAMS - 1 ] )
+			appendHP8753command( sRestore, optMeasurementType[ measurement ].code );
+		if( format != eFMT_SMITH )
+			appendHP8753command( sRestore, optFormat[ format ].code );
+		if( activeChannel != eCH_ONE )
+			g_string_append( sRestore, "CHAN2;" );
+		if( bContinuous )
+			g_string_append( sRestore, "CONT;" );
+		if( sRestore->len > 0 )
+			GPIBasyncSRQwrite( descGPIB_HP8753, sRestore->str, NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1MIN );
+		g_string_free( sRestore, TRUE );
+	} else {
+		// Return the analyzer to the previous configuration by sending back the learn string
+		restoreHP8753learnString( descGPIB_HP8753, learnString, pGPIBstatus );
 	}
-	// Next sweep on channel 2 will be S12
-	GPIBasyncWrite(descGPIB_HP8753, "S12;SMIC;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-
-	// ... but first get S11 from channel 1
-	setHP8753channel( descGPIB_HP8753, eCH_ONE, pGPIBstatus );
-	postInfo("Read S11 data");
-	getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S11, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
-
-	// Set channel 1 to measure S22 and sweep
-	postInfo("Set for S22 + S12");
-	// Depending upon the settings, a sweep may take a long time
-	if( GPIBasyncSRQwrite( descGPIB_HP8753, "S22;SMIC;SING;", NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
-        *pGPIBstatus = ERR;
-        goto err;
-    }
-	// collect S12 data
-	postInfo("Read S22 data");
-	getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S22, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
 
-	// Switch to channel two and get the S12 data
-	setHP8753channel( descGPIB_HP8753, eCH_TWO, pGPIBstatus );
-	postInfo("Read S12 data");
-	getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S12, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
+	// Finish converting the data (most of it was converted while the HP8753 was sweeping)
+	// (all the traces have the same number of points ... readFORM2trace checks)
+	finishGPIBtasks();
+	for( i = 0; i < eS2P_N_PARAMS; i++ ) {
+		if( pFORM2[ i ] == NULL )
+			goto err;
+	}
+	pS2P->nPoints = FORM2points( pFORM2[ eS2P_S11 ] );
 
-	postInfo("Restore setup");
-	// Return the analyzer to the previous configuration by sending back the learn string
-	GPIBasyncWrite( descGPIB_HP8753, "FORM1;INPULEAS;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC );
-	// Includes the 4 byte header with size in bytes (big endian)
-	GPIBasyncSRQwrite( descGPIB_HP8753, learnString, lengthFORM1data(learnString),
-			pGPIBstatus, 10 * TIMEOUT_RW_1MIN  );
+	// Derive the frequency points
+	linearS2Pfrequencies( pS2P, sweepStart, sweepStop );
+	pS2P->SnPtype = S2P;
 
-    enableSRQonOPC( descGPIB_HP8753, pGPIBstatus ); // learn string wipes out ESR and SRQ enables
-    pGlobal->HP8753.S2P.SnPtype = S2P;
+	rtn = GPIBfailed( *pGPIBstatus );
+err:
+	// the tasks converting the data must be done with it
+	finishGPIBtasks();
+	for( i = 0; i < eS2P_N_PARAMS; i++ )
+		g_free( pFORM2[ i ] );
 	g_free( learnString );
+	return rtn;
+}
 
-	return( GPIBfailed( *pGPIBstatus )  );
-err:
-	return ERROR;
+/*!     \brief  Retrieve all four complex S-paramaters data from HP8753
+ *
+ * \param  descGPIB_HP8753  GPIB descriptor for HP8753 device
+ * \param  pGlobal          Gloabl data
+ * \param  pGPIBstatus      pointer to GPIB status
+ * \return 0 on success or 1 or -1 on problem
+ */
+gint
+getHP3753_S2P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
+{
+	return measureHP8753_S2P( descGPIB_HP8753, pGlobal, NULL, NULL, pGPIBstatus );
 }
 
 /*!     \brief  Retrieve single S-paramater data from HP8753
@@ -177,8 +505,8 @@ getHP3753_S1P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 {
     guchar *learnString = NULL;
     gdouble sweepStart = 300.0e3, sweepStop=3.0e9;
+    gdouble sweepTime = 0.0;
     gint measurement = 0;
-    int i;
 
     enableSRQonOPC( descGPIB_HP8753, pGPIBstatus );
 
@@ -210,27 +538,26 @@ getHP3753_S1P( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
     }
 
     postInfo( measurement == S11_MEAS ? "Measure S11" : "Measure S22");
+    askHP8753_dbl(descGPIB_HP8753, "SWET", &sweepTime, pGPIBstatus);
 
-    // Depending upon the settings, a sweep may take a long time
-    if( GPIBasyncSRQwrite( descGPIB_HP8753, "SMIC;LINFREQ;SING;", NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
+    // Depending upon the settings, a sweep may take a long time (learned relative to the sweep time)
+    if( GPIBasyncSRQwriteTimed( descGPIB_HP8753, "SMIC;LINFREQ;SING;", NULL_STR, pGPIBstatus,
+            eTIMED_SINGLE_SWEEP, S1P_SWEEP, sweepTime, 10 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
         *pGPIBstatus = ERR;
         goto err;
     }
     if ( measurement == S11_MEAS ) {
         // Read real / imag S11
         postInfo( "Read S11");
-        getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S11, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
+        getSparam( descGPIB_HP8753, pGlobal, eS2P_S11, pGPIBstatus );
     } else {
         // Read real / imag S12
         postInfo( "Read S22");
-        getSparam( descGPIB_HP8753, pGlobal, &pGlobal->HP8753.S2P.S22, &pGlobal->HP8753.S2P.nPoints, pGPIBstatus );
+        getSparam( descGPIB_HP8753, pGlobal, eS2P_S22, pGPIBstatus );
     }
     // Derive the frequency points
-    pGlobal->HP8753.S2P.freq = g_realloc(pGlobal->HP8753.S2P.freq, pGlobal->HP8753.S2P.nPoints * sizeof(gdouble) );
-    for ( i = 0; i < pGlobal->HP8753.S2P.nPoints; i++) {
-        pGlobal->HP8753.S2P.freq[i] = sweepStart
-        		+ (sweepStop - sweepStart) * ((gdouble) i / ((gdouble)pGlobal->HP8753.S2P.nPoints - 1));
-    }
+    if( pGlobal->HP8753.S2P.pBuffer )
+        linearS2Pfrequencies( &pGlobal->HP8753.S2P, sweepStart, sweepStop );
 
     postInfo("Restore setup");
     // Return the analyzer to the previous configuration by sending back the learn string
@@ -32,24 +32,6 @@
 #define QUERY_SIZE    100
 #define ANSWER_SIZE    100
 
-// Index to HP8753 learn string for items that we cannot
-// get with conventional queries.
-// This will no doubt be different for every firmware version, so if in doubt
-// we don't access markers
-tLearnStringIndexes learnStringIndexes[] = {
-        {
-          .version        = 413,          // version valid for the data below
-          .iActiveChannel = 1859,         // active channel (0x01 or 0x02)
-          .iMarkersOn     = {2323, 2325}, // markers on     (bit or of 0x02 (marker 1) to 0x10 (marker 4) with 0x20 as all off)
-          .iMarkerActive  = {1285, 1378}, // current marker (0x02 (marker 1) to 0x10 (marker 4))
-          .iMarkerDelta   = {1286, 1379}, // (bit or of 0x02 (marker 1) to 0x10 (marker 4) with 0x20 (fixed) 0x40 as all off)
-          .iStartStop     = {2383, 2385}, // stimulus start/stop or center/span (0x01 is start/stop)
-          .iSmithMkrType  = {1289, 1382}, // Smith marker type 0x00 - Lin / 0x01 - Log / 0x02 - Re-Im / 0x04 - R+jX / 0x08 - G+jB
-          .iPolarMkrType  = {1288, 1381}, // Polar marker type 0x10 - Lin / 0x20 - log / 0x40 - Re-Im
-          .iNumSegments   = {2465, 2467}  // Number of segments defined (needed with 'all segments' sweep)
-        }
-};
-
 /*!     \brief  Enable for SRQ for OPC
  *
  * The OPC bit in the Event Status Register mask (B0) is set to
@@ -66,6 +48,11 @@ enableSRQonOPC( gint descGPIB_HP8753, gint *pGPIBstatus ) {
 
     return GPIBasyncWrite(descGPIB_HP8753, "ESE1;SRE32;", pGPIBstatus,  10 * TIMEOUT_RW_1SEC);
 }
+// estimated duration (s) of the operation being waited for (0 if unknown)
+static gdouble SRQestimate = 0.0;
+// when the last SRQ wait found the SRQ (monotonic us) .. the end of the operation for the timing model
+static gint64 SRQfoundTime = 0;
+
 /*!     \brief  Write string preceeding with OPC or binary adding OPC;NOOP;, then wait for SRQ
  *
  * The OPC bit in the Event Status Register mask (B0) is set to
@@ -83,8 +70,6 @@ tGPIBReadWriteStatus
 GPIBasyncSRQwrite( gint descGPIB_HP8753, void *pData,
         gint nBytes, gint *pGPIBstatus, gdouble timeoutSecs ) {
 
-#define SRQ_EVENT       1
-#define TIMEOUT_EVENT   0
 #define THIRTY_MS 0.030
 
     gchar *pPayload = NULL;
@@ -94,15 +79,34 @@ GPIBasyncSRQwrite( gint descGPIB_HP8753, void *pData,
     gdouble waitTime = 0.0;
     gint GPIBcontrollerIndex = 0;
     gint nTotalBytes = 0;
+    gint64 startTime;
+    gboolean bClearESR = FALSE;     // the ESR holds the OPC of the last SRQ
+    guchar statusByte = 0;
 
 #define SIZE_OPC_NOOP    9    // # bytes in OPC;NOOP;
+#define ESR_RESPONSE_MAXSIZE    5        // more than enough
 
     if (GPIBfailed(*pGPIBstatus)) {
         return eRDWT_PREVIOUS_ERROR;
     }
 
+#ifndef CLEAR_ESR
+    // The OPC of the last SRQ was shown by its status byte so the ESR was not read.
+    // Clear it now ... with the command or, before binary data, by reading it.
+    // (otherwise the event status summary stays set and the OPC cannot raise a new SRQ)
+    if( (bClearESR = GPIBsrqClearESR( descGPIB_HP8753, FALSE )) && nBytes >= 0 ) {
+        gchar sESR[ ESR_RESPONSE_MAXSIZE ] = {0};
+
+        if( GPIBasyncWrite( descGPIB_HP8753, "ESR?;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC ) != eRDWT_OK
+                || GPIBasyncRead( descGPIB_HP8753, sESR, ESR_RESPONSE_MAXSIZE, pGPIBstatus,
+                                    10 * TIMEOUT_RW_1SEC ) != eRDWT_OK )
+            return eRDWT_ERROR;
+    }
+#endif
+    expectGPIBsrq( descGPIB_HP8753 );
+
     if( nBytes < 0 ) {
-        pPayload = g_strdup_printf( "OPC;%s", (gchar *)pData );
+        pPayload = g_strdup_printf( "%sOPC;%s", bClearESR ? "CLES;ESE1;SRE32;" : "", (gchar *)pData );
         nTotalBytes = strlen( pPayload );
     } else {
         pPayload = g_malloc( nBytes + SIZE_OPC_NOOP );
@@ -119,77 +123,86 @@ GPIBasyncSRQwrite( gint descGPIB_HP8753, void *pData,
         g_free( pPayload );
     }
 
-    // get the controller index
-    ibask( descGPIB_HP8753, IbaBNA, &GPIBcontrollerIndex);
-    ibask( descGPIB_HP8753, IbaTMO, &currentTimeoutDevice);
-    ibtmo( descGPIB_HP8753, T1s);
-    ibask( GPIBcontrollerIndex, IbaTMO, &currentTimeoutController);
-    ibtmo( GPIBcontrollerIndex, T30ms);    // just to check if we've been ordered to abandon ship
-    DBG( eDEBUG_EXTENSIVE, "Waiting for SRQ" );
-    do {
-        short waitResult = 0;
-        char status = 0;
-        // This will timeout every 30ms (the timeout we set for the controller)
-        WaitSRQ( GPIBcontrollerIndex, &waitResult);
-
-        if ( waitResult == SRQ_EVENT ) {
-            // This actually is an SRQ ..  is it from the HP8753 ?
-            // Serial poll for status to reset SRQ and find out if it was the HP8753
-            if( (*pGPIBstatus = ibrsp( descGPIB_HP8753, &status)) & ERR ) {
-                LOG(G_LOG_LEVEL_CRITICAL, "HPIB serial poll fail %04X/%d", *pGPIBstatus, AsyncIberr());
+    startTime = g_get_monotonic_time();
+    if( GPIBreplaying() ) {
+        // (the status byte was recorded with the SRQ)
+        rtn = replayGPIBtransaction( eGPIB_SRQ_WAIT, &statusByte, sizeof( statusByte ), pGPIBstatus );
+        SRQfoundTime = g_get_monotonic_time();
+    } else {
+        // get the controller index
+        GPIBask( descGPIB_HP8753, IbaBNA, &GPIBcontrollerIndex);
+        GPIBask( descGPIB_HP8753, IbaTMO, &currentTimeoutDevice);
+        GPIBtmo( descGPIB_HP8753, T1s);
+        GPIBask( GPIBcontrollerIndex, IbaTMO, &currentTimeoutController);
+        GPIBtmo( GPIBcontrollerIndex, T30ms);    // just to check if we've been ordered to abandon ship
+        DBG( eDEBUG_EXTENSIVE, "Waiting for SRQ" );
+        do {
+            // This will timeout every 30ms (the timeout we set for the controller).
+            // All the devices we know are polled .. an SRQ from another is noted for its own wait.
+            if( serviceGPIBsrq( GPIBcontrollerIndex, pGPIBstatus ) == eRDWT_ERROR ) {
                 rtn = eRDWT_ERROR;
-            } else if( status & ST_SRQ ) {
+            } else if( GPIBsrqReceived( descGPIB_HP8753, &statusByte ) ) {
                 // there is but one condition that asserts the SRQ ... the OPC
-                // so it's probably not necessary in our setup to read the ESR.
-                // It also tends to re-enable the SRQ ... which is odd
-#ifndef CLEAR_ESR
-                // We've cleared the SRQ bit in the Status Register by the serial poll
-                // now clear the ESR flag by reading it
-#define ESR_RESPONSE_MAXSIZE    5        // more than enough
-                gchar sESR[ ESR_RESPONSE_MAXSIZE ] = {0};
-                // For some bazaar reason the HP8753C can raise SRQ again when the ESR?; is written and cleared when is read
-                // so mask it out before that.
-
-                if( GPIBasyncWrite(descGPIB_HP8753, "ESR?;", pGPIBstatus,
-                                            10 * TIMEOUT_RW_1SEC) == eRDWT_OK
-                    && GPIBasyncRead( descGPIB_HP8753, sESR, ESR_RESPONSE_MAXSIZE, pGPIBstatus,
-                                            10 * TIMEOUT_RW_1SEC ) == eRDWT_OK ) {
-                    gint ESR = atoi( sESR );
-                    if( ESR & ESE_OPC ) {
-                        rtn = eRDWT_OK;
-                    } else {
-                        DBG(eDEBUG_ALWAYS, "SRQ but ESR did not show OPC.. ESR = $s", sESR);
-                        rtn = eRDWT_ERROR;
-                    }
-                } else {
-                    rtn = eRDWT_ERROR;
-                }
-                // thats it .. we are good to go
-#else
+                SRQfoundTime = g_get_monotonic_time();
                 rtn = eRDWT_OK;
-#endif
-            }
-            // its not the HP8753 ... some other GPIB device is requesting service
-        } else { // it''s a 30ms timeout
-            // If we get a message on the queue, it is assumed to be an abort
-            if (checkMessageQueue( NULL) == SEVER_DIPLOMATIC_RELATIONS) {
+            } else if (GPIBjobCancelled()) {
+                // The job has been cancelled (by an abort)
                 // This will stop future GPIB commands for this sequence
                 *pGPIBstatus |= ERR;
                 rtn = eRDWT_ABORT;
+            } else if( GPIBtasksPending() ) {
+                // Convert data (etc.) while the HP8753 is busy (until the SRQ line is asserted)
+                runGPIBtasks( TASK_SLICE_us, GPIBcontrollerIndex );
             }
-        }
-        waitTime += THIRTY_MS;
-        if (waitTime > FIVE_SECONDS && fmod(waitTime, 1.0) < THIRTY_MS) {
-            gchar *sMessage;
-            if( nBytes == WAIT_STR && timeoutSecs > 15 ) {    // this means we have a "WAIT;" message .. so show the estimated time
-                sMessage = g_strdup_printf("✳️ Waiting for HP8753 : %ds / %.0lfs", (gint) (waitTime), (double)timeoutSecs / TIMEOUT_SAFETY_FACTOR );
-            } else {
-                sMessage = g_strdup_printf("✳️ Waiting for HP8753 : %ds", (gint) (waitTime));
+            waitTime = (g_get_monotonic_time() - startTime) / (gdouble)G_USEC_PER_SEC;
+            if (waitTime > FIVE_SECONDS && fmod(waitTime, 1.0) < THIRTY_MS) {
+                gchar *sMessage;
+                if( SRQestimate > 0.0 ) {    // learned from previous operations
+                    sMessage = g_strdup_printf("✳️ Waiting for HP8753 : %ds / ~%.0lfs", (gint) (waitTime), SRQestimate );
+                } else if( nBytes == WAIT_STR && timeoutSecs > 15 ) {    // this means we have a "WAIT;" message .. so show the estimated time
+                    sMessage = g_strdup_printf("✳️ Waiting for HP8753 : %ds / %.0lfs", (gint) (waitTime), (double)timeoutSecs / TIMEOUT_SAFETY_FACTOR );
+                } else {
+                    sMessage = g_strdup_printf("✳️ Waiting for HP8753 : %ds", (gint) (waitTime));
+                }
+                postInfo(sMessage);
+                g_free(sMessage);
+            }
+        } while (rtn == eRDWT_CONTINUE && (globalData.flags.bNoGPIBtimeout || waitTime < timeoutSecs));
+
+        // Return timeouts
+        GPIBtmo( descGPIB_HP8753, currentTimeoutDevice);
+        GPIBtmo( GPIBcontrollerIndex, currentTimeoutDevice);
+    }
+    recordGPIBtransaction( eGPIB_SRQ_WAIT, &statusByte, sizeof( statusByte ), rtn == eRDWT_OK ? sizeof( statusByte ) : 0,
+            startTime, g_get_monotonic_time() - startTime, rtn == eRDWT_CONTINUE ? eRDWT_TIMEOUT : rtn );
+
+#ifndef CLEAR_ESR
+    if( rtn == eRDWT_OK && (statusByte & ST_ESR) ) {
+        // The event status summary bit shows the OPC (the only event enabled) so there is
+        // no need to ask. The ESR is cleared with the next command (see above).
+        GPIBsrqClearESR( descGPIB_HP8753, TRUE );
+    } else if( rtn == eRDWT_OK ) {
+        // We've cleared the SRQ bit in the Status Register by the serial poll
+        // now clear the ESR flag by reading it
+        gchar sESR[ ESR_RESPONSE_MAXSIZE ] = {0};
+        // For some bazaar reason the HP8753C can raise SRQ again when the ESR?; is written and cleared when is read
+        // so mask it out before that.
+
+        if( GPIBasyncWrite(descGPIB_HP8753, "ESR?;", pGPIBstatus,
+                                    10 * TIMEOUT_RW_1SEC) == eRDWT_OK
+            && GPIBasyncRead( descGPIB_HP8753, sESR, ESR_RESPONSE_MAXSIZE, pGPIBstatus,
+                                    10 * TIMEOUT_RW_1SEC ) == eRDWT_OK ) {
+            gint ESR = atoi( sESR );
+            if( !(ESR & ESE_OPC) ) {
+                DBG(eDEBUG_ALWAYS, "SRQ but ESR did not show OPC.. ESR = $s", sESR);
+                rtn = eRDWT_ERROR;
             }
-            postInfo(sMessage);
-            g_free(sMessage);
+        } else {
+            rtn = eRDWT_ERROR;
         }
-    } while (rtn == eRDWT_CONTINUE && (globalData.flags.bNoGPIBtimeout || waitTime < timeoutSecs));
+        // thats it .. we are good to go
+    }
+#endif
 
     if( rtn == eRDWT_OK ) {
         DBG( eDEBUG_EXTENSIVE, "SRQ asserted and acknowledged" );
@@ -197,10 +210,6 @@ GPIBasyncSRQwrite( gint descGPIB_HP8753, void *pData,
         DBG( eDEBUG_ALWAYS, "SRQ error waiting: %04X/%d", ibsta, iberr );
     }
 
-    // Return timeouts
-    ibtmo( descGPIB_HP8753, currentTimeoutDevice);
-    ibtmo( GPIBcontrollerIndex, currentTimeoutDevice);
-
     if( rtn == eRDWT_CONTINUE ) {
         *pGPIBstatus |= ERR_TIMEOUT;
         return (eRDWT_TIMEOUT);
@@ -209,6 +218,52 @@ GPIBasyncSRQwrite( gint descGPIB_HP8753, void *pData,
     }
 }
 
+/*!     \brief  GPIBasyncSRQwrite with the timeout learned for the operation
+ *
+ * The timeout is learned from the time the operation took before on this
+ * instrument with this setup (see timingModel.c) and the default is used
+ * until enough is known. The time taken is then learned.
+ *
+ * \param descGPIB_HP8753  GPIB descriptor for HP8753 device
+ * \param pData            pointer to command to send (OPC permitted) or binary data
+ * \param nBytes           number of bytes or -1 for NULL terminated string
+ * \param pGPIBstatus      pointer to GPIB status
+ * \param operation        operation timed
+ * \param variant          setup variant of the operation
+ * \param expected         expected duration (in the units the operation is learned in)
+ * \param defaultTimeout   timeout until the duration has been learned
+ * \return TRUE on success or ERROR on problem
+ */
+tGPIBReadWriteStatus
+GPIBasyncSRQwriteTimed( gint descGPIB_HP8753, void *pData, gint nBytes, gint *pGPIBstatus,
+        tTimedOperation operation, gint variant, gdouble expected, gdouble defaultTimeout ) {
+    tHP8753 *pHP8753 = &globalData.HP8753;
+    gdouble timeoutSecs = timingModelTimeout( pHP8753, operation, variant, expected, defaultTimeout );
+    gint64 startTime = g_get_monotonic_time();
+    tGPIBReadWriteStatus rtn;
+
+    if (GPIBfailed(*pGPIBstatus))
+        return eRDWT_PREVIOUS_ERROR;
+
+    SRQestimate = timingModelEstimate( pHP8753, operation, variant, expected );
+    rtn = GPIBasyncSRQwrite( descGPIB_HP8753, pData, nBytes, pGPIBstatus, timeoutSecs );
+    SRQestimate = 0.0;
+
+    // a replayed session is paced by the replay speed
+    // (the operation ended when the SRQ was found .. not after clearing the ESR)
+    if( !GPIBreplaying() && (rtn == eRDWT_OK || rtn == eRDWT_TIMEOUT) )
+        timingModelLearn( pHP8753, operation, variant, expected,
+                ((rtn == eRDWT_OK ? SRQfoundTime : g_get_monotonic_time()) - startTime) / (gdouble)G_USEC_PER_SEC,
+                rtn == eRDWT_TIMEOUT );
+    if( rtn == eRDWT_TIMEOUT && timeoutSecs < defaultTimeout ) {
+        gchar *sMessage = g_strdup_printf( "HP8753 did not respond in %.0lfs (usually %.0lfs)",
+                timeoutSecs, timingModelEstimate( pHP8753, operation, variant, expected ) );
+        postError( sMessage );
+        g_free( sMessage );
+    }
+    return rtn;
+}
+
 
 
 /*!     \brief  Get option setting from list of possible
@@ -247,6 +302,7 @@ const HP8753_option optFormat[] = {
         { "SWR?;", "SWR" },
         { "REAL?;", "Real" },
         { "IMAG?;", "Imaginary" } };
+const gint nOptFormat = G_N_ELEMENTS( optFormat );
 /*!     \brief  Find the display/readout format for the current channel
  *
  * Find the format for the current channel.
@@ -298,6 +354,7 @@ const HP8753_option optMeasurementType[] = {
         { "MEASA?;", "A" },
         { "MEASB?;", "B" },
         { "MEASR?;", "R" } };
+const gint nOptMeasurementType = G_N_ELEMENTS( optMeasurementType );
 /*!     \brief  Find the measurement type for the current channel
  *
  * Find the measurement type for the current channel.
@@ -359,6 +416,7 @@ const HP8753_option optCalType[] =
       { "CALIFUL2?;",     "Full 2-port" },
       { "CALIONE?;",     "One path 2-port" },
       { "CALITRL2?;",     "TRL*/LRM* 2-port" } };
+const gint nOptCalType = G_N_ELEMENTS( optCalType );
 /*!     \brief  Find the type of calibration enabled
  *
  * Find the type of calibration enabled
@@ -408,7 +466,7 @@ askOption( gint descGPIB_HP8753, gchar *option, gint *pGPIBstatus ) {
     gint cnt = 0;
     GPIBasyncWrite(descGPIB_HP8753, option, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
     GPIBasyncRead(descGPIB_HP8753, &result, MAX_OPT_SIZE, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    cnt = AsyncIbcnt();
+    cnt = GPIBasyncCount();
     for( int i=0; GPIBsucceeded( *pGPIBstatus ) && i < cnt; i++ )
         if( result[i] == '1' ) {
             bOption = TRUE;
@@ -729,32 +787,23 @@ getHP8753switchOnOrOff( gint descGPIB_HP8753, gchar *sRequest, gint *pGPIBstatus
 
 /*!     \brief  assign learning string indexes based on firmware version
  *
- * Assign learning string indexes (to pointer in gloabl data structure) based on firmware version
+ * Assign learning string indexes (to pointer in gloabl data structure) based on
+ * the product and firmware version (see learnStringRegistry.c)
  *
  * \param  pGlobal  pointer to global data
  * \return true if assigned
  */
 gboolean
 selectLearningStringIndexes( tGlobal *pGlobal ) {
-    gint i;
-    gboolean bFound = FALSE;
-
-    pGlobal->HP8753.pLSindexes = (tLearnStringIndexes *)INVALID;
+    tLearnStringIndexes *pLSindexes = lookupLearnStringIndexes( pGlobal->HP8753.sProduct,
+                                            pGlobal->HP8753.firmwareVersion );
 
-    for( i = 0; i < sizeof(learnStringIndexes) / sizeof(tLearnStringIndexes); i++ ) {
-        if ( learnStringIndexes[ i ].version == pGlobal->HP8753.firmwareVersion ) {
-            pGlobal->HP8753.pLSindexes = &learnStringIndexes[i];
-            bFound = TRUE;
-            break;
-        }
-    }
-
-    if( !bFound && pGlobal->HP8753.firmwareVersion == pGlobal->HP8753.analyzedLSindexes.version ) {
-        pGlobal->HP8753.pLSindexes = &pGlobal->HP8753.analyzedLSindexes;
-        bFound = TRUE;
-    }
+    // an analysis kept only in the program options (by an earlier version)
+    if( pLSindexes == NULL && pGlobal->HP8753.firmwareVersion == pGlobal->HP8753.analyzedLSindexes.version )
+        pLSindexes = registerLearnStringIndexes( pGlobal->HP8753.sProduct, &pGlobal->HP8753.analyzedLSindexes );
 
-    return (bFound);
+    pGlobal->HP8753.pLSindexes = pLSindexes ? pLSindexes : (tLearnStringIndexes *)INVALID;
+    return (pLSindexes != NULL);
 }
 
 /*!     \brief  Get learning string from HP8753
@@ -795,6 +844,154 @@ err:
     return (GPIBfailed(*pGPIBstatus));
 }
 
+/*!     \brief  Read a trace array in one of the binary formats
+ *
+ * Send the output command and read the header, size and data pairs.
+ *  FORM1 - the HP8753's internal format (6 bytes per point) decoded here
+ *  FORM2 - 32 bit IEEE 754 (8 bytes per point)
+ *  FORM3 - 64 bit IEEE 754 (16 bytes per point)
+ *
+ * \param  descGPIB_HP8753    GPIB descriptor for HP8753 device
+ * \param  form        binary format (1, 2 or 3)
+ * \param  sOutput     output command (OUTPFORM; OUTPDATA; ...)
+ * \param  ppPoints    pointer to the array of points (g_realloc'ed to hold the trace)
+ * \param  pTiming     pointer to transfer timing (or NULL)
+ * \param  pGPIBstatus pointer of GPIB status
+ * \return number of points read (0 on error)
+ */
+static gint
+getHP8753binaryTrace( gint descGPIB_HP8753, gint form, gchar *sOutput, tComplex **ppPoints,
+        tTraceTransferTiming *pTiming, gint *pGPIBstatus ) {
+    static const gint bytesPerPoint[] = { 0, FORM1_POINT_SIZE, sizeof(gint32) * 2, sizeof(gint64) * 2 };
+    guint16 size = 0, headerAndSize[2];
+    guint8 *pData = 0;
+    gint nPoints;
+    gchar sCommand[ QUERY_SIZE ];
+    gint64 startTime, headerTime;
+
+    g_snprintf( sCommand, QUERY_SIZE, "FORM%d;%s", form, sOutput );
+    startTime = g_get_monotonic_time();
+    GPIBasyncWrite(descGPIB_HP8753, sCommand, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+    // first read header and size of data
+    GPIBasyncRead(descGPIB_HP8753, headerAndSize, HEADER_SIZE, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+    if( GPIBfailed(*pGPIBstatus) )
+        return 0;
+    headerTime = g_get_monotonic_time();
+    size = GUINT16_FROM_BE(headerAndSize[1]);
+    // the binary formats all start with '#A' ... anything else and we have lost our way
+    if( ((guint8 *)headerAndSize)[0] != '#' || ((guint8 *)headerAndSize)[1] != 'A'
+            || size % bytesPerPoint[ form ] != 0 )
+        return 0;
+    pData = g_malloc(size);
+    GPIBasyncRead(descGPIB_HP8753, pData, size, pGPIBstatus, 30 * TIMEOUT_RW_1SEC);
+
+    if( pTiming ) {
+        // the wait for the header is the HP8753 preparing the array
+        pTiming->instrumentTime = headerTime - startTime;
+        pTiming->transferTime = g_get_monotonic_time() - headerTime;
+        pTiming->nBytes = size + HEADER_SIZE;
+    }
+
+    nPoints = size / bytesPerPoint[ form ];
+    *ppPoints = g_realloc( *ppPoints, sizeof(tComplex) * MAX( nPoints, 1 ) );
+    binaryTraceToComplex( pData, form, nPoints, *ppPoints );
+    g_free(pData);
+
+    return GPIBfailed(*pGPIBstatus) ? 0 : nPoints;
+}
+
+// firmware with which a FORM1 transfer has failed (we use FORM2 from then on)
+static gint firmwareWithoutFORM1 = 0;
+
+/*!     \brief  Read a trace array using the fastest binary format that works
+ *
+ * FORM1 needs no conversion on the HP8753 so it is the quickest; if the
+ * option is set we try it and, should it fail, fall back to FORM2 for
+ * this firmware version.
+ *
+ * \param  descGPIB_HP8753    GPIB descriptor for HP8753 device
+ * \param  pGlobal     pointer global data
+ * \param  sOutput     output command (OUTPFORM; OUTPDATA; ...)
+ * \param  ppPoints    pointer to the array of points (g_realloc'ed to hold the trace)
+ * \param  pGPIBstatus pointer of GPIB status
+ * \return number of points read (0 on error)
+ */
+static gint
+getHP8753trace( gint descGPIB_HP8753, tGlobal *pGlobal, gchar *sOutput, tComplex **ppPoints, gint *pGPIBstatus ) {
+    gint nPoints;
+
+    if( pGlobal->flags.bFORM1traces && pGlobal->HP8753.firmwareVersion != firmwareWithoutFORM1 ) {
+        if( (nPoints = getHP8753binaryTrace( descGPIB_HP8753, 1, sOutput, ppPoints, NULL, pGPIBstatus )) != 0 )
+            return nPoints;
+        firmwareWithoutFORM1 = pGlobal->HP8753.firmwareVersion;
+        postInfo( "FORM1 transfer failed - using FORM2" );
+        *pGPIBstatus = GPIBclear( descGPIB_HP8753 );
+        usleep( ms( 250 ) );
+    }
+    return getHP8753binaryTrace( descGPIB_HP8753, 2, sOutput, ppPoints, NULL, pGPIBstatus );
+}
+
+/*!     \brief  Compare the time taken to read the trace in each binary format
+ *
+ * Read the active channel's formatted trace in FORM1, FORM2 and FORM3 and
+ * report the time the HP8753 takes to prepare the data and the transfer rate.
+ *
+ * \param  descGPIB_HP8753    GPIB descriptor for HP8753 device
+ * \param  pGPIBstatus pointer of GPIB status
+ * \return 0 (OK) or 1 (error)
+ */
+#define BENCHMARK_REPEATS   3
+gint
+benchmarkHP8753traceFormats( gint descGPIB_HP8753, gint *pGPIBstatus ) {
+    tComplex *pPoints[ 4 ] = { NULL, NULL, NULL, NULL };
+    gint nPoints[ 4 ] = { 0, 0, 0, 0 };
+    GString *sReport = g_string_new( "Transfer" );
+    gdouble maxDifference = 0.0;
+
+    for( gint form = 1; form <= 3; form++ ) {
+        tTraceTransferTiming timing, total = { 0, 0, 0 };
+
+        for( gint n = 0; n < BENCHMARK_REPEATS; n++ ) {
+            nPoints[ form ] = getHP8753binaryTrace( descGPIB_HP8753, form, "OUTPFORM;", &pPoints[ form ],
+                    &timing, pGPIBstatus );
+            if( nPoints[ form ] == 0 )
+                break;
+            total.instrumentTime += timing.instrumentTime;
+            total.transferTime += timing.transferTime;
+            total.nBytes += timing.nBytes;
+        }
+        if( nPoints[ form ] == 0 ) {
+            g_string_append_printf( sReport, " | FORM%d failed", form );
+            *pGPIBstatus = GPIBclear( descGPIB_HP8753 );
+            usleep( ms( 250 ) );
+            continue;
+        }
+        g_string_append_printf( sReport, " | FORM%d %.0f B/s, %.0f ms in HP8753", form,
+                total.nBytes / ((gdouble)(total.instrumentTime + total.transferTime) / G_USEC_PER_SEC),
+                (gdouble)total.instrumentTime / BENCHMARK_REPEATS / 1000.0 );
+        LOG( G_LOG_LEVEL_INFO, "FORM%d: %d points, %d bytes, HP8753 %.1f ms, transfer %.1f ms (mean of %d)", form, nPoints[ form ],
+                total.nBytes / BENCHMARK_REPEATS, (gdouble)total.instrumentTime / BENCHMARK_REPEATS / 1000.0,
+                (gdouble)total.transferTime / BENCHMARK_REPEATS / 1000.0, BENCHMARK_REPEATS );
+    }
+
+    // FORM1 has a 16 bit mantissa, so compare it with the (exact) FORM3 trace
+    if( nPoints[ 1 ] != 0 && nPoints[ 1 ] == nPoints[ 3 ] ) {
+        for( gint i = 0; i < nPoints[ 1 ]; i++ )
+            maxDifference = MAX( maxDifference, MAX( fabs( pPoints[ 1 ][ i ].r - pPoints[ 3 ][ i ].r ),
+                                                     fabs( pPoints[ 1 ][ i ].i - pPoints[ 3 ][ i ].i ) ) );
+        LOG( G_LOG_LEVEL_INFO, "FORM1 differs from FORM3 by at most %g", maxDifference );
+        g_string_append_printf( sReport, " | FORM1 within %.2g of FORM3", maxDifference );
+    }
+
+    postInfo( sReport->str );
+    g_string_free( sReport, TRUE );
+    for( gint form = 1; form <= 3; form++ )
+        g_free( pPoints[ form ] );
+
+    GPIBasyncWrite( descGPIB_HP8753, "FORM2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC );
+    return (GPIBfailed(*pGPIBstatus));
+}
+
 /*!     \brief  Get  the configuration and trace data for a channel
  *
  * Get the configuration and trace data for the channel
@@ -808,15 +1005,8 @@ err:
 gint
 getHP8753channelTrace(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel, gint *pGPIBstatus ) {
     tChannel *pChannel = &pGlobal->HP8753.channels[ channel ];
-    guint16 sizeF2 = 0, headerAndSize[2];
-    guint8 *pFORM2 = 0;
     gint i;
 
-    union {
-        float IEEE754;
-        guint32 bytes;
-    } rBits, iBits;
-
     pChannel->chFlags.bValidData = FALSE;
 
     pChannel->format = getHP8753format(descGPIB_HP8753, pGPIBstatus);
@@ -850,28 +1040,24 @@ getHP8753channelTrace(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel,
     pChannel->chFlags.bAveraging = askOption( descGPIB_HP8753, "AVERO?;", pGPIBstatus );
     pChannel->measurementType = getHP8753measurementType( descGPIB_HP8753, pGPIBstatus);
 
-    GPIBasyncWrite(descGPIB_HP8753, "FORM2;OUTPFORM;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    // first read header and size of data
-    GPIBasyncRead(descGPIB_HP8753, headerAndSize, HEADER_SIZE, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    sizeF2 = GUINT16_FROM_BE(headerAndSize[1]);
-    pFORM2 = g_malloc(sizeF2);
-    GPIBasyncRead(descGPIB_HP8753, pFORM2, sizeF2, pGPIBstatus, 30 * TIMEOUT_RW_1SEC);
+    pChannel->nPoints = getHP8753trace( descGPIB_HP8753, pGlobal, "OUTPFORM;",
+            &pChannel->responsePoints, pGPIBstatus );
 
-    pChannel->nPoints = sizeF2 / (sizeof(gint32) * 2);
-    pChannel->responsePoints = g_realloc( pChannel->responsePoints, sizeof(tComplex) * sizeF2 );
-    pChannel->stimulusPoints = g_realloc( pChannel->stimulusPoints, sizeof(gdouble) * sizeF2 );
+    // The corrected data (before formatting) lets the trace be shown in other formats later
+    if( !pGlobal->flags.bCaptureComplexData || pChannel->nPoints == 0
+            || getHP8753trace( descGPIB_HP8753, pGlobal, "OUTPDATA;",
+                    &pChannel->complexPoints, pGPIBstatus ) != pChannel->nPoints ) {
+        g_free( pChannel->complexPoints );
+        pChannel->complexPoints = NULL;
+    }
+
+    pChannel->stimulusPoints = g_realloc( pChannel->stimulusPoints, sizeof(gdouble) * MAX( pChannel->nPoints, 1 ) );
 
     gdouble logSweepStart = log10( pChannel->sweepStart );
     gdouble logStimulusStop = log10( pChannel->sweepStop );
     for ( i = 0; i < pChannel->nPoints; i++) {
         gdouble stimulusSample, stimulusFraction;
 
-        rBits.bytes = GUINT32_FROM_BE( *(guint32* )(pFORM2 + i * sizeof(gint32) * 2));
-        iBits.bytes = GUINT32_FROM_BE( *(guint32* )(pFORM2 + i * sizeof(gint32) * 2 + sizeof(gint32)));
-        pChannel->responsePoints[i].r = rBits.IEEE754;
-        pChannel->responsePoints[i].i = iBits.IEEE754;
-        // g_print( "%3d : %15e + j %15e\n", i, trace->points[i].r, trace->points[i].i);
-
         stimulusFraction = (gdouble) i / (pChannel->nPoints-1);
 
         switch( pChannel->sweepType ) {
@@ -889,7 +1075,7 @@ getHP8753channelTrace(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel,
             stimulusSample = pChannel->sweepStart + (pChannel->sweepStop - pChannel->sweepStart) * stimulusFraction;
             break;
         case eSWP_LOGFREQ:
-            stimulusSample = pow( 10.0,  logSweepStart + ( logStimulusStop - logSweepStart) * logStimulusStop );
+            stimulusSample = pow( 10.0,  logSweepStart + ( logStimulusStop - logSweepStart) * stimulusFraction );
             break;
         }
         pChannel->stimulusPoints[i] = stimulusSample;
@@ -897,7 +1083,6 @@ getHP8753channelTrace(gint descGPIB_HP8753, tGlobal *pGlobal, eChannel channel,
 
     if (pChannel->nPoints != 0 && !GPIBfailed(*pGPIBstatus))
         pChannel->chFlags.bValidData = TRUE;
-    g_free(pFORM2);
 
     return (GPIBfailed(*pGPIBstatus));
 }
@@ -953,10 +1138,10 @@ acquireHPGLplot( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus ) {
         if( GPIBasyncRead(descGPIB_HP8753, sHPGL+offset, MAX_HPGL_PLOT_CHUNK-offset,
                 pGPIBstatus, 1 * TIMEOUT_RW_1SEC) != eRDWT_OK )
             break;
-        sHPGL[ AsyncIbcnt()+offset ] = 0;
+        sHPGL[ GPIBasyncCount()+offset ] = 0;
         if( GPIBsucceeded(*pGPIBstatus) ) {
             if( pGlobal->flags.bbDebug == 6 )
-                g_printerr( "%.*s", AsyncIbcnt(), sHPGL+offset );
+                g_printerr( "%.*s", (gint)GPIBasyncCount(), sHPGL+offset );
             gchar **tokens =  g_strsplit ( sHPGL, ";", -1 );
             gint max=g_strv_length(tokens);
             // the last string may be partial, so stuff it into
@@ -1106,7 +1291,8 @@ process8753learnString( gint descGPIB_HP8753, guchar *pHP8753C_learn, tGlobal *p
  * There are no GPIB commands to find some required data; however there
  * are bytes in the learn string that we can use to determine these data.
  * We change settings with GPIB commands and then read back the learn string to
- * find which bytes have changed in the expected manner
+ * find which bytes have changed in the expected manner.
+ * Only the indexes not already known (0) are looked for.
  *
  * \param  descGPIB_HP8753    GPIB descriptor for HP8753 device
  * \param  pLSindex    pointer to the learn string index structure that will be updated
@@ -1121,6 +1307,7 @@ analyze8753learnString( gint descGPIB_HP8753, tLearnStringIndexes *pLSindexes, g
 
 #define START_OF_LS_PAYLOAD        4
 #define LS_PAYLOAD_SIZE_INDEX    2
+#define LS_KNOWN( index )       ((index)[ eCH_ONE ] != 0 && (index)[ eCH_TWO ] != 0)
     // We can restore the current state after examining changes
     enableSRQonOPC( descGPIB_HP8753, pGPIBstatus );
 
@@ -1139,108 +1326,120 @@ analyze8753learnString( gint descGPIB_HP8753, tLearnStringIndexes *pLSindexes, g
     if ( get8753learnString( descGPIB_HP8753, &baselineLS, pGPIBstatus ) )
         goto err;
 
-    DBG( eDEBUG_TESTING, "%s: Determine active channel", __FUNCTION__);
-    postInfo("active channel");
     LSsize = GUINT16_FROM_BE(*(guint16 *)(baselineLS+LS_PAYLOAD_SIZE_INDEX));
 // Active channel
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;CHAN2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-            goto err;
 #define LS_ACTIVE_CHAN1    0x01
 #define    LS_ACTIVE_CHAN2    0x02
-    for( i=START_OF_LS_PAYLOAD; i < LSsize; i++ ) {
-        if( baselineLS[i] == LS_ACTIVE_CHAN1 && modifiedLS[i] == LS_ACTIVE_CHAN2 ) {
-            pLSindexes->iActiveChannel = i;
-            DBG( eDEBUG_TESTING, "%s: Active channel @ %d", __FUNCTION__, i);
+    if( pLSindexes->iActiveChannel == 0 ) {
+        DBG( eDEBUG_TESTING, "%s: Determine active channel", __FUNCTION__);
+        postInfo("active channel");
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;CHAN2;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+                goto err;
+        for( i=START_OF_LS_PAYLOAD; i < LSsize; i++ ) {
+            if( baselineLS[i] == LS_ACTIVE_CHAN1 && modifiedLS[i] == LS_ACTIVE_CHAN2 ) {
+                pLSindexes->iActiveChannel = i;
+                DBG( eDEBUG_TESTING, "%s: Active channel @ %d", __FUNCTION__, i);
+            }
         }
     }
 
-    DBG( eDEBUG_TESTING, "%s: Determine enabled markers", __FUNCTION__);
-    postInfo("enabled markers");
-    // Markers and active marker
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;MARK1;MARK4;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-        goto err;
+    if( !LS_KNOWN( pLSindexes->iMarkersOn ) || !LS_KNOWN( pLSindexes->iMarkerActive ) ) {
+        DBG( eDEBUG_TESTING, "%s: Determine enabled markers", __FUNCTION__);
+        postInfo("enabled markers");
+        // Markers and active marker
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;MARK1;MARK4;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+            goto err;
 #define LS_NO_MARKERS        0x00
 #define    LS_MARKERS_1AND4    0x12
 #define LS_NO_ACTIVE_MKRS    0x00
 #define LS_ACTIVE_MKR_4        0x10
-    for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE, channelFn2=eCH_ONE;
-            i < LSsize && (channel <= eCH_TWO || channelFn2 <= eCH_TWO); i++ ) {
-        if( baselineLS[i] == LS_NO_MARKERS && modifiedLS[i] == LS_MARKERS_1AND4 ) {
-            DBG( eDEBUG_TESTING, "%s: Enabled markers - ch %d @ %d", __FUNCTION__, channel, i);
-            pLSindexes->iMarkersOn[ channel++ ] = i;
-        }
-        if( baselineLS[i] == LS_NO_ACTIVE_MKRS && modifiedLS[i] == LS_ACTIVE_MKR_4 ) {
-            DBG( eDEBUG_TESTING, "%s: Active marker - ch %d @ %d", __FUNCTION__, channelFn2, i);
-            pLSindexes->iMarkerActive[ channelFn2++ ] = i;
+        for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE, channelFn2=eCH_ONE;
+                i < LSsize && (channel <= eCH_TWO || channelFn2 <= eCH_TWO); i++ ) {
+            if( baselineLS[i] == LS_NO_MARKERS && modifiedLS[i] == LS_MARKERS_1AND4 ) {
+                DBG( eDEBUG_TESTING, "%s: Enabled markers - ch %d @ %d", __FUNCTION__, channel, i);
+                pLSindexes->iMarkersOn[ channel++ ] = i;
+            }
+            if( baselineLS[i] == LS_NO_ACTIVE_MKRS && modifiedLS[i] == LS_ACTIVE_MKR_4 ) {
+                DBG( eDEBUG_TESTING, "%s: Active marker - ch %d @ %d", __FUNCTION__, channelFn2, i);
+                pLSindexes->iMarkerActive[ channelFn2++ ] = i;
+            }
         }
     }
 
-    DBG( eDEBUG_TESTING, "%s: Determine enabled delta marker", __FUNCTION__);
-    postInfo("enabled delta marker");
-    // Delta Marker
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;DELR4;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-        goto err;
+    if( !LS_KNOWN( pLSindexes->iMarkerDelta ) ) {
+        DBG( eDEBUG_TESTING, "%s: Determine enabled delta marker", __FUNCTION__);
+        postInfo("enabled delta marker");
+        // Delta Marker
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;DELR4;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+            goto err;
 #define LS_NO_DELTA_MKR    0x40
 #define    LS_DELTA_MKR4    0x10
-    for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
-        if( baselineLS[i] == LS_NO_DELTA_MKR && modifiedLS[i] == LS_DELTA_MKR4 ) {
-            DBG( eDEBUG_TESTING, "%s: Enabled delta marker - ch %d @ %d", __FUNCTION__, channel, i);
-            pLSindexes->iMarkerDelta[ channel++ ] = i;
+        for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
+            if( baselineLS[i] == LS_NO_DELTA_MKR && modifiedLS[i] == LS_DELTA_MKR4 ) {
+                DBG( eDEBUG_TESTING, "%s: Enabled delta marker - ch %d @ %d", __FUNCTION__, channel, i);
+                pLSindexes->iMarkerDelta[ channel++ ] = i;
+            }
         }
     }
 
-    DBG( eDEBUG_TESTING, "%s: Determine start/stop or center", __FUNCTION__);
-    postInfo("start/stop or center/span");
+    if( !LS_KNOWN( pLSindexes->iStartStop ) ) {
+        DBG( eDEBUG_TESTING, "%s: Determine start/stop or center", __FUNCTION__);
+        postInfo("start/stop or center/span");
 #define LS_START_STOP    0x01
 #define    LS_CENTER_SPAN    0x00
-    // Strt/Stop or Center
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;CENT1500.15E6;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    GPIBasyncWrite(descGPIB_HP8753, "CHAN2;CENT1500.15E6;CHAN1;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-            goto err;
-    for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
-        if( baselineLS[i] == LS_START_STOP && modifiedLS[i] == LS_CENTER_SPAN ) {
-            DBG( eDEBUG_TESTING, "%s: start/stop or center - ch %d @ %d", __FUNCTION__, channel, i);
-            pLSindexes->iStartStop[ channel++ ] = i;
+        // Strt/Stop or Center
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;CENT1500.15E6;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        GPIBasyncWrite(descGPIB_HP8753, "CHAN2;CENT1500.15E6;CHAN1;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+                goto err;
+        for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
+            if( baselineLS[i] == LS_START_STOP && modifiedLS[i] == LS_CENTER_SPAN ) {
+                DBG( eDEBUG_TESTING, "%s: start/stop or center - ch %d @ %d", __FUNCTION__, channel, i);
+                pLSindexes->iStartStop[ channel++ ] = i;
+            }
         }
     }
 
-    DBG( eDEBUG_TESTING, "%s: Determine polar/smith marker", __FUNCTION__);
-    postInfo("polar/smith marker");
+    if( !LS_KNOWN( pLSindexes->iPolarMkrType ) || !LS_KNOWN( pLSindexes->iSmithMkrType ) ) {
+        DBG( eDEBUG_TESTING, "%s: Determine polar/smith marker", __FUNCTION__);
+        postInfo("polar/smith marker");
 #define LS_POLMKR_AngAmp    0x10
 #define LS_POLMKR_RI        0x40
 #define LS_SMIMKR_RI        0x04
 #define LS_SMIMKR_GB        0x08
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;POLMRI;SMIMGB;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-            goto err;
-    for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE, channelFn2=eCH_ONE;
-            i < LSsize && (channel <= eCH_TWO || channelFn2 <= eCH_TWO); i++ ) {
-        if( baselineLS[i] == LS_POLMKR_AngAmp && modifiedLS[i] == LS_POLMKR_RI ) {
-            DBG( eDEBUG_TESTING, "%s: polar mkr type - ch %d @ %d", __FUNCTION__, channel, i);
-            pLSindexes->iPolarMkrType[ channel++ ] = i;
-        }
-        if( baselineLS[i] == LS_SMIMKR_RI && modifiedLS[i] == LS_SMIMKR_GB ) {
-            pLSindexes->iSmithMkrType[ channelFn2++ ] = i;
-            DBG( eDEBUG_TESTING, "%s: Smith mkr type - ch %d @ %d", __FUNCTION__, channel, i);
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;POLMRI;SMIMGB;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+                goto err;
+        for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE, channelFn2=eCH_ONE;
+                i < LSsize && (channel <= eCH_TWO || channelFn2 <= eCH_TWO); i++ ) {
+            if( baselineLS[i] == LS_POLMKR_AngAmp && modifiedLS[i] == LS_POLMKR_RI ) {
+                DBG( eDEBUG_TESTING, "%s: polar mkr type - ch %d @ %d", __FUNCTION__, channel, i);
+                pLSindexes->iPolarMkrType[ channel++ ] = i;
+            }
+            if( baselineLS[i] == LS_SMIMKR_RI && modifiedLS[i] == LS_SMIMKR_GB ) {
+                pLSindexes->iSmithMkrType[ channelFn2++ ] = i;
+                DBG( eDEBUG_TESTING, "%s: Smith mkr type - ch %d @ %d", __FUNCTION__, channel, i);
+            }
         }
     }
 
-    DBG( eDEBUG_TESTING, "%s: enabled segments", __FUNCTION__);
-    postInfo("enabled segments");
+    if( !LS_KNOWN( pLSindexes->iNumSegments ) ) {
+        DBG( eDEBUG_TESTING, "%s: enabled segments", __FUNCTION__);
+        postInfo("enabled segments");
 #define LS_NO_SEGMENTS    0x00
 #define    LS_ONE_SEGMENT    0x03
-    // Number of list segments
-    GPIBasyncWrite(descGPIB_HP8753, "PRES;EDITLIST;SADD;SADD;SADD;EDITDONE;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
-    if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
-            goto err;
-    for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
-        if( baselineLS[i] == LS_NO_SEGMENTS && modifiedLS[i] == LS_ONE_SEGMENT ) {
-            DBG( eDEBUG_TESTING, "%s: enabled segments - ch %d @ %d", __FUNCTION__, channel, i);
-            pLSindexes->iNumSegments[ channel++ ] = i;
+        // Number of list segments
+        GPIBasyncWrite(descGPIB_HP8753, "PRES;EDITLIST;SADD;SADD;SADD;EDITDONE;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+        if ( get8753learnString( descGPIB_HP8753, &modifiedLS, pGPIBstatus ) )
+                goto err;
+        for( i=START_OF_LS_PAYLOAD, channel=eCH_ONE; i < LSsize && channel <= eCH_TWO; i++ ) {
+            if( baselineLS[i] == LS_NO_SEGMENTS && modifiedLS[i] == LS_ONE_SEGMENT ) {
+                DBG( eDEBUG_TESTING, "%s: enabled segments - ch %d @ %d", __FUNCTION__, channel, i);
+                pLSindexes->iNumSegments[ channel++ ] = i;
+            }
         }
     }
 
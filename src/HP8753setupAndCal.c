@@ -53,7 +53,7 @@ get8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 	gint i, nchannel;
 
 	// clear the status registers and preset the HP8753
-	*pGPIBstatus = ibclr( descGPIB_HP8753 );
+	*pGPIBstatus = GPIBclear( descGPIB_HP8753 );
 	GPIBasyncWrite(descGPIB_HP8753, "CLS;", pGPIBstatus, 20 * TIMEOUT_RW_1SEC);
 	usleep( ms(20) );
 	GPIBasyncSRQwrite(descGPIB_HP8753, "ESE1;SRE32;NOOP;", NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
@@ -155,7 +155,7 @@ get8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 					pGlobal->HP8753cal.perChannelCal[ channel ].settings.bbInterplativeCalibration = eInterplativeCalibration;
 					postInfo( "Retrieve the interpolated calibration arrays");
 				} else {
-					ibclr( descGPIB_HP8753 );
+					GPIBclear( descGPIB_HP8753 );
 					pGlobal->HP8753cal.perChannelCal[ channel ].settings.bbInterplativeCalibration = eNoInterplativeCalibration;
 					// Get measured calibration arrays if there are no interpolated arrays
 					GPIBasyncWrite(descGPIB_HP8753, "OUTPCALC01;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
@@ -178,8 +178,15 @@ get8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 				memmove(pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[i], CALheaderAndSize, HEADER_SIZE);
 				GPIBasyncRead(descGPIB_HP8753, pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ] + HEADER_SIZE,
 						CALsize, pGPIBstatus, TIMEOUT_RW_1MIN);
-
-				if( pGlobal->HP8753cal.settings.bSourceCoupled )
+				// each coefficient array holds one FORM1 point for each point of the sweep
+				if( FORM1points( pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ] )
+						!= pGlobal->HP8753cal.perChannelCal[ channel ].nPoints ) {
+					gchar *sError = g_strdup_printf( "Channel %d calibration array %d has %d points (sweep has %d)",
+							channel+1, i+1, FORM1points( pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ] ),
+							pGlobal->HP8753cal.perChannelCal[ channel ].nPoints );
+					postError( sError );
+					g_free( sError );
+				} else if( pGlobal->HP8753cal.settings.bSourceCoupled )
 					postInfoWithCount( "Retrieve calibration array %d", i+1, 0 );
 				else
 					postInfoWithCount( "Retrieve channel %d calibration array %d", channel+1, i+1 );
@@ -274,15 +281,18 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 	gchar sCommand[ MAX_OUTPCAL_LEN ];
 	gdouble sweepTime[ eNUM_CH ] = {0};
 	eChannel channel = eCH_ONE;
-	gdouble totalSweepTime;
+	gdouble totalSweepTime, expectedSweepTime;
 	gdouble bUncertainSweepTime = FALSE;
+	gboolean bInterpolated = FALSE;
+	gint nCalArrays = 0;
 	int i, nchannel;
 
 	// clear the status registers and preset the HP8753
-	*pGPIBstatus = ibclr( descGPIB_HP8753 );
+	*pGPIBstatus = GPIBclear( descGPIB_HP8753 );
     GPIBasyncWrite(descGPIB_HP8753, "CLS;", pGPIBstatus, 20 * TIMEOUT_RW_1SEC);
     usleep( ms(20) );
-	GPIBasyncSRQwrite(descGPIB_HP8753, "PRES;ESE1;SRE32;NOOP;", NULL_STR, pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
+	GPIBasyncSRQwriteTimed(descGPIB_HP8753, "PRES;ESE1;SRE32;NOOP;", NULL_STR, pGPIBstatus,
+			eTIMED_PRESET, 0, 1.0, 10 * TIMEOUT_RW_1SEC);
 
 	// abort if we can't get this far
 	if( GPIBfailed( *pGPIBstatus ))
@@ -291,9 +301,13 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 	GPIBasyncWrite( descGPIB_HP8753, "FORM1;INPULEAS;", pGPIBstatus, 10 * TIMEOUT_RW_1SEC);
 	// Includes the 4 byte header with size in bytes (big endian)
 	gint LSsize = GUINT16_FROM_BE(*(guint16 *)(pGlobal->HP8753cal.pHP8753_learn+2)) + 4;
+	// an interpolated calibration takes the HP8753 much longer to process
+	for( eChannel ch = eCH_ONE; ch < eNUM_CH; ch++ )
+		if( pGlobal->HP8753cal.perChannelCal[ ch ].settings.bbInterplativeCalibration == eInterplativeCalibration )
+			bInterpolated = TRUE;
 
-	GPIBasyncSRQwrite( descGPIB_HP8753, (gchar *)pGlobal->HP8753cal.pHP8753_learn, LSsize,
-			pGPIBstatus, 10 * TIMEOUT_RW_1MIN );
+	GPIBasyncSRQwriteTimed( descGPIB_HP8753, (gchar *)pGlobal->HP8753cal.pHP8753_learn, LSsize,
+			pGPIBstatus, eTIMED_LEARN_STRING, bInterpolated, 1.0, 10 * TIMEOUT_RW_1MIN );
 	// Restoring the setup seems to reset the ESR and SRQ enable ... so do it here
 	enableSRQonOPC( descGPIB_HP8753, pGPIBstatus );
 
@@ -329,6 +343,7 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 		g_free( ts );
 
 		// Send the cal arrays
+		nCalArrays = 0;
 		for( i=0; i < MAX_CAL_ARRAYS && pGlobal->HP8753cal.perChannelCal[ channel ].iCalType != eCALtypeNONE ; i++ ) {
 			if ( pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[ i ] != NULL ) {
 				if ( pGlobal->HP8753cal.settings.bSourceCoupled )
@@ -338,9 +353,11 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 				g_snprintf( sCommand, MAX_OUTPCAL_LEN, "INPUCALC%02d;", i+1);
 				GPIBasyncWrite( descGPIB_HP8753, sCommand, pGPIBstatus, 10 *TIMEOUT_RW_1SEC );
 
-				GPIBasyncSRQwrite( descGPIB_HP8753, pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ],
+				GPIBasyncSRQwriteTimed( descGPIB_HP8753, pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ],
 						lengthFORM1data( pGlobal->HP8753cal.perChannelCal[ channel ].pCalArrays[ i ] ),
-						pGPIBstatus, 20 * TIMEOUT_RW_1SEC );
+						pGPIBstatus, eTIMED_CAL_ARRAY, pGlobal->HP8753cal.perChannelCal[ channel ].nPoints,
+						1.0, 20 * TIMEOUT_RW_1SEC );
+				nCalArrays++;
 			}
 		}
 
@@ -348,8 +365,8 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 			postInfoWithCount( pGlobal->HP8753cal.settings.bSourceCoupled ?
 					"Save calibration arrays" : "Save channel %d calibration arrays", channel+1, 0 );
 		    GPIBasyncWrite(descGPIB_HP8753, "ESE1;SRE32;", pGPIBstatus,  10 * TIMEOUT_RW_1SEC);
-		    if( GPIBasyncSRQwrite( descGPIB_HP8753, "SAVC;", NULL_STR,
-		    		pGPIBstatus, 4 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
+		    if( GPIBasyncSRQwriteTimed( descGPIB_HP8753, "SAVC;", NULL_STR, pGPIBstatus, eTIMED_SAVE_CAL,
+		    		pGlobal->HP8753cal.perChannelCal[ channel ].nPoints, nCalArrays, 4 * TIMEOUT_RW_1MIN ) != eRDWT_OK ) {
 				*pGPIBstatus = ERR;
 				break;
 			}
@@ -457,13 +474,16 @@ send8753setupAndCal( gint descGPIB_HP8753, tGlobal *pGlobal, gint *pGPIBstatus )
 	}
 
 	// We need to wait for a clean sweep  ... the 8753 is not useful until it does sweep in any case
+	expectedSweepTime = totalSweepTime;
 	if( totalSweepTime < 5.0 )
 		totalSweepTime = 10.0;
 
 	postInfo( "Waiting for clean sweep" );
 	// Show estimated sweep time in the status line unless we have some doubt as to it's accuracy.
-	GPIBasyncSRQwrite( descGPIB_HP8753, "WAIT;", bUncertainSweepTime ? NULL_STR : WAIT_STR,
-			pGPIBstatus, (gint) (totalSweepTime * TIMEOUT_SAFETY_FACTOR) );
+	// (the time to the first clean sweep is learned relative to the sweep time)
+	GPIBasyncSRQwriteTimed( descGPIB_HP8753, "WAIT;", bUncertainSweepTime ? NULL_STR : WAIT_STR,
+			pGPIBstatus, eTIMED_CLEAN_SWEEP, bUncertainSweepTime, expectedSweepTime,
+			(gint) (totalSweepTime * TIMEOUT_SAFETY_FACTOR) );
 
 	// beep
 	GPIBasyncWrite( descGPIB_HP8753, "MENUOFF;EMIB", pGPIBstatus, 10 * TIMEOUT_RW_1SEC );
@@ -33,35 +33,110 @@
  *		This uses glib-2 for convenience.
  *
  *		Algorith from page 13-48 8510C Network Analyzer System Operating and Programming Manual 08510-90281 May 2001
- *		... but the exponent doesn't give sensible answers
+ *
+ *		Each point is six bytes: the imaginary mantissa, the real mantissa (both signed 16 bit)
+ *		then an unused byte and a signed 8 bit binary exponent. The value is mantissa x 2^(exponent - 15).
+ *		The exponent is a two's complement byte ... the earlier conversion took the negative
+ *		exponents as (exponent - 255) rather than (exponent - 256), which is why they didn't give sensible answers.
  */
 
 #include <glib-2.0/glib.h>
 #include <math.h>
+#include "hp8753.h"
+
+#define FORM1_MANTISSA_BITS	15
+
+// 2^(exponent - 15) for every value of the exponent byte
+static gdouble FORM1exponent[ 256 ];
 
-#define TOPBITofBYTE 0x80
-#define LOWER_8BITS 0xFF
+/*!     \brief  Fill the table of FORM1 exponent scaling
+ *
+ * Called once at start up (it is safe to call more than once).
+ */
 void
-FORM1toDouble( gint16 *form1, gdouble *real, gdouble *imag, gboolean bDBnotLinear )
-{
-    gdouble dExp;
+initializeFORM1exponentTable( void ) {
+	static gsize initialized = 0;
 
-    // big endien .. so the lower 8 bits of the 16 bit
-      gint16 iExp = GINT16_FROM_BE( form1[2] ) & LOWER_8BITS;
+	if( g_once_init_enter( &initialized ) ) {
+		for( gint exponent = 0; exponent < 256; exponent++ )
+			FORM1exponent[ exponent ] = ldexp( 1.0, (gint8)exponent - FORM1_MANTISSA_BITS );
+		g_once_init_leave( &initialized, 1 );
+	}
+}
 
-    // big endien .. so the lower 8 bits of the 16 bit
-    if( (iExp & TOPBITofBYTE) == 0 )
-        dExp = pow( 2.0, (double)( iExp - 15 ));
-    else
-        dExp = pow( 2.0, (double)(~(iExp ^ LOWER_8BITS) + 1) - 15.0 );
+/*!     \brief  Convert an array of FORM1 points to complex values
+ *
+ * The points are decoded with the exponent table in a single pass with no
+ * branches, so a whole trace is converted in one call.
+ *
+ * \param pFORM1        pointer to the FORM1 data (after the header)
+ * \param nPoints       number of points
+ * \param pComplex      pointer to nPoints of complex results
+ */
+void
+FORM1toComplex( const guint8 *restrict pFORM1, gint nPoints, tComplex *restrict pComplex )
+{
+	for( gint i = 0; i < nPoints; i++ ) {
+		const guint8 *pPoint = pFORM1 + i * FORM1_POINT_SIZE;
+		gdouble dExp = FORM1exponent[ pPoint[ 5 ] ];
 
-    *real = GINT16_FROM_BE( form1[1] ) * dExp;
-    *imag = GINT16_FROM_BE( form1[0] ) * dExp;
+		pComplex[ i ].r = (gint16)((pPoint[ 2 ] << 8) | pPoint[ 3 ]) * dExp;
+		pComplex[ i ].i = (gint16)((pPoint[ 0 ] << 8) | pPoint[ 1 ]) * dExp;
+	}
+}
 
-    if( bDBnotLinear ) {
-        *real = 20.0 * log10( *real );
-        *real = 20.0 * log10( *imag );
-    }
+/*!     \brief  The number of points in FORM1 data with its header
+ *
+ * \param pFORM1withHeader  pointer to FORM1 data (starting with the four byte header)
+ * \return                  number of points
+ */
+gint
+FORM1points( const guint8 *pFORM1withHeader )
+{
+	return GUINT16_FROM_BE( *(guint16 *)(pFORM1withHeader + 2) ) / FORM1_POINT_SIZE;
 }
 
+/*!     \brief  Convert trace data in FORM1, FORM2 or FORM3 (without its header) to complex values
+ *
+ * FORM2 is a pair of big endian IEEE 754 32 bit floats per point and FORM3 a pair of 64 bit doubles.
+ *
+ * \param pData             pointer to the data (after the four byte header)
+ * \param form              1, 2 or 3
+ * \param nPoints           number of points
+ * \param pComplex          pointer to nPoints complex values
+ */
+void
+binaryTraceToComplex( const guint8 *restrict pData, gint form, gint nPoints, tComplex *restrict pComplex )
+{
+	union {
+		gfloat IEEE754;
+		guint32 bytes;
+	} rBits, iBits;
+	union {
+		gdouble IEEE754;
+		guint64 bytes;
+	} rBits64, iBits64;
 
+	switch( form ) {
+	case 1:
+		FORM1toComplex( pData, nPoints, pComplex );
+		break;
+	case 2:
+	default:
+		for( gint i = 0; i < nPoints; i++ ) {
+			rBits.bytes = GUINT32_FROM_BE( *(guint32 *)(pData + i * sizeof(gint32) * 2) );
+			iBits.bytes = GUINT32_FROM_BE( *(guint32 *)(pData + i * sizeof(gint32) * 2 + sizeof(gint32)) );
+			pComplex[ i ].r = rBits.IEEE754;
+			pComplex[ i ].i = iBits.IEEE754;
+		}
+		break;
+	case 3:
+		for( gint i = 0; i < nPoints; i++ ) {
+			rBits64.bytes = GUINT64_FROM_BE( *(guint64 *)(pData + i * sizeof(gint64) * 2) );
+			iBits64.bytes = GUINT64_FROM_BE( *(guint64 *)(pData + i * sizeof(gint64) * 2 + sizeof(gint64)) );
+			pComplex[ i ].r = rBits64.IEEE754;
+			pComplex[ i ].i = iBits64.IEEE754;
+		}
+		break;
+	}
+}
@@ -0,0 +1,737 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <locale.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+#include <cairo/cairo.h>
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+#include "GTKplot.h"
+#include "HPGLplot.h"
+#include "calibrationKit.h"
+#include "messageEvent.h"
+
+/*
+ * Benchmarks of the hot paths that do not need the HP8753 or a display
+ * (built and run with 'make bench').
+ *
+ * Each benchmark is run in batches long enough to time reliably; the time per
+ * operation of each batch is a sample and the minimum, median and mean of the
+ * samples are reported as JSON so that releases can be compared.
+ *
+ * The inputs are synthesized (a 401 point trace on each channel, an HP8753 style
+ * HPGL screen plot and a calibration kit) unless recorded HPGL (as shown by
+ * '--debug 6') or an XKT file is given.
+ */
+
+#define BENCH_SAMPLES_DEFAULT		7
+#define BENCH_MIN_TIME_DEFAULT		0.25	// s per benchmark
+#define BENCH_TRACE_POINTS			401
+#define BENCH_PROJECT				"Benchmark"
+
+typedef void (*tBenchFunction)( gpointer pContext );
+
+typedef struct {
+	gchar	*sName;			// e.g. "form1/decode"
+	gchar	*sParameter;	// e.g. "1601 points"
+	gint64	iterations;		// per sample
+	gint	nSamples;
+	gdouble	minTime, medianTime, meanTime;	// ns per operation
+	gdouble	itemsPerOperation;				// points, commands ... (for the throughput)
+} tBenchResult;
+
+static struct {
+	gint		nSamples;
+	gdouble		minTime;
+	gchar		*sFilter;
+	gchar		*sOutput;
+	gchar		*sHPGLfile;
+	gchar		*sXKTfile;
+	gboolean	bList;
+	GArray		*results;
+} bench = { BENCH_SAMPLES_DEFAULT, BENCH_MIN_TIME_DEFAULT };
+
+static GOptionEntry benchOptionEntries[] = {
+	{ "output",   'o', 0, G_OPTION_ARG_FILENAME, &bench.sOutput, "Write the results (JSON) to FILE (default: standard output)", "FILE" },
+	{ "samples",  's', 0, G_OPTION_ARG_INT,      &bench.nSamples, "Number of samples of each benchmark (default: 7)", "N" },
+	{ "min-time", 't', 0, G_OPTION_ARG_DOUBLE,   &bench.minTime, "Minimum time to spend on each benchmark (default: 0.25 s)", "SECONDS" },
+	{ "filter",   'f', 0, G_OPTION_ARG_STRING,   &bench.sFilter, "Only run the benchmarks whose names contain TEXT", "TEXT" },
+	{ "hpgl",     'g', 0, G_OPTION_ARG_FILENAME, &bench.sHPGLfile, "Recorded HPGL screen plot to parse and draw", "FILE" },
+	{ "xkt",      'x', 0, G_OPTION_ARG_FILENAME, &bench.sXKTfile, "Calibration kit (XKT) to parse", "FILE" },
+	{ "list",     'l', 0, G_OPTION_ARG_NONE,     &bench.bList, "List the benchmarks without running them", NULL },
+	{ NULL }
+};
+
+/*!     \brief  Compare doubles (for qsort)
+ */
+static gint
+compareDoubles( gconstpointer a, gconstpointer b ) {
+	return (*(gdouble *)a > *(gdouble *)b) - (*(gdouble *)a < *(gdouble *)b);
+}
+
+/*!     \brief  Discard the messages intended for the (absent) main loop
+ */
+static void
+drainMessagesToMain( void ) {
+	messageEventData *message;
+
+	while( (message = g_async_queue_try_pop( globalData.messageQueueToMain )) != NULL ) {
+		if( message->command == TM_ERROR )
+			g_printerr( "error: %s\n", message->sMessage );
+		g_free( message->sMessage );
+		g_free( message );
+	}
+}
+
+/*!     \brief  Time a benchmark and record the result
+ *
+ * The number of iterations per sample is doubled until a sample takes at least
+ * its share of the minimum time.
+ *
+ * \param sName              benchmark name
+ * \param sParameter         what distinguishes this run (size, number of points)
+ * \param itemsPerOperation  items processed by one call (for the throughput)
+ * \param function           function to time
+ * \param pContext           passed to the function
+ */
+static void
+runBenchmark( gchar *sName, gchar *sParameter, gdouble itemsPerOperation,
+		tBenchFunction function, gpointer pContext ) {
+	tBenchResult result = { g_strdup( sName ), g_strdup( sParameter ), 1, bench.nSamples, 0 };
+	gdouble sampleTime = bench.minTime / bench.nSamples * G_USEC_PER_SEC;
+	gdouble *samples = g_new( gdouble, bench.nSamples ), sum = 0.0;
+	gint64 start, elapsed;
+
+	if( bench.sFilter && strstr( sName, bench.sFilter ) == NULL ) {
+		g_free( result.sName );
+		g_free( result.sParameter );
+		g_free( samples );
+		return;
+	}
+	if( bench.bList ) {
+		g_print( "%-24s %s\n", sName, sParameter );
+		g_free( result.sName );
+		g_free( result.sParameter );
+		g_free( samples );
+		return;
+	}
+
+	// warm up (and calibrate)
+	for( ;; ) {
+		start = g_get_monotonic_time();
+		for( gint64 i = 0; i < result.iterations; i++ )
+			function( pContext );
+		elapsed = g_get_monotonic_time() - start;
+		if( elapsed >= sampleTime || result.iterations >= G_MAXINT32 )
+			break;
+		result.iterations *= 2;
+	}
+
+	for( gint n = 0; n < bench.nSamples; n++ ) {
+		start = g_get_monotonic_time();
+		for( gint64 i = 0; i < result.iterations; i++ )
+			function( pContext );
+		elapsed = g_get_monotonic_time() - start;
+		samples[ n ] = elapsed * 1.0e3 / result.iterations;
+		sum += samples[ n ];
+	}
+	drainMessagesToMain();
+
+	qsort( samples, bench.nSamples, sizeof( gdouble ), compareDoubles );
+	result.minTime = samples[ 0 ];
+	result.medianTime = samples[ bench.nSamples / 2 ];
+	result.meanTime = sum / bench.nSamples;
+	result.itemsPerOperation = itemsPerOperation;
+	g_free( samples );
+
+	g_printerr( "%-24s %-16s %12.1f ns %14.0f /s\n", sName, sParameter,
+			result.medianTime, itemsPerOperation * 1.0e9 / result.medianTime );
+	g_array_append_val( bench.results, result );
+}
+
+/*
+ * Trace data
+ */
+
+typedef struct {
+	gint		form;
+	gint		nPoints;
+	guint8		*pData;
+	tComplex	*pPoints;
+} tDecodeContext;
+
+/*!     \brief  Encode a trace as the HP8753 would send it in FORM1, FORM2 or FORM3
+ *
+ * \param pContext     decode context (form and number of points set)
+ */
+static void
+encodeTrace( tDecodeContext *pContext ) {
+	static const gint bytesPerPoint[] = { 0, FORM1_POINT_SIZE, sizeof( gint32 ) * 2, sizeof( gint64 ) * 2 };
+	guint8 *pPoint;
+
+	pContext->pData = g_malloc( pContext->nPoints * bytesPerPoint[ pContext->form ] );
+	pContext->pPoints = g_new( tComplex, pContext->nPoints );
+	for( gint i = 0; i < pContext->nPoints; i++ ) {
+		gdouble theta = 2.0 * G_PI * 5.0 * i / pContext->nPoints, magnitude = 0.9 - 0.8 * i / pContext->nPoints;
+		gdouble re = magnitude * cos( theta ), im = -magnitude * sin( theta );
+
+		pPoint = pContext->pData + i * bytesPerPoint[ pContext->form ];
+		switch( pContext->form ) {
+		case 1: {
+			// mantissas scaled into 16 bits with a common exponent
+			gint exponent = (gint)ceil( log2( MAX( MAX( fabs( re ), fabs( im ) ), 1.0e-30 ) ) );
+			gint16 mRe = (gint16)lround( ldexp( re, 15 - exponent ) * 0.999 );
+			gint16 mIm = (gint16)lround( ldexp( im, 15 - exponent ) * 0.999 );
+
+			*(guint16 *)(pPoint + 0) = GUINT16_TO_BE( (guint16)mIm );
+			*(guint16 *)(pPoint + 2) = GUINT16_TO_BE( (guint16)mRe );
+			pPoint[ 4 ] = 0;
+			pPoint[ 5 ] = (guint8)(gint8)exponent;
+			break;
+		}
+		case 2: {
+			union { gfloat IEEE754; guint32 bytes; } rBits = { re }, iBits = { im };
+			*(guint32 *)(pPoint + 0) = GUINT32_TO_BE( rBits.bytes );
+			*(guint32 *)(pPoint + sizeof( gint32 )) = GUINT32_TO_BE( iBits.bytes );
+			break;
+		}
+		case 3: {
+			union { gdouble IEEE754; guint64 bytes; } rBits = { re }, iBits = { im };
+			*(guint64 *)(pPoint + 0) = GUINT64_TO_BE( rBits.bytes );
+			*(guint64 *)(pPoint + sizeof( gint64 )) = GUINT64_TO_BE( iBits.bytes );
+			break;
+		}
+		}
+	}
+}
+
+static void
+benchDecodeTrace( gpointer pContext ) {
+	tDecodeContext *pDecode = pContext;
+	binaryTraceToComplex( pDecode->pData, pDecode->form, pDecode->nPoints, pDecode->pPoints );
+}
+
+/*!     \brief  Fill a channel with a synthetic trace
+ *
+ * \param pChannel     pointer to the channel
+ * \param format       format of the trace
+ * \param nPoints      number of points
+ */
+static void
+synthesizeChannel( tChannel *pChannel, tFormat format, gint nPoints ) {
+	pChannel->nPoints = nPoints;
+	pChannel->format = format;
+	pChannel->sweepType = eSWP_LINFREQ;
+	pChannel->sweepStart = 300.0e3;
+	pChannel->sweepStop = 3.0e9;
+	pChannel->IFbandwidth = 3000.0;
+	pChannel->measurementType = eMEAS_S11;
+	pChannel->chFlags.bValidData = TRUE;
+	pChannel->chFlags.bValidSegments = FALSE;
+
+	pChannel->responsePoints = g_renew( tComplex, pChannel->responsePoints, nPoints );
+	pChannel->complexPoints = g_renew( tComplex, pChannel->complexPoints, nPoints );
+	pChannel->stimulusPoints = g_renew( gdouble, pChannel->stimulusPoints, nPoints );
+	for( gint i = 0; i < nPoints; i++ ) {
+		gdouble fraction = (gdouble)i / (nPoints - 1);
+		gdouble theta = 2.0 * G_PI * 3.0 * fraction, magnitude = 0.95 - 0.9 * fraction;
+
+		pChannel->stimulusPoints[ i ] = LIN_INTERP( pChannel->sweepStart, pChannel->sweepStop, fraction );
+		pChannel->complexPoints[ i ].r = magnitude * cos( theta );
+		pChannel->complexPoints[ i ].i = -magnitude * sin( theta );
+		if( format == eFMT_SMITH || format == eFMT_POLAR ) {
+			pChannel->responsePoints[ i ] = pChannel->complexPoints[ i ];
+		} else {
+			pChannel->responsePoints[ i ].r = 20.0 * log10( magnitude ) + 0.5 * sin( 40.0 * theta );
+			pChannel->responsePoints[ i ].i = 0.0;
+		}
+	}
+
+	switch( format ) {
+	case eFMT_SMITH:
+	case eFMT_POLAR:
+		pChannel->scaleVal = 1.0;
+		break;
+	default:
+		pChannel->scaleVal = 5.0;
+		pChannel->scaleRefPos = NVGRIDS;
+		pChannel->scaleRefVal = 0.0;
+		break;
+	}
+}
+
+/*
+ * HPGL
+ */
+
+typedef struct {
+	gchar	*sHPGL;			// the plot as read from the HP8753
+	gint	nCommands;
+} tHPGLcontext;
+
+/*!     \brief  Synthesize an HPGL screen plot like that of the HP8753 (graticule, annotation and two traces)
+ *
+ * \return             g_malloced HPGL
+ */
+static gchar *
+synthesizeHPGL( void ) {
+	GString *sHPGL = g_string_new( "IN;DF;IP250,279,10250,7479;SC0,4095,0,4212;SP1;LT;SR1.472,2.279;" );
+	const gint left = 400, right = 3600, bottom = 550, top = 3750;
+
+	// graticule
+	for( gint i = 0; i <= NHGRIDS; i++ ) {
+		gint x = left + (right - left) * i / NHGRIDS;
+		g_string_append_printf( sHPGL, "PA%d,%d;PD;PA%d,%d;PU;", x, bottom, x, top );
+	}
+	for( gint i = 0; i <= NVGRIDS; i++ ) {
+		gint y = bottom + (top - bottom) * i / NVGRIDS;
+		g_string_append_printf( sHPGL, "PA%d,%d;PD;PA%d,%d;PU;", left, y, right, y );
+	}
+	// annotation
+	g_string_append( sHPGL, "SP2;PA0,3900;LBCH1: S11     log MAG       5 dB/  REF 0 dB\003;"
+			"PA0,2432;LBHld\003;PA3000,3900;LB1: -12.345 dB\003;PA3000,3820;LB1.500 000 000 GHz\003;"
+			"PA400,420;LBSTART   .300 000 MHz\003;PA2400,420;LBSTOP 3 000.000 000 MHz\003;"
+			"PA0,3000;LBCor\003;PA0,2900;LBAvg\003;PA0,2800;LB 16\003;" );
+	// a trace on each channel
+	for( gint pen = 3; pen <= 4; pen++ ) {
+		g_string_append_printf( sHPGL, "SP%d;", pen );
+		for( gint i = 0; i < BENCH_TRACE_POINTS; i++ ) {
+			gdouble fraction = (gdouble)i / (BENCH_TRACE_POINTS - 1);
+			gint x = left + (gint)((right - left) * fraction);
+			gint y = (bottom + top) / 2 + (gint)((top - bottom) * 0.4 * sin( 2.0 * G_PI * (pen - 1) * fraction ));
+			g_string_append_printf( sHPGL, i == 0 ? "PA%d,%d;PD;" : "PA%d,%d;", x, y );
+		}
+		g_string_append( sHPGL, "PU;" );
+		// marker
+		g_string_append_printf( sHPGL, "PA%d,%d;PD;PA%d,%d;PA%d,%d;PA%d,%d;PU;",
+				2000, 2200, 2030, 2250, 1970, 2250, 2000, 2200 );
+	}
+	g_string_append( sHPGL, "SP0;PA0,0;PG;" );
+
+	return g_string_free( sHPGL, FALSE );
+}
+
+/*!     \brief  Parse an HPGL plot into the compiled plot
+ *
+ * Split into commands as acquireHPGLplot does.
+ *
+ * \param sHPGL        HPGL plot
+ * \return             number of commands
+ */
+static gint
+compileHPGL( gchar *sHPGL ) {
+	gchar **tokens = g_strsplit( sHPGL, ";", -1 );
+	gint n;
+
+	parseHPGL( NULL, &globalData );
+	for( n = 0; tokens[ n ] != NULL; n++ )
+		parseHPGL( tokens[ n ], &globalData );
+	g_strfreev( tokens );
+	globalData.HP8753.flags.bHPGLdataValid = TRUE;
+	return n;
+}
+
+static void
+benchParseHPGL( gpointer pContext ) {
+	compileHPGL( ((tHPGLcontext *)pContext)->sHPGL );
+}
+
+/*
+ * Rendering
+ */
+
+typedef struct {
+	gint				width, height;
+	cairo_surface_t		*surface;
+	cairo_t				*cr;
+	gboolean			bPlotB;
+	tComplex			*pSplinePoints;
+	gint				nSplinePoints;
+} tRenderContext;
+
+static void
+benchPlotScreen( gpointer pContext ) {
+	tRenderContext *pRender = pContext;
+
+	cairo_save( pRender->cr );
+	cairo_set_source_rgb( pRender->cr, 1.0, 1.0, 1.0 );
+	cairo_paint( pRender->cr );
+	plotScreen( pRender->cr, pRender->height, pRender->width, &globalData );
+	cairo_restore( pRender->cr );
+	cairo_surface_flush( pRender->surface );
+}
+
+static void
+benchPlot( gpointer pContext ) {
+	tRenderContext *pRender = pContext;
+
+	cairo_save( pRender->cr );
+	cairo_set_source_rgb( pRender->cr, 1.0, 1.0, 1.0 );
+	cairo_paint( pRender->cr );
+	if( pRender->bPlotB )
+		plotB( pRender->width, pRender->height, 0.0, pRender->cr, &globalData );
+	else
+		plotA( pRender->width, pRender->height, 0.0, pRender->cr, &globalData );
+	cairo_restore( pRender->cr );
+	cairo_surface_flush( pRender->surface );
+}
+
+static void
+benchBezierSpline( gpointer pContext ) {
+	tRenderContext *pRender = pContext;
+
+	drawBezierSpline( pRender->cr, pRender->pSplinePoints, pRender->nSplinePoints );
+	cairo_surface_flush( pRender->surface );
+}
+
+/*!     \brief  Create an image surface to render to
+ */
+static void
+openRenderContext( tRenderContext *pRender, gint width, gint height ) {
+	pRender->width = width;
+	pRender->height = height;
+	pRender->surface = cairo_image_surface_create( CAIRO_FORMAT_RGB24, width, height );
+	pRender->cr = cairo_create( pRender->surface );
+}
+
+static void
+closeRenderContext( tRenderContext *pRender ) {
+	cairo_destroy( pRender->cr );
+	cairo_surface_destroy( pRender->surface );
+}
+
+/*
+ * Database
+ */
+
+static void
+benchSaveTrace( gpointer pContext ) {
+	saveTraceData( &globalData, BENCH_PROJECT, (gchar *)pContext );
+}
+
+static void
+benchRecoverTrace( gpointer pContext ) {
+	recoverTraceData( &globalData, BENCH_PROJECT, (gchar *)pContext );
+}
+
+static void
+benchSaveAndRecoverTrace( gpointer pContext ) {
+	saveTraceData( &globalData, BENCH_PROJECT, (gchar *)pContext );
+	recoverTraceData( &globalData, BENCH_PROJECT, (gchar *)pContext );
+}
+
+/*!     \brief  Remove the temporary database directory
+ *
+ * \param sDirectory   directory (with the .local/share/hp8753c tree below it)
+ */
+static void
+removeBenchmarkDB( gchar *sDirectory ) {
+	gchar *sDBdir = g_build_filename( sDirectory, ".local", "share", "hp8753c", NULL );
+	GDir *dir = g_dir_open( sDBdir, 0, NULL );
+	const gchar *sFile;
+
+	while( dir && (sFile = g_dir_read_name( dir )) != NULL ) {
+		gchar *sPath = g_build_filename( sDBdir, sFile, NULL );
+		unlink( sPath );
+		g_free( sPath );
+	}
+	if( dir )
+		g_dir_close( dir );
+	for( gint level = 0; level < 3; level++ ) {
+		rmdir( sDBdir );
+		*strrchr( sDBdir, G_DIR_SEPARATOR ) = 0;
+	}
+	rmdir( sDirectory );
+	g_free( sDBdir );
+}
+
+/*
+ * Calibration kits
+ */
+
+// an 85033D style 3.5mm kit
+static const gchar sSyntheticXKT[] =
+	"<?xml version=\"1.0\" encoding=\"utf-8\"?>\n"
+	"<CalKit>\n"
+	"  <CalKitLabel>85033D</CalKitLabel>\n"
+	"  <CalKitVersion>1.0</CalKitVersion>\n"
+	"  <CalKitDescription>3.5mm calibration kit</CalKitDescription>\n"
+	"  <ConnectorList>\n"
+	"    <Coaxial><Family>APC 3.5</Family><Gender>male</Gender><MaximumFrequencyHz>999000000000</MaximumFrequencyHz>"
+	"<MinimumFrequencyHz>0</MinimumFrequencyHz><SystemZ0>50</SystemZ0></Coaxial>\n"
+	"    <Coaxial><Family>APC 3.5</Family><Gender>female</Gender><MaximumFrequencyHz>999000000000</MaximumFrequencyHz>"
+	"<MinimumFrequencyHz>0</MinimumFrequencyHz><SystemZ0>50</SystemZ0></Coaxial>\n"
+	"  </ConnectorList>\n"
+	"  <StandardList>\n"
+	"    <ShortStandard><Label>SHORT</Label><Description>short</Description>"
+	"<PortConnectorIDs>APC 3.5 male</PortConnectorIDs><MaximumFrequencyHz>999000000000</MaximumFrequencyHz>"
+	"<MinimumFrequencyHz>0</MinimumFrequencyHz><StandardNumber>1</StandardNumber>"
+	"<L0>0</L0><L1>0</L1><L2>0</L2><L3>0</L3>"
+	"<Offset><OffsetDelay>2.9242E-11</OffsetDelay><OffsetLoss>1.3E9</OffsetLoss><OffsetZ0>50</OffsetZ0></Offset>"
+	"</ShortStandard>\n"
+	"    <OpenStandard><Label>OPEN</Label><Description>open</Description>"
+	"<PortConnectorIDs>APC 3.5 male</PortConnectorIDs><MaximumFrequencyHz>999000000000</MaximumFrequencyHz>"
+	"<MinimumFrequencyHz>0</MinimumFrequencyHz><StandardNumber>2</StandardNumber>"
+	"<C0>4.9E-14</C0><C1>-3.101E-25</C1><C2>2.317E-35</C2><C3>-1.597E-46</C3>"
+	"<Offset><OffsetDelay>2.9433E-11</OffsetDelay><OffsetLoss>1.3E9</OffsetLoss><OffsetZ0>50</OffsetZ0></Offset>"
+	"</OpenStandard>\n"
+	"    <FixedLoadStandard><Label>BROADBAND</Label><Description>load</Description>"
+	"<PortConnectorIDs>APC 3.5 male</PortConnectorIDs><MaximumFrequencyHz>999000000000</MaximumFrequencyHz>"
+	"<MinimumFrequencyHz>0</MinimumFrequencyHz><StandardNumber>3</StandardNumber>"
+	"<Offset><OffsetDelay>0</OffsetDelay><OffsetLoss>0</OffsetLoss><OffsetZ0>50</OffsetZ0></Offset>"
+	"</FixedLoadStandard>\n"
+	"    <ThruStandard><Label>THRU</Label><Description>thru</Description>"
+	"<PortConnectorIDs>APC 3.5 male</PortConnectorIDs><PortConnectorIDs>APC 3.5 female</PortConnectorIDs>"
+	"<MaximumFrequencyHz>999000000000</MaximumFrequencyHz><MinimumFrequencyHz>0</MinimumFrequencyHz>"
+	"<StandardNumber>4</StandardNumber>"
+	"<Offset><OffsetDelay>0</OffsetDelay><OffsetLoss>0</OffsetLoss><OffsetZ0>50</OffsetZ0></Offset>"
+	"</ThruStandard>\n"
+	"  </StandardList>\n"
+	"  <KitClasses><KitClassID>SA</KitClassID><StandardsList>2</StandardsList><KitClassLabel>OPEN</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>SB</KitClassID><StandardsList>1</StandardsList><KitClassLabel>SHORT</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>SC</KitClassID><StandardsList>3</StandardsList><KitClassLabel>LOAD</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>FORWARD_THRU</KitClassID><StandardsList>4</StandardsList><KitClassLabel>THRU</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>FORWARD_MATCH</KitClassID><StandardsList>4</StandardsList><KitClassLabel>THRU</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>REVERSE_THRU</KitClassID><StandardsList>4</StandardsList><KitClassLabel>THRU</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>REVERSE_MATCH</KitClassID><StandardsList>4</StandardsList><KitClassLabel>THRU</KitClassLabel></KitClasses>\n"
+	"  <KitClasses><KitClassID>ISOLATION</KitClassID><StandardsList>3</StandardsList><KitClassLabel>ISOLATION</KitClassLabel></KitClasses>\n"
+	"</CalKit>\n";
+
+static void
+benchParseXKT( gpointer pContext ) {
+	tHP8753calibrationKit calibrationKit;
+
+	parseCalibrationKit( (gchar *)pContext, &calibrationKit );
+}
+
+/*
+ * Results
+ */
+
+/*!     \brief  Write the results as JSON
+ *
+ * \param fp           output stream
+ */
+static void
+writeResults( FILE *fp ) {
+	struct utsname UTSbuffer = { 0 };
+	GDateTime *dt = g_date_time_new_now_utc();
+	gchar *sTime = g_date_time_format_iso8601( dt ), *sEscaped;
+
+	uname( &UTSbuffer );
+	fprintf( fp, "{\n  \"program\": \"hp8753bench\",\n  \"version\": \"%s\",\n  \"time\": \"%s\",\n", VERSION, sTime );
+	fprintf( fp, "  \"machine\": \"%s\",\n  \"system\": \"%s %s\",\n  \"glib\": \"%u.%u.%u\",\n",
+			UTSbuffer.machine, UTSbuffer.sysname, UTSbuffer.release, glib_major_version, glib_minor_version, glib_micro_version );
+	fprintf( fp, "  \"cairo\": \"%s\",\n  \"samples\": %d,\n  \"units\": \"ns\",\n  \"benchmarks\": [",
+			cairo_version_string(), bench.nSamples );
+	for( guint i = 0; i < bench.results->len; i++ ) {
+		tBenchResult *pResult = &g_array_index( bench.results, tBenchResult, i );
+
+		sEscaped = g_strescape( pResult->sParameter, NULL );
+		fprintf( fp, "%s\n    { \"name\": \"%s\", \"parameter\": \"%s\", \"iterations\": %" G_GINT64_FORMAT ","
+				" \"min\": %.1f, \"median\": %.1f, \"mean\": %.1f, \"itemsPerSecond\": %.1f }",
+				i == 0 ? "" : ",", pResult->sName, sEscaped, pResult->iterations,
+				pResult->minTime, pResult->medianTime, pResult->meanTime,
+				pResult->itemsPerOperation * 1.0e9 / pResult->medianTime );
+		g_free( sEscaped );
+	}
+	fprintf( fp, "\n  ]\n}\n" );
+
+	g_free( sTime );
+	g_date_time_unref( dt );
+}
+
+/*!     \brief  Benchmark runner
+ *
+ * \param argc	number of arguments
+ * \param argv	pointer to array of arguments
+ * \return		success or failure error code
+ */
+int
+main( int argc, char *argv[] ) {
+	static const gint decodePoints[] = { 201, 801, 1601 };
+	static const struct { gint width, height; } sizes[] = { { 640, 480 }, { 1280, 960 }, { 2560, 1920 } };
+	static const struct { tFormat format; gchar *sName; } plotFormats[] = {
+			{ eFMT_LOGM, "log mag" }, { eFMT_SMITH, "Smith" }, { eFMT_POLAR, "polar" } };
+	GOptionContext *context = g_option_context_new( "- benchmark the HP8753 Companion" );
+	GError *error = NULL;
+	gchar *sParameter, *sTempDir, *sXKTfile;
+	tHPGLcontext hpgl = { 0 };
+	tRenderContext render = { 0 };
+	FILE *fpOutput = stdout;
+
+	setlocale( LC_NUMERIC, "C" );
+	g_option_context_add_main_entries( context, benchOptionEntries, NULL );
+	if( !g_option_context_parse( context, &argc, &argv, &error ) || bench.nSamples < 1 || bench.minTime <= 0.0 ) {
+		g_printerr( "%s\n", error ? error->message : "invalid number of samples or time" );
+		return EXIT_FAILURE;
+	}
+	g_option_context_free( context );
+	bench.results = g_array_new( FALSE, TRUE, sizeof( tBenchResult ) );
+
+	globalData.messageQueueToMain = g_async_queue_new();
+	globalData.messageQueueToGPIB = g_async_queue_new();
+	for( gint i = 0; i < NUM_HPGL_PENS; i++ )
+		HPGLpens[ i ] = HPGLpensFactory[ i ];
+	for( gint i = 0; i < eMAX_COLORS; i++ )
+		plotElementColors[ i ] = plotElementColorsFactory[ i ];
+	initializeFORM1exponentTable();
+
+	// FORM1, FORM2 & FORM3 decoding
+	for( gint form = 1; form <= 3; form++ ) {
+		for( gint n = 0; n < G_N_ELEMENTS( decodePoints ); n++ ) {
+			tDecodeContext decode = { form, decodePoints[ n ] };
+			gchar *sName = g_strdup_printf( "form%d/decode", form );
+
+			encodeTrace( &decode );
+			sParameter = g_strdup_printf( "%d points", decode.nPoints );
+			runBenchmark( sName, sParameter, decode.nPoints, benchDecodeTrace, &decode );
+			g_free( sParameter );
+			g_free( sName );
+			g_free( decode.pData );
+			g_free( decode.pPoints );
+		}
+	}
+
+	// HPGL screen plot
+	if( bench.sHPGLfile ) {
+		if( !g_file_get_contents( bench.sHPGLfile, &hpgl.sHPGL, NULL, &error ) ) {
+			g_printerr( "%s\n", error->message );
+			return EXIT_FAILURE;
+		}
+	} else {
+		hpgl.sHPGL = synthesizeHPGL();
+	}
+	hpgl.nCommands = compileHPGL( hpgl.sHPGL );
+	sParameter = g_strdup_printf( "%d commands", hpgl.nCommands );
+	runBenchmark( "hpgl/parse", sParameter, hpgl.nCommands, benchParseHPGL, &hpgl );
+	g_free( sParameter );
+
+	// trace data on both channels
+	globalData.HP8753.sProduct = g_strdup( "HP8753C" );
+	globalData.HP8753.sTitle = g_strdup( "Benchmark" );
+	globalData.HP8753.sNote = g_strdup( "" );
+	getTimeStamp( &globalData.HP8753.dateTime );
+	synthesizeChannel( &globalData.HP8753.channels[ eCH_ONE ], eFMT_LOGM, BENCH_TRACE_POINTS );
+	synthesizeChannel( &globalData.HP8753.channels[ eCH_TWO ], eFMT_SMITH, BENCH_TRACE_POINTS );
+
+	// rendering to image surfaces
+	for( gint s = 0; s < G_N_ELEMENTS( sizes ); s++ ) {
+		openRenderContext( &render, sizes[ s ].width, sizes[ s ].height );
+		sParameter = g_strdup_printf( "%dx%d", sizes[ s ].width, sizes[ s ].height );
+
+		globalData.HP8753.flags.bShowHPGLplot = TRUE;
+		runBenchmark( "render/plotScreen", sParameter, 1, benchPlotScreen, &render );
+		globalData.HP8753.flags.bShowHPGLplot = FALSE;
+
+		globalData.HP8753.flags.bDualChannel = FALSE;
+		for( gint f = 0; f < G_N_ELEMENTS( plotFormats ); f++ ) {
+			gchar *sPlotParameter = g_strdup_printf( "%s %s", sParameter, plotFormats[ f ].sName );
+
+			synthesizeChannel( &globalData.HP8753.channels[ eCH_ONE ], plotFormats[ f ].format, BENCH_TRACE_POINTS );
+			render.bPlotB = FALSE;
+			runBenchmark( "render/plotA", sPlotParameter, 1, benchPlot, &render );
+			g_free( sPlotParameter );
+		}
+		synthesizeChannel( &globalData.HP8753.channels[ eCH_ONE ], eFMT_LOGM, BENCH_TRACE_POINTS );
+
+		// dual channel split ... channel 2 (Smith) on plot B
+		globalData.HP8753.flags.bDualChannel = TRUE;
+		globalData.HP8753.flags.bSplitChannels = TRUE;
+		render.bPlotB = TRUE;
+		runBenchmark( "render/plotB", sParameter, 1, benchPlot, &render );
+		globalData.HP8753.flags.bDualChannel = FALSE;
+		globalData.HP8753.flags.bSplitChannels = FALSE;
+
+		g_free( sParameter );
+		closeRenderContext( &render );
+	}
+
+	// spline through the trace (as the Smith and polar traces are drawn)
+	openRenderContext( &render, 1280, 960 );
+	for( gint n = 0; n < G_N_ELEMENTS( decodePoints ); n++ ) {
+		render.nSplinePoints = decodePoints[ n ];
+		render.pSplinePoints = g_new( tComplex, render.nSplinePoints );
+		for( gint i = 0; i < render.nSplinePoints; i++ ) {
+			gdouble theta = 2.0 * G_PI * 3.0 * i / render.nSplinePoints;
+			gdouble radius = 450.0 * (1.0 - 0.8 * i / render.nSplinePoints);
+			render.pSplinePoints[ i ].r = 640.0 + radius * cos( theta );
+			render.pSplinePoints[ i ].i = 480.0 + radius * sin( theta );
+		}
+		sParameter = g_strdup_printf( "%d points", render.nSplinePoints );
+		runBenchmark( "render/bezierSpline", sParameter, render.nSplinePoints, benchBezierSpline, &render );
+		g_free( sParameter );
+		g_free( render.pSplinePoints );
+	}
+	closeRenderContext( &render );
+
+	// database round trips ... in a scratch database (the database is found from $HOME)
+	if( (sTempDir = g_dir_make_tmp( "hp8753bench-XXXXXX", &error )) == NULL ) {
+		g_printerr( "%s\n", error->message );
+		return EXIT_FAILURE;
+	}
+	g_setenv( "HOME", sTempDir, TRUE );
+	if( openOrCreateDB() != ERROR ) {
+		// time the database itself, not the recall cache
+		setTraceCacheBudget( 0 );
+		globalData.HP8753.flags.bDualChannel = TRUE;
+		globalData.HP8753.flags.bHPGLdataValid = TRUE;
+		saveTraceData( &globalData, BENCH_PROJECT, "trace" );
+		sParameter = g_strdup_printf( "2 x %d points", BENCH_TRACE_POINTS );
+		runBenchmark( "db/saveTrace", sParameter, 1, benchSaveTrace, "trace" );
+		runBenchmark( "db/recoverTrace", sParameter, 1, benchRecoverTrace, "trace" );
+		runBenchmark( "db/roundTrip", sParameter, 1, benchSaveAndRecoverTrace, "trace" );
+		g_free( sParameter );
+		closeDB();
+	}
+	drainMessagesToMain();
+	removeBenchmarkDB( sTempDir );
+
+	// calibration kit
+	if( bench.sXKTfile ) {
+		sXKTfile = g_strdup( bench.sXKTfile );
+	} else {
+		gint fd = g_file_open_tmp( "hp8753bench-XXXXXX.xkt", &sXKTfile, &error );
+		if( fd == -1 || !g_file_set_contents( sXKTfile, sSyntheticXKT, -1, &error ) ) {
+			g_printerr( "%s\n", error->message );
+			return EXIT_FAILURE;
+		}
+		close( fd );
+	}
+	runBenchmark( "xkt/parse", bench.sXKTfile ? bench.sXKTfile : "85033D (synthesized)", 1, benchParseXKT, sXKTfile );
+	if( !bench.sXKTfile )
+		unlink( sXKTfile );
+	g_free( sXKTfile );
+
+	if( !bench.bList ) {
+		if( bench.sOutput && (fpOutput = fopen( bench.sOutput, "w" )) == NULL ) {
+			g_printerr( "cannot write %s\n", bench.sOutput );
+			return EXIT_FAILURE;
+		}
+		writeResults( fpOutput );
+		if( fpOutput != stdout )
+			fclose( fpOutput );
+	}
+
+	g_free( hpgl.sHPGL );
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * A trace capture is timed phase by phase with the monotonic clock. The GPIB
+ * thread times the phases up to the markers and passes the timing to the main
+ * loop, which adds the time to redraw the plot and saves it in the database.
+ */
+
+const gchar *capturePhaseNames[ eCAPTURE_NUM_PHASES ] = {
+		"Configuration", "Learn string", "Hold", "Traces", "HPGL plot", "Markers & segments", "Redraw"
+};
+
+/*!     \brief  Start timing a capture
+ *
+ * \param pTiming       pointer to the capture timing
+ */
+void
+beginCaptureTiming( tCaptureTiming *pTiming ) {
+	memset( pTiming, 0, sizeof( tCaptureTiming ) );
+	pTiming->timestamp = g_get_real_time();
+	pTiming->phase = eCAPTURE_CONFIGURATION;
+	pTiming->phaseStart = g_get_monotonic_time();
+}
+
+/*!     \brief  Finish timing the capture in the GPIB thread
+ *
+ * The current phase is ended and a copy, labeled with the analyzer identity,
+ * is returned to be passed to the main loop for the redraw.
+ *
+ * \param pTiming       pointer to the capture timing
+ * \param pHP8753       pointer to the analyzer
+ * \return              g_malloced copy (free with freeCaptureTiming)
+ */
+tCaptureTiming *
+endCaptureTiming( tCaptureTiming *pTiming, tHP8753 *pHP8753 ) {
+	tCaptureTiming *pCopy;
+
+	startCapturePhase( pTiming, eCAPTURE_REDRAW );
+	pCopy = g_memdup2( pTiming, sizeof( tCaptureTiming ) );
+	pCopy->sProduct = g_strdup( pHP8753->sProduct ? pHP8753->sProduct : "HP8753" );
+	pCopy->firmwareVersion = pHP8753->firmwareVersion;
+	pCopy->nPoints = pHP8753->channels[ eCH_ONE ].nPoints;
+	pCopy->bDualChannel = pHP8753->flags.bDualChannel;
+	return pCopy;
+}
+
+/*!     \brief  End the current phase of the capture and start the next
+ *
+ * \param pTiming       pointer to the capture timing
+ * \param phase         phase starting now
+ */
+void
+startCapturePhase( tCaptureTiming *pTiming, tCapturePhase phase ) {
+	gint64 now = g_get_monotonic_time();
+
+	pTiming->phaseTime[ pTiming->phase ] += now - pTiming->phaseStart;
+	pTiming->phase = phase;
+	pTiming->phaseStart = now;
+}
+
+/*!     \brief  The total time of a capture
+ *
+ * \param pTiming       pointer to the capture timing
+ * \return              µs
+ */
+gint64
+captureTimingTotal( tCaptureTiming *pTiming ) {
+	gint64 total = 0;
+
+	for( tCapturePhase phase = 0; phase < eCAPTURE_NUM_PHASES; phase++ )
+		total += pTiming->phaseTime[ phase ];
+	return total;
+}
+
+/*!     \brief  Free a capture timing
+ *
+ * \param pTiming       pointer to the capture timing
+ */
+void
+freeCaptureTiming( tCaptureTiming *pTiming ) {
+	if( pTiming )
+		g_free( pTiming->sProduct );
+	g_free( pTiming );
+}
+
+/*!     \brief  The time of a phase (or the total time) of a capture
+ *
+ * \param pTiming       pointer to the capture timing
+ * \param phase         phase or eCAPTURE_NUM_PHASES for the total
+ * \return              µs
+ */
+static gint64
+phaseTime( tCaptureTiming *pTiming, tCapturePhase phase ) {
+	return phase == eCAPTURE_NUM_PHASES ? captureTimingTotal( pTiming ) : pTiming->phaseTime[ phase ];
+}
+
+/*!     \brief  Mean time of a phase over the most recent captures
+ *
+ * \param timings       captures (most recent first)
+ * \param nTimings      number of captures
+ * \param phase         phase or eCAPTURE_NUM_PHASES for the total
+ * \param nRecent       number of recent captures to average
+ * \return              µs
+ */
+gint64
+capturePhaseMean( tCaptureTiming *timings, gint nTimings, tCapturePhase phase, gint nRecent ) {
+	gint64 sum = 0;
+	gint n = MIN( nTimings, nRecent );
+
+	for( gint i = 0; i < n; i++ )
+		sum += phaseTime( &timings[ i ], phase );
+	return n ? sum / n : 0;
+}
+
+static gint
+compareInt64( gconstpointer a, gconstpointer b ) {
+	return (*(gint64 *)a > *(gint64 *)b) - (*(gint64 *)a < *(gint64 *)b);
+}
+
+/*!     \brief  Percentile of the time of a phase
+ *
+ * \param timings       captures
+ * \param nTimings      number of captures
+ * \param phase         phase or eCAPTURE_NUM_PHASES for the total
+ * \param fraction      0.5 for the median, 0.9 ...
+ * \return              µs (nearest rank)
+ */
+gint64
+capturePhasePercentile( tCaptureTiming *timings, gint nTimings, tCapturePhase phase, gdouble fraction ) {
+	gint64 *times, percentile;
+	gint rank;
+
+	if( nTimings == 0 )
+		return 0;
+	times = g_new( gint64, nTimings );
+	for( gint i = 0; i < nTimings; i++ )
+		times[ i ] = phaseTime( &timings[ i ], phase );
+	qsort( times, nTimings, sizeof( gint64 ), compareInt64 );
+	rank = CLAMP( (gint)(fraction * nTimings + 0.999999) - 1, 0, nTimings - 1 );
+	percentile = times[ rank ];
+	g_free( times );
+	return percentile;
+}
+
+/*!     \brief  The plot of a capture has been drawn
+ *
+ * Called after drawing plot A. If a capture is waiting for its plot, the time to
+ * redraw is added and the capture timing is saved and shown.
+ *
+ * \param pGlobal       pointer to global data
+ */
+void
+completeCaptureRedraw( tGlobal *pGlobal ) {
+	tCaptureTiming *pTiming = pGlobal->pPendingCaptureTiming;
+
+	if( pTiming == NULL )
+		return;
+	pGlobal->pPendingCaptureTiming = NULL;
+
+	// the redraw phase was started when the capture reached the main loop
+	startCapturePhase( pTiming, eCAPTURE_REDRAW );
+	saveCaptureTiming( pTiming );
+	showCaptureTimingStatistics( pGlobal, pTiming->sProduct, pTiming->firmwareVersion );
+	freeCaptureTiming( pTiming );
+}
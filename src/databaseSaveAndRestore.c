@@ -22,6 +22,11 @@
 #include "calibrationKit.h"
 
 static sqlite3 *db = NULL;
+static gboolean bFullTextSearch = FALSE;	// SQLite has FTS5 (otherwise search text is matched with LIKE)
+
+static int sqlProfileCallback( unsigned, void *, void *, void * );
+static void freeQueryTimings( void );
+static gint queryInteger( sqlite3 *, const gchar *, gint64 * );
 
 /*!     \brief  Callback for every row in SQL query to fill combo box list
  *
@@ -79,6 +84,7 @@ gchar *sqlCreateTables[] = {
 		    "notes       TEXT,"
 		    "perChannelCalSettings    INTEGER,"
 			"calSettings INTEGER,"
+			"calKit      TEXT,"
 		    "PRIMARY KEY (project, name, channel)"
 		");",
 		"CREATE TABLE IF NOT EXISTS HP8753C_TRACEDATA("
@@ -112,6 +118,7 @@ gchar *sqlCreateTables[] = {
 			"perChannelFlags    INTEGER,"
 			"generalFlags       INTEGER,"
 			"time			TEXT,"
+			"complexPoints	BLOB,"
 			"PRIMARY KEY (project, name, channel)"
 		");",
 		"CREATE TABLE IF NOT EXISTS CAL_KITS("
@@ -140,9 +147,132 @@ gchar *sqlCreateTables[] = {
 		    "product            TEXT,"
 			"PRIMARY KEY (ID)"
 		");",
-		"PRAGMA auto_vacuum = FULL;"
+		// Stimulus axis (header) shared by the archived sweeps of the same setup
+		"CREATE TABLE IF NOT EXISTS HP8753C_ARCHIVE_AXIS("
+			"ID             INTEGER PRIMARY KEY,"
+			"sweepStart     REAL,"
+			"sweepStop      REAL,"
+			"IFbandwidth    REAL,"
+			"CWfrequency    REAL,"
+			"sweepType      INTEGER,"
+			"npoints        INTEGER,"
+			"stimulusPoints BLOB"
+		");",
+		// Append only time series of sweeps (the rowid increases monotonically)
+		"CREATE TABLE IF NOT EXISTS HP8753C_TRACE_ARCHIVE("
+			"ID             INTEGER PRIMARY KEY,"
+			"project        TEXT,"
+			"name           TEXT    NOT NULL,"
+			"channel        INTEGER,"
+			"timestamp      INTEGER NOT NULL,"
+			"axis           INTEGER REFERENCES HP8753C_ARCHIVE_AXIS(ID),"
+			"format         INTEGER,"
+			"sParamOrInputPort INTEGER,"
+			"npoints        INTEGER,"
+			"points         BLOB"
+		");",
+		// (a sweep is only archived once, so re-importing a project can skip or replace it)
+		"CREATE UNIQUE INDEX IF NOT EXISTS IDX_TRACE_ARCHIVE_TIME"
+			" ON HP8753C_TRACE_ARCHIVE(project, name, channel, timestamp);",
+		"CREATE INDEX IF NOT EXISTS IDX_TRACE_ARCHIVE_AXIS"
+			" ON HP8753C_TRACE_ARCHIVE(axis);",
+		// Phase times (µs) of each trace capture
+		"CREATE TABLE IF NOT EXISTS CAPTURE_TIMING("
+			"ID             INTEGER PRIMARY KEY,"
+			"timestamp      INTEGER NOT NULL,"
+			"product        TEXT,"
+			"firmware       INTEGER,"
+			"dualChannel    INTEGER,"
+			"npoints        INTEGER,"
+			"configuration  INTEGER,"
+			"learnString    INTEGER,"
+			"hold           INTEGER,"
+			"traces         INTEGER,"
+			"HPGL           INTEGER,"
+			"markers        INTEGER,"
+			"redraw         INTEGER,"
+			"total          INTEGER"
+		");",
+		"CREATE INDEX IF NOT EXISTS IDX_CAPTURE_TIMING_INSTRUMENT"
+			" ON CAPTURE_TIMING(product, firmware, ID);",
+		// Learned durations of operations (timingModel.c)
+		"CREATE TABLE IF NOT EXISTS TIMING_MODEL("
+			"product        TEXT NOT NULL,"
+			"firmware       INTEGER NOT NULL,"
+			"operation      INTEGER NOT NULL,"
+			"variant        INTEGER NOT NULL,"
+			"mean           REAL,"
+			"deviation      REAL,"
+			"samples        INTEGER,"
+			"PRIMARY KEY (product, firmware, operation, variant)"
+		");",
+		// Learn string indexes analyzed or imported (learnStringRegistry.c)
+		"CREATE TABLE IF NOT EXISTS LEARN_STRING_INDEXES("
+			"product        TEXT NOT NULL,"
+			"firmware       INTEGER NOT NULL,"
+			"indexes        BLOB,"
+			"PRIMARY KEY (product, firmware)"
+		");"
+};
+
+
+// Full text search of the trace and calibration profiles (kept up to date by triggers)
+gchar *sqlCreateFullTextSearch[] = {
+		"CREATE VIRTUAL TABLE IF NOT EXISTS TRACE_SEARCH"
+			" USING fts5(project, name, title, notes, tokenize = 'unicode61 remove_diacritics 2');",
+		"CREATE VIRTUAL TABLE IF NOT EXISTS CALIBRATION_SEARCH"
+			" USING fts5(project, name, notes, tokenize = 'unicode61 remove_diacritics 2');",
+		"CREATE TRIGGER IF NOT EXISTS TRACE_SEARCH_INSERT AFTER INSERT ON HP8753C_TRACEDATA"
+			" WHEN new.channel = 0 BEGIN"
+			"  INSERT INTO TRACE_SEARCH (rowid, project, name, title, notes)"
+			"    VALUES (new.rowid, new.project, new.name, new.title, new.notes);"
+			" END;",
+		"CREATE TRIGGER IF NOT EXISTS TRACE_SEARCH_DELETE AFTER DELETE ON HP8753C_TRACEDATA"
+			" WHEN old.channel = 0 BEGIN"
+			"  DELETE FROM TRACE_SEARCH WHERE rowid = old.rowid;"
+			" END;",
+		"CREATE TRIGGER IF NOT EXISTS TRACE_SEARCH_UPDATE AFTER UPDATE OF project, name, title, notes"
+			" ON HP8753C_TRACEDATA WHEN new.channel = 0 BEGIN"
+			"  DELETE FROM TRACE_SEARCH WHERE rowid = old.rowid;"
+			"  INSERT INTO TRACE_SEARCH (rowid, project, name, title, notes)"
+			"    VALUES (new.rowid, new.project, new.name, new.title, new.notes);"
+			" END;",
+		"CREATE TRIGGER IF NOT EXISTS CALIBRATION_SEARCH_INSERT AFTER INSERT ON HP8753C_CALIBRATION"
+			" WHEN new.channel = 0 BEGIN"
+			"  INSERT INTO CALIBRATION_SEARCH (rowid, project, name, notes)"
+			"    VALUES (new.rowid, new.project, new.name, new.notes);"
+			" END;",
+		"CREATE TRIGGER IF NOT EXISTS CALIBRATION_SEARCH_DELETE AFTER DELETE ON HP8753C_CALIBRATION"
+			" WHEN old.channel = 0 BEGIN"
+			"  DELETE FROM CALIBRATION_SEARCH WHERE rowid = old.rowid;"
+			" END;",
+		"CREATE TRIGGER IF NOT EXISTS CALIBRATION_SEARCH_UPDATE AFTER UPDATE OF project, name, notes"
+			" ON HP8753C_CALIBRATION WHEN new.channel = 0 BEGIN"
+			"  DELETE FROM CALIBRATION_SEARCH WHERE rowid = old.rowid;"
+			"  INSERT INTO CALIBRATION_SEARCH (rowid, project, name, notes)"
+			"    VALUES (new.rowid, new.project, new.name, new.notes);"
+			" END;"
+};
+
+// Without FTS5 the triggers (if the database was created with it) cannot update the index
+gchar *sqlDropFullTextSearchTriggers[] = {
+		"DROP TRIGGER IF EXISTS TRACE_SEARCH_INSERT;",
+		"DROP TRIGGER IF EXISTS TRACE_SEARCH_DELETE;",
+		"DROP TRIGGER IF EXISTS TRACE_SEARCH_UPDATE;",
+		"DROP TRIGGER IF EXISTS CALIBRATION_SEARCH_INSERT;",
+		"DROP TRIGGER IF EXISTS CALIBRATION_SEARCH_DELETE;",
+		"DROP TRIGGER IF EXISTS CALIBRATION_SEARCH_UPDATE;"
 };
 
+// Indexes on the columns used to filter searches
+gchar *sqlCreateSearchIndex[] = {
+		"CREATE INDEX IF NOT EXISTS IDX_TRACE_MEASUREMENT"
+			" ON HP8753C_TRACEDATA(sParamOrInputPort, sweepStart, sweepStop, IFbandwidth);",
+		"CREATE INDEX IF NOT EXISTS IDX_TRACE_SWEEP"
+			" ON HP8753C_TRACEDATA(sweepStart, sweepStop, IFbandwidth, npoints, format);",
+		"CREATE INDEX IF NOT EXISTS IDX_CALIBRATION_TYPE"
+			" ON HP8753C_CALIBRATION(calType, sweepStart, sweepStop, IFbandwidth, npoints);"
+};
 
 /*!     \brief  Open Sqlite database (or create tables)
  *
@@ -175,6 +305,14 @@ openOrCreateDB(void) {
 			break;
 		}
 
+		// INSERT OR REPLACE must fire the delete triggers that maintain the search index
+		sqlite3_exec(db, "PRAGMA recursive_triggers = ON;", NULL, 0, NULL);
+		// free pages are released by the maintenance thread (this only takes effect on a new database).
+		// With a write ahead log the maintenance connection does not block us (and vice versa)
+		sqlite3_exec(db, "PRAGMA auto_vacuum = INCREMENTAL; PRAGMA journal_mode = WAL;", NULL, 0, NULL);
+		sqlite3_busy_timeout(db, DB_BUSY_TIMEOUT);
+		sqlite3_trace_v2(db, SQLITE_TRACE_PROFILE, sqlProfileCallback, NULL);
+
 		// if the table(s) do not exist, create them
 		for (i = 0; i < sizeof(sqlCreateTables) / sizeof(gchar*); i++) {
 			if ((rc = sqlite3_exec(db, sqlCreateTables[i], NULL, 0, &zErrMsg)) != SQLITE_OK) {
@@ -188,6 +326,9 @@ openOrCreateDB(void) {
 		if (bProblem)
 			break;
 
+		if (createSearchIndex() != OK)
+			break;
+
 		rtn = 0;
 	} while ( FALSE);
 
@@ -502,22 +643,24 @@ inventorySavedTraceNames(tGlobal *pGlobal) {
 	return OK;
 }
 
-/*!     \brief  Save the trace profile
+/*!     \brief  Write the trace profile
  *
- * Save the selected trace data to the database
+ * Write the selected trace data to the database
  *
  * \param pGlobal      pointer to tGlobal structure
  * \param sName         trace profile identifier
  * \return 				completion status
  */
-gint
-saveTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
+static gint
+writeTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 
 	sqlite3_stmt *stmt = NULL;
 	guint32 perChannelFlags=0;
 	guint16 generalFlags=0;
 	gint queryIndex;
 
+	invalidateTraceCache( sProject, sName );
+
 		// Source information
 	if (sqlite3_prepare_v2(db,
 			"INSERT OR REPLACE INTO HP8753C_TRACEDATA"
@@ -526,8 +669,8 @@ saveTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 			"   format, scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort, "
 			"   markers, activeMkr, deltaMkr, mkrType, bandwidth, "
 			"   nSegments, segments, screenPlot, title, notes, "
-			"   perChannelFlags, generalFlags, time)"
-			" VALUES (?,?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
+			"   perChannelFlags, generalFlags, time, complexPoints)"
+			" VALUES (?,?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		return ERROR;
 	}
@@ -579,7 +722,7 @@ saveTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 		if( pGlobal->HP8753.channels[channel].stimulusPoints ) {
 			if (sqlite3_bind_blob(stmt, ++queryIndex,
 					pGlobal->HP8753.channels[channel].stimulusPoints,
-					pGlobal->HP8753.channels[channel].nPoints * sizeof(tComplex), SQLITE_STATIC) != SQLITE_OK)
+					pGlobal->HP8753.channels[channel].nPoints * sizeof(gdouble), SQLITE_STATIC) != SQLITE_OK)
 				goto err;
 		} else {
 			++queryIndex;
@@ -666,6 +809,15 @@ saveTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 		// time
 		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753.dateTime, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
 			goto err;
+		// complexPoints
+		if( pGlobal->HP8753.channels[channel].complexPoints ) {
+			if (sqlite3_bind_blob(stmt, ++queryIndex,
+					pGlobal->HP8753.channels[channel].complexPoints,
+					pGlobal->HP8753.channels[channel].nPoints * sizeof(tComplex), SQLITE_STATIC) != SQLITE_OK)
+				goto err;
+		} else {
+			++queryIndex;
+		}
 
 		if (sqlite3_step(stmt) != SQLITE_DONE)
 			goto err;
@@ -682,9 +834,56 @@ err:
 	return ERROR;
 }
 
+/*!     \brief  Save the trace profile
+ *
+ * Save the selected trace data to the database (as acquired, even if the
+ * channels are being shown in another format)
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param sName         trace profile identifier
+ * \return 				completion status
+ */
+gint
+saveTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
+	tFormat shownFormats[ eNUM_CH ];
+	gint rtn;
+
+	showAcquiredFormats( pGlobal, shownFormats );
+	rtn = writeTraceData( pGlobal, sProject, sName );
+	restoreChannelFormats( pGlobal, shownFormats );
+	return rtn;
+}
+
+/*!     \brief  Read a blob from the trace table directly into a buffer
+ *
+ * Use incremental blob I/O so that the blob is copied from the database pages
+ * straight into the destination (without an intermediate copy). The blob handle is
+ * kept open so it can be moved to the next row cheaply.
+ *
+ * \param ppBlob       pointer to blob handle (opened if NULL)
+ * \param sColumn      column holding the blob
+ * \param rowID        row ID of the trace
+ * \param pDest        destination buffer
+ * \param nBytes       number of bytes to read
+ * \return 			   sqlite3 result code
+ */
+static gint
+readTraceBlob( sqlite3_blob **ppBlob, const gchar *sColumn, sqlite3_int64 rowID, void *pDest, gint nBytes ) {
+	gint rc;
+
+	if( *ppBlob == NULL )
+		rc = sqlite3_blob_open( db, "main", "HP8753C_TRACEDATA", sColumn, rowID, 0, ppBlob );
+	else
+		rc = sqlite3_blob_reopen( *ppBlob, rowID );
+
+	if( rc == SQLITE_OK )
+		rc = sqlite3_blob_read( *ppBlob, pDest, nBytes, 0 );
+	return rc;
+}
+
 /*!     \brief  Recover the saved trace profile
  *
- * Get the data of the named profile from the database
+ * Get the data of the named profile from the recall cache or, if not cached, from the database
  *
  * \param pGlobal      pointer to tGlobal structure
  * \param sName        name of the profile to recover
@@ -693,9 +892,13 @@ err:
 gint
 recoverTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 	sqlite3_stmt *stmt = NULL;
-	gint nPoints, pointsSize, mkrSize, bandwidthSize, segmentsSize;
-	const guchar *points = NULL, *markers = NULL, *bandwidth = NULL, *segments=NULL, *screenPlot = NULL;
+	sqlite3_blob *blobPoints = NULL, *blobStimulus = NULL, *blobScreenPlot = NULL, *blobComplex = NULL;
+	sqlite3_int64 rowID;
+	gint nPoints, pointsSize, mkrSize, bandwidthSize, segmentsSize, screenPlotSize;
+	const guchar *markers = NULL, *bandwidth = NULL, *segments=NULL;
 	eChannel channel = eCH_SINGLE;
+	tChannel *pChannel;
+	guint channelMask = 0;
 	const gchar *tText;
 
 	gint traceRetrieved = FALSE;
@@ -703,14 +906,21 @@ recoverTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 	guint32 perChannelFlags;
 	guint16 generalFlags;
 
+	// a different trace (the host formatted views are no longer valid)
+	for( eChannel ch = eCH_ONE; ch < eNUM_CH; ch++ )
+		invalidateReformatCache( pGlobal, ch );
+
+	if( recallTraceFromCache( &pGlobal->HP8753, sProject, sName ) )
+		return TRUE;
+
 	if (sqlite3_prepare_v2(db,
 			"SELECT "
-			"   channel, sweepStart, sweepStop, IFbandwidth, CWfrequency, "
-			"   sweepType, npoints, points, stimulusPoints, format, "
+			"   rowid, channel, sweepStart, sweepStop, IFbandwidth, CWfrequency, "
+			"   sweepType, npoints, length(points), length(stimulusPoints), format, "
 			"   scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort, markers, "
 			"   activeMkr, deltaMkr, mkrType, bandwidth, nSegments, "
-			"   segments, screenPlot, title, notes, perChannelFlags, generalFlags, "
-			"   time"
+			"   segments, length(screenPlot), title, notes, perChannelFlags, generalFlags, "
+			"   time, length(complexPoints)"
 			" FROM HP8753C_TRACEDATA WHERE project IS (?) AND name = (?);", -1, &stmt, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		return ERROR;
@@ -736,75 +946,99 @@ recoverTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 		queryIndex = 0;
 		traceRetrieved = TRUE;
 
+		rowID       = sqlite3_column_int64(stmt,   queryIndex++);
 		channel     = sqlite3_column_int(stmt,     queryIndex++);
-		pGlobal->HP8753.channels[channel].sweepStart   = sqlite3_column_double(stmt,  queryIndex++);
-		pGlobal->HP8753.channels[channel].sweepStop    = sqlite3_column_double(stmt,  queryIndex++);
-		pGlobal->HP8753.channels[channel].IFbandwidth  = sqlite3_column_double(stmt,  queryIndex++);
-		pGlobal->HP8753.channels[channel].CWfrequency  = sqlite3_column_double(stmt,  queryIndex++);
-		pGlobal->HP8753.channels[channel].sweepType    = sqlite3_column_int(stmt,    queryIndex++);
+		pChannel    = &pGlobal->HP8753.channels[channel];
+		channelMask |= (1 << channel);
+		pChannel->sweepStart   = sqlite3_column_double(stmt,  queryIndex++);
+		pChannel->sweepStop    = sqlite3_column_double(stmt,  queryIndex++);
+		pChannel->IFbandwidth  = sqlite3_column_double(stmt,  queryIndex++);
+		pChannel->CWfrequency  = sqlite3_column_double(stmt,  queryIndex++);
+		pChannel->sweepType    = sqlite3_column_int(stmt,    queryIndex++);
 
 		nPoints = sqlite3_column_int(stmt, queryIndex++);
-		// points
-		pointsSize = sqlite3_column_bytes(stmt, queryIndex);
-		points = sqlite3_column_blob(stmt, queryIndex++);
-		g_free(pGlobal->HP8753.channels[channel].responsePoints);
-		if (pointsSize > 0 && nPoints > 0) {
-			pGlobal->HP8753.channels[channel].responsePoints = g_memdup2(points, pointsSize);
-			pGlobal->HP8753.channels[channel].nPoints = nPoints;
+		// points (reuse the buffer if the number of points has not changed)
+		pointsSize = sqlite3_column_int(stmt, queryIndex++);
+		if (nPoints > 0 && pointsSize >= nPoints * sizeof(tComplex)) {
+			if( pChannel->responsePoints == NULL || pChannel->nPoints != nPoints ) {
+				g_free(pChannel->responsePoints);
+				pChannel->responsePoints = g_malloc(nPoints * sizeof(tComplex));
+			}
+			if( readTraceBlob( &blobPoints, "points", rowID,
+					pChannel->responsePoints, nPoints * sizeof(tComplex) ) != SQLITE_OK ) {
+				traceRetrieved = ERROR;
+				goto err;
+			}
 		} else {
-			pGlobal->HP8753.channels[channel].nPoints = 0;
-			pGlobal->HP8753.channels[channel].responsePoints = NULL;
+			nPoints = 0;
+			g_free(pChannel->responsePoints);
+			pChannel->responsePoints = NULL;
 		}
 		// stimulus points
-		pointsSize = sqlite3_column_bytes(stmt, queryIndex);
-		points = sqlite3_column_blob(stmt, queryIndex++);
-		g_free(pGlobal->HP8753.channels[channel].stimulusPoints);
-		if (pointsSize > 0 && nPoints > 0) {
-			pGlobal->HP8753.channels[channel].stimulusPoints = g_memdup2(points, pointsSize);
+		pointsSize = sqlite3_column_int(stmt, queryIndex++);
+		if (nPoints > 0 && pointsSize >= nPoints * sizeof(gdouble)) {
+			if( pChannel->stimulusPoints == NULL || pChannel->nPoints != nPoints ) {
+				g_free(pChannel->stimulusPoints);
+				pChannel->stimulusPoints = g_malloc(nPoints * sizeof(gdouble));
+			}
+			if( readTraceBlob( &blobStimulus, "stimulusPoints", rowID,
+					pChannel->stimulusPoints, nPoints * sizeof(gdouble) ) != SQLITE_OK ) {
+				traceRetrieved = ERROR;
+				goto err;
+			}
 		} else {
-			pGlobal->HP8753.channels[channel].stimulusPoints = NULL;
+			g_free(pChannel->stimulusPoints);
+			pChannel->stimulusPoints = NULL;
 		}
 
-		pGlobal->HP8753.channels[channel].format = sqlite3_column_int(stmt, queryIndex++);
-		pGlobal->HP8753.channels[channel].scaleVal = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753.channels[channel].scaleRefPos = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753.channels[channel].scaleRefVal = sqlite3_column_double(stmt, queryIndex++);
+		pChannel->format = sqlite3_column_int(stmt, queryIndex++);
+		pChannel->scaleVal = sqlite3_column_double(stmt, queryIndex++);
+		pChannel->scaleRefPos = sqlite3_column_double(stmt, queryIndex++);
+		pChannel->scaleRefVal = sqlite3_column_double(stmt, queryIndex++);
 
-		pGlobal->HP8753.channels[channel].measurementType = sqlite3_column_int(stmt, queryIndex++);
+		pChannel->measurementType = sqlite3_column_int(stmt, queryIndex++);
 
 		mkrSize = sqlite3_column_bytes(stmt, queryIndex);
 		markers = sqlite3_column_blob(stmt, queryIndex++);
 		if( mkrSize > 0 )
-			memcpy( (guchar*)&pGlobal->HP8753.channels[channel].numberedMarkers, markers, mkrSize);
+			memcpy( (guchar*)&pChannel->numberedMarkers, markers, mkrSize);
 		else
-			memset( pGlobal->HP8753.channels[channel].numberedMarkers, 0, sizeof(pGlobal->HP8753.channels[channel].numberedMarkers));
+			memset( pChannel->numberedMarkers, 0, sizeof(pChannel->numberedMarkers));
 
-		pGlobal->HP8753.channels[channel].activeMarker = sqlite3_column_int(stmt,queryIndex++);
-		pGlobal->HP8753.channels[channel].deltaMarker = sqlite3_column_int(stmt, queryIndex++);
-		pGlobal->HP8753.channels[channel].mkrType = sqlite3_column_int(stmt, queryIndex++);
+		pChannel->activeMarker = sqlite3_column_int(stmt,queryIndex++);
+		pChannel->deltaMarker = sqlite3_column_int(stmt, queryIndex++);
+		pChannel->mkrType = sqlite3_column_int(stmt, queryIndex++);
 
 		bandwidthSize = sqlite3_column_bytes(stmt, queryIndex);
 		bandwidth = sqlite3_column_blob(stmt, queryIndex++);
-		if (bandwidthSize == sizeof( pGlobal->HP8753.channels[channel].bandwidth ))
-			memcpy( (guchar*)&pGlobal->HP8753.channels[channel].bandwidth, bandwidth, bandwidthSize);
+		if (bandwidthSize == sizeof( pChannel->bandwidth ))
+			memcpy( (guchar*)&pChannel->bandwidth, bandwidth, bandwidthSize);
 		else
-			memset( pGlobal->HP8753.channels[channel].bandwidth, 0, sizeof( pGlobal->HP8753.channels[channel].bandwidth ));
+			memset( pChannel->bandwidth, 0, sizeof( pChannel->bandwidth ));
 
-		pGlobal->HP8753.channels[channel].nSegments = sqlite3_column_int(stmt, queryIndex++);
+		pChannel->nSegments = sqlite3_column_int(stmt, queryIndex++);
 		segmentsSize = sqlite3_column_bytes(stmt, queryIndex);
 		segments = sqlite3_column_blob(stmt, queryIndex++);
 		if (segmentsSize == sizeof( tSegment ) * MAX_SEGMENTS )
-			memcpy( (guchar*)&pGlobal->HP8753.channels[channel].segments, segments, segmentsSize);
+			memcpy( (guchar*)&pChannel->segments, segments, segmentsSize);
 		else
-			memset( pGlobal->HP8753.channels[channel].bandwidth, 0, sizeof( pGlobal->HP8753.channels[channel].bandwidth ));
-
-		// Screenplot
-		screenPlot = sqlite3_column_blob(stmt, queryIndex);
-		g_free( pGlobal->HP8753.plotHPGL );
-		pGlobal->HP8753.plotHPGL = NULL;
-		if( screenPlot != NULL && sqlite3_column_bytes( stmt, queryIndex ) == *(guint *)screenPlot )
-		        pGlobal->HP8753.plotHPGL = g_memdup2( screenPlot, *(guint *)screenPlot);
-		queryIndex++;
+			memset( pChannel->bandwidth, 0, sizeof( pChannel->bandwidth ));
+
+		// Screenplot (the same plot is saved with both channels, so only read it once)
+		screenPlotSize = sqlite3_column_int(stmt, queryIndex++);
+		if( channelMask == (1 << channel) ) {
+			g_free( pGlobal->HP8753.plotHPGL );
+			pGlobal->HP8753.plotHPGL = NULL;
+			if( screenPlotSize > sizeof( guint ) ) {
+				pGlobal->HP8753.plotHPGL = g_malloc( screenPlotSize );
+				if( readTraceBlob( &blobScreenPlot, "screenPlot", rowID,
+						pGlobal->HP8753.plotHPGL, screenPlotSize ) != SQLITE_OK
+						|| *(guint *)pGlobal->HP8753.plotHPGL != screenPlotSize ) {
+					g_free( pGlobal->HP8753.plotHPGL );
+					pGlobal->HP8753.plotHPGL = NULL;
+				}
+			}
+		}
 
 		if( channel == eCH_ONE ) {
 			tText = (const gchar *)sqlite3_column_text(stmt, queryIndex++);
@@ -818,1220 +1052,3410 @@ recoverTraceData(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 		}
 
 		perChannelFlags = sqlite3_column_int(stmt, queryIndex++);
-		memcpy(&pGlobal->HP8753.channels[channel].chFlags, &perChannelFlags, sizeof(guint32));
+		memcpy(&pChannel->chFlags, &perChannelFlags, sizeof(guint32));
 
 		if( channel == eCH_ONE ) {
 			generalFlags = sqlite3_column_int(stmt, queryIndex++);
 			memcpy(&pGlobal->HP8753.flags, &generalFlags, sizeof(guint16));
+			g_free( pGlobal->HP8753.dateTime );
 			pGlobal->HP8753.dateTime = g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) );
 		} else {
 			queryIndex +=2;
 		}
+
+		// complex points (only if retrieved with the trace)
+		pointsSize = sqlite3_column_int(stmt, queryIndex++);
+		if (nPoints > 0 && pointsSize >= nPoints * sizeof(tComplex)) {
+			if( pChannel->complexPoints == NULL || pChannel->nPoints != nPoints ) {
+				g_free(pChannel->complexPoints);
+				pChannel->complexPoints = g_malloc(nPoints * sizeof(tComplex));
+			}
+			if( readTraceBlob( &blobComplex, "complexPoints", rowID,
+					pChannel->complexPoints, nPoints * sizeof(tComplex) ) != SQLITE_OK ) {
+				traceRetrieved = ERROR;
+				goto err;
+			}
+		} else {
+			g_free(pChannel->complexPoints);
+			pChannel->complexPoints = NULL;
+		}
+		pChannel->nPoints = nPoints;
 	}
 
+	if( traceRetrieved == TRUE )
+		storeTraceInCache( &pGlobal->HP8753, channelMask, sProject, sName );
+
 err:
 	if( sqlite3_errcode(db) != SQLITE_DONE) postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_blob_close( blobPoints );
+	sqlite3_blob_close( blobStimulus );
+	sqlite3_blob_close( blobScreenPlot );
+	sqlite3_blob_close( blobComplex );
 	sqlite3_finalize(stmt);
 	return traceRetrieved;
 }
 
-/*!     \brief  Delete the identified profile
+// The last stimulus axis used for each channel is kept so that appending
+// a sweep of an unchanged setup costs one row insert
+static struct {
+	gint64		ID;
+	guint		nPoints;
+	gdouble		sweepStart, sweepStop, IFbandwidth, CWfrequency;
+	tSweepType	sweepType;
+	gdouble		*stimulusPoints;
+} archiveAxisCache[ eNUM_CH ];
+
+/*!     \brief  Find (or add) the stimulus axis for an archived sweep
  *
- * Remove either a setup/calibration profile or a trace profile
+ * The stimulus axis is stored once for each distinct setup. The last axis
+ * used for each channel is cached so that repeated captures of the same
+ * setup do not need to query the database.
  *
- * \param pGlobal      pointer to tGlobal structure
- * \param sProject     name of profile
- * \param sName        name of profile
- * \param bCalibration true if the array to delete is setup/calibration, false for trace
- * \return 			   completion status
+ * \ingroup database
+ *
+ * \param pChannel      pointer to the channel data
+ * \param channel       channel number (index to the cache)
+ * \return 				row ID of the axis or ERROR
  */
-guint
-deleteDBentry(tGlobal *pGlobal, gchar *sProject, gchar *sName, tDBtable whichTable) {
+static gint64
+archiveAxisID( tChannel *pChannel, eChannel channel ) {
 	sqlite3_stmt *stmt = NULL;
-	gchar *sSQL = NULL;
-	GList *listElement = NULL;
-	tProjectAndName projectAndName = {sProject, sName};
-
-	switch( whichTable ) {
-	case eDB_CALandSETUP:
-		sSQL = "DELETE FROM HP8753C_CALIBRATION WHERE project IS (?) AND name = (?);";
-		break;
-	case eDB_TRACE:
-		sSQL = "DELETE FROM HP8753C_TRACEDATA WHERE project IS (?) AND name = (?);";
-		break;
-	case eDB_CALKIT:
-		sSQL = "DELETE FROM CAL_KITS WHERE label = (?);";
-		// Calkits are not associated with projects
-		break;
-	default:
-		return 0;
-		break;
-	}
+	gint queryIndex = 0;
+	gint64 axisID = ERROR;
+	gsize stimulusSize = pChannel->stimulusPoints ? pChannel->nPoints * sizeof(gdouble) : 0;
+
+	if( archiveAxisCache[ channel ].ID > 0
+			&& archiveAxisCache[ channel ].nPoints == pChannel->nPoints
+			&& archiveAxisCache[ channel ].sweepStart == pChannel->sweepStart
+			&& archiveAxisCache[ channel ].sweepStop == pChannel->sweepStop
+			&& archiveAxisCache[ channel ].IFbandwidth == pChannel->IFbandwidth
+			&& archiveAxisCache[ channel ].CWfrequency == pChannel->CWfrequency
+			&& archiveAxisCache[ channel ].sweepType == pChannel->sweepType
+			&& (archiveAxisCache[ channel ].stimulusPoints == NULL) == (pChannel->stimulusPoints == NULL)
+			&& (stimulusSize == 0
+				|| memcmp( archiveAxisCache[ channel ].stimulusPoints, pChannel->stimulusPoints, stimulusSize ) == 0) )
+		return archiveAxisCache[ channel ].ID;
 
-	if (sqlite3_prepare_v2(db, sSQL, -1, &stmt, NULL) != SQLITE_OK) {
+	if (sqlite3_prepare_v2(db,
+			"SELECT ID FROM HP8753C_ARCHIVE_AXIS"
+			" WHERE sweepStart = ? AND sweepStop = ? AND IFbandwidth = ? AND CWfrequency = ?"
+			"   AND sweepType = ? AND npoints = ? AND stimulusPoints IS ?;", -1, &stmt, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		goto err;
+		return ERROR;
 	}
-	if( whichTable == eDB_CALKIT ) {
-		if (sqlite3_bind_text(stmt, 1, sName, STRLENGTH,
-				SQLITE_STATIC) != SQLITE_OK)
+	for( gint pass = 0; pass < 2; pass++ ) {
+		queryIndex = 0;
+		if (sqlite3_bind_double(stmt, ++queryIndex, pChannel->sweepStart) != SQLITE_OK)
 			goto err;
-	} else {
-		// bind project
-		if( sProject == NULL )
-			sqlite3_bind_null(stmt, 1);
-		else
-			sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC);
-		if( sqlite3_errcode( db ) != SQLITE_OK)
+		if (sqlite3_bind_double(stmt, ++queryIndex, pChannel->sweepStop) != SQLITE_OK)
 			goto err;
-		// bind name
-		if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
+		if (sqlite3_bind_double(stmt, ++queryIndex, pChannel->IFbandwidth) != SQLITE_OK)
+			goto err;
+		if (sqlite3_bind_double(stmt, ++queryIndex, pChannel->CWfrequency) != SQLITE_OK)
 			goto err;
+		if (sqlite3_bind_int(stmt, ++queryIndex, pChannel->sweepType) != SQLITE_OK)
+			goto err;
+		if (sqlite3_bind_int(stmt, ++queryIndex, pChannel->nPoints) != SQLITE_OK)
+			goto err;
+		if( stimulusSize ) {
+			if (sqlite3_bind_blob(stmt, ++queryIndex, pChannel->stimulusPoints,
+					stimulusSize, SQLITE_STATIC) != SQLITE_OK)
+				goto err;
+		} else {
+			if (sqlite3_bind_null(stmt, ++queryIndex) != SQLITE_OK)
+				goto err;
+		}
+
+		if( pass == 0 ) {
+			// look for an existing axis
+			if( sqlite3_step(stmt) == SQLITE_ROW )
+				axisID = sqlite3_column_int64(stmt, 0);
+			sqlite3_finalize(stmt);
+			stmt = NULL;
+			if( axisID != ERROR )
+				break;
+			// ... none, so add one
+			if (sqlite3_prepare_v2(db,
+					"INSERT INTO HP8753C_ARCHIVE_AXIS"
+					" (sweepStart, sweepStop, IFbandwidth, CWfrequency, sweepType, npoints, stimulusPoints)"
+					" VALUES (?,?,?,?,?,?,?);", -1, &stmt, NULL) != SQLITE_OK)
+				goto err;
+		} else {
+			if (sqlite3_step(stmt) != SQLITE_DONE)
+				goto err;
+			axisID = sqlite3_last_insert_rowid(db);
 		}
 	}
+	sqlite3_finalize(stmt);
+
+	archiveAxisCache[ channel ].ID = axisID;
+	archiveAxisCache[ channel ].nPoints = pChannel->nPoints;
+	archiveAxisCache[ channel ].sweepStart = pChannel->sweepStart;
+	archiveAxisCache[ channel ].sweepStop = pChannel->sweepStop;
+	archiveAxisCache[ channel ].IFbandwidth = pChannel->IFbandwidth;
+	archiveAxisCache[ channel ].CWfrequency = pChannel->CWfrequency;
+	archiveAxisCache[ channel ].sweepType = pChannel->sweepType;
+	g_free( archiveAxisCache[ channel ].stimulusPoints );
+	archiveAxisCache[ channel ].stimulusPoints = g_memdup2( pChannel->stimulusPoints, stimulusSize );
+
+	return axisID;
+
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	archiveAxisCache[ channel ].ID = 0;
+	return ERROR;
+}
+
+/*!     \brief  Remove the stimulus axes no longer used by any archived sweep
+ *
+ * The axes cached for each channel are kept (they are used by the next sweep appended
+ * and their IDs must not be reused for another axis).
+ *
+ * \ingroup database
+ *
+ * \return 				completion status
+ */
+static gint
+pruneArchiveAxes( void ) {
+	sqlite3_stmt *stmt = NULL;
 
+	if (sqlite3_prepare_v2(db,
+			"DELETE FROM HP8753C_ARCHIVE_AXIS WHERE ID NOT IN (?,?)"
+			" AND NOT EXISTS (SELECT 1 FROM HP8753C_TRACE_ARCHIVE a WHERE a.axis = HP8753C_ARCHIVE_AXIS.ID);",
+			-1, &stmt, NULL) != SQLITE_OK)
+		goto err;
+	for (eChannel channel = 0; channel < eNUM_CH; channel++)
+		if (sqlite3_bind_int64(stmt, channel + 1, archiveAxisCache[ channel ].ID) != SQLITE_OK)
+			goto err;
 	if (sqlite3_step(stmt) != SQLITE_DONE)
 		goto err;
 
 	sqlite3_finalize(stmt);
+	return OK;
 
-	// Must do this after the preparation of the SQL command because otherwise the name will be freed
-	// and the prep statement will fail
-    switch( whichTable ) {
-    case eDB_CALandSETUP:
-        listElement = g_list_find_custom( pGlobal->pCalList, &projectAndName, (GCompareFunc)compareCalItemsForFind );
-        if( listElement ) {
-            freeCalListItem(  listElement->data );
-            pGlobal->pCalList = g_list_remove( pGlobal->pCalList, listElement->data );
-        }
-        break;
-    case eDB_TRACE:
-        listElement = g_list_find_custom( pGlobal->pTraceList, &projectAndName, (GCompareFunc)compareTraceItemsForFind );
-        if( listElement ) {
-            freeTraceListItem( listElement->data );
-            pGlobal->pTraceList = g_list_remove( pGlobal->pTraceList, listElement->data );
-        }
-        break;
-    case eDB_CALKIT:
-        listElement = g_list_find_custom( pGlobal->pCalKitList, sName, (GCompareFunc)compareCalKitIdentifierItem );
-        if( listElement ) {
-            freeCalKitIdentifierItem(  listElement->data );
-            pGlobal->pCalKitList = g_list_remove( pGlobal->pCalKitList, listElement->data );
-        }
-        // Calkits are not associated with projects
-        break;
-    default:
-        break;
-    }
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Keep only the newest archived sweeps of a trace profile channel
+ *
+ * \ingroup database
+ *
+ * \param sProject     project name
+ * \param sName        trace profile identifier
+ * \param channel      channel
+ * \param nKeep        number of sweeps to keep
+ * \return 			   number of sweeps removed or ERROR
+ */
+static gint
+pruneTraceArchive( gchar *sProject, gchar *sName, eChannel channel, gint nKeep ) {
+	sqlite3_stmt *stmt = NULL;
+
+	if (sqlite3_prepare_v2(db,
+			"DELETE FROM HP8753C_TRACE_ARCHIVE WHERE project IS ?1 AND name = ?2 AND channel = ?3"
+			" AND timestamp <= (SELECT timestamp FROM HP8753C_TRACE_ARCHIVE"
+			"   WHERE project IS ?1 AND name = ?2 AND channel = ?3 ORDER BY timestamp DESC LIMIT 1 OFFSET ?4);",
+			-1, &stmt, NULL) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_int(stmt, 3, channel) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_int(stmt, 4, nKeep) != SQLITE_OK)
+		goto err;
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+
+	sqlite3_finalize(stmt);
+	return sqlite3_changes(db);
 
-	return 0;
 err:
 	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 	sqlite3_finalize(stmt);
 	return ERROR;
 }
 
-/*!     \brief  Save the identified setup/calibration profile
+/*!     \brief  Append the current traces to the time series archive
  *
- * Save the identified setup/calibration profile
+ * Unlike saveTraceData(), which replaces the trace profile, every call
+ * adds a new timestamped sweep for each channel with valid data.
+ * The stimulus axis is only stored when the setup changes, so each append
+ * is a single row insert at the end of the table. Only the newest
+ * DB_ARCHIVE_MAX_SWEEPS sweeps of each channel are kept.
+ *
+ * \ingroup database
  *
  * \param pGlobal      pointer to tGlobal structure
- * \param sName        name of profile
- * \return 			   completion status
+ * \param sProject     project name
+ * \param sName        trace profile identifier
+ * \param timestamp    time of the sweep (µs since the epoch) or 0 for now
+ * \return 			   number of channels archived or ERROR
  */
 gint
-saveCalibrationAndSetup(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
-
+appendTraceToArchive(tGlobal *pGlobal, gchar *sProject, gchar *sName, gint64 timestamp) {
 	sqlite3_stmt *stmt = NULL;
-	guint perChannelCalSettings, calSettings;
-	gint  queryIndex;
+	gint queryIndex;
+	gint64 axisID;
+	gint nArchived = 0, nPruned;
+	gboolean bPruned = FALSE;
+	tFormat shownFormats[ eNUM_CH ];
 
-	if (sqlite3_prepare_v2(db,
-			"INSERT OR REPLACE INTO HP8753C_CALIBRATION "
-			" (project, name,  channel, learn, sweepStart, sweepStop,"
-			"  IFbandwidth, CWfrequency, sweepType, npoints, calType,"
-			"  cal01, cal02, cal03, cal04, cal05, "
-			"  cal06, cal07, cal08, cal09, cal10, "
-			"  cal11, cal12, notes, perChannelCalSettings, calSettings)"
-			"  VALUES (?,?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?)", -1, &stmt,
-			NULL) != SQLITE_OK) {
+	if( timestamp == 0 )
+		timestamp = g_get_real_time();
+
+	if (sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		return ERROR;
 	}
+	// archive the traces as acquired
+	showAcquiredFormats( pGlobal, shownFormats );
 
-	// project and name
+	if (sqlite3_prepare_v2(db,
+			"INSERT INTO HP8753C_TRACE_ARCHIVE"
+			" (project, name, channel, timestamp, axis, format, sParamOrInputPort, npoints, points)"
+			" VALUES (?,?,?,?,?,?,?,?,?);", -1, &stmt, NULL) != SQLITE_OK)
+		goto err;
 
-	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
-		queryIndex = 0;
+	for (eChannel channel = 0; channel < eNUM_CH; channel++) {
+		tChannel *pChannel = &pGlobal->HP8753.channels[channel];
 
-		// bind project
-		if( sProject == NULL ) {
-			if (sqlite3_bind_null(stmt, ++queryIndex) != SQLITE_OK) {
-				goto err;
-			}
-		} else {
-			if (sqlite3_bind_text(stmt, ++queryIndex, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
-				goto err;
-			}
-		}
-		// bind name
-		if (sqlite3_bind_text(stmt, ++queryIndex, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
+		if( !pChannel->chFlags.bValidData || pChannel->responsePoints == NULL || pChannel->nPoints == 0 )
+			continue;
+
+		if( (axisID = archiveAxisID( pChannel, channel )) == ERROR )
+			goto rollback;
+
+		queryIndex = 0;
+		// project
+		if (sqlite3_bind_text(stmt, ++queryIndex, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+		// name
+		if (sqlite3_bind_text(stmt, ++queryIndex, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
 			goto err;
-		}
 		// channel
 		if (sqlite3_bind_int(stmt, ++queryIndex, channel) != SQLITE_OK)
 			goto err;
-		//learn
-		if( channel == eCH_ONE ) {
-			if (sqlite3_bind_blob(stmt, ++queryIndex, pGlobal->HP8753cal.pHP8753_learn,
-					lengthFORM1data( pGlobal->HP8753cal.pHP8753_learn ), SQLITE_STATIC) != SQLITE_OK)
-				goto err;
-		} else {
-			++queryIndex;
-		}
-		// sweepStart
-		if (sqlite3_bind_double(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].sweepStart) != SQLITE_OK)
-			goto err;
-		// sweepStop
-		if (sqlite3_bind_double(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].sweepStop) != SQLITE_OK)
+		// timestamp
+		if (sqlite3_bind_int64(stmt, ++queryIndex, timestamp) != SQLITE_OK)
 			goto err;
-
-		// IFbandwidth
-		if (sqlite3_bind_double(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].IFbandwidth) != SQLITE_OK)
+		// axis
+		if (sqlite3_bind_int64(stmt, ++queryIndex, axisID) != SQLITE_OK)
 			goto err;
-		// CWfrequency
-		if (sqlite3_bind_double(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].CWfrequency) != SQLITE_OK)
+		// format
+		if (sqlite3_bind_int(stmt, ++queryIndex, pChannel->format) != SQLITE_OK)
 			goto err;
-		// sweepType
-		if (sqlite3_bind_int(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].sweepType) != SQLITE_OK)
+		// sParamOrInputPort
+		if (sqlite3_bind_int(stmt, ++queryIndex, pChannel->measurementType) != SQLITE_OK)
 			goto err;
 		// npoints
-		if (sqlite3_bind_int(stmt, ++queryIndex,
-				pGlobal->HP8753cal.perChannelCal[channel].nPoints) != SQLITE_OK)
-			goto err;
-		// calType
-		if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->HP8753cal.perChannelCal[channel].iCalType) != SQLITE_OK)
+		if (sqlite3_bind_int(stmt, ++queryIndex, pChannel->nPoints) != SQLITE_OK)
 			goto err;
-		// cal01 to cal12
-		for (int i = 0; i < MAX_CAL_ARRAYS; i++) {
-			gint length = 0;
-			if( i < numOfCalArrays[pGlobal->HP8753cal.perChannelCal[channel].iCalType] &&
-					pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] != NULL )
-				length = lengthFORM1data( pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] );
-			if (sqlite3_bind_blob(stmt, ++queryIndex, pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i], length,
-					SQLITE_STATIC) != SQLITE_OK)
-				goto err;
-		}
-		// notes
-		if( channel == eCH_ONE ) {
-			if (pGlobal->HP8753cal.sNote)
-				if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753cal.sNote, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
-					goto err;
-		} else {
-			++queryIndex;
-		}
-
-		memcpy(&perChannelCalSettings, &pGlobal->HP8753cal.perChannelCal[channel].settings, sizeof(gushort));
-		memcpy(&calSettings, &pGlobal->HP8753cal.settings, sizeof(gushort));
-		// perChannelCalSettings
-		if (sqlite3_bind_int(stmt, ++queryIndex, perChannelCalSettings) != SQLITE_OK)
+		// points
+		if (sqlite3_bind_blob(stmt, ++queryIndex, pChannel->responsePoints,
+				pChannel->nPoints * sizeof(tComplex), SQLITE_STATIC) != SQLITE_OK)
 			goto err;
-		// calSettings
-		if( channel == eCH_ONE ) {
-			if (sqlite3_bind_int(stmt, ++queryIndex, calSettings) != SQLITE_OK)
-						goto err;
-		} else {
-			++queryIndex;
-		}
 
 		if (sqlite3_step(stmt) != SQLITE_DONE)
 			goto err;
 
 		sqlite3_reset( stmt );
 		sqlite3_clear_bindings( stmt );
-	}
-	sqlite3_finalize(stmt);
+		nArchived++;
 
-	tProjectAndName projectAndName = { sProject, sName, FALSE };
-	GList *calPreviewElement = g_list_find_custom( pGlobal->pCalList, &projectAndName, (GCompareFunc)compareCalItemsForFind );
-	if( calPreviewElement ) {
-		freeCalListItem( calPreviewElement->data );
-		pGlobal->pCalList = g_list_remove( pGlobal->pCalList, calPreviewElement->data );
+		// the archive only keeps the newest sweeps
+		if( (nPruned = pruneTraceArchive( sProject, sName, channel, DB_ARCHIVE_MAX_SWEEPS )) == ERROR )
+			goto rollback;
+		bPruned |= (nPruned > 0);
 	}
-	// Mark all other Calibration profiles as unselected
-    for( GList *l = pGlobal->pCalList; l != NULL; l = l->next ){
-            tProjectAndName *pProjectAndName = &(((tHP8753cal *)l->data)->projectAndName);
-            pProjectAndName->bSelected = FALSE;
-    }
-
-	tHP8753cal *pCal = g_new0(tHP8753cal, 1);
 
-	pCal->projectAndName.sProject = g_strdup( sProject );
-	pCal->projectAndName.sName = g_strdup( sName );
-	pCal->projectAndName.bSelected = TRUE;
-	pCal->sNote = g_strdup( pGlobal->HP8753cal.sNote );
-	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
-		pCal->perChannelCal[ channel ].sweepStart = pGlobal->HP8753cal.perChannelCal[ channel ].sweepStart;
-		pCal->perChannelCal[ channel ].sweepStop = pGlobal->HP8753cal.perChannelCal[ channel ].sweepStop;
-		pCal->perChannelCal[ channel ].IFbandwidth = pGlobal->HP8753cal.perChannelCal[ channel ].IFbandwidth;
-		pCal->perChannelCal[ channel ].CWfrequency = pGlobal->HP8753cal.perChannelCal[ channel ].CWfrequency;
-		pCal->perChannelCal[ channel ].sweepType = pGlobal->HP8753cal.perChannelCal[ channel ].sweepType;
-		pCal->perChannelCal[ channel ].nPoints = pGlobal->HP8753cal.perChannelCal[ channel ].nPoints;
-		memcpy( &pCal->perChannelCal[ channel ].settings, &pGlobal->HP8753cal.perChannelCal[ channel ].settings, sizeof( gushort ) );
-	}
-	memcpy( &pCal->settings, &pGlobal->HP8753cal.settings, sizeof( gushort ) );
+	sqlite3_finalize( stmt );
+	stmt = NULL;
+	if( bPruned && pruneArchiveAxes() != OK )
+		goto rollback;
+	if (sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK)
+		goto err;
 
-	pGlobal->pCalList = g_list_insert_sorted( pGlobal->pCalList, pCal, (GCompareFunc)compareCalItemsForSort );
-	pGlobal->pCalibrationAbstract = pCal;
-	return 0;
+	restoreChannelFormats( pGlobal, shownFormats );
+	return nArchived;
 
 err:
 	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-	sqlite3_finalize(stmt);
+rollback:
+	sqlite3_finalize( stmt );
+	sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+	// the axis may have been rolled back
+	for (eChannel channel = 0; channel < eNUM_CH; channel++)
+		g_free( archiveAxisCache[ channel ].stimulusPoints );
+	memset( archiveAxisCache, 0, sizeof( archiveAxisCache ) );
+	restoreChannelFormats( pGlobal, shownFormats );
 	return ERROR;
 }
 
-/*!     \brief  Recover identified setup/calibration profile
+/*!     \brief  The reason the last database call on the main thread failed
  *
- * Recover the identified setup/calibration profile
+ * \ingroup database
  *
- * \param pGlobal      pointer to tGlobal structure
- * \param sName        name of profile
- * \return 			   completion status
+ * \return 			   SQLite error message (owned by SQLite)
+ */
+const gchar *
+databaseErrorMessage( void ) {
+	return sqlite3_errmsg( db );
+}
+
+/*!     \brief  Query the time series archive
+ *
+ * Call the callback for every archived sweep of the trace profile in the time range
+ * (in time order). The sweeps are read one row at a time, so a range of any size can be
+ * visited without loading it. The data pointed to in the tArchivedSweep structure
+ * is only valid for the duration of the callback.
+ *
+ * \ingroup database
+ *
+ * \param sProject     project name
+ * \param sName        trace profile identifier
+ * \param channel      eCH_ONE, eCH_TWO or eCH_BOTH
+ * \param fromTime     start of the time range (µs since the epoch, inclusive)
+ * \param toTime       end of the time range (µs since the epoch, inclusive)
+ * \param callback     function called for each sweep (return FALSE to stop)
+ * \param pUserData    data passed to the callback
+ * \return 			   number of sweeps visited or ERROR (see databaseErrorMessage())
  */
 gint
-recoverCalibrationAndSetup(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
+queryTraceArchive(gchar *sProject, gchar *sName, eChannel channel, gint64 fromTime, gint64 toTime,
+		tArchiveSweepCallback callback, gpointer pUserData) {
 	sqlite3_stmt *stmt = NULL;
-	gint length;
-	eChannel channel = eCH_SINGLE;
-	const guchar *tBlob;
-	const gchar *tText;
-	gint queryIndex;
-	gint calRetrieved = FALSE;
-	gushort perChannelCalSettings, calSettings;
+	gint queryIndex = 0;
+	gint nSweeps = 0;
+	tArchivedSweep sweep;
+	gint rc;
 
-	if (sqlite3_prepare_v2(db,
-			"SELECT "
-			"  channel, learn, sweepStart, sweepStop, IFbandwidth,"
-			"  CWfrequency, sweepType, npoints, calType, cal01,"
-			"  cal02, cal03, cal04, cal05, cal06, "
-			"  cal07, cal08, cal09, cal10, cal11, "
-			"  cal12, notes, perChannelCalSettings, calSettings "
-			"  FROM HP8753C_CALIBRATION"
-			" WHERE project IS (?) AND name = (?);", -1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	if (sqlite3_prepare_v2(db, channel == eCH_BOTH ?
+			"SELECT a.timestamp, a.channel, a.format, a.sParamOrInputPort, a.npoints, a.points,"
+			"   b.stimulusPoints, b.sweepStart, b.sweepStop, b.sweepType, b.IFbandwidth, b.CWfrequency"
+			" FROM HP8753C_TRACE_ARCHIVE a LEFT JOIN HP8753C_ARCHIVE_AXIS b ON a.axis = b.ID"
+			" WHERE a.project IS (?) AND a.name = (?) AND a.channel IN (0, 1)"
+			"   AND a.timestamp BETWEEN ? AND ? ORDER BY a.timestamp, a.channel;"
+			:
+			"SELECT a.timestamp, a.channel, a.format, a.sParamOrInputPort, a.npoints, a.points,"
+			"   b.stimulusPoints, b.sweepStart, b.sweepStop, b.sweepType, b.IFbandwidth, b.CWfrequency"
+			" FROM HP8753C_TRACE_ARCHIVE a LEFT JOIN HP8753C_ARCHIVE_AXIS b ON a.axis = b.ID"
+			" WHERE a.project IS (?) AND a.name = (?) AND a.channel = (?)"
+			"   AND a.timestamp BETWEEN ? AND ? ORDER BY a.timestamp;",
+			-1, &stmt, NULL) != SQLITE_OK)
 		return ERROR;
-	}
 
-	// bind project
-	if( sProject == NULL )
-		sqlite3_bind_null(stmt, 1);
-	else
-		sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC);
-	if( sqlite3_errcode( db ) != SQLITE_OK) {
-		calRetrieved = ERROR;
+	// project
+	if( sProject == NULL ) {
+		if (sqlite3_bind_null(stmt, ++queryIndex) != SQLITE_OK)
+			goto err;
+	} else if (sqlite3_bind_text(stmt, ++queryIndex, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
 		goto err;
 	}
-	// bind name
-	if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
-		calRetrieved = ERROR;
+	// name
+	if (sqlite3_bind_text(stmt, ++queryIndex, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	// channel
+	if( channel != eCH_BOTH && sqlite3_bind_int(stmt, ++queryIndex, channel) != SQLITE_OK)
+		goto err;
+	// time range
+	if (sqlite3_bind_int64(stmt, ++queryIndex, fromTime) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_int64(stmt, ++queryIndex, toTime) != SQLITE_OK)
 		goto err;
-	}
 
-	// Line for ch 1 and ch 2
-	// learn, title, notes, flags and options are only taken from ch 1
-	while (sqlite3_step(stmt) == SQLITE_ROW) {
-		calRetrieved = TRUE;
+	while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
 		queryIndex = 0;
+		sweep.timestamp       = sqlite3_column_int64(stmt, queryIndex++);
+		sweep.channel         = sqlite3_column_int(stmt, queryIndex++);
+		sweep.format          = sqlite3_column_int(stmt, queryIndex++);
+		sweep.measurementType = sqlite3_column_int(stmt, queryIndex++);
+		sweep.nPoints         = sqlite3_column_int(stmt, queryIndex++);
+		sweep.responsePoints  = sqlite3_column_blob(stmt, queryIndex);
+		if( sqlite3_column_bytes(stmt, queryIndex++) != sweep.nPoints * sizeof(tComplex) )
+			continue;	// corrupt row
+		sweep.stimulusPoints  = sqlite3_column_blob(stmt, queryIndex);
+		if( sqlite3_column_bytes(stmt, queryIndex++) != sweep.nPoints * sizeof(gdouble) )
+			sweep.stimulusPoints = NULL;
+		sweep.sweepStart      = sqlite3_column_double(stmt, queryIndex++);
+		sweep.sweepStop       = sqlite3_column_double(stmt, queryIndex++);
+		sweep.sweepType       = sqlite3_column_int(stmt, queryIndex++);
+		sweep.IFbandwidth     = sqlite3_column_double(stmt, queryIndex++);
+		sweep.CWfrequency     = sqlite3_column_double(stmt, queryIndex++);
+
+		nSweeps++;
+		if( !callback( &sweep, pUserData ) ) {
+			rc = SQLITE_DONE;
+			break;
+		}
+	}
+	if( rc != SQLITE_DONE )
+		goto err;
 
-		// Channel
-		channel = sqlite3_column_int(stmt, queryIndex++);
+	sqlite3_finalize(stmt);
+	return nSweeps;
 
-		// Learn string
-		length  = sqlite3_column_bytes(stmt, queryIndex);
-		tBlob   = sqlite3_column_blob(stmt, queryIndex++);
-		if( channel == eCH_ONE ) {
-			g_free(pGlobal->HP8753cal.pHP8753_learn);
-			pGlobal->HP8753cal.pHP8753_learn = g_memdup2(tBlob, (gsize) length);
+err:
+	// (the caller reports databaseErrorMessage())
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Create the full text search index (if it does not exist)
+ *
+ * If SQLite has no FTS5 only the indexes of the filter columns are created
+ * and openSearchCursor() matches the text with LIKE instead. An existing index
+ * is rebuilt if it was not maintained (the database was last opened without FTS5)
+ * or does not have a row for each profile.
+ *
+ * \ingroup database
+ *
+ * \return 			   OK or ERROR
+ */
+gint
+createSearchIndex( void ) {
+	gchar *zErrMsg = NULL;
+	gchar **sqlFullText;
+	gint nFullText;
+	gint64 nIndexTables = 0, nTriggers = 0, bConsistent = TRUE;
+
+	// SQLite may have been built without FTS5
+	bFullTextSearch = sqlite3_exec(db, "CREATE VIRTUAL TABLE temp.FTS5_PROBE USING fts5(x);"
+			"DROP TABLE temp.FTS5_PROBE;", NULL, NULL, NULL) == SQLITE_OK;
+	// the state of an existing index (before its triggers are created)
+	if( bFullTextSearch
+			&& queryInteger( db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'table'"
+					" AND name IN ('TRACE_SEARCH', 'CALIBRATION_SEARCH');", &nIndexTables ) == OK
+			&& nIndexTables == 2 ) {
+		queryInteger( db, "SELECT COUNT(*) FROM sqlite_master WHERE type = 'trigger'"
+				" AND (name LIKE 'TRACE\\_SEARCH\\_%' ESCAPE '\\' OR name LIKE 'CALIBRATION\\_SEARCH\\_%' ESCAPE '\\');",
+				&nTriggers );
+		queryInteger( db, "SELECT (SELECT COUNT(*) FROM TRACE_SEARCH)"
+				"   = (SELECT COUNT(*) FROM HP8753C_TRACEDATA WHERE channel = 0)"
+				" AND (SELECT COUNT(*) FROM CALIBRATION_SEARCH)"
+				"   = (SELECT COUNT(*) FROM HP8753C_CALIBRATION WHERE channel = 0);", &bConsistent );
+	}
+	if( bFullTextSearch ) {
+		sqlFullText = sqlCreateFullTextSearch;
+		nFullText = sizeof(sqlCreateFullTextSearch) / sizeof(gchar*);
+	} else {
+		sqlFullText = sqlDropFullTextSearchTriggers;
+		nFullText = sizeof(sqlDropFullTextSearchTriggers) / sizeof(gchar*);
+	}
+
+	for( gint i = 0; i < nFullText; i++ ) {
+		if (sqlite3_exec(db, sqlFullText[i], NULL, 0, &zErrMsg) != SQLITE_OK) {
+			postMessageToMainLoop(TM_ERROR, zErrMsg);
+			sqlite3_free(zErrMsg);
+			return ERROR;
+		}
+	}
+	for( gint i = 0; i < sizeof(sqlCreateSearchIndex) / sizeof(gchar*); i++ ) {
+		if (sqlite3_exec(db, sqlCreateSearchIndex[i], NULL, 0, &zErrMsg) != SQLITE_OK) {
+			postMessageToMainLoop(TM_ERROR, zErrMsg);
+			sqlite3_free(zErrMsg);
+			return ERROR;
 		}
+	}
+	// (the index tables hold their own copy of the text, so are repopulated from the profiles)
+	if( nIndexTables == 2 && (nTriggers < sizeof(sqlDropFullTextSearchTriggers) / sizeof(gchar*) || !bConsistent) )
+		return rebuildSearchIndex();
+	return OK;
+}
 
-		pGlobal->HP8753cal.perChannelCal[channel].sweepStart   = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753cal.perChannelCal[channel].sweepStop    = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753cal.perChannelCal[channel].IFbandwidth  = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753cal.perChannelCal[channel].CWfrequency  = sqlite3_column_double(stmt, queryIndex++);
-		pGlobal->HP8753cal.perChannelCal[channel].sweepType    = sqlite3_column_int(stmt,    queryIndex++);
-		pGlobal->HP8753cal.perChannelCal[channel].nPoints      = sqlite3_column_int(stmt,    queryIndex++);
+/*!     \brief  Repopulate the full text search index from the profile tables
+ *
+ * The index is normally maintained by triggers; this is only needed when it is
+ * first created over existing profiles or was not maintained.
+ *
+ * \ingroup database
+ *
+ * \return 			   OK or ERROR
+ */
+gint
+rebuildSearchIndex( void ) {
+	if( !bFullTextSearch )
+		return OK;
+	if (sqlite3_exec(db,
+			"BEGIN;"
+			"DELETE FROM TRACE_SEARCH;"
+			"INSERT INTO TRACE_SEARCH (rowid, project, name, title, notes)"
+			"  SELECT rowid, project, name, title, notes FROM HP8753C_TRACEDATA WHERE channel = 0;"
+			"DELETE FROM CALIBRATION_SEARCH;"
+			"INSERT INTO CALIBRATION_SEARCH (rowid, project, name, notes)"
+			"  SELECT rowid, project, name, notes FROM HP8753C_CALIBRATION WHERE channel = 0;"
+			"COMMIT;", NULL, NULL, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+		return ERROR;
+	}
+	return OK;
+}
 
-		// calType
-		pGlobal->HP8753cal.perChannelCal[channel].iCalType = sqlite3_column_int(stmt, queryIndex++);
+struct _searchCursor {
+	sqlite3_stmt	*stmt;
+	gboolean		bDone;
+};
 
-		// calArrays
-		for (int i = 0; i < MAX_CAL_ARRAYS; i++) {
-			length = sqlite3_column_bytes(stmt, queryIndex);
-			g_free(pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i]);
-			tBlob = sqlite3_column_blob(stmt, queryIndex++);
-			if (length > 0) {
-				pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] = g_memdup2(tBlob, (gsize) length);
-				// We infer size from cal string .. its only used for informational purposes
-				if( i==0 && length > 4 ) {
-					pGlobal->HP8753cal.perChannelCal[channel].nPoints = GUINT16_FROM_BE( (guint16 *)&tBlob[2] ) / BYTES_PER_CALPOINT;
-				}
-			} else {
-				pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] = NULL;
-			}
-		}
+/*!     \brief  Bind a named parameter if it is used in the statement
+ *
+ * \param stmt         prepared statement
+ * \param sParameter   parameter name
+ * \param value        value to bind
+ * \return 			   SQLITE_OK or error
+ */
+static gint
+bindSearchDouble( sqlite3_stmt *stmt, const gchar *sParameter, gdouble value ) {
+	gint index = sqlite3_bind_parameter_index( stmt, sParameter );
+	return index == 0 ? SQLITE_OK : sqlite3_bind_double( stmt, index, value );
+}
 
-		tText = (const gchar *)sqlite3_column_text(stmt, queryIndex++);
-		if( channel == eCH_ONE ) {
-			g_free(pGlobal->HP8753cal.sNote);
-			pGlobal->HP8753cal.sNote = g_strdup(tText);
-		}
+/*!     \brief  Match each search word with LIKE (when SQLite has no FTS5)
+ *
+ * \param sSQL         statement being built
+ * \param sWords       words to match (NULL terminated)
+ * \param bTitle       the profile has a title column
+ */
+static void
+appendSearchLike( GString *sSQL, gchar **sWords, gboolean bTitle ) {
+	static const gchar *columns[] = { "project", "name", "notes", "title" };
+
+	for( gint i = 0; sWords && sWords[ i ]; i++ ) {
+		g_string_append( sSQL, " AND (" );
+		for( gint c = 0; c < (bTitle ? 4 : 3); c++ )
+			g_string_append_printf( sSQL, "%sh.%s LIKE :w%d ESCAPE '\\'", c ? " OR " : "", columns[ c ], i );
+		g_string_append_c( sSQL, ')' );
+	}
+}
 
-		perChannelCalSettings = sqlite3_column_int(stmt, queryIndex++);
-		memcpy( &pGlobal->HP8753cal.perChannelCal[ channel ].settings, &perChannelCalSettings, sizeof( gushort ) );
+/*!     \brief  Start a search of the saved trace and/or calibration profiles
+ *
+ * The text (if any) is matched against the full text index of the project, name,
+ * title and notes (or each word with LIKE if SQLite has no FTS5); the remaining fields of the query filter on the indexed sweep columns.
+ * Results are best match first and are retrieved in batches with fetchSearchResults()
+ * so that the caller can show them as they arrive.
+ *
+ * \ingroup database
+ *
+ * \param pQuery       pointer to the search query
+ * \return 			   search cursor (free with closeSearchCursor()) or NULL on error
+ */
+tSearchCursor *
+openSearchCursor( tSearchQuery *pQuery ) {
+	tSearchCursor *pCursor;
+	GString *sSQL = g_string_new( NULL );
+	GString *sFilter = g_string_new( NULL );
+	gboolean bText = pQuery->sText != NULL && pQuery->sText[0] != 0;
+	gboolean bMatch = bText && bFullTextSearch;
+	gboolean bTraces = pQuery->bTraces && pQuery->calType == INVALID;
+	gboolean bCalibrations = pQuery->bCalibrations
+			&& pQuery->measurementType == INVALID && pQuery->format == INVALID;
+	sqlite3_stmt *stmt = NULL;
+	gint index;
+
+	// filters common to both tables (the sweep must overlap the frequency range)
+	if( pQuery->minFrequency > 0.0 )
+		g_string_append( sFilter, " AND t.sweepStop >= :fmin" );
+	if( pQuery->maxFrequency > 0.0 )
+		g_string_append( sFilter, " AND t.sweepStart <= :fmax" );
+	if( pQuery->maxIFbandwidth > 0.0 )
+		g_string_append( sFilter, " AND t.IFbandwidth <= :ifbw" );
+	if( pQuery->minPoints > 0 )
+		g_string_append( sFilter, " AND t.npoints >= :pmin" );
+	if( pQuery->maxPoints > 0 )
+		g_string_append( sFilter, " AND t.npoints <= :pmax" );
+
+	if( bTraces ) {
+		g_string_append_printf( sSQL,
+			"SELECT %d, t.project, t.name, h.title, h.notes, h.time, min(t.sweepStart), max(t.sweepStop),"
+			"   max(t.IFbandwidth), max(t.npoints), t.sParamOrInputPort, t.format, %d, %s AS rank"
+			" FROM HP8753C_TRACEDATA t"
+			"   JOIN HP8753C_TRACEDATA h ON h.project IS t.project AND h.name = t.name AND h.channel = 0"
+			"%s"
+			" WHERE 1%s",
+			eDB_TRACE, INVALID, bMatch ? "min(s.rank)" : "0",
+			bMatch ? " JOIN TRACE_SEARCH s ON s.rowid = h.rowid AND TRACE_SEARCH MATCH :text" : "",
+			sFilter->str );
+		if( bText && !bMatch )
+			appendSearchLike( sSQL, pQuery->sWords, TRUE );
+		if( pQuery->measurementType != INVALID )
+			g_string_append( sSQL, " AND t.sParamOrInputPort = :meas" );
+		if( pQuery->format != INVALID )
+			g_string_append( sSQL, " AND t.format = :fmt" );
+		g_string_append( sSQL, " GROUP BY t.project, t.name" );
+	}
+	if( bCalibrations ) {
+		if( bTraces )
+			g_string_append( sSQL, " UNION ALL " );
+		g_string_append_printf( sSQL,
+			"SELECT %d, t.project, t.name, NULL, h.notes, NULL, min(t.sweepStart), max(t.sweepStop),"
+			"   max(t.IFbandwidth), max(t.npoints), %d, %d, h.calType, %s AS rank"
+			" FROM HP8753C_CALIBRATION t"
+			"   JOIN HP8753C_CALIBRATION h ON h.project IS t.project AND h.name = t.name AND h.channel = 0"
+			"%s"
+			" WHERE 1%s",
+			eDB_CALandSETUP, INVALID, INVALID, bMatch ? "min(s.rank)" : "0",
+			bMatch ? " JOIN CALIBRATION_SEARCH s ON s.rowid = h.rowid AND CALIBRATION_SEARCH MATCH :text" : "",
+			sFilter->str );
+		if( bText && !bMatch )
+			appendSearchLike( sSQL, pQuery->sWords, FALSE );
+		if( pQuery->calType != INVALID )
+			g_string_append( sSQL, " AND t.calType = :cal" );
+		g_string_append( sSQL, " GROUP BY t.project, t.name" );
+	}
+	g_string_free( sFilter, TRUE );
+
+	pCursor = g_new0( tSearchCursor, 1 );
+	// nothing can match (e.g. a calibration type for traces only)
+	if( !bTraces && !bCalibrations ) {
+		pCursor->bDone = TRUE;
+		g_string_free( sSQL, TRUE );
+		return pCursor;
+	}
+	g_string_append( sSQL, " ORDER BY rank, 2, 3;" );
 
-		if( channel == eCH_ONE ) {
-			calSettings = sqlite3_column_int(stmt, queryIndex++);
-			memcpy( &pGlobal->HP8753cal.settings, &calSettings, sizeof( gushort ) );
-		} else {
-			queryIndex++;
+	if (sqlite3_prepare_v2(db, sSQL->str, -1, &stmt, NULL) != SQLITE_OK) {
+		g_string_free( sSQL, TRUE );
+		goto err;
+	}
+	g_string_free( sSQL, TRUE );
+
+	if( (index = sqlite3_bind_parameter_index( stmt, ":text" )) != 0
+			&& sqlite3_bind_text(stmt, index, pQuery->sText, STRLENGTH, SQLITE_TRANSIENT) != SQLITE_OK )
+		goto err;
+	for( gint i = 0; !bMatch && pQuery->sWords && pQuery->sWords[ i ]; i++ ) {
+		gchar *sParameter = g_strdup_printf( ":w%d", i );
+		GString *sPattern = g_string_new( "%" );
+
+		for( gchar *s = pQuery->sWords[ i ]; *s; s++ ) {
+			if( *s == '%' || *s == '_' || *s == '\\' )
+				g_string_append_c( sPattern, '\\' );
+			g_string_append_c( sPattern, *s );
+		}
+		g_string_append_c( sPattern, '%' );
+		index = sqlite3_bind_parameter_index( stmt, sParameter );
+		g_free( sParameter );
+		if( index != 0 && sqlite3_bind_text(stmt, index, sPattern->str, STRLENGTH, SQLITE_TRANSIENT) != SQLITE_OK ) {
+			g_string_free( sPattern, TRUE );
+			goto err;
 		}
+		g_string_free( sPattern, TRUE );
 	}
+	if( (index = sqlite3_bind_parameter_index( stmt, ":meas" )) != 0
+			&& sqlite3_bind_int(stmt, index, pQuery->measurementType) != SQLITE_OK )
+		goto err;
+	if( (index = sqlite3_bind_parameter_index( stmt, ":fmt" )) != 0
+			&& sqlite3_bind_int(stmt, index, pQuery->format) != SQLITE_OK )
+		goto err;
+	if( (index = sqlite3_bind_parameter_index( stmt, ":cal" )) != 0
+			&& sqlite3_bind_int(stmt, index, pQuery->calType) != SQLITE_OK )
+		goto err;
+	if( (index = sqlite3_bind_parameter_index( stmt, ":pmin" )) != 0
+			&& sqlite3_bind_int(stmt, index, pQuery->minPoints) != SQLITE_OK )
+		goto err;
+	if( (index = sqlite3_bind_parameter_index( stmt, ":pmax" )) != 0
+			&& sqlite3_bind_int(stmt, index, pQuery->maxPoints) != SQLITE_OK )
+		goto err;
+	if( bindSearchDouble( stmt, ":fmin", pQuery->minFrequency ) != SQLITE_OK
+			|| bindSearchDouble( stmt, ":fmax", pQuery->maxFrequency ) != SQLITE_OK
+			|| bindSearchDouble( stmt, ":ifbw", pQuery->maxIFbandwidth ) != SQLITE_OK )
+		goto err;
+
+	pCursor->stmt = stmt;
+	return pCursor;
+
 err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 	sqlite3_finalize(stmt);
-	return calRetrieved;
+	g_free( pCursor );
+	return NULL;
 }
 
-/*!     \brief  Save the program options
+/*!     \brief  Retrieve the next batch of search results
  *
- * Save the program options (on shutdown)
+ * \ingroup database
  *
- * \param pGlobal      pointer to tGlobal structure
- * \return 			   completion status
+ * \param pCursor      search cursor from openSearchCursor()
+ * \param maxResults   maximum number of results to retrieve in this batch
+ * \param callback     function called for each result (return FALSE to stop the search)
+ * \param pUserData    data passed to the callback
+ * \return 			   number of results retrieved (0 when the search is complete) or ERROR
  */
 gint
-saveProgramOptions(tGlobal *pGlobal) {
-
-	sqlite3_stmt *stmt = NULL;
-	gchar *zErrMsg = 0;
-	union uOptions {
-        struct stOptions {
-            guint16 flagsL;
-            guint8  flagsU;
-            guint8  PDFpaperSize;
-        }  __attribute__((packed)) components;
-        guint all;
-	} options;
-	GBytes *byPage = NULL;
-	GBytes *byPrintSettings = NULL;
-	gint queryIndex;
+fetchSearchResults( tSearchCursor *pCursor, gint maxResults,
+		tSearchResultCallback callback, gpointer pUserData ) {
+	tSearchResult result;
+	gint queryIndex, nResults = 0;
+	gint rc;
 
-	if (sqlite3_prepare_v2(db,
-			"INSERT OR REPLACE INTO OPTIONS"
-			" (ID, flags, GPIBcontrollerName, GPIBdeviceName, GPIBcontrollerCard, "
-			"  GPIBdevicePID, GtkPrintSettings, GtkPageSetup, lastDirectory, calProfile, "
-			"  traceProfile, project, colors, colorsHPGL, learnStringIndexes, product"
-			" )"
-			" VALUES (?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	if( pCursor == NULL )
 		return ERROR;
+	if( pCursor->bDone )
+		return 0;
+
+	while( nResults < maxResults ) {
+		if( (rc = sqlite3_step(pCursor->stmt)) != SQLITE_ROW ) {
+			pCursor->bDone = TRUE;
+			if( rc != SQLITE_DONE ) {
+				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+				return ERROR;
+			}
+			break;
+		}
+		queryIndex = 0;
+		result.whichTable      = sqlite3_column_int(pCursor->stmt, queryIndex++);
+		result.sProject        = (const gchar *)sqlite3_column_text(pCursor->stmt, queryIndex++);
+		result.sName           = (const gchar *)sqlite3_column_text(pCursor->stmt, queryIndex++);
+		result.sTitle          = (const gchar *)sqlite3_column_text(pCursor->stmt, queryIndex++);
+		result.sNote           = (const gchar *)sqlite3_column_text(pCursor->stmt, queryIndex++);
+		result.dateTime        = (const gchar *)sqlite3_column_text(pCursor->stmt, queryIndex++);
+		result.sweepStart      = sqlite3_column_double(pCursor->stmt, queryIndex++);
+		result.sweepStop       = sqlite3_column_double(pCursor->stmt, queryIndex++);
+		result.IFbandwidth     = sqlite3_column_double(pCursor->stmt, queryIndex++);
+		result.nPoints         = sqlite3_column_int(pCursor->stmt, queryIndex++);
+		result.measurementType = sqlite3_column_int(pCursor->stmt, queryIndex++);
+		result.format          = sqlite3_column_int(pCursor->stmt, queryIndex++);
+		result.calType         = sqlite3_column_int(pCursor->stmt, queryIndex++);
+
+		nResults++;
+		if( !callback( &result, pUserData ) ) {
+			pCursor->bDone = TRUE;
+			break;
+		}
 	}
-	queryIndex = 0;
-	if (sqlite3_bind_int(stmt, ++queryIndex, CURRENT_DB_SCHEMA) != SQLITE_OK)		// always 0 for now
-		goto err;
+	return nResults;
+}
 
-	memcpy( &options.components.flagsL, &pGlobal->flags, sizeof( guint32 ));
-	options.components.PDFpaperSize = (guchar)pGlobal->PDFpaperSize;    // top 8 bits of a 64 bit word
-	if (sqlite3_bind_int(stmt, ++queryIndex, options.all) != SQLITE_OK)
-		goto err;
-	// No longer using sGPIBcontrollerName
-	++queryIndex;
-	if( pGlobal->sGPIBdeviceName ) {
-		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sGPIBdeviceName, strlen(pGlobal->sGPIBdeviceName), SQLITE_STATIC) != SQLITE_OK)
-			goto err;
-	} else {
-		++queryIndex;
+/*!     \brief  Finish with a search
+ *
+ * \ingroup database
+ *
+ * \param pCursor      search cursor from openSearchCursor()
+ */
+void
+closeSearchCursor( tSearchCursor *pCursor ) {
+	if( pCursor == NULL )
+		return;
+	sqlite3_finalize( pCursor->stmt );
+	g_free( pCursor );
+}
+
+/*!     \brief  Delete the identified profile
+ *
+ * Remove either a setup/calibration profile or a trace profile
+ * (with its archived sweeps)
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param sProject     name of profile
+ * \param sName        name of profile
+ * \param bCalibration true if the array to delete is setup/calibration, false for trace
+ * \return 			   completion status
+ */
+guint
+deleteDBentry(tGlobal *pGlobal, gchar *sProject, gchar *sName, tDBtable whichTable) {
+	sqlite3_stmt *stmt = NULL;
+	gchar *sSQL = NULL;
+	GList *listElement = NULL;
+	tProjectAndName projectAndName = {sProject, sName};
+
+	switch( whichTable ) {
+	case eDB_CALandSETUP:
+		sSQL = "DELETE FROM HP8753C_CALIBRATION WHERE project IS (?) AND name = (?);";
+		break;
+	case eDB_TRACE:
+		sSQL = "DELETE FROM HP8753C_TRACEDATA WHERE project IS (?) AND name = (?);";
+		invalidateTraceCache( sProject, sName );
+		break;
+	case eDB_CALKIT:
+		sSQL = "DELETE FROM CAL_KITS WHERE label = (?);";
+		// Calkits are not associated with projects
+		break;
+	default:
+		return 0;
+		break;
 	}
-	if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->GPIBcontrollerIndex) != SQLITE_OK)
-		goto err;
-	if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->GPIBdevicePID) != SQLITE_OK)
+
+	if (sqlite3_prepare_v2(db, sSQL, -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		goto err;
-	if( pGlobal->printSettings ) {
-		GVariant *vPrintSettings = gtk_print_settings_to_gvariant( pGlobal->printSettings );
-		byPrintSettings = g_variant_get_data_as_bytes( vPrintSettings );
-		g_variant_unref( vPrintSettings );
-		gsize size;
-		gconstpointer pPrintSettingsBytes= g_bytes_get_data( byPrintSettings, &size );
-		if (sqlite3_bind_blob(stmt, ++queryIndex, pPrintSettingsBytes, size,
-				SQLITE_STATIC) != SQLITE_OK)
-			goto err;
-	} else {
-		++queryIndex;
 	}
-	if( pGlobal->pageSetup ) {
-		GVariant *vPage = gtk_page_setup_to_gvariant( pGlobal->pageSetup );
-		byPage = g_variant_get_data_as_bytes( vPage );
-		g_variant_unref( vPage );
-		gsize size;
-		gconstpointer pPageBytes= g_bytes_get_data( byPage, &size );
-		if (sqlite3_bind_blob(stmt, ++queryIndex, pPageBytes, size,
+	if( whichTable == eDB_CALKIT ) {
+		if (sqlite3_bind_text(stmt, 1, sName, STRLENGTH,
 				SQLITE_STATIC) != SQLITE_OK)
 			goto err;
 	} else {
-		++queryIndex;
-	}
-	if( pGlobal->sLastDirectory ) {
-		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sLastDirectory, strlen( pGlobal->sLastDirectory ), SQLITE_STATIC) != SQLITE_OK)
+		// bind project
+		if( sProject == NULL )
+			sqlite3_bind_null(stmt, 1);
+		else
+			sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC);
+		if( sqlite3_errcode( db ) != SQLITE_OK)
 			goto err;
-	} else {
-		++queryIndex;
-	}
-	// saveing the selected calibration and trace profles are deprecated. They are now determied by the selected project
-    if (sqlite3_bind_null(stmt, ++queryIndex) ) {
-        goto err;
-    }
-    if (sqlite3_bind_null(stmt, ++queryIndex) ) {
-        goto err;
-    }
-
-	if( pGlobal->sProject ) {
-		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sProject, strlen( pGlobal->sProject ), SQLITE_STATIC) != SQLITE_OK)
+		// bind name
+		if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
 			goto err;
-	} else {
-		++queryIndex;
+		}
 	}
 
-	// plot colors
-    if (sqlite3_bind_blob(stmt, ++queryIndex, &plotElementColors,
-                            sizeof( plotElementColors ), SQLITE_STATIC) != SQLITE_OK)
-        goto err;
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
 
-    // HPGL plot colors
-    if (sqlite3_bind_blob(stmt, ++queryIndex, &HPGLpens,
-                            sizeof( HPGLpens ), SQLITE_STATIC) != SQLITE_OK) {
-        goto err;
-    }
+	sqlite3_finalize(stmt);
+	stmt = NULL;
 
-	if( pGlobal->HP8753.analyzedLSindexes.version != 0 ) {
-		if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753.analyzedLSindexes,
-								sizeof( tLearnStringIndexes ), SQLITE_STATIC) != SQLITE_OK) {
+	// ... and the archived sweeps of a trace profile
+	if( whichTable == eDB_TRACE ) {
+		if (sqlite3_prepare_v2(db,
+				"DELETE FROM HP8753C_TRACE_ARCHIVE WHERE project IS (?) AND name = (?);",
+				-1, &stmt, NULL) != SQLITE_OK)
 			goto err;
-		}
-	} else {
-		++queryIndex;
-	}
-	if( pGlobal->HP8753.sProduct ) {
-		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753.sProduct, strlen( pGlobal->HP8753.sProduct ), SQLITE_STATIC) != SQLITE_OK)
+		if( sProject == NULL )
+			sqlite3_bind_null(stmt, 1);
+		else
+			sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC);
+		if( sqlite3_errcode( db ) != SQLITE_OK)
 			goto err;
-	} else {
-		++queryIndex;
+		if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+			goto err;
+		sqlite3_finalize(stmt);
+		if( pruneArchiveAxes() != OK )
+			return ERROR;
 	}
 
-	if (sqlite3_step(stmt) != SQLITE_DONE)
-		goto err;
+	// Must do this after the preparation of the SQL command because otherwise the name will be freed
+	// and the prep statement will fail
+    switch( whichTable ) {
+    case eDB_CALandSETUP:
+        listElement = g_list_find_custom( pGlobal->pCalList, &projectAndName, (GCompareFunc)compareCalItemsForFind );
+        if( listElement ) {
+            freeCalListItem(  listElement->data );
+            pGlobal->pCalList = g_list_remove( pGlobal->pCalList, listElement->data );
+        }
+        break;
+    case eDB_TRACE:
+        listElement = g_list_find_custom( pGlobal->pTraceList, &projectAndName, (GCompareFunc)compareTraceItemsForFind );
+        if( listElement ) {
+            freeTraceListItem( listElement->data );
+            pGlobal->pTraceList = g_list_remove( pGlobal->pTraceList, listElement->data );
+        }
+        break;
+    case eDB_CALKIT:
+        listElement = g_list_find_custom( pGlobal->pCalKitList, sName, (GCompareFunc)compareCalKitIdentifierItem );
+        if( listElement ) {
+            freeCalKitIdentifierItem(  listElement->data );
+            pGlobal->pCalKitList = g_list_remove( pGlobal->pCalKitList, listElement->data );
+        }
+        // Calkits are not associated with projects
+        break;
+    default:
+        break;
+    }
+
+	return 0;
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 	sqlite3_finalize(stmt);
+	return ERROR;
+}
 
-	g_bytes_unref( byPrintSettings );
-	g_bytes_unref( byPage );
+/*!     \brief  Save the identified setup/calibration profile
+ *
+ * Save the identified setup/calibration profile
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param sName        name of profile
+ * \return 			   completion status
+ */
+gint
+saveCalibrationAndSetup(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
 
-	// first clear all selections of trace and calibration profiles from the tables
-	if ( sqlite3_exec(db,
-			"UPDATE HP8753C_CALIBRATION SET selected=0;"
-			"UPDATE HP8753C_TRACEDATA SET selected=0;"
-			, NULL, 0, &zErrMsg) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, zErrMsg);
-		sqlite3_free(zErrMsg);
+	sqlite3_stmt *stmt = NULL;
+	guint perChannelCalSettings, calSettings;
+	gint  queryIndex;
+
+	if (sqlite3_prepare_v2(db,
+			"INSERT OR REPLACE INTO HP8753C_CALIBRATION "
+			" (project, name,  channel, learn, sweepStart, sweepStop,"
+			"  IFbandwidth, CWfrequency, sweepType, npoints, calType,"
+			"  cal01, cal02, cal03, cal04, cal05, "
+			"  cal06, cal07, cal08, cal09, cal10, "
+			"  cal11, cal12, notes, perChannelCalSettings, calSettings, calKit)"
+			"  VALUES (?,?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?, ?)", -1, &stmt,
+			NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		return ERROR;
 	}
-	// set the selected calibration and trace profiles for each project
-	for( GList *l = pGlobal->pCalList; l != NULL; l = l->next ){
-		tProjectAndName *pProjectAndName = &(((tHP8753cal *)l->data)->projectAndName);
-		if( pProjectAndName->bSelected ) {
-			if (sqlite3_prepare_v2(db,
-					"UPDATE HP8753C_CALIBRATION SET selected=1"
-					" WHERE project IS (?) AND name=(?);", -1, &stmt, NULL) != SQLITE_OK) {
-				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-				return ERROR;
-			}
-			queryIndex = 0;
-			// bind project
-			if( pProjectAndName->sProject == NULL )
-				sqlite3_bind_null(stmt, ++queryIndex);
-			else
-				sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sProject, STRLENGTH, SQLITE_STATIC);
-			sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sName, STRLENGTH, SQLITE_STATIC);
 
-			if (sqlite3_step(stmt) != SQLITE_DONE)
-				goto err;
-			sqlite3_finalize(stmt);
-		}
-	}
-	for( GList *l = pGlobal->pTraceList; l != NULL; l = l->next ){
-		tProjectAndName *pProjectAndName = &((tHP8753traceAbstract *)(l->data))->projectAndName;
-		if( pProjectAndName->bSelected ) {
-			if (sqlite3_prepare_v2(db,
-					"UPDATE HP8753C_TRACEDATA SET selected=1"
-					" WHERE project IS (?) AND name=(?);", -1, &stmt, NULL) != SQLITE_OK) {
-				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-				return ERROR;
-			}
-			queryIndex = 0;
-			// bind project
-			if( pProjectAndName->sProject == NULL )
-				sqlite3_bind_null(stmt, ++queryIndex);
-			else
-				sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sProject, STRLENGTH, SQLITE_STATIC);
-			sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sName, STRLENGTH, SQLITE_STATIC);
-			if (sqlite3_step(stmt) != SQLITE_DONE)
-				goto err;
-			sqlite3_finalize(stmt);
-		}
+	// project and name
+
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+		queryIndex = 0;
+
+		// bind project
+		if( sProject == NULL ) {
+			if (sqlite3_bind_null(stmt, ++queryIndex) != SQLITE_OK) {
+				goto err;
+			}
+		} else {
+			if (sqlite3_bind_text(stmt, ++queryIndex, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
+				goto err;
+			}
+		}
+		// bind name
+		if (sqlite3_bind_text(stmt, ++queryIndex, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
+			goto err;
+		}
+		// channel
+		if (sqlite3_bind_int(stmt, ++queryIndex, channel) != SQLITE_OK)
+			goto err;
+		//learn
+		if( channel == eCH_ONE ) {
+			if (sqlite3_bind_blob(stmt, ++queryIndex, pGlobal->HP8753cal.pHP8753_learn,
+					lengthFORM1data( pGlobal->HP8753cal.pHP8753_learn ), SQLITE_STATIC) != SQLITE_OK)
+				goto err;
+		} else {
+			++queryIndex;
+		}
+		// sweepStart
+		if (sqlite3_bind_double(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].sweepStart) != SQLITE_OK)
+			goto err;
+		// sweepStop
+		if (sqlite3_bind_double(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].sweepStop) != SQLITE_OK)
+			goto err;
+
+		// IFbandwidth
+		if (sqlite3_bind_double(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].IFbandwidth) != SQLITE_OK)
+			goto err;
+		// CWfrequency
+		if (sqlite3_bind_double(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].CWfrequency) != SQLITE_OK)
+			goto err;
+		// sweepType
+		if (sqlite3_bind_int(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].sweepType) != SQLITE_OK)
+			goto err;
+		// npoints
+		if (sqlite3_bind_int(stmt, ++queryIndex,
+				pGlobal->HP8753cal.perChannelCal[channel].nPoints) != SQLITE_OK)
+			goto err;
+		// calType
+		if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->HP8753cal.perChannelCal[channel].iCalType) != SQLITE_OK)
+			goto err;
+		// cal01 to cal12
+		for (int i = 0; i < MAX_CAL_ARRAYS; i++) {
+			gint length = 0;
+			if( i < numOfCalArrays[pGlobal->HP8753cal.perChannelCal[channel].iCalType] &&
+					pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] != NULL )
+				length = lengthFORM1data( pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] );
+			if (sqlite3_bind_blob(stmt, ++queryIndex, pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i], length,
+					SQLITE_STATIC) != SQLITE_OK)
+				goto err;
+		}
+		// notes
+		if( channel == eCH_ONE ) {
+			if (pGlobal->HP8753cal.sNote)
+				if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753cal.sNote, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+					goto err;
+		} else {
+			++queryIndex;
+		}
+
+		memcpy(&perChannelCalSettings, &pGlobal->HP8753cal.perChannelCal[channel].settings, sizeof(gushort));
+		memcpy(&calSettings, &pGlobal->HP8753cal.settings, sizeof(gushort));
+		// perChannelCalSettings
+		if (sqlite3_bind_int(stmt, ++queryIndex, perChannelCalSettings) != SQLITE_OK)
+			goto err;
+		// calSettings
+		if( channel == eCH_ONE ) {
+			if (sqlite3_bind_int(stmt, ++queryIndex, calSettings) != SQLITE_OK)
+						goto err;
+		} else {
+			++queryIndex;
+		}
+		// calKit (the calibration kit last sent to the HP8753)
+		if( channel == eCH_ONE && pGlobal->sCalKit ) {
+			if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sCalKit, STRLENGTH, SQLITE_STATIC) != SQLITE_OK)
+				goto err;
+		} else {
+			++queryIndex;
+		}
+
+		if (sqlite3_step(stmt) != SQLITE_DONE)
+			goto err;
+
+		sqlite3_reset( stmt );
+		sqlite3_clear_bindings( stmt );
+	}
+	sqlite3_finalize(stmt);
+
+	tProjectAndName projectAndName = { sProject, sName, FALSE };
+	GList *calPreviewElement = g_list_find_custom( pGlobal->pCalList, &projectAndName, (GCompareFunc)compareCalItemsForFind );
+	if( calPreviewElement ) {
+		freeCalListItem( calPreviewElement->data );
+		pGlobal->pCalList = g_list_remove( pGlobal->pCalList, calPreviewElement->data );
+	}
+	// Mark all other Calibration profiles as unselected
+    for( GList *l = pGlobal->pCalList; l != NULL; l = l->next ){
+            tProjectAndName *pProjectAndName = &(((tHP8753cal *)l->data)->projectAndName);
+            pProjectAndName->bSelected = FALSE;
+    }
+
+	tHP8753cal *pCal = g_new0(tHP8753cal, 1);
+
+	pCal->projectAndName.sProject = g_strdup( sProject );
+	pCal->projectAndName.sName = g_strdup( sName );
+	pCal->projectAndName.bSelected = TRUE;
+	pCal->sNote = g_strdup( pGlobal->HP8753cal.sNote );
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+		pCal->perChannelCal[ channel ].sweepStart = pGlobal->HP8753cal.perChannelCal[ channel ].sweepStart;
+		pCal->perChannelCal[ channel ].sweepStop = pGlobal->HP8753cal.perChannelCal[ channel ].sweepStop;
+		pCal->perChannelCal[ channel ].IFbandwidth = pGlobal->HP8753cal.perChannelCal[ channel ].IFbandwidth;
+		pCal->perChannelCal[ channel ].CWfrequency = pGlobal->HP8753cal.perChannelCal[ channel ].CWfrequency;
+		pCal->perChannelCal[ channel ].sweepType = pGlobal->HP8753cal.perChannelCal[ channel ].sweepType;
+		pCal->perChannelCal[ channel ].nPoints = pGlobal->HP8753cal.perChannelCal[ channel ].nPoints;
+		memcpy( &pCal->perChannelCal[ channel ].settings, &pGlobal->HP8753cal.perChannelCal[ channel ].settings, sizeof( gushort ) );
+	}
+	memcpy( &pCal->settings, &pGlobal->HP8753cal.settings, sizeof( gushort ) );
+
+	pGlobal->pCalList = g_list_insert_sorted( pGlobal->pCalList, pCal, (GCompareFunc)compareCalItemsForSort );
+	pGlobal->pCalibrationAbstract = pCal;
+	return 0;
+
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Recover identified setup/calibration profile
+ *
+ * Recover the identified setup/calibration profile
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param sName        name of profile
+ * \return 			   completion status
+ */
+gint
+recoverCalibrationAndSetup(tGlobal *pGlobal, gchar *sProject, gchar *sName) {
+	sqlite3_stmt *stmt = NULL;
+	gint length;
+	eChannel channel = eCH_SINGLE;
+	const guchar *tBlob;
+	const gchar *tText;
+	gint queryIndex;
+	gint calRetrieved = FALSE;
+	gushort perChannelCalSettings, calSettings;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT "
+			"  channel, learn, sweepStart, sweepStop, IFbandwidth,"
+			"  CWfrequency, sweepType, npoints, calType, cal01,"
+			"  cal02, cal03, cal04, cal05, cal06, "
+			"  cal07, cal08, cal09, cal10, cal11, "
+			"  cal12, notes, perChannelCalSettings, calSettings "
+			"  FROM HP8753C_CALIBRATION"
+			" WHERE project IS (?) AND name = (?);", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+
+	// bind project
+	if( sProject == NULL )
+		sqlite3_bind_null(stmt, 1);
+	else
+		sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC);
+	if( sqlite3_errcode( db ) != SQLITE_OK) {
+		calRetrieved = ERROR;
+		goto err;
+	}
+	// bind name
+	if (sqlite3_bind_text(stmt, 2, sName, STRLENGTH, SQLITE_STATIC) != SQLITE_OK) {
+		calRetrieved = ERROR;
+		goto err;
+	}
+
+	// Line for ch 1 and ch 2
+	// learn, title, notes, flags and options are only taken from ch 1
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		calRetrieved = TRUE;
+		queryIndex = 0;
+
+		// Channel
+		channel = sqlite3_column_int(stmt, queryIndex++);
+
+		// Learn string
+		length  = sqlite3_column_bytes(stmt, queryIndex);
+		tBlob   = sqlite3_column_blob(stmt, queryIndex++);
+		if( channel == eCH_ONE ) {
+			g_free(pGlobal->HP8753cal.pHP8753_learn);
+			pGlobal->HP8753cal.pHP8753_learn = g_memdup2(tBlob, (gsize) length);
+		}
+
+		pGlobal->HP8753cal.perChannelCal[channel].sweepStart   = sqlite3_column_double(stmt, queryIndex++);
+		pGlobal->HP8753cal.perChannelCal[channel].sweepStop    = sqlite3_column_double(stmt, queryIndex++);
+		pGlobal->HP8753cal.perChannelCal[channel].IFbandwidth  = sqlite3_column_double(stmt, queryIndex++);
+		pGlobal->HP8753cal.perChannelCal[channel].CWfrequency  = sqlite3_column_double(stmt, queryIndex++);
+		pGlobal->HP8753cal.perChannelCal[channel].sweepType    = sqlite3_column_int(stmt,    queryIndex++);
+		pGlobal->HP8753cal.perChannelCal[channel].nPoints      = sqlite3_column_int(stmt,    queryIndex++);
+
+		// calType
+		pGlobal->HP8753cal.perChannelCal[channel].iCalType = sqlite3_column_int(stmt, queryIndex++);
+
+		// calArrays
+		for (int i = 0; i < MAX_CAL_ARRAYS; i++) {
+			length = sqlite3_column_bytes(stmt, queryIndex);
+			g_free(pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i]);
+			tBlob = sqlite3_column_blob(stmt, queryIndex++);
+			if (length > 0) {
+				pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] = g_memdup2(tBlob, (gsize) length);
+				// We infer size from cal string .. its only used for informational purposes
+				if( i==0 && length > 4 ) {
+					pGlobal->HP8753cal.perChannelCal[channel].nPoints = GUINT16_FROM_BE( (guint16 *)&tBlob[2] ) / BYTES_PER_CALPOINT;
+				}
+			} else {
+				pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] = NULL;
+			}
+		}
+
+		tText = (const gchar *)sqlite3_column_text(stmt, queryIndex++);
+		if( channel == eCH_ONE ) {
+			g_free(pGlobal->HP8753cal.sNote);
+			pGlobal->HP8753cal.sNote = g_strdup(tText);
+		}
+
+		perChannelCalSettings = sqlite3_column_int(stmt, queryIndex++);
+		memcpy( &pGlobal->HP8753cal.perChannelCal[ channel ].settings, &perChannelCalSettings, sizeof( gushort ) );
+
+		if( channel == eCH_ONE ) {
+			calSettings = sqlite3_column_int(stmt, queryIndex++);
+			memcpy( &pGlobal->HP8753cal.settings, &calSettings, sizeof( gushort ) );
+		} else {
+			queryIndex++;
+		}
+	}
+err:
+	sqlite3_finalize(stmt);
+	return calRetrieved;
+}
+
+/*!     \brief  Save the program options
+ *
+ * Save the program options (on shutdown)
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \return 			   completion status
+ */
+gint
+saveProgramOptions(tGlobal *pGlobal) {
+
+	sqlite3_stmt *stmt = NULL;
+	gchar *zErrMsg = 0;
+	union uOptions {
+        struct stOptions {
+            guint16 flagsL;
+            guint8  flagsU;
+            guint8  PDFpaperSize;
+        }  __attribute__((packed)) components;
+        guint all;
+	} options;
+	GBytes *byPage = NULL;
+	GBytes *byPrintSettings = NULL;
+	gint queryIndex;
+
+	if (sqlite3_prepare_v2(db,
+			"INSERT OR REPLACE INTO OPTIONS"
+			" (ID, flags, GPIBcontrollerName, GPIBdeviceName, GPIBcontrollerCard, "
+			"  GPIBdevicePID, GtkPrintSettings, GtkPageSetup, lastDirectory, calProfile, "
+			"  traceProfile, project, colors, colorsHPGL, learnStringIndexes, product"
+			" )"
+			" VALUES (?,?,?,?,?, ?,?,?,?,?, ?,?,?,?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+	queryIndex = 0;
+	if (sqlite3_bind_int(stmt, ++queryIndex, CURRENT_DB_SCHEMA) != SQLITE_OK)		// always 0 for now
+		goto err;
+
+	memcpy( &options.components.flagsL, &pGlobal->flags, sizeof( guint32 ));
+	options.components.PDFpaperSize = (guchar)pGlobal->PDFpaperSize;    // top 8 bits of a 64 bit word
+	if (sqlite3_bind_int(stmt, ++queryIndex, options.all) != SQLITE_OK)
+		goto err;
+	// No longer using sGPIBcontrollerName
+	++queryIndex;
+	if( pGlobal->sGPIBdeviceName ) {
+		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sGPIBdeviceName, strlen(pGlobal->sGPIBdeviceName), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+	if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->GPIBcontrollerIndex) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_int(stmt, ++queryIndex, pGlobal->GPIBdevicePID) != SQLITE_OK)
+		goto err;
+	if( pGlobal->printSettings ) {
+		GVariant *vPrintSettings = gtk_print_settings_to_gvariant( pGlobal->printSettings );
+		byPrintSettings = g_variant_get_data_as_bytes( vPrintSettings );
+		g_variant_unref( vPrintSettings );
+		gsize size;
+		gconstpointer pPrintSettingsBytes= g_bytes_get_data( byPrintSettings, &size );
+		if (sqlite3_bind_blob(stmt, ++queryIndex, pPrintSettingsBytes, size,
+				SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+	if( pGlobal->pageSetup ) {
+		GVariant *vPage = gtk_page_setup_to_gvariant( pGlobal->pageSetup );
+		byPage = g_variant_get_data_as_bytes( vPage );
+		g_variant_unref( vPage );
+		gsize size;
+		gconstpointer pPageBytes= g_bytes_get_data( byPage, &size );
+		if (sqlite3_bind_blob(stmt, ++queryIndex, pPageBytes, size,
+				SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+	if( pGlobal->sLastDirectory ) {
+		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sLastDirectory, strlen( pGlobal->sLastDirectory ), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+	// saveing the selected calibration and trace profles are deprecated. They are now determied by the selected project
+    if (sqlite3_bind_null(stmt, ++queryIndex) ) {
+        goto err;
+    }
+    if (sqlite3_bind_null(stmt, ++queryIndex) ) {
+        goto err;
+    }
+
+	if( pGlobal->sProject ) {
+		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->sProject, strlen( pGlobal->sProject ), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+
+	// plot colors
+    if (sqlite3_bind_blob(stmt, ++queryIndex, &plotElementColors,
+                            sizeof( plotElementColors ), SQLITE_STATIC) != SQLITE_OK)
+        goto err;
+
+    // HPGL plot colors
+    if (sqlite3_bind_blob(stmt, ++queryIndex, &HPGLpens,
+                            sizeof( HPGLpens ), SQLITE_STATIC) != SQLITE_OK) {
+        goto err;
+    }
+
+	if( pGlobal->HP8753.analyzedLSindexes.version != 0 ) {
+		if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753.analyzedLSindexes,
+								sizeof( tLearnStringIndexes ), SQLITE_STATIC) != SQLITE_OK) {
+			goto err;
+		}
+	} else {
+		++queryIndex;
+	}
+	if( pGlobal->HP8753.sProduct ) {
+		if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753.sProduct, strlen( pGlobal->HP8753.sProduct ), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	} else {
+		++queryIndex;
+	}
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+	sqlite3_finalize(stmt);
+
+	g_bytes_unref( byPrintSettings );
+	g_bytes_unref( byPage );
+
+	// first clear all selections of trace and calibration profiles from the tables
+	if ( sqlite3_exec(db,
+			"UPDATE HP8753C_CALIBRATION SET selected=0;"
+			"UPDATE HP8753C_TRACEDATA SET selected=0;"
+			, NULL, 0, &zErrMsg) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, zErrMsg);
+		sqlite3_free(zErrMsg);
+		return ERROR;
+	}
+	// set the selected calibration and trace profiles for each project
+	for( GList *l = pGlobal->pCalList; l != NULL; l = l->next ){
+		tProjectAndName *pProjectAndName = &(((tHP8753cal *)l->data)->projectAndName);
+		if( pProjectAndName->bSelected ) {
+			if (sqlite3_prepare_v2(db,
+					"UPDATE HP8753C_CALIBRATION SET selected=1"
+					" WHERE project IS (?) AND name=(?);", -1, &stmt, NULL) != SQLITE_OK) {
+				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+				return ERROR;
+			}
+			queryIndex = 0;
+			// bind project
+			if( pProjectAndName->sProject == NULL )
+				sqlite3_bind_null(stmt, ++queryIndex);
+			else
+				sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sProject, STRLENGTH, SQLITE_STATIC);
+			sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sName, STRLENGTH, SQLITE_STATIC);
+
+			if (sqlite3_step(stmt) != SQLITE_DONE)
+				goto err;
+			sqlite3_finalize(stmt);
+		}
+	}
+	for( GList *l = pGlobal->pTraceList; l != NULL; l = l->next ){
+		tProjectAndName *pProjectAndName = &((tHP8753traceAbstract *)(l->data))->projectAndName;
+		if( pProjectAndName->bSelected ) {
+			if (sqlite3_prepare_v2(db,
+					"UPDATE HP8753C_TRACEDATA SET selected=1"
+					" WHERE project IS (?) AND name=(?);", -1, &stmt, NULL) != SQLITE_OK) {
+				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+				return ERROR;
+			}
+			queryIndex = 0;
+			// bind project
+			if( pProjectAndName->sProject == NULL )
+				sqlite3_bind_null(stmt, ++queryIndex);
+			else
+				sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sProject, STRLENGTH, SQLITE_STATIC);
+			sqlite3_bind_text(stmt, ++queryIndex, pProjectAndName->sName, STRLENGTH, SQLITE_STATIC);
+			if (sqlite3_step(stmt) != SQLITE_DONE)
+				goto err;
+			sqlite3_finalize(stmt);
+		}
+	}
+
+	return OK;
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+
+	return ERROR;
+}
+
+/*!     \brief  Save the learn string analysis
+ *
+ * After an analysis is done, we save it to the database
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param pLSanalysis  pointer to the tLearnStringIndexes structure
+ * \return 			   completion status
+ */
+gint
+saveLearnStringAnalysis( tGlobal *pGlobal, tLearnStringIndexes *pLSanalysis ) {
+	sqlite3_stmt *stmt = NULL;
+
+	if (sqlite3_prepare_v2(db,
+			"UPDATE OPTIONS"
+			" SET learnStringIndexes = ?;",
+			-1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+
+	if (sqlite3_bind_blob(stmt, 1, &pGlobal->HP8753.analyzedLSindexes,
+							sizeof( tLearnStringIndexes ), SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+	sqlite3_finalize(stmt);
+	return OK;
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Recover the option settings
+ *
+ * Recover the option settings upon startup
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \return 			   completion status (ERROR, TRUE of options recovered or FALSE if no options recovered)
+ */
+gint
+recoverProgramOptions(tGlobal *pGlobal) {
+	sqlite3_stmt *stmt = NULL;
+	gint length, size;
+	const guchar *tBlob;
+	gint queryIndex;
+	gint schemaVersion = 0;
+	gint64 nColumns;
+	gboolean bOptionsRecovered  = FALSE;
+    union uOptions {
+        struct stOptions {
+            guint16 flagsL;
+            guint8  flagsU;
+            guint8  PDFpaperSize;
+        }  __attribute__((packed)) components;
+        guint all;
+    } options;
+
+	// First update database schema if needed
+	// Find out the current schema ID
+	if (sqlite3_prepare_v2(db,
+			"SELECT ID FROM OPTIONS;", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	} else {
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			// check the database version and update if necessary
+			schemaVersion = sqlite3_column_int(stmt, 0);
+		}
+		sqlite3_finalize(stmt);
+
+		// *************** Alert!
+		// if the stored database is older than the current schema ... update
+		// ***************
+		while( schemaVersion < CURRENT_DB_SCHEMA ) {
+			switch( schemaVersion ) {
+			case 0: // going from version 0 to 1
+				if (sqlite3_exec(db,
+						"ALTER TABLE HP8753C_CALIBRATION RENAME TO OLD_HP8753C_CALIBRATION;"
+						"ALTER TABLE HP8753C_TRACEDATA RENAME TO OLD_HP8753C_TRACEDATA;",
+						NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				if (sqlite3_exec(db, sqlCreateTables[0], NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				if (sqlite3_exec(db,
+						"INSERT INTO HP8753C_CALIBRATION ( "
+						"    project, name, channel, learn, sweepStart, sweepStop, IFbandwidth, CWfrequency, "
+						"    sweepType, npoints, calType, "
+						"    cal01, cal02, cal03,cal04, cal05, cal06, cal07, cal08, cal09, cal10, cal11, cal12,"
+						"    notes, perChannelCalSettings, calSettings )"
+						"  SELECT '🚧 default', name, channel, learn, sweepStart, sweepStop, IFbandwidth, CWfrequency,"
+						"    sweepType, npoints, calType, "
+						"    cal01, cal02, cal03,cal04, cal05, cal06, cal07, cal08, cal09, cal10, cal11, cal12,"
+						"    notes, perChannelCalSettings, calSettings "
+						"    FROM OLD_HP8753C_CALIBRATION; "
+						" DROP TABLE OLD_HP8753C_CALIBRATION;"
+						, NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				if (sqlite3_exec(db,sqlCreateTables[1], NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				if (sqlite3_exec(db,
+						"INSERT INTO HP8753C_TRACEDATA ( "
+						"   project, name, channel, sweepStart, sweepStop, IFbandwidth, "
+						"   CWfrequency, sweepType, npoints, points, stimulusPoints,"
+						"   format, scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort,"
+						"   markers, activeMkr, deltaMkr, mkrType, bandwidth, nSegments,"
+						"   segments, title, notes, perChannelFlags, generalFlags, time )"
+						" SELECT '🚧 default', name, channel, sweepStart, sweepStop, IFbandwidth, "
+						" CWfrequency, sweepType, npoints, points, stimulusPoints,"
+						" format, scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort,"
+						" markers, activeMkr, deltaMkr, mkrType, bandwidth, nSegments,"
+						" segments, title, notes, perChannelFlags, generalFlags, time "
+						"    FROM OLD_HP8753C_TRACEDATA; "
+						" DROP TABLE OLD_HP8753C_TRACEDATA;"
+						"PRAGMA auto_vacuum = INCREMENTAL;VACUUM;"
+						, NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				// the search triggers were dropped with the old tables (and the rowids have changed)
+				if( createSearchIndex() != OK || rebuildSearchIndex() != OK )
+					return ERROR;
+				if (sqlite3_exec(db,
+						"ALTER TABLE Options ADD COLUMN project TEXT DEFAULT '🚧 default';"
+						, NULL, NULL, NULL) != SQLITE_OK) {
+					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+					return ERROR;
+				}
+				schemaVersion++;
+				break;
+			case 1: // from version 1 to version 2 (when we get there)
+                if (sqlite3_exec(db,
+                        "ALTER TABLE Options ADD COLUMN colors BLOB; ALTER TABLE Options ADD COLUMN colorsHPGL BLOB;"
+                        , NULL, NULL, NULL) != SQLITE_OK) {
+                    postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+                    return ERROR;
+                }
+			    break;
+			case 2: // from version 2 to version 3 (full text search over the existing profiles)
+			    if( createSearchIndex() != OK || rebuildSearchIndex() != OK )
+			        return ERROR;
+			    break;
+			case 3: // from version 3 to version 4 (unformatted trace data)
+			    // (the trace table already has the column if it was recreated going from version 0)
+			    if( queryInteger( db, "SELECT COUNT(*) FROM pragma_table_info('HP8753C_TRACEDATA')"
+			            " WHERE name = 'complexPoints';", &nColumns ) == OK && nColumns > 0 )
+			        break;
+			    if (sqlite3_exec(db,
+			            "ALTER TABLE HP8753C_TRACEDATA ADD COLUMN complexPoints BLOB;"
+			            , NULL, NULL, NULL) != SQLITE_OK) {
+			        postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+			        return ERROR;
+			    }
+			    break;
+			case 4: // from version 4 to version 5 (archived sweeps are unique)
+			    if (sqlite3_exec(db,
+			            "DROP INDEX IF EXISTS IDX_TRACE_ARCHIVE_TIME;"
+			            "DELETE FROM HP8753C_TRACE_ARCHIVE WHERE ID NOT IN"
+			            "  (SELECT MIN(ID) FROM HP8753C_TRACE_ARCHIVE GROUP BY project, name, channel, timestamp);"
+			            "CREATE UNIQUE INDEX IDX_TRACE_ARCHIVE_TIME"
+			            "  ON HP8753C_TRACE_ARCHIVE(project, name, channel, timestamp);"
+			            , NULL, NULL, NULL) != SQLITE_OK) {
+			        postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+			        return ERROR;
+			    }
+			    break;
+			case 5: // from version 5 to version 6 (the calibration kit used by a calibration)
+			    // (the calibration table already has the column if it was recreated going from version 0)
+			    if( queryInteger( db, "SELECT COUNT(*) FROM pragma_table_info('HP8753C_CALIBRATION')"
+			            " WHERE name = 'calKit';", &nColumns ) == OK && nColumns > 0 )
+			        break;
+			    if (sqlite3_exec(db,
+			            "ALTER TABLE HP8753C_CALIBRATION ADD COLUMN calKit TEXT;"
+			            , NULL, NULL, NULL) != SQLITE_OK) {
+			        postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+			        return ERROR;
+			    }
+			    break;
+			default:
+				postMessageToMainLoop(TM_ERROR, (gchar*) "Database schema version error");
+				return ERROR;
+			}
+
+			// Update the schema so that if we crash, the schema ID will reflect reality
+			gchar *sCmd = g_strdup_printf( "UPDATE OPTIONS SET ID = %d;", ++schemaVersion );
+			if (sqlite3_exec(db, sCmd, NULL, NULL, NULL) != SQLITE_OK) {
+				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+				g_free( sCmd );
+				return ERROR;
+			}
+			g_free( sCmd );
+		}
+	}
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT flags, GPIBcontrollerName, GPIBdeviceName, "
+			"  GPIBcontrollerCard, GPIBdevicePID, "
+			"  GtkPrintSettings, GtkPageSetup, lastDirectory, calProfile, traceProfile, project, colors, colorsHPGL, learnStringIndexes, product FROM OPTIONS;",
+			-1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	} else {
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			bOptionsRecovered = TRUE;
+			queryIndex = 0;
+			// check the database version and update if necessary
+
+			options.all = sqlite3_column_int(stmt, queryIndex++);
+			// don't overwrite this bit if it has been set with the command line switch
+			gint bNoGPIBtimeout = pGlobal->flags.bNoGPIBtimeout;
+			// the lower 24 bits are the option flags
+			memcpy(&pGlobal->flags, &options.components.flagsL, sizeof(gushort) + sizeof(guint8));
+			// The top byte is the PDF paper size
+			pGlobal->PDFpaperSize = options.components.PDFpaperSize;
+			GtkComboBox     *wComboPDFpaperSize = GTK_COMBO_BOX ( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_CB_PDFpaperSize" ) );
+			gtk_combo_box_set_active( wComboPDFpaperSize, pGlobal->PDFpaperSize );
+
+			pGlobal->flags.bRunning = TRUE;
+			pGlobal->flags.bNoGPIBtimeout = bNoGPIBtimeout;
+
+			setUseGPIBcardNoAndPID(pGlobal, pGlobal->flags.bGPIB_UseCardNoAndPID );
+			// No longer using sGPIBcontrollerName
+			queryIndex++;
+
+			g_free( pGlobal->sGPIBdeviceName );
+			pGlobal->sGPIBdeviceName = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+			gtk_entry_set_text( GTK_ENTRY(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Entry_GPIB_HP8753" )), pGlobal->sGPIBdeviceName);
+
+			pGlobal->GPIBcontrollerIndex = sqlite3_column_int(stmt, queryIndex++);
+			gtk_spin_button_set_value( GTK_SPIN_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Spin_GPIB_Controller_Card" )), pGlobal->GPIBcontrollerIndex);
+
+			pGlobal->GPIBdevicePID = sqlite3_column_int(stmt, queryIndex++);
+			gtk_spin_button_set_value( GTK_SPIN_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Spin_GPIB_HP8753_ID" )), pGlobal->GPIBdevicePID);
+
+
+			length = sqlite3_column_bytes(stmt, queryIndex);
+			if( length > 0 ) {
+				tBlob = sqlite3_column_blob(stmt, queryIndex++);
+				GBytes *byPrintSettings = g_bytes_new( tBlob, length );
+				GVariant *vPrintSettings =
+						g_variant_new_from_bytes ( G_VARIANT_TYPE_VARDICT, byPrintSettings, TRUE );
+				g_bytes_unref( byPrintSettings );
+				if( pGlobal->printSettings != NULL  )
+				g_object_unref (pGlobal->printSettings);
+				pGlobal->printSettings = gtk_print_settings_new_from_gvariant( vPrintSettings );
+			} else {
+				queryIndex++;
+			}
+			length = sqlite3_column_bytes(stmt, queryIndex);
+			if( length > 0 ) {
+				tBlob = sqlite3_column_blob(stmt, queryIndex++);
+				GBytes *byPageSetup = g_bytes_new( tBlob, length );
+				GVariant *vPageSetup =
+						g_variant_new_from_bytes ( G_VARIANT_TYPE_VARDICT, byPageSetup, TRUE );
+				g_bytes_unref( byPageSetup );
+				if( pGlobal->pageSetup != NULL )
+					g_object_unref (pGlobal->pageSetup);
+				pGlobal->pageSetup = gtk_page_setup_new_from_gvariant( vPageSetup );
+			} else {
+				queryIndex++;
+			}
+			pGlobal->sLastDirectory = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+
+			// deprecated ... recovery of the selected calibration and trace profiles are determined from the project.
+			queryIndex++;
+			queryIndex++;
+
+			pGlobal->sProject = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+
+			// plot colors
+            size = sqlite3_column_bytes(stmt, queryIndex);
+			tBlob = sqlite3_column_blob(stmt, queryIndex++);
+            if( size == sizeof( plotElementColors ))
+                 memcpy( &plotElementColors, tBlob, sizeof( plotElementColors ));
+			// HPGL plot colors
+            size = sqlite3_column_bytes(stmt, queryIndex);
+			tBlob = sqlite3_column_blob(stmt, queryIndex++);
+            if( size == sizeof( HPGLpens ))
+                 memcpy( &HPGLpens, tBlob, sizeof( HPGLpens ));
+
+			size = sqlite3_column_bytes(stmt, queryIndex);
+			tBlob = sqlite3_column_blob(stmt, queryIndex++);
+			if( size == sizeof( tLearnStringIndexes ))
+				 memcpy( &pGlobal->HP8753.analyzedLSindexes, tBlob, sizeof( tLearnStringIndexes ));
+
+			pGlobal->HP8753.sProduct = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+		}
+
+		sqlite3_finalize(stmt);
+	}
+
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_UseGPIB_ID" )), pGlobal->flags.bGPIB_UseCardNoAndPID);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_SmithSpline" )), pGlobal->flags.bSmithSpline);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_ShowDateTime" )), pGlobal->flags.bShowDateTime);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_SmithGBnotRX" )), pGlobal->flags.bAdmitanceSmith);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_DeltaMarkerAbsolute" )), !pGlobal->flags.bDeltaMarkerZero);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_UserCalKit" )), pGlobal->flags.bSaveUserKit);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_DoNotRetrieveHPGL" )), pGlobal->flags.bDoNotRetrieveHPGLdata);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_ShowHPlogo" )), pGlobal->flags.bHPlogo);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_CaptureComplex" )), pGlobal->flags.bCaptureComplexData);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_FORM1traces" )), pGlobal->flags.bFORM1traces);
+    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_ArchiveTraces" )), pGlobal->flags.bArchiveTraces);
+
+	return bOptionsRecovered ? TRUE : FALSE;;
+}
+
+
+/*!     \brief  Get the label & description of saved calibration kits
+ *
+ * Populate a list of available calibration kits
+ * including the description.
+ *
+ * \param  pGlobal      pointer to tGlobal structure (containing the pointer to list)
+ * \return 				completion status
+ */
+gint
+inventorySavedCalibrationKits(tGlobal *pGlobal) {
+
+	g_list_free_full ( g_steal_pointer (&pGlobal->pCalKitList), (GDestroyNotify)freeCalListItem );
+	pGlobal->pCalKitList = NULL;
+
+	tCalibrationKitIdentifier *pCal;
+	sqlite3_stmt *stmt = NULL;
+	gint queryIndex;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT a.label, a.description "
+			" FROM CAL_KITS a;", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	} else {
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			pCal = g_new0(tCalibrationKitIdentifier, 1);
+			queryIndex = 0;
+
+			// label
+			pCal->sLabel = g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+			// description
+			pCal->sDescription = g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+
+			pGlobal->pCalKitList = g_list_prepend(pGlobal->pCalKitList, pCal);
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	pGlobal->pCalKitList = g_list_sort (pGlobal->pCalKitList, (GCompareFunc)compareCalKitIdentifierItemForSort);
+	return OK;
+}
+
+/*!     \brief  Get the projects
+ *
+ * Populate a list of available projects
+ *
+ * \param  pGlobal      pointer to tGlobal structure (containing the pointer to list)
+ * \return 				completion status
+ */
+gint
+inventoryProjects(tGlobal *pGlobal) {
+
+	g_list_free_full ( g_steal_pointer (&pGlobal->pProjectList), (GDestroyNotify)g_free );
+	pGlobal->pProjectList = NULL;
+	sqlite3_stmt *stmt = NULL;
+	gint queryIndex;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT DISTINCT project FROM  HP8753C_TRACEDATA"
+			" UNION SELECT DISTINCT project FROM HP8753C_CALIBRATION;", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	} else {
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			queryIndex = 0;
+			pGlobal->pProjectList = g_list_prepend(pGlobal->pProjectList, g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) ));
+		}
+		sqlite3_finalize(stmt);
+	}
+
+	pGlobal->pProjectList = g_list_sort (pGlobal->pProjectList, (GCompareFunc)g_strcmp0);
+	return OK;
+}
+
+/*!     \brief  Save the calibration kit
+ *
+ * Save the program options (on shutdown)
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \return 			   completion status
+ */
+gint
+saveCalKit(tGlobal *pGlobal) {
+
+	sqlite3_stmt *stmt = NULL;
+	tCalibrationKitIdentifier *pCal;
+	gint queryIndex;
+
+	if (sqlite3_prepare_v2(db,
+			"INSERT OR REPLACE INTO CAL_KITS"
+			" (label, description, standards, classes)"
+			" VALUES (?,?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+	queryIndex = 0;
+	if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753calibrationKit.label,
+			strlen( pGlobal->HP8753calibrationKit.label ), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753calibrationKit.description,
+			strlen( pGlobal->HP8753calibrationKit.description ), SQLITE_STATIC) != SQLITE_OK)
+			goto err;
+	if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753calibrationKit.calibrationStandards,
+			sizeof( tHP8753calibrationStandard) * MAX_CAL_STANDARDS, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753calibrationKit.calibrationClasses,
+			sizeof( tHP8753calibrationClass) * MAX_CAL_CLASSES, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+	sqlite3_finalize(stmt);
+
+	GList *listElement = g_list_find_custom( pGlobal->pCalKitList,
+							pGlobal->HP8753calibrationKit.label, (GCompareFunc)compareCalKitIdentifierItem );
+	if( listElement ) {
+		g_free(  ((tCalibrationKitIdentifier *)listElement->data)->sDescription );
+		((tCalibrationKitIdentifier *)listElement->data)->sDescription = g_strdup( pGlobal->HP8753calibrationKit.description );
+	} else {
+		pCal = g_new0(tCalibrationKitIdentifier, 1);
+		// label
+		pCal->sLabel = g_strdup( pGlobal->HP8753calibrationKit.label );
+		// description
+		pCal->sDescription = g_strdup( pGlobal->HP8753calibrationKit.description );
+
+		pGlobal->pCalKitList = g_list_prepend(pGlobal->pCalKitList, pCal);
+		pGlobal->pCalKitList = g_list_sort (pGlobal->pCalKitList, (GCompareFunc)compareCalKitIdentifierItemForSort);
+	}
+	return OK;
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+
+	return ERROR;
+}
+
+/*!     \brief  Recover the calibration kit
+ *
+ * Recover the calibration kit
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param sLabel       calibration kit label
+ * \return 			   completion status
+ */
+gint
+recoverCalibrationKit(tGlobal *pGlobal, gchar *sLabel) {
+	sqlite3_stmt *stmt = NULL;
+	gint length;
+	const guchar *tBlob;
+	gint queryIndex;
+	gboolean bError = FALSE;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT label, description, standards, "
+			"  classes FROM CAL_KITS WHERE label = (?);",
+			-1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	} else {
+
+		sqlite3_bind_text(stmt, 1, sLabel, strlen(sLabel), SQLITE_STATIC);
+
+		while (sqlite3_step(stmt) == SQLITE_ROW) {
+			queryIndex = 0;
+
+			g_strlcpy( pGlobal->HP8753calibrationKit.label, (gchar *)sqlite3_column_text(stmt, queryIndex++), MAX_CALKIT_LABEL_SIZE );
+			g_strlcpy( pGlobal->HP8753calibrationKit.description, (gchar *)sqlite3_column_text(stmt, queryIndex++), MAX_CALKIT_LABEL_SIZE );
+
+			length = sqlite3_column_bytes(stmt, queryIndex);
+			if( !bError && length == sizeof( tHP8753calibrationStandard ) * MAX_CAL_STANDARDS ) {
+				tBlob = sqlite3_column_blob(stmt, queryIndex++);
+				memcpy( &pGlobal->HP8753calibrationKit.calibrationStandards, tBlob, sizeof( tHP8753calibrationStandard ) * MAX_CAL_STANDARDS  );
+			} else {
+				bError = TRUE;
+			}
+
+			length = sqlite3_column_bytes(stmt, queryIndex);
+			if( !bError && length == sizeof( tHP8753calibrationClass ) * MAX_CAL_CLASSES ) {
+				tBlob = sqlite3_column_blob(stmt, queryIndex++);
+				memcpy( &pGlobal->HP8753calibrationKit.calibrationClasses, tBlob, sizeof( tHP8753calibrationClass ) * MAX_CAL_CLASSES  );
+			} else {
+				bError = TRUE;
+			}
+		}
+
+		sqlite3_finalize(stmt);
+	}
+	return (bError ? ERROR : 0);
+}
+
+
+
+/*!     \brief  Rename, move or copy the archived sweeps with their trace profile
+ *
+ * The parameters are those of renameMoveCopyDBitems(). Only trace profiles have
+ * archived sweeps (the copies share the stimulus axes of the originals).
+ *
+ * \return             completion status
+ */
+static gint
+renameMoveCopyArchive( tRMCtarget target, tRMCpurpose purpose, gchar *sWhat, gchar *sFrom, gchar *sTo ) {
+	sqlite3_stmt *stmt = NULL;
+	gchar *sSQL;
+	gint queryIndex = 0;
+
+	switch( purpose ) {
+	case eMove:
+		sSQL = "UPDATE HP8753C_TRACE_ARCHIVE SET project = (?) WHERE project = (?) AND name = (?);";
+		break;
+	case eCopy:
+		sSQL = "INSERT OR IGNORE INTO HP8753C_TRACE_ARCHIVE"
+				" (project, name, channel, timestamp, axis, format, sParamOrInputPort, npoints, points)"
+				" SELECT (?), name, channel, timestamp, axis, format, sParamOrInputPort, npoints, points"
+				" FROM HP8753C_TRACE_ARCHIVE WHERE project = (?) AND name = (?);";
+		break;
+	case eRename:
+	default:
+		sSQL = target == eProjectName
+				? "UPDATE HP8753C_TRACE_ARCHIVE SET project = (?) WHERE project = (?);"
+				: "UPDATE HP8753C_TRACE_ARCHIVE SET name = (?) WHERE name = (?) AND project = (?);";
+		break;
+	}
+	if( target == eCalibrationName || (target == eProjectName && purpose != eRename) )
+		return OK;
+
+	if (sqlite3_prepare_v2(db, sSQL, -1, &stmt, NULL) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if( target != eProjectName
+			&& sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
+		goto err;
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+
+	sqlite3_finalize(stmt);
+	return OK;
+
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  reanme, move or copy project/cal/trace
+ *
+ * Rename database items
+ *
+ * \param pGlobal      pointer to tGlobal structure
+ * \param target       enum indication if we are refering to the project, the calibration or the trace
+ * \param purpose      enum indication if we are renaming, moving or copying
+ * \param sWhat        the project or name to move, copy or the project (if renaming calibration or trace)
+ * \param sFrom        the source
+ * \param sTo          the new name or project
+ * \return             completion status
+ */
+gint
+renameMoveCopyDBitems(tGlobal *pGlobal, tRMCtarget target, tRMCpurpose purpose,
+        gchar *sWhat, gchar *sFrom, gchar *sTo) {
+    gint rtn = ERROR;
+    gchar *sSQL = 0;
+    sqlite3_stmt *stmt = NULL;
+    gint queryIndex=0;
+    gchar *sSQLquery;
+
+    // cached trace profiles are keyed by project and name
+    invalidateTraceCache( NULL, NULL );
+
+    switch( purpose ) {
+    case eMove:
+        if( target == eCalibrationName )
+            sSQLquery = "UPDATE HP8753C_CALIBRATION SET project = (?) "
+                        " WHERE project = (?) AND name = (?);";
+        else if( target == eTraceName )
+            sSQLquery = "UPDATE HP8753C_TRACEDATA SET project = (?) "
+                        " WHERE project = (?) AND name = (?);";
+        else
+            goto err;
+
+        if (sqlite3_prepare_v2(db, sSQLquery, -1, &stmt, NULL) != SQLITE_OK) {
+            postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+            goto err;
+        }
+        if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        break;
+    case eCopy:
+        if( target == eCalibrationName ) {
+            sSQLquery =
+                    "INSERT INTO HP8753C_CALIBRATION "
+                    " ( project, selected, name, channel, learn, sweepStart, sweepStop, "
+                    "   IFbandwidth, CWfrequency, sweepType, npoints, calType, "
+                    "   cal01, cal02, cal03, cal04, cal05, cal06, "
+                    "   caL07, cal08, cal09, cal10, cal11, cal12, "
+                    "   notes, perChannelCalSettings, calSettings, calKit )"
+                    " SELECT (?), 0, name, channel, learn, sweepStart, sweepStop, "
+                    "   IFbandwidth, CWfrequency, sweepType, npoints, calType, "
+                    "   cal01, cal02, cal03, cal04, cal05, cal06, "
+                    "   caL07, cal08, cal09, cal10, cal11, cal12, "
+                    "   notes, perChannelCalSettings, calSettings, calKit "
+                    " FROM HP8753C_CALIBRATION WHERE project = (?) AND name = (?);";
+        } else if( target == eTraceName ) {
+            sSQLquery =
+                    "INSERT INTO HP8753C_TRACEDATA "
+                    " ( project, selected, name, channel, sweepStart, sweepStop, "
+                    "   IFbandwidth, CWfrequency, sweepType, npoints, points, "
+                    "   stimulusPoints, format, scaleVal, scaleRefPos, scaleRefVal, "
+                    "   sParamOrInputPort, markers, activeMkr, deltaMkr, mkrType, "
+                    "   bandwidth, nSegments, segments, screenPlot, title, notes, "
+                    "   perChannelFlags, generalFlags, time, complexPoints ) "
+                    " SELECT (?), 0, name, channel, sweepStart, sweepStop, "
+                    "   IFbandwidth, CWfrequency, sweepType, npoints, points, "
+                    "   stimulusPoints, format, scaleVal, scaleRefPos, scaleRefVal, "
+                    "   sParamOrInputPort, markers, activeMkr, deltaMkr, mkrType, "
+                    "   bandwidth, nSegments, segments, screenPlot, title, notes, "
+                    "   perChannelFlags, generalFlags, time, complexPoints "
+                    " FROM HP8753C_TRACEDATA WHERE project = (?) AND name = (?);";
+        } else {
+            goto err;
+        }
+        if (sqlite3_prepare_v2(db, sSQLquery, -1, &stmt, NULL) != SQLITE_OK) {
+            postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+            goto err;
+        }
+        if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
+                goto err;
+        break;
+    case eRename:
+        switch( target ) {
+        case eProjectName:
+            if (sqlite3_prepare_v2(db,
+                    "UPDATE HP8753C_CALIBRATION SET project = (?) WHERE project = (?);",
+                    -1, &stmt, NULL) != SQLITE_OK) {
+                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+                goto err;
+            }
+            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_step(stmt) != SQLITE_DONE) goto err;
+            if (sqlite3_finalize(stmt) != SQLITE_OK) goto err;
+
+            if (sqlite3_prepare_v2(db,
+                    "UPDATE HP8753C_TRACEDATA SET project = (?) WHERE project = (?);",
+                    -1, &stmt, NULL) != SQLITE_OK) {
+                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+                goto err;
+            }
+            queryIndex = 0;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            break;
+        case eCalibrationName:
+            if (sqlite3_prepare_v2(db,
+                    "UPDATE HP8753C_CALIBRATION SET name = (?) "
+                    "   WHERE name = (?) AND project = (?);",
+                    -1, &stmt, NULL) != SQLITE_OK) {
+                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+                goto err;
+            }
+            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            break;
+        case eTraceName:
+            if (sqlite3_prepare_v2(db,
+                    "UPDATE HP8753C_TRACEDATA SET name = (?) "
+                    "   WHERE name = (?) AND project = (?);",
+                    -1, &stmt, NULL) != SQLITE_OK) {
+                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+                goto err;
+            }
+            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
+                    goto err;
+            break;
+        }
+
+        break;
+    default:
+        goto err;
+        break;
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE)
+        goto err;
+    if( renameMoveCopyArchive( target, purpose, sWhat, sFrom, sTo ) != OK )
+        goto err;
+    rtn = 0;
+err:
+    g_free( sSQL );
+    sqlite3_finalize(stmt);
+    return rtn;
+}
+
+/*!     \brief  Save the phase times of a trace capture
+ *
+ * \param pTiming      pointer to the capture timing
+ * \return             completion status
+ */
+gint
+saveCaptureTiming( tCaptureTiming *pTiming ) {
+	sqlite3_stmt *stmt = NULL;
+	gint queryIndex = 1;
+
+	if (sqlite3_prepare_v2(db,
+			"INSERT INTO CAPTURE_TIMING"
+			" (timestamp, product, firmware, dualChannel, npoints, configuration,"
+			"  learnString, hold, traces, HPGL, markers, redraw, total)"
+			" VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?);",
+			-1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+
+	if (sqlite3_bind_int64(stmt, queryIndex++, pTiming->timestamp) != SQLITE_OK
+			|| sqlite3_bind_text(stmt, queryIndex++, pTiming->sProduct, -1, SQLITE_STATIC) != SQLITE_OK
+			|| sqlite3_bind_int(stmt, queryIndex++, pTiming->firmwareVersion) != SQLITE_OK
+			|| sqlite3_bind_int(stmt, queryIndex++, pTiming->bDualChannel) != SQLITE_OK
+			|| sqlite3_bind_int(stmt, queryIndex++, pTiming->nPoints) != SQLITE_OK)
+		goto err;
+	for (tCapturePhase phase = 0; phase < eCAPTURE_NUM_PHASES; phase++)
+		if (sqlite3_bind_int64(stmt, queryIndex++, pTiming->phaseTime[ phase ]) != SQLITE_OK)
+			goto err;
+	if (sqlite3_bind_int64(stmt, queryIndex++, captureTimingTotal( pTiming )) != SQLITE_OK)
+		goto err;
+	if (sqlite3_step(stmt) != SQLITE_DONE)
+		goto err;
+	sqlite3_finalize(stmt);
+	return OK;
+err:
+	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Recover the most recent capture timings of an instrument
+ *
+ * \param sProduct     product
+ * \param firmware     firmware version
+ * \param maxTimings   maximum number of captures to recover
+ * \param pTimings     pointer to the g_malloced array of timings (most recent first)
+ * \return             number of timings recovered or ERROR
+ */
+gint
+recoverCaptureTimings( gchar *sProduct, gint firmware, gint maxTimings, tCaptureTiming **pTimings ) {
+	sqlite3_stmt *stmt = NULL;
+	gint nTimings = 0;
+
+	*pTimings = g_new0( tCaptureTiming, maxTimings );
+	if (sqlite3_prepare_v2(db,
+			"SELECT timestamp, dualChannel, npoints, configuration, learnString,"
+			" hold, traces, HPGL, markers, redraw FROM CAPTURE_TIMING"
+			" WHERE product = ? AND firmware = ? ORDER BY ID DESC LIMIT ?;",
+			-1, &stmt, NULL) != SQLITE_OK
+			|| sqlite3_bind_text(stmt, 1, sProduct, -1, SQLITE_STATIC) != SQLITE_OK
+			|| sqlite3_bind_int(stmt, 2, firmware) != SQLITE_OK
+			|| sqlite3_bind_int(stmt, 3, maxTimings) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		sqlite3_finalize(stmt);
+		return ERROR;
+	}
+
+	while (nTimings < maxTimings && sqlite3_step(stmt) == SQLITE_ROW) {
+		tCaptureTiming *pTiming = &(*pTimings)[ nTimings++ ];
+		gint queryIndex = 0;
+
+		pTiming->timestamp = sqlite3_column_int64(stmt, queryIndex++);
+		pTiming->bDualChannel = sqlite3_column_int(stmt, queryIndex++);
+		pTiming->nPoints = sqlite3_column_int(stmt, queryIndex++);
+		pTiming->firmwareVersion = firmware;
+		for (tCapturePhase phase = 0; phase < eCAPTURE_NUM_PHASES; phase++)
+			pTiming->phaseTime[ phase ] = sqlite3_column_int64(stmt, queryIndex++);
+	}
+	sqlite3_finalize(stmt);
+	return nTimings;
+}
+
+/*!     \brief  Get the instruments with capture timings
+ *
+ * \return             list of "product\tfirmware" strings (most recently used first)
+ */
+GList *
+inventoryCaptureTimingInstruments( void ) {
+	sqlite3_stmt *stmt = NULL;
+	GList *instruments = NULL;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT product, firmware FROM CAPTURE_TIMING"
+			" GROUP BY product, firmware ORDER BY MAX(ID) DESC;", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return NULL;
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW)
+		instruments = g_list_prepend(instruments, g_strdup_printf("%s\t%d",
+				(gchar *)sqlite3_column_text(stmt, 0), sqlite3_column_int(stmt, 1)));
+	sqlite3_finalize(stmt);
+	return g_list_reverse(instruments);
+}
+
+/*!     \brief  Save the learned durations of operations
+ *
+ * Called after the GPIB thread has ended.
+ *
+ * \return             completion status
+ */
+gint
+saveTimingModel( void ) {
+	sqlite3_stmt *stmt = NULL;
+	GList *entries = timingModelEntries();
+	gint rtn = ERROR;
+
+	if (entries == NULL)
+		return OK;
+	if (sqlite3_prepare_v2(db,
+			"INSERT OR REPLACE INTO TIMING_MODEL"
+			" (product, firmware, operation, variant, mean, deviation, samples)"
+			" VALUES (?, ?, ?, ?, ?, ?, ?);", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		g_list_free(entries);
+		return ERROR;
 	}
 
-	return OK;
+	sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+	for (GList *l = entries; l != NULL; l = l->next) {
+		tTimingModelEntry *pEntry = l->data;
+		gint queryIndex = 1;
+
+		sqlite3_reset(stmt);
+		if (sqlite3_bind_text(stmt, queryIndex++, pEntry->sProduct, -1, SQLITE_STATIC) != SQLITE_OK
+				|| sqlite3_bind_int(stmt, queryIndex++, pEntry->firmwareVersion) != SQLITE_OK
+				|| sqlite3_bind_int(stmt, queryIndex++, pEntry->operation) != SQLITE_OK
+				|| sqlite3_bind_int(stmt, queryIndex++, pEntry->variant) != SQLITE_OK
+				|| sqlite3_bind_double(stmt, queryIndex++, pEntry->mean) != SQLITE_OK
+				|| sqlite3_bind_double(stmt, queryIndex++, pEntry->deviation) != SQLITE_OK
+				|| sqlite3_bind_int(stmt, queryIndex++, pEntry->nSamples) != SQLITE_OK
+				|| sqlite3_step(stmt) != SQLITE_DONE)
+			goto err;
+	}
+	rtn = OK;
 err:
-	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	if (rtn != OK)
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_exec(db, rtn == OK ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
 	sqlite3_finalize(stmt);
+	g_list_free(entries);
+	return rtn;
+}
 
-	return ERROR;
+/*!     \brief  Recover the learned durations of operations
+ *
+ * Called before the GPIB thread starts.
+ *
+ * \return             number of entries recovered or ERROR
+ */
+gint
+recoverTimingModel( void ) {
+	sqlite3_stmt *stmt = NULL;
+	gint nEntries = 0;
+
+	if (sqlite3_prepare_v2(db,
+			"SELECT product, firmware, operation, variant, mean, deviation, samples"
+			" FROM TIMING_MODEL;", -1, &stmt, NULL) != SQLITE_OK) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		return ERROR;
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		tTimingModelEntry entry = {
+			.sProduct = (gchar *)sqlite3_column_text(stmt, 0),
+			.firmwareVersion = sqlite3_column_int(stmt, 1),
+			.operation = sqlite3_column_int(stmt, 2),
+			.variant = sqlite3_column_int(stmt, 3),
+			.mean = sqlite3_column_double(stmt, 4),
+			.deviation = sqlite3_column_double(stmt, 5),
+			.nSamples = sqlite3_column_int(stmt, 6)
+		};
+		if (entry.operation < eTIMED_NUM_OPERATIONS) {
+			timingModelRestore(&entry);
+			nEntries++;
+		}
+	}
+	sqlite3_finalize(stmt);
+	return nEntries;
 }
 
-/*!     \brief  Save the learn string analysis
+/*!     \brief  Save the learn string indexes that are not compiled in
  *
- * After an analysis is done, we save it to the database
+ * Called after an analysis or an import.
  *
- * \param pGlobal      pointer to tGlobal structure
- * \param pLSanalysis  pointer to the tLearnStringIndexes structure
- * \return 			   completion status
+ * \return             completion status
  */
 gint
-saveLearnStringAnalysis( tGlobal *pGlobal, tLearnStringIndexes *pLSanalysis ) {
+saveLearnStringIndexes( void ) {
 	sqlite3_stmt *stmt = NULL;
+	GList *entries = learnStringRegistryEntries( FALSE );
+	gint rtn = ERROR;
 
+	if (entries == NULL)
+		return OK;
 	if (sqlite3_prepare_v2(db,
-			"UPDATE OPTIONS"
-			" SET learnStringIndexes = ?;",
-			-1, &stmt, NULL) != SQLITE_OK) {
+			"INSERT OR REPLACE INTO LEARN_STRING_INDEXES"
+			" (product, firmware, indexes) VALUES (?, ?, ?);", -1, &stmt, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+		freeLearnStringRegistryEntries(entries);
 		return ERROR;
 	}
 
-	if (sqlite3_bind_blob(stmt, 1, &pGlobal->HP8753.analyzedLSindexes,
-							sizeof( tLearnStringIndexes ), SQLITE_STATIC) != SQLITE_OK)
-		goto err;
-	if (sqlite3_step(stmt) != SQLITE_DONE)
-		goto err;
-	sqlite3_finalize(stmt);
-	return OK;
+	sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+	for (GList *l = entries; l != NULL; l = l->next) {
+		tLearnStringRegistryEntry *pEntry = l->data;
+
+		sqlite3_reset(stmt);
+		if (sqlite3_bind_text(stmt, 1, pEntry->sProduct, -1, SQLITE_STATIC) != SQLITE_OK
+				|| sqlite3_bind_int(stmt, 2, pEntry->indexes.version) != SQLITE_OK
+				|| sqlite3_bind_blob(stmt, 3, &pEntry->indexes, sizeof( tLearnStringIndexes ), SQLITE_STATIC) != SQLITE_OK
+				|| sqlite3_step(stmt) != SQLITE_DONE)
+			goto err;
+	}
+	rtn = OK;
 err:
-	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	if (rtn != OK)
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+	sqlite3_exec(db, rtn == OK ? "COMMIT;" : "ROLLBACK;", NULL, NULL, NULL);
 	sqlite3_finalize(stmt);
-	return ERROR;
+	freeLearnStringRegistryEntries(entries);
+	return rtn;
 }
 
-/*!     \brief  Recover the option settings
+/*!     \brief  Recover the learn string indexes analyzed or imported before
  *
- * Recover the option settings upon startup
+ * Called before the GPIB thread starts.
  *
- * \param pGlobal      pointer to tGlobal structure
- * \return 			   completion status (ERROR, TRUE of options recovered or FALSE if no options recovered)
+ * \return             number of entries recovered or ERROR
  */
 gint
-recoverProgramOptions(tGlobal *pGlobal) {
+recoverLearnStringIndexes( void ) {
 	sqlite3_stmt *stmt = NULL;
-	gint length, size;
-	const guchar *tBlob;
-	gint queryIndex;
-	gint schemaVersion = 0;
-	gboolean bOptionsRecovered  = FALSE;
-    union uOptions {
-        struct stOptions {
-            guint16 flagsL;
-            guint8  flagsU;
-            guint8  PDFpaperSize;
-        }  __attribute__((packed)) components;
-        guint all;
-    } options;
+	gint nEntries = 0;
 
-	// First update database schema if needed
-	// Find out the current schema ID
 	if (sqlite3_prepare_v2(db,
-			"SELECT ID FROM OPTIONS;", -1, &stmt, NULL) != SQLITE_OK) {
+			"SELECT product, indexes FROM LEARN_STRING_INDEXES;", -1, &stmt, NULL) != SQLITE_OK) {
 		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
 		return ERROR;
-	} else {
-		while (sqlite3_step(stmt) == SQLITE_ROW) {
-			// check the database version and update if necessary
-			schemaVersion = sqlite3_column_int(stmt, 0);
-		}
-		sqlite3_finalize(stmt);
+	}
+	while (sqlite3_step(stmt) == SQLITE_ROW) {
+		tLearnStringIndexes LSindexes;
 
-		// *************** Alert!
-		// if the stored database is older than the current schema ... update
-		// ***************
-		while( schemaVersion < CURRENT_DB_SCHEMA ) {
-			switch( schemaVersion ) {
-			case 0: // going from version 0 to 1
-				if (sqlite3_exec(db,
-						"ALTER TABLE HP8753C_CALIBRATION RENAME TO OLD_HP8753C_CALIBRATION;"
-						"ALTER TABLE HP8753C_TRACEDATA RENAME TO OLD_HP8753C_TRACEDATA;",
-						NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				if (sqlite3_exec(db, sqlCreateTables[0], NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				if (sqlite3_exec(db,
-						"INSERT INTO HP8753C_CALIBRATION ( "
-						"    project, name, channel, learn, sweepStart, sweepStop, IFbandwidth, CWfrequency, "
-						"    sweepType, npoints, calType, "
-						"    cal01, cal02, cal03,cal04, cal05, cal06, cal07, cal08, cal09, cal10, cal11, cal12,"
-						"    notes, perChannelCalSettings, calSettings )"
-						"  SELECT '🚧 default', name, channel, learn, sweepStart, sweepStop, IFbandwidth, CWfrequency,"
-						"    sweepType, npoints, calType, "
-						"    cal01, cal02, cal03,cal04, cal05, cal06, cal07, cal08, cal09, cal10, cal11, cal12,"
-						"    notes, perChannelCalSettings, calSettings "
-						"    FROM OLD_HP8753C_CALIBRATION; "
-						" DROP TABLE OLD_HP8753C_CALIBRATION;"
-						, NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				if (sqlite3_exec(db,sqlCreateTables[1], NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				if (sqlite3_exec(db,
-						"INSERT INTO HP8753C_TRACEDATA ( "
-						"   project, name, channel, sweepStart, sweepStop, IFbandwidth, "
-						"   CWfrequency, sweepType, npoints, points, stimulusPoints,"
-						"   format, scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort,"
-						"   markers, activeMkr, deltaMkr, mkrType, bandwidth, nSegments,"
-						"   segments, title, notes, perChannelFlags, generalFlags, time )"
-						" SELECT '🚧 default', name, channel, sweepStart, sweepStop, IFbandwidth, "
-						" CWfrequency, sweepType, npoints, points, stimulusPoints,"
-						" format, scaleVal, scaleRefPos, scaleRefVal, sParamOrInputPort,"
-						" markers, activeMkr, deltaMkr, mkrType, bandwidth, nSegments,"
-						" segments, title, notes, perChannelFlags, generalFlags, time "
-						"    FROM OLD_HP8753C_TRACEDATA; "
-						" DROP TABLE OLD_HP8753C_TRACEDATA;"
-						"VACUUM;PRAGMA auto_vacuum = FULL;"
-						, NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				if (sqlite3_exec(db,
-						"ALTER TABLE Options ADD COLUMN project TEXT DEFAULT '🚧 default';"
-						, NULL, NULL, NULL) != SQLITE_OK) {
-					postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-					return ERROR;
-				}
-				schemaVersion++;
+		if (sqlite3_column_bytes(stmt, 1) != sizeof( tLearnStringIndexes ))
+			continue;
+		memcpy(&LSindexes, sqlite3_column_blob(stmt, 1), sizeof( tLearnStringIndexes ));
+		registerLearnStringIndexes((gchar *)sqlite3_column_text(stmt, 0), &LSindexes);
+		nEntries++;
+	}
+	sqlite3_finalize(stmt);
+	return nEntries;
+}
+
+/*!     \brief  Close the Sqlite3 database
+ *
+ * Close the Sqlite3 database prior to ending program
+ *
+ */
+void closeDB(void) {
+	stopDBmaintenance();
+	sqlite3_exec(db, "PRAGMA optimize;", NULL, NULL, NULL);
+	sqlite3_trace_v2(db, 0, NULL, NULL);
+	freeQueryTimings();
+	for (eChannel channel = 0; channel < eNUM_CH; channel++)
+		g_free( archiveAxisCache[ channel ].stimulusPoints );
+	memset( archiveAxisCache, 0, sizeof( archiveAxisCache ) );
+	sqlite3_close(db);
+	sqlite3_shutdown();
+}
+
+/*
+ * Project archives
+ *
+ * A project is exported as a gzip compressed stream of the rows of its calibration and
+ * trace profiles (and the calibration kits) so that it can be moved to another machine.
+ * The rows are streamed one at a time, so the size of the project does not matter.
+ *
+ *      header      "HP8753PA" archive version (u32) database schema (u32) project (string)
+ *      table       'T' table name (string) number of columns (u16) column names (strings)
+ *      row         'R' value for each column of the table
+ *      end         'E' number of rows (u32) SHA-256 of everything before the digest
+ *
+ * integers are little endian, strings are a length (u32) followed by the UTF-8 bytes and
+ * values are a type byte ('n'ull, 'i'nteger (i64), 'f'loat (IEEE 754 u64), 't'ext or 'b'lob)
+ * followed by the data (text and blobs are length prefixed like strings).
+ */
+#define ARCHIVE_MAGIC           "HP8753PA"
+#define ARCHIVE_VERSION         2       // (2 adds the archived sweeps)
+#define ARCHIVE_MAX_ITEM_SIZE   (256 * 1024 * 1024)     // sanity check on lengths read
+
+// tables in an archive (calibration kits are shared by all projects, so only those used
+// by the project's calibrations are included and a kit that already exists is never replaced)
+static const struct {
+	gchar		*sTable;
+	gchar		*sSelect;		// the rows exported (the parameter is the project)
+	gboolean	bRowID;			// the ID column is a rowid (a new one is assigned on import)
+	gboolean	bShared;		// not part of the project (existing rows are kept whatever the policy)
+} archiveTables[] = {
+		{ "HP8753C_CALIBRATION",   "SELECT * FROM HP8753C_CALIBRATION WHERE project IS (?);", FALSE, FALSE },
+		{ "HP8753C_TRACEDATA",     "SELECT * FROM HP8753C_TRACEDATA WHERE project IS (?);", FALSE, FALSE },
+		{ "CAL_KITS",              "SELECT * FROM CAL_KITS WHERE label IN"
+		                           " (SELECT calKit FROM HP8753C_CALIBRATION WHERE project IS (?));", FALSE, TRUE },
+		// the axes come before the sweeps that use them, so that their new IDs are known
+		{ "HP8753C_ARCHIVE_AXIS",  "SELECT * FROM HP8753C_ARCHIVE_AXIS WHERE ID IN"
+		                           " (SELECT axis FROM HP8753C_TRACE_ARCHIVE WHERE project IS (?));", TRUE, FALSE },
+		{ "HP8753C_TRACE_ARCHIVE", "SELECT * FROM HP8753C_TRACE_ARCHIVE WHERE project IS (?);", TRUE, FALSE } };
+
+typedef struct {
+	GOutputStream	*stream;
+	GInputStream	*inStream;
+	GChecksum		*checksum;
+	GError			*error;
+	guint8			*buffer;		// holds the text or blob last read
+	gsize			bufferSize;
+} tArchiveStream;
+
+/*!     \brief  Write to the archive (and add to the checksum)
+ *
+ * \param pArchive     pointer to the archive stream
+ * \param pData        data to write
+ * \param length       number of bytes
+ * \return             TRUE if written
+ */
+static gboolean
+archiveWrite( tArchiveStream *pArchive, gconstpointer pData, gsize length ) {
+	if( pArchive->error != NULL )
+		return FALSE;
+	g_checksum_update( pArchive->checksum, pData, length );
+	return g_output_stream_write_all( pArchive->stream, pData, length, NULL, NULL, &pArchive->error );
+}
+
+static gboolean
+archiveWriteU32( tArchiveStream *pArchive, guint32 value ) {
+	value = GUINT32_TO_LE( value );
+	return archiveWrite( pArchive, &value, sizeof( value ) );
+}
+
+static gboolean
+archiveWriteString( tArchiveStream *pArchive, gconstpointer pData, gsize length ) {
+	return archiveWriteU32( pArchive, length ) && archiveWrite( pArchive, pData, length );
+}
+
+/*!     \brief  Read from the archive (and add to the checksum)
+ *
+ * \param pArchive     pointer to the archive stream
+ * \param pData        buffer to read into
+ * \param length       number of bytes
+ * \return             TRUE if all bytes were read
+ */
+static gboolean
+archiveRead( tArchiveStream *pArchive, gpointer pData, gsize length ) {
+	gsize nRead = 0;
+
+	if( pArchive->error != NULL )
+		return FALSE;
+	if( !g_input_stream_read_all( pArchive->inStream, pData, length, &nRead, NULL, &pArchive->error ) )
+		return FALSE;
+	if( nRead != length ) {
+		g_set_error_literal( &pArchive->error, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT, "Project archive is truncated" );
+		return FALSE;
+	}
+	g_checksum_update( pArchive->checksum, pData, length );
+	return TRUE;
+}
+
+static gboolean
+archiveReadU32( tArchiveStream *pArchive, guint32 *pValue ) {
+	if( !archiveRead( pArchive, pValue, sizeof( guint32 ) ) )
+		return FALSE;
+	*pValue = GUINT32_FROM_LE( *pValue );
+	return TRUE;
+}
+
+/*!     \brief  Read a length prefixed string or blob into the archive buffer
+ *
+ * The buffer is reused (and grown as needed) so it only ever holds the largest item.
+ * It is always NUL terminated so that it can be used as a string.
+ *
+ * \param pArchive     pointer to the archive stream
+ * \param pLength      pointer to the length read
+ * \return             TRUE if read
+ */
+static gboolean
+archiveReadString( tArchiveStream *pArchive, guint32 *pLength ) {
+	if( !archiveReadU32( pArchive, pLength ) )
+		return FALSE;
+	if( *pLength > ARCHIVE_MAX_ITEM_SIZE ) {
+		g_set_error_literal( &pArchive->error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Project archive is corrupt" );
+		return FALSE;
+	}
+	if( *pLength + 1 > pArchive->bufferSize ) {
+		pArchive->bufferSize = *pLength + 1;
+		pArchive->buffer = g_realloc( pArchive->buffer, pArchive->bufferSize );
+	}
+	pArchive->buffer[ *pLength ] = 0;
+	return archiveRead( pArchive, pArchive->buffer, *pLength );
+}
+
+/*!     \brief  Write the rows of one table to the archive
+ *
+ * \param pArchive     pointer to the archive stream
+ * \param sTable       name of the table
+ * \param sSelect      query for the rows to export
+ * \param sProject     project to export (bound to the query parameter, if it has one)
+ * \param pNrows       pointer to running count of rows written
+ * \return             OK or ERROR (with the error in the archive stream)
+ */
+static gint
+exportTable( tArchiveStream *pArchive, const gchar *sTable, const gchar *sSelect, gchar *sProject, guint32 *pNrows ) {
+	sqlite3_stmt *stmt = NULL;
+	gint nColumns, rc;
+	guint16 nColumnsLE;
+
+	if( sqlite3_prepare_v2(db, sSelect, -1, &stmt, NULL) != SQLITE_OK )
+		goto err;
+	if( sqlite3_bind_parameter_count( stmt ) > 0
+			&& sqlite3_bind_text(stmt, 1, sProject, STRLENGTH, SQLITE_STATIC) != SQLITE_OK )
+		goto err;
+
+	// the column names let the archive be imported into a different version of the schema
+	nColumns = sqlite3_column_count( stmt );
+	nColumnsLE = GUINT16_TO_LE( nColumns );
+	archiveWrite( pArchive, "T", 1 );
+	archiveWriteString( pArchive, sTable, strlen( sTable ) );
+	archiveWrite( pArchive, &nColumnsLE, sizeof( nColumnsLE ) );
+	for( gint i = 0; i < nColumns; i++ )
+		archiveWriteString( pArchive, sqlite3_column_name( stmt, i ), strlen( sqlite3_column_name( stmt, i ) ) );
+
+	while( pArchive->error == NULL && (rc = sqlite3_step(stmt)) == SQLITE_ROW ) {
+		archiveWrite( pArchive, "R", 1 );
+		for( gint i = 0; i < nColumns; i++ ) {
+			guint64 value;
+			gdouble dValue;
+
+			switch( sqlite3_column_type( stmt, i ) ) {
+			case SQLITE_INTEGER:
+				value = GUINT64_TO_LE( (guint64)sqlite3_column_int64( stmt, i ) );
+				archiveWrite( pArchive, "i", 1 );
+				archiveWrite( pArchive, &value, sizeof( value ) );
+				break;
+			case SQLITE_FLOAT:
+				dValue = sqlite3_column_double( stmt, i );
+				memcpy( &value, &dValue, sizeof( value ) );
+				value = GUINT64_TO_LE( value );
+				archiveWrite( pArchive, "f", 1 );
+				archiveWrite( pArchive, &value, sizeof( value ) );
+				break;
+			case SQLITE_TEXT:
+				archiveWrite( pArchive, "t", 1 );
+				archiveWriteString( pArchive, sqlite3_column_text( stmt, i ), sqlite3_column_bytes( stmt, i ) );
+				break;
+			case SQLITE_BLOB:
+				archiveWrite( pArchive, "b", 1 );
+				archiveWriteString( pArchive, sqlite3_column_blob( stmt, i ), sqlite3_column_bytes( stmt, i ) );
 				break;
-			case 1: // from version 1 to version 2 (when we get there)
-                if (sqlite3_exec(db,
-                        "ALTER TABLE Options ADD COLUMN colors BLOB; ALTER TABLE Options ADD COLUMN colorsHPGL BLOB;"
-                        , NULL, NULL, NULL) != SQLITE_OK) {
-                    postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-                    return ERROR;
-                }
-			    break;
-			case 2:
-			    break;
 			default:
-				postMessageToMainLoop(TM_ERROR, (gchar*) "Database schema version error");
-				return ERROR;
+				archiveWrite( pArchive, "n", 1 );
+				break;
 			}
+		}
+		(*pNrows)++;
+	}
+	if( pArchive->error == NULL && rc != SQLITE_DONE )
+		goto err;
 
-			// Update the schema so that if we crash, the schema ID will reflect reality
-			gchar *sCmd = g_strdup_printf( "UPDATE OPTIONS SET ID = %d;", ++schemaVersion );
-			if (sqlite3_exec(db, sCmd, NULL, NULL, NULL) != SQLITE_OK) {
-				postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-				g_free( sCmd );
-				return ERROR;
-			}
-			g_free( sCmd );
+	sqlite3_finalize(stmt);
+	return pArchive->error ? ERROR : OK;
+
+err:
+	// (reported, and the partial archive removed, by the caller)
+	if( pArchive->error == NULL )
+		g_set_error_literal( &pArchive->error, G_IO_ERROR, G_IO_ERROR_FAILED, sqlite3_errmsg(db) );
+	sqlite3_finalize(stmt);
+	return ERROR;
+}
+
+/*!     \brief  Export a project to an archive file
+ *
+ * Write all the calibration and trace profiles of the project (with the archived sweeps
+ * and the calibration kits they used) to a compressed, checksummed archive that can be imported with importProject().
+ *
+ * \ingroup database
+ *
+ * \param sProject     project to export
+ * \param sFilename    archive file to create (replaced if it exists)
+ * \return             number of rows exported or ERROR
+ */
+gint
+exportProject( gchar *sProject, gchar *sFilename ) {
+	GFile *file = g_file_new_for_path( sFilename );
+	GFileOutputStream *fileStream;
+	GConverter *compressor = NULL;
+	GCancellable *cancellable = g_cancellable_new();
+	gboolean bExisted = g_file_query_exists( file, NULL );
+	tArchiveStream archive = { 0 };
+	guint8 digest[ 32 ];
+	gsize digestLength = sizeof( digest );
+	guint32 nRows = 0;
+	gint rtn = ERROR;
+
+	if( (fileStream = g_file_replace( file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &archive.error )) == NULL )
+		goto err;
+	compressor = G_CONVERTER( g_zlib_compressor_new( G_ZLIB_COMPRESSOR_FORMAT_GZIP, -1 ) );
+	archive.stream = g_converter_output_stream_new( G_OUTPUT_STREAM( fileStream ), compressor );
+	archive.checksum = g_checksum_new( G_CHECKSUM_SHA256 );
+
+	// a consistent snapshot of the project
+	sqlite3_exec(db, "BEGIN;", NULL, NULL, NULL);
+
+	archiveWrite( &archive, ARCHIVE_MAGIC, strlen( ARCHIVE_MAGIC ) );
+	archiveWriteU32( &archive, ARCHIVE_VERSION );
+	archiveWriteU32( &archive, CURRENT_DB_SCHEMA );
+	archiveWriteString( &archive, sProject, strlen( sProject ) );
+
+	for( gint i = 0; i < sizeof( archiveTables ) / sizeof( archiveTables[0] ); i++ ) {
+		if( exportTable( &archive, archiveTables[i].sTable, archiveTables[i].sSelect, sProject, &nRows ) != OK ) {
+			sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+			goto err;
 		}
 	}
 
-	if (sqlite3_prepare_v2(db,
-			"SELECT flags, GPIBcontrollerName, GPIBdeviceName, "
-			"  GPIBcontrollerCard, GPIBdevicePID, "
-			"  GtkPrintSettings, GtkPageSetup, lastDirectory, calProfile, traceProfile, project, colors, colorsHPGL, learnStringIndexes, product FROM OPTIONS;",
-			-1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		return ERROR;
-	} else {
-		while (sqlite3_step(stmt) == SQLITE_ROW) {
-			bOptionsRecovered = TRUE;
-			queryIndex = 0;
-			// check the database version and update if necessary
+	sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL);
 
-			options.all = sqlite3_column_int(stmt, queryIndex++);
-			// don't overwrite this bit if it has been set with the command line switch
-			gint bNoGPIBtimeout = pGlobal->flags.bNoGPIBtimeout;
-			memcpy(&pGlobal->flags, &options.components.flagsL, sizeof(gushort));
-			// The top byte is the PDF paper size
-			pGlobal->PDFpaperSize = options.components.PDFpaperSize;
-			GtkComboBox     *wComboPDFpaperSize = GTK_COMBO_BOX ( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_CB_PDFpaperSize" ) );
-			gtk_combo_box_set_active( wComboPDFpaperSize, pGlobal->PDFpaperSize );
+	archiveWrite( &archive, "E", 1 );
+	archiveWriteU32( &archive, nRows );
+	g_checksum_get_digest( archive.checksum, digest, &digestLength );
+	if( archive.error == NULL )
+		g_output_stream_write_all( archive.stream, digest, digestLength, NULL, NULL, &archive.error );
 
-			pGlobal->flags.bRunning = TRUE;
-			pGlobal->flags.bNoGPIBtimeout = bNoGPIBtimeout;
+	if( archive.error == NULL && g_output_stream_close( archive.stream, cancellable, &archive.error ) )
+		rtn = nRows;
 
-			setUseGPIBcardNoAndPID(pGlobal, pGlobal->flags.bGPIB_UseCardNoAndPID );
-			// No longer using sGPIBcontrollerName
-			queryIndex++;
+err:
+	if( rtn == ERROR ) {
+		if( archive.error )
+			postMessageToMainLoop(TM_ERROR, archive.error->message);
+		// a cancelled close leaves any existing file as it was
+		g_cancellable_cancel( cancellable );
+		if( archive.stream )
+			g_output_stream_close( archive.stream, cancellable, NULL );
+		if( !bExisted )
+			g_file_delete( file, NULL, NULL );
+	}
+	g_clear_error( &archive.error );
+	g_object_unref( cancellable );
+	if( archive.checksum )
+		g_checksum_free( archive.checksum );
+	if( archive.stream )
+		g_object_unref( archive.stream );
+	if( compressor )
+		g_object_unref( compressor );
+	if( fileStream )
+		g_object_unref( fileStream );
+	g_object_unref( file );
+	return rtn;
+}
 
-			g_free( pGlobal->sGPIBdeviceName );
-			pGlobal->sGPIBdeviceName = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
-			gtk_entry_set_text( GTK_ENTRY(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Entry_GPIB_HP8753" )), pGlobal->sGPIBdeviceName);
+/*!     \brief  Prepare the insert statement for a table section of an archive
+ *
+ * Columns in the archive that are not in this version of the table are skipped.
+ *
+ * \param sTable       name of the table (must be one of archiveTables)
+ * \param columnNames  names of the columns in the archive
+ * \param nColumns     number of columns in the archive
+ * \param bRowID       skip the ID column (so that a new rowid is assigned)
+ * \param policy       what to do if a profile already exists
+ * \param bindIndex    set to the parameter index for each archive column (0 if skipped)
+ * \param pProjectColumn   set to the index of the project column (or INVALID)
+ * \return             prepared statement or NULL on error
+ */
+static sqlite3_stmt *
+prepareArchiveInsert( const gchar *sTable, gchar **columnNames, gint nColumns, gboolean bRowID,
+		tImportPolicy policy, gint *bindIndex, gint *pProjectColumn ) {
+	static const gchar *conflictClause[] = { "OR IGNORE", "OR REPLACE", "OR ABORT" };
+	GString *sSQL = g_string_new( NULL );
+	GString *sValues = g_string_new( NULL );
+	GHashTable *tableColumns = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, NULL );
+	sqlite3_stmt *stmt = NULL;
+	gchar *sPragma = g_strdup_printf( "PRAGMA table_info(%s);", sTable );
+	gint nBound = 0;
 
-			pGlobal->GPIBcontrollerIndex = sqlite3_column_int(stmt, queryIndex++);
-			gtk_spin_button_set_value( GTK_SPIN_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Spin_GPIB_Controller_Card" )), pGlobal->GPIBcontrollerIndex);
+	// the columns that exist in this database
+	if (sqlite3_prepare_v2(db, sPragma, -1, &stmt, NULL) == SQLITE_OK) {
+		while( sqlite3_step(stmt) == SQLITE_ROW )
+			g_hash_table_add( tableColumns, g_strdup( (gchar *)sqlite3_column_text(stmt, 1) ) );
+	}
+	sqlite3_finalize(stmt);
+	stmt = NULL;
+	g_free( sPragma );
+
+	g_string_printf( sSQL, "INSERT %s INTO %s (", conflictClause[ policy ], sTable );
+	*pProjectColumn = INVALID;
+	for( gint i = 0; i < nColumns; i++ ) {
+		bindIndex[ i ] = 0;
+		// column names are only used if they exist in the table, so are safe to quote
+		if( !g_hash_table_contains( tableColumns, columnNames[ i ] )
+				|| (bRowID && g_strcmp0( columnNames[ i ], "ID" ) == 0) )
+			continue;
+		bindIndex[ i ] = ++nBound;
+		if( g_strcmp0( columnNames[ i ], "project" ) == 0 )
+			*pProjectColumn = i;
+		g_string_append_printf( sSQL, "%s\"%s\"", nBound > 1 ? ", " : "", columnNames[ i ] );
+		g_string_append( sValues, nBound > 1 ? ", ?" : "?" );
+	}
+	g_string_append_printf( sSQL, ") VALUES (%s);", sValues->str );
 
-			pGlobal->GPIBdevicePID = sqlite3_column_int(stmt, queryIndex++);
-			gtk_spin_button_set_value( GTK_SPIN_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Spin_GPIB_HP8753_ID" )), pGlobal->GPIBdevicePID);
+	if( nBound == 0 || sqlite3_prepare_v2(db, sSQL->str, -1, &stmt, NULL) != SQLITE_OK ) {
+		postMessageToMainLoop(TM_ERROR, nBound == 0 ? "Project archive table does not match" : (gchar*) sqlite3_errmsg(db));
+		stmt = NULL;
+	}
 
+	g_hash_table_destroy( tableColumns );
+	g_string_free( sValues, TRUE );
+	g_string_free( sSQL, TRUE );
+	return stmt;
+}
 
-			length = sqlite3_column_bytes(stmt, queryIndex);
-			if( length > 0 ) {
-				tBlob = sqlite3_column_blob(stmt, queryIndex++);
-				GBytes *byPrintSettings = g_bytes_new( tBlob, length );
-				GVariant *vPrintSettings =
-						g_variant_new_from_bytes ( G_VARIANT_TYPE_VARDICT, byPrintSettings, TRUE );
-				g_bytes_unref( byPrintSettings );
-				if( pGlobal->printSettings != NULL  )
-				g_object_unref (pGlobal->printSettings);
-				pGlobal->printSettings = gtk_print_settings_new_from_gvariant( vPrintSettings );
-			} else {
-				queryIndex++;
-			}
-			length = sqlite3_column_bytes(stmt, queryIndex);
-			if( length > 0 ) {
-				tBlob = sqlite3_column_blob(stmt, queryIndex++);
-				GBytes *byPageSetup = g_bytes_new( tBlob, length );
-				GVariant *vPageSetup =
-						g_variant_new_from_bytes ( G_VARIANT_TYPE_VARDICT, byPageSetup, TRUE );
-				g_bytes_unref( byPageSetup );
-				if( pGlobal->pageSetup != NULL )
-					g_object_unref (pGlobal->pageSetup);
-				pGlobal->pageSetup = gtk_page_setup_new_from_gvariant( vPageSetup );
-			} else {
-				queryIndex++;
+/*!     \brief  Import a project from an archive file
+ *
+ * The archive is read and inserted a row at a time in a single transaction, which is
+ * only committed if the whole archive is read and its checksum is correct.
+ * The archived sweeps are given new IDs (and refer to the new IDs of their stimulus axes).
+ *
+ * \ingroup database
+ *
+ * \param sFilename    archive file created by exportProject()
+ * \param sProjectTo   project to import into (or NULL to use the project in the archive)
+ * \param policy       what to do with profiles that already exist (keep, replace or abandon the import)
+ * \param psProject    if not NULL, set to the (g_malloced) name of the project imported
+ * \return             number of rows imported or ERROR
+ */
+gint
+importProject( gchar *sFilename, gchar *sProjectTo, tImportPolicy policy, gchar **psProject ) {
+	GFile *file = g_file_new_for_path( sFilename );
+	GFileInputStream *fileStream;
+	GConverter *decompressor = NULL;
+	tArchiveStream archive = { 0 };
+	sqlite3_stmt *stmt = NULL;
+	gchar **columnNames = NULL;
+	gint *bindIndex = NULL;
+	gint nColumns = 0, projectColumn = INVALID, idColumn = INVALID, axisColumn = INVALID;
+	gint iTable = INVALID;
+	gint64 rowID = 0, axisID = 0;
+	GHashTable *axisIDs = g_hash_table_new_full( g_int64_hash, g_int64_equal, g_free, g_free );
+	gchar *sProject = NULL;
+	guint8 magic[ sizeof( ARCHIVE_MAGIC ) - 1 ];
+	guint8 digest[ 32 ], digestRead[ 32 ];
+	gsize digestLength = sizeof( digest ), nDigestRead;
+	guint32 version, schema, length, nRowsRead = 0, nRowsArchive;
+	gint nImported = 0, rtn = ERROR;
+	gboolean bTransaction = FALSE, bEnd = FALSE;
+	gchar recordType;
+
+	if( psProject )
+		*psProject = NULL;
+
+	if( (fileStream = g_file_read( file, NULL, &archive.error )) == NULL )
+		goto err;
+	decompressor = G_CONVERTER( g_zlib_decompressor_new( G_ZLIB_COMPRESSOR_FORMAT_GZIP ) );
+	archive.inStream = g_converter_input_stream_new( G_INPUT_STREAM( fileStream ), decompressor );
+	archive.checksum = g_checksum_new( G_CHECKSUM_SHA256 );
+
+	if( !archiveRead( &archive, magic, sizeof( magic ) ) || !archiveReadU32( &archive, &version )
+			|| !archiveReadU32( &archive, &schema ) || !archiveReadString( &archive, &length ) )
+		goto err;
+	if( memcmp( magic, ARCHIVE_MAGIC, sizeof( magic ) ) != 0 || GUINT32_FROM_LE( version ) > ARCHIVE_VERSION ) {
+		g_set_error_literal( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Not a (supported) project archive" );
+		goto err;
+	}
+	sProject = g_strdup( sProjectTo ? sProjectTo : (gchar *)archive.buffer );
+
+	if( sqlite3_exec(db, "BEGIN IMMEDIATE;", NULL, NULL, NULL) != SQLITE_OK )
+		goto errDB;
+	bTransaction = TRUE;
+
+	while( !bEnd && archiveRead( &archive, &recordType, 1 ) ) {
+		switch( recordType ) {
+		case 'T':	// start of a table
+			sqlite3_finalize( stmt );
+			stmt = NULL;
+			g_strfreev( columnNames );
+			columnNames = NULL;
+
+			if( !archiveReadString( &archive, &length ) )
+				goto err;
+			for( iTable = 0; iTable < sizeof( archiveTables ) / sizeof( archiveTables[0] ); iTable++ )
+				if( g_strcmp0( (gchar *)archive.buffer, archiveTables[ iTable ].sTable ) == 0 )
+					break;
+			if( iTable == sizeof( archiveTables ) / sizeof( archiveTables[0] ) ) {
+				g_set_error( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+						"Unknown table in project archive (%s)", (gchar *)archive.buffer );
+				goto err;
 			}
-			pGlobal->sLastDirectory = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
 
-			// deprecated ... recovery of the selected calibration and trace profiles are determined from the project.
-			queryIndex++;
-			queryIndex++;
+			guint16 nColumnsLE;
+			if( !archiveRead( &archive, &nColumnsLE, sizeof( nColumnsLE ) ) )
+				goto err;
+			nColumns = GUINT16_FROM_LE( nColumnsLE );
+			columnNames = g_new0( gchar *, nColumns + 1 );
+			bindIndex = g_renew( gint, bindIndex, nColumns );
+			idColumn = axisColumn = INVALID;
+			for( gint i = 0; i < nColumns; i++ ) {
+				if( !archiveReadString( &archive, &length ) )
+					goto err;
+				columnNames[ i ] = g_strdup( (gchar *)archive.buffer );
+				// the archived sweeps are linked to their axis by rowid
+				if( g_strcmp0( archiveTables[ iTable ].sTable, "HP8753C_ARCHIVE_AXIS" ) == 0
+						&& g_strcmp0( columnNames[ i ], "ID" ) == 0 )
+					idColumn = i;
+				if( g_strcmp0( archiveTables[ iTable ].sTable, "HP8753C_TRACE_ARCHIVE" ) == 0
+						&& g_strcmp0( columnNames[ i ], "axis" ) == 0 )
+					axisColumn = i;
+			}
+			if( (stmt = prepareArchiveInsert( archiveTables[ iTable ].sTable, columnNames, nColumns,
+					archiveTables[ iTable ].bRowID, archiveTables[ iTable ].bShared ? eIMPORT_KEEP_EXISTING : policy,
+					bindIndex, &projectColumn )) == NULL )
+				goto err;
+			break;
 
-			pGlobal->sProject = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+		case 'R':	// a row of the current table
+			if( stmt == NULL ) {
+				g_set_error_literal( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Project archive is corrupt" );
+				goto err;
+			}
+			sqlite3_reset( stmt );
+			sqlite3_clear_bindings( stmt );
+			rowID = axisID = 0;
+			for( gint i = 0; i < nColumns; i++ ) {
+				gchar valueType;
+				guint64 value;
+				gdouble dValue;
+				gint rc = SQLITE_OK;
+
+				if( !archiveRead( &archive, &valueType, 1 ) )
+					goto err;
+				switch( valueType ) {
+				case 'i':
+				case 'f':
+					if( !archiveRead( &archive, &value, sizeof( value ) ) )
+						goto err;
+					value = GUINT64_FROM_LE( value );
+					if( i == idColumn )
+						rowID = (gint64)value;
+					else if( i == axisColumn )
+						axisID = (gint64)value;
+					if( bindIndex[ i ] == 0 )
+						break;
+					if( valueType == 'i' ) {
+						rc = sqlite3_bind_int64( stmt, bindIndex[ i ], (sqlite3_int64)value );
+					} else {
+						memcpy( &dValue, &value, sizeof( dValue ) );
+						rc = sqlite3_bind_double( stmt, bindIndex[ i ], dValue );
+					}
+					break;
+				case 't':
+				case 'b':
+					if( !archiveReadString( &archive, &length ) )
+						goto err;
+					if( bindIndex[ i ] == 0 )
+						break;
+					if( valueType == 't' )
+						rc = sqlite3_bind_text( stmt, bindIndex[ i ], (gchar *)archive.buffer, length, SQLITE_TRANSIENT );
+					else
+						rc = sqlite3_bind_blob( stmt, bindIndex[ i ], archive.buffer, length, SQLITE_TRANSIENT );
+					break;
+				case 'n':
+					break;
+				default:
+					g_set_error_literal( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Project archive is corrupt" );
+					goto err;
+				}
+				if( rc != SQLITE_OK )
+					goto errDB;
+			}
+			// the profiles go into the chosen project
+			if( projectColumn != INVALID
+					&& sqlite3_bind_text( stmt, bindIndex[ projectColumn ], sProject, STRLENGTH, SQLITE_STATIC ) != SQLITE_OK )
+				goto errDB;
+			// ... and the sweeps refer to the axes as imported
+			if( axisColumn != INVALID && bindIndex[ axisColumn ] != 0 ) {
+				gint64 *pAxisID = g_hash_table_lookup( axisIDs, &axisID );
+
+				if( (pAxisID ? sqlite3_bind_int64( stmt, bindIndex[ axisColumn ], *pAxisID )
+						: sqlite3_bind_null( stmt, bindIndex[ axisColumn ] )) != SQLITE_OK )
+					goto errDB;
+			}
+			if( sqlite3_step( stmt ) != SQLITE_DONE )
+				goto errDB;
+			if( idColumn != INVALID ) {
+				gint64 newID = sqlite3_last_insert_rowid( db );
 
-			// plot colors
-            size = sqlite3_column_bytes(stmt, queryIndex);
-			tBlob = sqlite3_column_blob(stmt, queryIndex++);
-            if( size == sizeof( plotElementColors ))
-                 memcpy( &plotElementColors, tBlob, sizeof( plotElementColors ));
-			// HPGL plot colors
-            size = sqlite3_column_bytes(stmt, queryIndex);
-			tBlob = sqlite3_column_blob(stmt, queryIndex++);
-            if( size == sizeof( HPGLpens ))
-                 memcpy( &HPGLpens, tBlob, sizeof( HPGLpens ));
+				g_hash_table_insert( axisIDs, g_memdup2( &rowID, sizeof( rowID ) ), g_memdup2( &newID, sizeof( newID ) ) );
+			} else {
+				// (an axis is only kept if a sweep imported uses it)
+				nImported += sqlite3_changes( db );
+			}
+			nRowsRead++;
+			break;
 
-			size = sqlite3_column_bytes(stmt, queryIndex);
-			tBlob = sqlite3_column_blob(stmt, queryIndex++);
-			if( size == sizeof( tLearnStringIndexes ))
-				 memcpy( &pGlobal->HP8753.analyzedLSindexes, tBlob, sizeof( tLearnStringIndexes ));
+		case 'E':	// end ... check the row count & checksum
+			if( !archiveReadU32( &archive, &nRowsArchive ) )
+				goto err;
+			g_checksum_get_digest( archive.checksum, digest, &digestLength );
+			if( !g_input_stream_read_all( archive.inStream, digestRead, sizeof( digestRead ), &nDigestRead, NULL, &archive.error ) )
+				goto err;
+			if( nRowsArchive != nRowsRead || nDigestRead != sizeof( digestRead )
+					|| memcmp( digest, digestRead, sizeof( digest ) ) != 0 ) {
+				g_set_error_literal( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+						"Project archive is corrupt (checksum error)" );
+				goto err;
+			}
+			bEnd = TRUE;
+			break;
 
-			pGlobal->HP8753.sProduct = g_strdup(  (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+		default:
+			g_set_error_literal( &archive.error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA, "Project archive is corrupt" );
+			goto err;
 		}
+	}
+	if( !bEnd )
+		goto err;
 
-		sqlite3_finalize(stmt);
+	sqlite3_finalize( stmt );
+	stmt = NULL;
+	// the axes of sweeps that were already archived are not needed
+	if( g_hash_table_size( axisIDs ) > 0 && pruneArchiveAxes() != OK )
+		goto cleanup;
+	if( sqlite3_exec(db, "COMMIT;", NULL, NULL, NULL) != SQLITE_OK )
+		goto errDB;
+	bTransaction = FALSE;
+
+	// replaced trace profiles may be in the cache
+	invalidateTraceCache( NULL, NULL );
+	if( psProject )
+		*psProject = g_strdup( sProject );
+	rtn = nImported;
+	goto cleanup;
+
+errDB:
+	if( policy == eIMPORT_ABORT_ON_CONFLICT && sqlite3_errcode( db ) == SQLITE_CONSTRAINT )
+		postMessageToMainLoop(TM_ERROR, "Import abandoned: a profile in the archive already exists");
+	else
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
+err:
+	if( archive.error ) {
+		postMessageToMainLoop(TM_ERROR, archive.error->message);
+		g_clear_error( &archive.error );
+	}
+cleanup:
+	sqlite3_finalize( stmt );
+	if( bTransaction )
+		sqlite3_exec(db, "ROLLBACK;", NULL, NULL, NULL);
+	g_strfreev( columnNames );
+	g_free( bindIndex );
+	g_hash_table_destroy( axisIDs );
+	g_free( sProject );
+	g_free( archive.buffer );
+	if( archive.checksum )
+		g_checksum_free( archive.checksum );
+	if( archive.inStream ) {
+		g_input_stream_close( archive.inStream, NULL, NULL );
+		g_object_unref( archive.inStream );
 	}
+	if( decompressor )
+		g_object_unref( decompressor );
+	if( fileStream )
+		g_object_unref( fileStream );
+	g_object_unref( file );
+	return rtn;
+}
 
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_UseGPIB_ID" )), pGlobal->flags.bGPIB_UseCardNoAndPID);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_SmithSpline" )), pGlobal->flags.bSmithSpline);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_ShowDateTime" )), pGlobal->flags.bShowDateTime);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_SmithGBnotRX" )), pGlobal->flags.bAdmitanceSmith);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_DeltaMarkerAbsolute" )), !pGlobal->flags.bDeltaMarkerZero);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_UserCalKit" )), pGlobal->flags.bSaveUserKit);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_DoNotRetrieveHPGL" )), pGlobal->flags.bDoNotRetrieveHPGLdata);
-    gtk_toggle_button_set_active( GTK_TOGGLE_BUTTON(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_ChkBtn_ShowHPlogo" )), pGlobal->flags.bHPlogo);
+/*
+ * Database maintenance
+ *
+ * Deleting and replacing profiles leaves free pages in the database file and the
+ * query planner has no statistics to work with. When the database has been idle for
+ * a while, a thread with its own connection releases the free pages (a few at a time so
+ * that the lock is only held briefly), refreshes the planner statistics and checks the
+ * integrity of the database. A full VACUUM is only run when the user asks for it. The results are posted to the main loop for display on
+ * the options page.
+ */
 
-	return bOptionsRecovered ? TRUE : FALSE;;
-}
+enum { eDBM_MAINTAIN = 1, eDBM_STATISTICS, eDBM_END };
 
+#define MAX_PROFILED_STATEMENTS	256
 
-/*!     \brief  Get the label & description of saved calibration kits
+static GThread		*pDBmaintenanceThread = NULL;
+static sqlite3		*dbMaintenance = NULL;		// the maintenance thread's connection (protected by maintenanceMutex)
+static GMutex		maintenanceMutex;
+static GAsyncQueue	*DBmaintenanceQueue = NULL;
+static gint			bStopDBmaintenance = FALSE;
+static gint			lastDBactivity = 0;			// s (monotonic clock) of the last statement on the main connection
+static GMutex		queryTimingMutex;
+static GHashTable	*queryTimings = NULL;		// SQL -> tDBqueryTiming (protected by queryTimingMutex)
+static gchar		*sLastIntegrity = NULL;		// only touched by the maintenance thread
+static gint64		lastMaintenance = 0, lastMaintenanceTime = 0, lastPagesReclaimed = 0;
+static gboolean		bVacuumAdvised = FALSE;		// only touched by the maintenance thread
+
+/*!     \brief  Record the time taken by each statement on the main connection
  *
- * Populate a list of available calibration kits
- * including the description.
+ * Called by Sqlite when each statement finishes (sqlite3_trace_v2 SQLITE_TRACE_PROFILE)
  *
- * \param  pGlobal      pointer to tGlobal structure (containing the pointer to list)
- * \return 				completion status
+ * \ingroup database
+ *
+ * \param type      trace event type (SQLITE_TRACE_PROFILE)
+ * \param context   unused
+ * \param pStmt     the prepared statement
+ * \param pElapsed  pointer to sqlite3_int64 holding the elapsed time in ns
+ * \return          0
  */
-gint
-inventorySavedCalibrationKits(tGlobal *pGlobal) {
-
-	g_list_free_full ( g_steal_pointer (&pGlobal->pCalKitList), (GDestroyNotify)freeCalListItem );
-	pGlobal->pCalKitList = NULL;
+static int
+sqlProfileCallback( unsigned type, void *context, void *pStmt, void *pElapsed ) {
+	const gchar *sSQL = sqlite3_sql( (sqlite3_stmt *)pStmt );
+	gint64 elapsed = *(sqlite3_int64 *)pElapsed;
+	tDBqueryTiming *pTiming;
+
+	g_atomic_int_set( &lastDBactivity, (gint)(g_get_monotonic_time() / G_USEC_PER_SEC) );
+	if( sSQL == NULL )
+		return 0;
 
-	tCalibrationKitIdentifier *pCal;
-	sqlite3_stmt *stmt = NULL;
-	gint queryIndex;
+	g_mutex_lock( &queryTimingMutex );
+	if( queryTimings == NULL )
+		queryTimings = g_hash_table_new( g_str_hash, g_str_equal );
+	if( (pTiming = g_hash_table_lookup( queryTimings, sSQL )) == NULL
+			&& g_hash_table_size( queryTimings ) < MAX_PROFILED_STATEMENTS ) {
+		pTiming = g_new0( tDBqueryTiming, 1 );
+		pTiming->sSQL = g_strdup( sSQL );
+		g_hash_table_insert( queryTimings, pTiming->sSQL, pTiming );
+	}
+	if( pTiming ) {
+		pTiming->nCalls++;
+		pTiming->totalTime += elapsed;
+		pTiming->maxTime = MAX( pTiming->maxTime, elapsed );
+	}
+	g_mutex_unlock( &queryTimingMutex );
 
-	if (sqlite3_prepare_v2(db,
-			"SELECT a.label, a.description "
-			" FROM CAL_KITS a;", -1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		return ERROR;
-	} else {
-		while (sqlite3_step(stmt) == SQLITE_ROW) {
-			pCal = g_new0(tCalibrationKitIdentifier, 1);
-			queryIndex = 0;
+	return 0;
+}
 
-			// label
-			pCal->sLabel = g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) );
-			// description
-			pCal->sDescription = g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) );
+/*!     \brief  Free a query timing (g_hash_table_foreach_remove callback)
+ *
+ * \param sSQL     key (freed with the timing)
+ * \param pTiming  pointer to the tDBqueryTiming
+ * \param udata    unused
+ * \return         TRUE to remove the entry
+ */
+static gboolean
+freeQueryTiming( gpointer sSQL, gpointer pTiming, gpointer udata ) {
+	g_free( ((tDBqueryTiming *)pTiming)->sSQL );
+	g_free( pTiming );
+	return TRUE;
+}
 
-			pGlobal->pCalKitList = g_list_prepend(pGlobal->pCalKitList, pCal);
-		}
-		sqlite3_finalize(stmt);
+/*!     \brief  Free the query timings of the main connection
+ */
+static void
+freeQueryTimings( void ) {
+	g_mutex_lock( &queryTimingMutex );
+	if( queryTimings ) {
+		g_hash_table_foreach_remove( queryTimings, freeQueryTiming, NULL );
+		g_hash_table_destroy( queryTimings );
+		queryTimings = NULL;
 	}
+	g_mutex_unlock( &queryTimingMutex );
+}
 
-	pGlobal->pCalKitList = g_list_sort (pGlobal->pCalKitList, (GCompareFunc)compareCalKitIdentifierItemForSort);
-	return OK;
+/*!     \brief  Sort query timings by decreasing mean time
+ *
+ * \param pA       pointer to first tDBqueryTiming pointer
+ * \param pB       pointer to second tDBqueryTiming pointer
+ * \return         <0, 0 or >0
+ */
+static gint
+compareQueryTimings( gconstpointer pA, gconstpointer pB ) {
+	const tDBqueryTiming *pTimingA = *(tDBqueryTiming **)pA, *pTimingB = *(tDBqueryTiming **)pB;
+	gdouble meanA = pTimingA->totalTime / (gdouble)pTimingA->nCalls;
+	gdouble meanB = pTimingB->totalTime / (gdouble)pTimingB->nCalls;
+
+	return meanA < meanB ? 1 : (meanA > meanB ? -1 : 0);
 }
 
-/*!     \brief  Get the projects
+/*!     \brief  Free the tDBstatistics posted by the maintenance thread
  *
- * Populate a list of available projects
+ * \ingroup database
  *
- * \param  pGlobal      pointer to tGlobal structure (containing the pointer to list)
- * \return 				completion status
+ * \param pStats    pointer to the statistics
  */
-gint
-inventoryProjects(tGlobal *pGlobal) {
+void
+freeDBstatistics( tDBstatistics *pStats ) {
+	if( pStats == NULL )
+		return;
+	for( gint i = 0; i < pStats->nQueryTimings; i++ )
+		g_free( pStats->queryTimings[ i ].sSQL );
+	g_free( pStats->sIntegrity );
+	g_free( pStats );
+}
 
-	g_list_free_full ( g_steal_pointer (&pGlobal->pProjectList), (GDestroyNotify)g_free );
-	pGlobal->pProjectList = NULL;
+/*!     \brief  Get a single integer from a query (or pragma)
+ *
+ * \param dbm       database connection
+ * \param sSQL      SQL returning an integer in the first column of the first row
+ * \param pValue    pointer to the value returned
+ * \return          OK or ERROR
+ */
+static gint
+queryInteger( sqlite3 *dbm, const gchar *sSQL, gint64 *pValue ) {
 	sqlite3_stmt *stmt = NULL;
-	gint queryIndex;
+	gint rtn = ERROR;
 
-	if (sqlite3_prepare_v2(db,
-			"SELECT DISTINCT project FROM  HP8753C_TRACEDATA"
-			" UNION SELECT DISTINCT project FROM HP8753C_CALIBRATION;", -1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		return ERROR;
-	} else {
-		while (sqlite3_step(stmt) == SQLITE_ROW) {
-			queryIndex = 0;
-			pGlobal->pProjectList = g_list_prepend(pGlobal->pProjectList, g_strdup( (gchar *)sqlite3_column_text(stmt, queryIndex++) ));
+	if( sqlite3_prepare_v2( dbm, sSQL, -1, &stmt, NULL ) == SQLITE_OK
+			&& sqlite3_step( stmt ) == SQLITE_ROW ) {
+		*pValue = sqlite3_column_int64( stmt, 0 );
+		rtn = OK;
+	}
+	sqlite3_finalize( stmt );
+	return rtn;
+}
+
+/*!     \brief  Has the main connection been idle long enough for maintenance
+ *
+ * \return          TRUE if there was no database activity for DB_IDLE_TIME
+ */
+static gboolean
+isDBidle( void ) {
+	return (gint)(g_get_monotonic_time() / G_USEC_PER_SEC) - g_atomic_int_get( &lastDBactivity ) >= DB_IDLE_TIME;
+}
+
+/*!     \brief  Gather the database statistics
+ *
+ * \param dbm       the maintenance database connection
+ * \return          g_malloced statistics (free with freeDBstatistics)
+ */
+static tDBstatistics *
+gatherDBstatistics( sqlite3 *dbm ) {
+	tDBstatistics *pStats = g_new0( tDBstatistics, 1 );
+	const gchar *sDBfile = sqlite3_db_filename( dbm, "main" );
+	GStatBuf statBuf;
+	GPtrArray *pTimings;
+
+	if( sDBfile && g_stat( sDBfile, &statBuf ) == 0 ) {
+		gchar *sWALfile = g_strdup_printf( "%s-wal", sDBfile );
+		pStats->fileSize = statBuf.st_size;
+		if( g_stat( sWALfile, &statBuf ) == 0 )
+			pStats->fileSize += statBuf.st_size;
+		g_free( sWALfile );
+	}
+	queryInteger( dbm, "PRAGMA page_size;", &pStats->pageSize );
+	queryInteger( dbm, "PRAGMA page_count;", &pStats->nPages );
+	queryInteger( dbm, "PRAGMA freelist_count;", &pStats->nFreePages );
+	queryInteger( dbm, "SELECT COUNT(*) FROM (SELECT project FROM HP8753C_CALIBRATION"
+			" UNION SELECT project FROM HP8753C_TRACEDATA);", &pStats->nProjects );
+	queryInteger( dbm, "SELECT COUNT(*) FROM HP8753C_CALIBRATION WHERE channel=0;", &pStats->nCalibrations );
+	queryInteger( dbm, "SELECT COUNT(*) FROM HP8753C_TRACEDATA WHERE channel=0;", &pStats->nTraces );
+	queryInteger( dbm, "SELECT COUNT(*) FROM HP8753C_TRACE_ARCHIVE;", &pStats->nArchivedSweeps );
+	queryInteger( dbm, "SELECT COUNT(*) FROM CAL_KITS;", &pStats->nCalKits );
+
+	pStats->sIntegrity = g_strdup( sLastIntegrity );
+	pStats->lastMaintenance = lastMaintenance;
+	pStats->maintenanceTime = lastMaintenanceTime;
+	pStats->nPagesReclaimed = lastPagesReclaimed;
+
+	// the slowest statements (by mean time) executed on the main connection
+	g_mutex_lock( &queryTimingMutex );
+	if( queryTimings ) {
+		pTimings = g_ptr_array_new();
+		GHashTableIter iter;
+		gpointer pTiming;
+		g_hash_table_iter_init( &iter, queryTimings );
+		while( g_hash_table_iter_next( &iter, NULL, &pTiming ) )
+			g_ptr_array_add( pTimings, pTiming );
+		g_ptr_array_sort( pTimings, compareQueryTimings );
+		for( gint i = 0; i < pTimings->len && i < DB_NUM_QUERY_TIMINGS; i++ ) {
+			pStats->queryTimings[ i ] = *(tDBqueryTiming *)g_ptr_array_index( pTimings, i );
+			pStats->queryTimings[ i ].sSQL = g_strdup( pStats->queryTimings[ i ].sSQL );
+			pStats->nQueryTimings++;
 		}
-		sqlite3_finalize(stmt);
+		g_ptr_array_free( pTimings, TRUE );
 	}
+	g_mutex_unlock( &queryTimingMutex );
 
-	pGlobal->pProjectList = g_list_sort (pGlobal->pProjectList, (GCompareFunc)g_strcmp0);
-	return OK;
+	return pStats;
 }
 
-/*!     \brief  Save the calibration kit
+/*!     \brief  Vacuum, analyze and check the database
  *
- * Save the program options (on shutdown)
+ * Runs on the maintenance thread with its own connection.
  *
- * \param pGlobal      pointer to tGlobal structure
- * \return 			   completion status
+ * \param dbm       the maintenance database connection
+ * \param bForce    do not give way to the main connection (maintenance requested by the user)
+ * \return          OK or ERROR
  */
-gint
-saveCalKit(tGlobal *pGlobal) {
-
+static gint
+maintainDB( sqlite3 *dbm, gboolean bForce ) {
+	gint64 autoVacuum = 0, nFreePages = 0, nStatTables = 0;
+	gint64 startTime = g_get_monotonic_time();
 	sqlite3_stmt *stmt = NULL;
-	tCalibrationKitIdentifier *pCal;
-	gint queryIndex;
+	GString *sIntegrity;
 
-	if (sqlite3_prepare_v2(db,
-			"INSERT OR REPLACE INTO CAL_KITS"
-			" (label, description, standards, classes)"
-			" VALUES (?,?,?,?)", -1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		return ERROR;
+	lastPagesReclaimed = 0;
+
+	// Databases created before we used incremental vacuum must be rebuilt (once) to enable it.
+	// That holds the lock for as long as it takes to copy the whole database, so it is
+	// only done when the user asks for maintenance.
+	if( queryInteger( dbm, "PRAGMA auto_vacuum;", &autoVacuum ) != OK )
+		goto err;
+	if( autoVacuum != 2 /* INCREMENTAL */ ) {
+		if( bForce ) {
+			if( sqlite3_exec( dbm, "PRAGMA auto_vacuum = INCREMENTAL; VACUUM;", NULL, NULL, NULL ) != SQLITE_OK )
+				goto err;
+			autoVacuum = 2;
+		} else if( !bVacuumAdvised ) {
+			postInfo( "Press \"Maintain Now\" (Options) to release the free space in the database" );
+			bVacuumAdvised = TRUE;
+		}
 	}
-	queryIndex = 0;
-	if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753calibrationKit.label,
-			strlen( pGlobal->HP8753calibrationKit.label ), SQLITE_STATIC) != SQLITE_OK)
-			goto err;
-	if (sqlite3_bind_text(stmt, ++queryIndex, pGlobal->HP8753calibrationKit.description,
-			strlen( pGlobal->HP8753calibrationKit.description ), SQLITE_STATIC) != SQLITE_OK)
+
+	// Release the free pages a few at a time, giving way if the main connection becomes busy
+	while( autoVacuum == 2 && !g_atomic_int_get( &bStopDBmaintenance ) && (bForce || isDBidle())
+			&& queryInteger( dbm, "PRAGMA freelist_count;", &nFreePages ) == OK && nFreePages > 0 ) {
+		if( sqlite3_exec( dbm, "PRAGMA incremental_vacuum(" G_STRINGIFY( DB_VACUUM_STEP ) ");",
+				NULL, NULL, NULL ) != SQLITE_OK )
 			goto err;
-	if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753calibrationKit.calibrationStandards,
-			sizeof( tHP8753calibrationStandard) * MAX_CAL_STANDARDS, SQLITE_STATIC) != SQLITE_OK)
+		lastPagesReclaimed += MIN( nFreePages, DB_VACUUM_STEP );
+	}
+
+	// Query planner statistics (a full analysis the first time, afterwards only when useful).
+	// Both only sample each index (analysis_limit) so the lock is held briefly.
+	if( queryInteger( dbm, "SELECT COUNT(*) FROM sqlite_master WHERE name='sqlite_stat1';", &nStatTables ) != OK )
 		goto err;
-	if (sqlite3_bind_blob(stmt, ++queryIndex, &pGlobal->HP8753calibrationKit.calibrationClasses,
-			sizeof( tHP8753calibrationClass) * MAX_CAL_CLASSES, SQLITE_STATIC) != SQLITE_OK)
+	if( sqlite3_exec( dbm, nStatTables == 0 ? "ANALYZE;" : "PRAGMA optimize;", NULL, NULL, NULL ) != SQLITE_OK )
 		goto err;
 
-	if (sqlite3_step(stmt) != SQLITE_DONE)
-		goto err;
-	sqlite3_finalize(stmt);
+	// Integrity check (report the first few problems)
+	if( !g_atomic_int_get( &bStopDBmaintenance ) ) {
+		if( sqlite3_prepare_v2( dbm, "PRAGMA integrity_check(10);", -1, &stmt, NULL ) != SQLITE_OK )
+			goto err;
+		sIntegrity = g_string_new( NULL );
+		while( sqlite3_step( stmt ) == SQLITE_ROW ) {
+			if( sIntegrity->len )
+				g_string_append_c( sIntegrity, '\n' );
+			g_string_append( sIntegrity, (const gchar *)sqlite3_column_text( stmt, 0 ) );
+		}
+		sqlite3_finalize( stmt );
+		g_free( sLastIntegrity );
+		sLastIntegrity = g_string_free( sIntegrity, FALSE );
+		if( g_strcmp0( sLastIntegrity, "ok" ) != 0 ) {
+			gchar *sError = g_strdup_printf( "Database integrity check failed: %s", sLastIntegrity );
+			postError( sError );
+			g_free( sError );
+		}
+	}
 
-	GList *listElement = g_list_find_custom( pGlobal->pCalKitList,
-							pGlobal->HP8753calibrationKit.label, (GCompareFunc)compareCalKitIdentifierItem );
-	if( listElement ) {
-		g_free(  ((tCalibrationKitIdentifier *)listElement->data)->sDescription );
-		((tCalibrationKitIdentifier *)listElement->data)->sDescription = g_strdup( pGlobal->HP8753calibrationKit.description );
-	} else {
-		pCal = g_new0(tCalibrationKitIdentifier, 1);
-		// label
-		pCal->sLabel = g_strdup( pGlobal->HP8753calibrationKit.label );
-		// description
-		pCal->sDescription = g_strdup( pGlobal->HP8753calibrationKit.description );
+	// keep the write ahead log small
+	sqlite3_exec( dbm, "PRAGMA wal_checkpoint(TRUNCATE);", NULL, NULL, NULL );
 
-		pGlobal->pCalKitList = g_list_prepend(pGlobal->pCalKitList, pCal);
-		pGlobal->pCalKitList = g_list_sort (pGlobal->pCalKitList, (GCompareFunc)compareCalKitIdentifierItemForSort);
-	}
+	lastMaintenance = g_get_real_time();
+	lastMaintenanceTime = g_get_monotonic_time() - startTime;
 	return OK;
-err:
-	postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-	sqlite3_finalize(stmt);
 
+err:
+	// an interrupted maintenance (because we are closing) is not an error
+	if( !g_atomic_int_get( &bStopDBmaintenance ) )
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(dbm));
 	return ERROR;
 }
 
-/*!     \brief  Recover the calibration kit
+/*!     \brief  Database maintenance thread
  *
- * Recover the calibration kit
+ * Wait for a request (or the maintenance interval) and maintain the database
+ * when it is not being used by the main connection.
  *
- * \param pGlobal      pointer to tGlobal structure
- * \param sLabel       calibration kit label
- * \return 			   completion status
+ * \param pDBfile   g_malloced name of the database file (freed by the thread)
+ * \return          NULL
  */
-gint
-recoverCalibrationKit(tGlobal *pGlobal, gchar *sLabel) {
-	sqlite3_stmt *stmt = NULL;
-	gint length;
-	const guchar *tBlob;
-	gint queryIndex;
-	gboolean bError = FALSE;
-
-	if (sqlite3_prepare_v2(db,
-			"SELECT label, description, standards, "
-			"  classes FROM CAL_KITS WHERE label = (?);",
-			-1, &stmt, NULL) != SQLITE_OK) {
-		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-		return ERROR;
-	} else {
-
-		sqlite3_bind_text(stmt, 1, sLabel, strlen(sLabel), SQLITE_STATIC);
-
-		while (sqlite3_step(stmt) == SQLITE_ROW) {
-			queryIndex = 0;
-
-			g_strlcpy( pGlobal->HP8753calibrationKit.label, (gchar *)sqlite3_column_text(stmt, queryIndex++), MAX_CALKIT_LABEL_SIZE );
-			g_strlcpy( pGlobal->HP8753calibrationKit.description, (gchar *)sqlite3_column_text(stmt, queryIndex++), MAX_CALKIT_LABEL_SIZE );
+static gpointer
+threadDBmaintenance( gpointer pDBfile ) {
+	sqlite3 *dbm = NULL;
+	gint64 nextMaintenance = g_get_monotonic_time() + (gint64)DB_MAINTENANCE_DELAY * G_USEC_PER_SEC;
+	gint command;
+	gboolean bScheduled;
+
+	if( sqlite3_open_v2( (gchar *)pDBfile, &dbm, SQLITE_OPEN_READWRITE, NULL ) != SQLITE_OK ) {
+		postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(dbm));
+		sqlite3_close( dbm );
+		g_free( pDBfile );
+		return NULL;
+	}
+	sqlite3_busy_timeout( dbm, DB_BUSY_TIMEOUT );
+	sqlite3_exec( dbm, "PRAGMA analysis_limit = " G_STRINGIFY( DB_ANALYSIS_LIMIT ) ";", NULL, NULL, NULL );
+	g_mutex_lock( &maintenanceMutex );
+	dbMaintenance = dbm;
+	g_mutex_unlock( &maintenanceMutex );
 
-			length = sqlite3_column_bytes(stmt, queryIndex);
-			if( !bError && length == sizeof( tHP8753calibrationStandard ) * MAX_CAL_STANDARDS ) {
-				tBlob = sqlite3_column_blob(stmt, queryIndex++);
-				memcpy( &pGlobal->HP8753calibrationKit.calibrationStandards, tBlob, sizeof( tHP8753calibrationStandard ) * MAX_CAL_STANDARDS  );
-			} else {
-				bError = TRUE;
-			}
+	for( ;; ) {
+		gint64 wait = MAX( nextMaintenance - g_get_monotonic_time(), 0 );
+		command = GPOINTER_TO_INT( g_async_queue_timeout_pop( DBmaintenanceQueue, wait ) );
 
-			length = sqlite3_column_bytes(stmt, queryIndex);
-			if( !bError && length == sizeof( tHP8753calibrationClass ) * MAX_CAL_CLASSES ) {
-				tBlob = sqlite3_column_blob(stmt, queryIndex++);
-				memcpy( &pGlobal->HP8753calibrationKit.calibrationClasses, tBlob, sizeof( tHP8753calibrationClass ) * MAX_CAL_CLASSES  );
-			} else {
-				bError = TRUE;
+		if( command == eDBM_END )
+			break;
+		if( (bScheduled = (command == 0)) ) {
+			// scheduled maintenance is postponed while the database is in use
+			if( !isDBidle() ) {
+				nextMaintenance = g_get_monotonic_time() + (gint64)DB_IDLE_TIME * G_USEC_PER_SEC;
+				continue;
 			}
+			command = eDBM_MAINTAIN;
 		}
-
-		sqlite3_finalize(stmt);
+		if( command == eDBM_MAINTAIN ) {
+			maintainDB( dbm, !bScheduled );
+			nextMaintenance = g_get_monotonic_time() + (gint64)DB_MAINTENANCE_INTERVAL * G_USEC_PER_SEC;
+		}
+		if( !g_atomic_int_get( &bStopDBmaintenance ) )
+			postDataToMainLoop( TM_DB_STATISTICS, gatherDBstatistics( dbm ) );
 	}
-	return (bError ? ERROR : 0);
-}
-
 
+	g_mutex_lock( &maintenanceMutex );
+	dbMaintenance = NULL;
+	g_mutex_unlock( &maintenanceMutex );
+	sqlite3_close( dbm );
+	g_free( pDBfile );
+	return NULL;
+}
 
-/*!     \brief  reanme, move or copy project/cal/trace
+/*!     \brief  Start the database maintenance thread
  *
- * Rename database items
+ * \ingroup database
  *
- * \param pGlobal      pointer to tGlobal structure
- * \param target       enum indication if we are refering to the project, the calibration or the trace
- * \param purpose      enum indication if we are renaming, moving or copying
- * \param sWhat        the project or name to move, copy or the project (if renaming calibration or trace)
- * \param sFrom        the source
- * \param sTo          the new name or project
- * \return             completion status
+ * \return          OK or ERROR
  */
 gint
-renameMoveCopyDBitems(tGlobal *pGlobal, tRMCtarget target, tRMCpurpose purpose,
-        gchar *sWhat, gchar *sFrom, gchar *sTo) {
-    gint rtn = ERROR;
-    gchar *sSQL = 0;
-    sqlite3_stmt *stmt = NULL;
-    gint queryIndex=0;
-    gchar *sSQLquery;
-
-    switch( purpose ) {
-    case eMove:
-        if( target == eCalibrationName )
-            sSQLquery = "UPDATE HP8753C_CALIBRATION SET project = (?) "
-                        " WHERE project = (?) AND name = (?);";
-        else if( target == eTraceName )
-            sSQLquery = "UPDATE HP8753C_TRACEDATA SET project = (?) "
-                        " WHERE project = (?) AND name = (?);";
-        else
-            goto err;
-
-        if (sqlite3_prepare_v2(db, sSQLquery, -1, &stmt, NULL) != SQLITE_OK) {
-            postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-            goto err;
-        }
-        if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        break;
-    case eCopy:
-        if( target == eCalibrationName ) {
-            sSQLquery =
-                    "INSERT INTO HP8753C_CALIBRATION "
-                    " ( project, selected, name, channel, learn, sweepStart, sweepStop, "
-                    "   IFbandwidth, CWfrequency, sweepType, npoints, calType, "
-                    "   cal01, cal02, cal03, cal04, cal05, cal06, "
-                    "   caL07, cal08, cal09, cal10, cal11, cal12, "
-                    "   notes, perChannelCalSettings, calSettings )"
-                    " SELECT (?), 0, name, channel, learn, sweepStart, sweepStop, "
-                    "   IFbandwidth, CWfrequency, sweepType, npoints, calType, "
-                    "   cal01, cal02, cal03, cal04, cal05, cal06, "
-                    "   caL07, cal08, cal09, cal10, cal11, cal12, "
-                    "   notes, perChannelCalSettings, calSettings "
-                    " FROM HP8753C_CALIBRATION WHERE project = (?) AND name = (?);";
-        } else if( target == eTraceName ) {
-            sSQLquery =
-                    "INSERT INTO HP8753C_TRACEDATA "
-                    " ( project, selected, name, channel, sweepStart, sweepStop, "
-                    "   IFbandwidth, CWfrequency, sweepType, npoints, points, "
-                    "   stimulusPoints, format, scaleVal, scaleRefPos, scaleRefVal, "
-                    "   sParamOrInputPort, markers, activeMkr, deltaMkr, mkrType, "
-                    "   bandwidth, nSegments, segments, screenPlot, title, notes, "
-                    "   perChannelFlags, generalFlags, time ) "
-                    " SELECT (?), 0, name, channel, sweepStart, sweepStop, "
-                    "   IFbandwidth, CWfrequency, sweepType, npoints, points, "
-                    "   stimulusPoints, format, scaleVal, scaleRefPos, scaleRefVal, "
-                    "   sParamOrInputPort, markers, activeMkr, deltaMkr, mkrType, "
-                    "   bandwidth, nSegments, segments, screenPlot, title, notes, "
-                    "   perChannelFlags, generalFlags, time "
-                    " FROM HP8753C_TRACEDATA WHERE project = (?) AND name = (?);";
-        } else {
-            goto err;
-        }
-        if (sqlite3_prepare_v2(db, sSQLquery, -1, &stmt, NULL) != SQLITE_OK) {
-            postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-            goto err;
-        }
-        if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
-                goto err;
-        break;
-    case eRename:
-        switch( target ) {
-        case eProjectName:
-            if (sqlite3_prepare_v2(db,
-                    "UPDATE HP8753C_CALIBRATION SET project = (?) WHERE project = (?);",
-                    -1, &stmt, NULL) != SQLITE_OK) {
-                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-                goto err;
-            }
-            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_step(stmt) != SQLITE_DONE) goto err;
-            if (sqlite3_finalize(stmt) != SQLITE_OK) goto err;
-
-            if (sqlite3_prepare_v2(db,
-                    "UPDATE HP8753C_TRACEDATA SET project = (?) WHERE project = (?);",
-                    -1, &stmt, NULL) != SQLITE_OK) {
-                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-                goto err;
-            }
-            queryIndex = 0;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            break;
-        case eCalibrationName:
-            if (sqlite3_prepare_v2(db,
-                    "UPDATE HP8753C_CALIBRATION SET name = (?) "
-                    "   WHERE name = (?) AND project = (?);",
-                    -1, &stmt, NULL) != SQLITE_OK) {
-                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-                goto err;
-            }
-            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            break;
-        case eTraceName:
-            if (sqlite3_prepare_v2(db,
-                    "UPDATE HP8753C_TRACEDATA SET name = (?) "
-                    "   WHERE name = (?) AND project = (?);",
-                    -1, &stmt, NULL) != SQLITE_OK) {
-                postMessageToMainLoop(TM_ERROR, (gchar*) sqlite3_errmsg(db));
-                goto err;
-            }
-            if (sqlite3_bind_text(stmt, ++queryIndex, sTo, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sFrom, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            if (sqlite3_bind_text(stmt, ++queryIndex, sWhat, -1, SQLITE_STATIC) != SQLITE_OK)
-                    goto err;
-            break;
-        }
+startDBmaintenance( void ) {
+	const gchar *sDBfile;
 
-        break;
-    default:
-        goto err;
-        break;
-    }
+	if( db == NULL || pDBmaintenanceThread != NULL
+			|| (sDBfile = sqlite3_db_filename( db, "main" )) == NULL || *sDBfile == 0 )
+		return ERROR;
 
-    if (sqlite3_step(stmt) != SQLITE_DONE)
-        goto err;
-    rtn = 0;
-err:
-    g_free( sSQL );
-    sqlite3_finalize(stmt);
-    return rtn;
+	g_atomic_int_set( &bStopDBmaintenance, FALSE );
+	DBmaintenanceQueue = g_async_queue_new();
+	pDBmaintenanceThread = g_thread_new( "DBmaintenance", threadDBmaintenance, g_strdup( sDBfile ) );
+	return OK;
 }
 
+/*!     \brief  Ask the maintenance thread for maintenance or statistics
+ *
+ * The results are posted to the main loop (TM_DB_STATISTICS)
+ *
+ * \ingroup database
+ *
+ * \param bMaintain TRUE to maintain the database now (even if in use), FALSE for statistics only
+ */
+void
+requestDBmaintenance( gboolean bMaintain ) {
+	if( DBmaintenanceQueue )
+		g_async_queue_push( DBmaintenanceQueue, GINT_TO_POINTER( bMaintain ? eDBM_MAINTAIN : eDBM_STATISTICS ) );
+}
 
-/*!     \brief  Close the Sqlite3 database
+/*!     \brief  Stop the database maintenance thread
  *
- * Close the Sqlite3 database prior to ending program
+ * Any maintenance in progress is cut short (the incremental vacuum is abandoned between steps)
  *
+ * \ingroup database
  */
-void closeDB(void) {
-	sqlite3_close(db);
-	sqlite3_shutdown();
+void
+stopDBmaintenance( void ) {
+	if( pDBmaintenanceThread == NULL )
+		return;
+
+	g_atomic_int_set( &bStopDBmaintenance, TRUE );
+	g_async_queue_push_front( DBmaintenanceQueue, GINT_TO_POINTER( eDBM_END ) );
+	// cut short a long running statement (sqlite3_interrupt may be called from any thread)
+	g_mutex_lock( &maintenanceMutex );
+	if( dbMaintenance )
+		sqlite3_interrupt( dbMaintenance );
+	g_mutex_unlock( &maintenanceMutex );
+	g_thread_join( pDBmaintenanceThread );
+	pDBmaintenanceThread = NULL;
+	g_async_queue_unref( DBmaintenanceQueue );
+	DBmaintenanceQueue = NULL;
 }
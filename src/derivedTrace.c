@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * Quantities derived from a whole complex trace (reflection or transmission coefficient).
+ *
+ * Each quantity is calculated by a kernel that makes one pass over the trace with no
+ * branches in the loop (undefined values are selected as NAN) and no aliasing between
+ * the input and the outputs, so the compiler can vectorize the arithmetic.
+ * The input may be the planes of a tS2P (stride 1) or an array of tComplex (stride 2).
+ */
+
+// At -O2 GCC only vectorizes loops that need no scalar epilogue; allow the usual ones
+#if defined( __GNUC__ ) && !defined( __clang__ )
+#pragma GCC optimize ( "vect-cost-model=cheap" )
+#endif
+
+/*!     \brief  Describe an array of tComplex points as a complex trace
+ *
+ * \param points       complex points
+ * \param freq         frequency of each point (may be NULL if not needed)
+ * \param nPoints      number of points
+ * \return             the trace description
+ */
+tComplexTrace
+complexTraceOfPoints( const tComplex *points, const gdouble *freq, gint nPoints ) {
+	tComplexTrace trace = { &points[0].r, &points[0].i, sizeof( tComplex ) / sizeof( gdouble ), freq, nPoints };
+
+	return trace;
+}
+
+/*!     \brief  Describe an S-parameter of a tS2P as a complex trace
+ *
+ * \param pS2P         pointer to the S-parameters
+ * \param sParam       the S-parameter
+ * \return             the trace description
+ */
+tComplexTrace
+complexTraceOfS2P( const tS2P *pS2P, tS2Pparameter sParam ) {
+	tComplexTrace trace = { pS2P->re[ sParam ], pS2P->im[ sParam ], 1, pS2P->freq, pS2P->nPoints };
+
+	return trace;
+}
+
+static void
+componentKernel( const gdouble *restrict component, gsize stride, gint nPoints, gdouble *restrict out ) {
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = component[ i * stride ];
+}
+
+// |Γ|² (the magnitude is only taken where needed)
+static void
+magnitudeSquaredKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble *restrict out ) {
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = SQU( re[ i * stride ] ) + SQU( im[ i * stride ] );
+}
+
+static void
+linearMagnitudeKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble *restrict out ) {
+	magnitudeSquaredKernel( re, im, stride, nPoints, out );
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = sqrt( out[ i ] );
+}
+
+// 10 log10 |Γ|² ... negated for return loss (NAN for |Γ| = 0)
+static void
+logMagnitudeKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble sign, gdouble *restrict out ) {
+	magnitudeSquaredKernel( re, im, stride, nPoints, out );
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = out[ i ] > 0.0 ? sign * 10.0 * log10( out[ i ] ) : NAN;
+}
+
+static void
+phaseKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble *restrict out ) {
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = RAD2DEG( atan2( im[ i * stride ], re[ i * stride ] ) );
+}
+
+// remove the ±360° steps from the phase (in place)
+static void
+unwrapPhase( gint nPoints, gdouble *out ) {
+	gdouble offset = 0.0;
+
+	for( gint i = 1; i < nPoints; i++ ) {
+		gdouble step = out[ i ] + offset - out[ i - 1 ];
+
+		offset -= 360.0 * round( step / 360.0 );
+		out[ i ] += offset;
+	}
+}
+
+// (1 + |Γ|) / (1 - |Γ|) (NAN for |Γ| >= 1)
+static void
+SWRkernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble *restrict out ) {
+	linearMagnitudeKernel( re, im, stride, nPoints, out );
+	for( gint i = 0; i < nPoints; i++ )
+		out[ i ] = out[ i ] < 1.0 ? (1.0 + out[ i ]) / (1.0 - out[ i ]) : NAN;
+}
+
+/*
+ * Z = Z0 (1 + Γ) / (1 - Γ)
+ * Y = (1 - Γ) / ((1 + Γ) Z0)
+ * The sign selects impedance (+1) or admittance (-1) as they differ only in the sign of Γ
+ */
+static void
+immittanceKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		gint nPoints, gdouble sign, gdouble scale, gdouble *restrict outReal, gdouble *restrict outImag ) {
+	for( gint i = 0; i < nPoints; i++ ) {
+		gdouble gammaReal = sign * re[ i * stride ], gammaImag = sign * im[ i * stride ];
+		gdouble denominator = SQU( 1.0 - gammaReal ) + SQU( gammaImag );
+
+		outReal[ i ] = scale * (1.0 - SQU( gammaReal ) - SQU( gammaImag )) / denominator;
+		outImag[ i ] = scale * 2.0 * gammaImag / denominator;
+	}
+}
+
+/*
+ * Equivalent inductance and capacitance of a reactance (series) or susceptance (parallel).
+ * Positive reactance is an inductance X / ω and negative a capacitance -1 / (X ω);
+ * positive susceptance is a capacitance B / ω and negative an inductance -1 / (B ω).
+ * The element that does not apply is NAN.
+ */
+static void
+equivalentLCkernel( const gdouble *restrict reactive, const gdouble *restrict freq, gint nPoints, gboolean bSusceptance,
+		gdouble *restrict outL, gdouble *restrict outC ) {
+	for( gint i = 0; i < nPoints; i++ ) {
+		gdouble omega = 2.0 * G_PI * freq[ i ];
+		gdouble direct = reactive[ i ] / omega, inverse = -1.0 / (reactive[ i ] * omega);
+		gboolean bPositive = reactive[ i ] >= 0.0;
+
+		if( bSusceptance ) {
+			outC[ i ] = bPositive ? direct : NAN;
+			outL[ i ] = bPositive ? NAN : inverse;
+		} else {
+			outL[ i ] = bPositive ? direct : NAN;
+			outC[ i ] = bPositive ? NAN : inverse;
+		}
+	}
+}
+
+/*!     \brief  Group delay by finite difference of the phase
+ *
+ * The phase change between the neighbouring points is the angle of next × conj(previous),
+ * so the phase need not be unwrapped. The difference is one sided at the ends of the trace.
+ * Points where the frequency does not increase are NAN.
+ */
+static void
+groupDelayKernel( const gdouble *restrict re, const gdouble *restrict im, gsize stride,
+		const gdouble *restrict freq, gint nPoints, gdouble *restrict out ) {
+	for( gint i = 0; i < nPoints; i++ ) {
+		gint previous = i > 0 ? i - 1 : i, next = i < nPoints - 1 ? i + 1 : i;
+		gdouble pr = re[ previous * stride ], pi = im[ previous * stride ];
+		gdouble nr = re[ next * stride ], ni = im[ next * stride ];
+		gdouble dFreq = freq[ next ] - freq[ previous ];
+		gdouble dPhase = atan2( ni * pr - nr * pi, nr * pr + ni * pi );
+
+		out[ i ] = dFreq > 0.0 ? -dPhase / (2.0 * G_PI * dFreq) : NAN;
+	}
+}
+
+/*!     \brief  Calculate a derived quantity over a whole complex trace
+ *
+ * Complex results (impedance and admittance) and the equivalent L and C use both outputs;
+ * the others only the first. Values that are not defined at a point
+ * (such as the SWR of |Γ| >= 1) are NAN.
+ *
+ * \param quantity             the quantity to calculate
+ * \param pTrace               the complex trace (with the frequencies for delay and L / C)
+ * \param referenceImpedance   reference impedance for impedance, admittance and L / C (Ω)
+ * \param out                  array of nPoints for the result (the real part, or L)
+ * \param out2                 array of nPoints for the imaginary part (or C) ... or NULL for scalar quantities
+ * \return                     OK or ERROR if the quantity needs an input that was not given
+ */
+gint
+deriveTrace( tDerivedQuantity quantity, const tComplexTrace *pTrace, gdouble referenceImpedance,
+		gdouble *out, gdouble *out2 ) {
+	const gdouble *re = pTrace->re, *im = pTrace->im;
+	gsize stride = pTrace->stride;
+	gint nPoints = pTrace->nPoints;
+	gdouble *reactive;
+
+	if( nPoints <= 0 )
+		return OK;
+	if( (quantity >= eDERIVED_IMPEDANCE && out2 == NULL)
+			|| ((quantity == eDERIVED_DELAY || quantity >= eDERIVED_SERIES_LC) && pTrace->freq == NULL) )
+		return ERROR;
+
+	switch( quantity ) {
+	case eDERIVED_LOGM:
+		logMagnitudeKernel( re, im, stride, nPoints, 1.0, out );
+		break;
+	case eDERIVED_RETURN_LOSS:
+		logMagnitudeKernel( re, im, stride, nPoints, -1.0, out );
+		break;
+	case eDERIVED_LINM:
+		linearMagnitudeKernel( re, im, stride, nPoints, out );
+		break;
+	case eDERIVED_PHASE:
+		phaseKernel( re, im, stride, nPoints, out );
+		break;
+	case eDERIVED_UNWRAPPED_PHASE:
+		phaseKernel( re, im, stride, nPoints, out );
+		unwrapPhase( nPoints, out );
+		break;
+	case eDERIVED_DELAY:
+		groupDelayKernel( re, im, stride, pTrace->freq, nPoints, out );
+		break;
+	case eDERIVED_SWR:
+		SWRkernel( re, im, stride, nPoints, out );
+		break;
+	case eDERIVED_REAL:
+		componentKernel( re, stride, nPoints, out );
+		break;
+	case eDERIVED_IMAG:
+		componentKernel( im, stride, nPoints, out );
+		break;
+	case eDERIVED_IMPEDANCE:
+		immittanceKernel( re, im, stride, nPoints, 1.0, referenceImpedance, out, out2 );
+		break;
+	case eDERIVED_ADMITTANCE:
+		immittanceKernel( re, im, stride, nPoints, -1.0, 1.0 / referenceImpedance, out, out2 );
+		break;
+	case eDERIVED_SERIES_LC:
+	case eDERIVED_PARALLEL_LC:
+		// the reactance (or susceptance) is needed before L and C are known
+		reactive = g_new( gdouble, nPoints );
+		immittanceKernel( re, im, stride, nPoints,
+				quantity == eDERIVED_SERIES_LC ? 1.0 : -1.0,
+				quantity == eDERIVED_SERIES_LC ? referenceImpedance : 1.0 / referenceImpedance, out, reactive );
+		equivalentLCkernel( reactive, pTrace->freq, nPoints, quantity == eDERIVED_PARALLEL_LC, out, out2 );
+		g_free( reactive );
+		break;
+	default:
+		return ERROR;
+	}
+	return OK;
+}
+
+/*!     \brief  The derived quantity shown by a display format
+ *
+ * \param format       display format
+ * \return             the derived quantity or INVALID for the complex formats (Smith and polar)
+ */
+gint
+derivedQuantityOfFormat( tFormat format ) {
+	switch( format ) {
+	case eFMT_LOGM:		return eDERIVED_LOGM;
+	case eFMT_PHASE:	return eDERIVED_PHASE;
+	case eFMT_DELAY:	return eDERIVED_DELAY;
+	case eFMT_LINM:		return eDERIVED_LINM;
+	case eFMT_SWR:		return eDERIVED_SWR;
+	case eFMT_REAL:		return eDERIVED_REAL;
+	case eFMT_IMAG:		return eDERIVED_IMAG;
+	case eFMT_SMITH:
+	case eFMT_POLAR:
+	default:			return INVALID;
+	}
+}
@@ -0,0 +1,928 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <hp8753.h>
+#include <math.h>
+#include <errno.h>
+
+#include "messageEvent.h"
+
+/*
+ * Export of S-parameter (Touchstone) and trace (CSV) data files
+ *
+ * Numbers are formatted with the Grisu2 algorithm (Florian Loitsch, "Printing Floating-Point
+ * Numbers Quickly and Accurately with Integers", PLDI 2010) which gives the shortest string
+ * that reads back as the same double, without the cost of printf. Lines are assembled in a
+ * large buffer that is written to the file when full.
+ *
+ * The data is copied and the file is written by a background thread, so the main loop
+ * is not held up while large files are written.
+ */
+
+// Powers of ten 10^-348 ... 10^340 (in steps of 8) as normalized 64 bit significands and binary exponents
+static const guint64 cachedPowersF[] = {
+	0xfa8fd5a0081c0288, 0xbaaee17fa23ebf76, 0x8b16fb203055ac76,
+	0xcf42894a5dce35ea, 0x9a6bb0aa55653b2d, 0xe61acf033d1a45df,
+	0xab70fe17c79ac6ca, 0xff77b1fcbebcdc4f, 0xbe5691ef416bd60c,
+	0x8dd01fad907ffc3c, 0xd3515c2831559a83, 0x9d71ac8fada6c9b5,
+	0xea9c227723ee8bcb, 0xaecc49914078536d, 0x823c12795db6ce57,
+	0xc21094364dfb5637, 0x9096ea6f3848984f, 0xd77485cb25823ac7,
+	0xa086cfcd97bf97f4, 0xef340a98172aace5, 0xb23867fb2a35b28e,
+	0x84c8d4dfd2c63f3b, 0xc5dd44271ad3cdba, 0x936b9fcebb25c996,
+	0xdbac6c247d62a584, 0xa3ab66580d5fdaf6, 0xf3e2f893dec3f126,
+	0xb5b5ada8aaff80b8, 0x87625f056c7c4a8b, 0xc9bcff6034c13053,
+	0x964e858c91ba2655, 0xdff9772470297ebd, 0xa6dfbd9fb8e5b88f,
+	0xf8a95fcf88747d94, 0xb94470938fa89bcf, 0x8a08f0f8bf0f156b,
+	0xcdb02555653131b6, 0x993fe2c6d07b7fac, 0xe45c10c42a2b3b06,
+	0xaa242499697392d3, 0xfd87b5f28300ca0e, 0xbce5086492111aeb,
+	0x8cbccc096f5088cc, 0xd1b71758e219652c, 0x9c40000000000000,
+	0xe8d4a51000000000, 0xad78ebc5ac620000, 0x813f3978f8940984,
+	0xc097ce7bc90715b3, 0x8f7e32ce7bea5c70, 0xd5d238a4abe98068,
+	0x9f4f2726179a2245, 0xed63a231d4c4fb27, 0xb0de65388cc8ada8,
+	0x83c7088e1aab65db, 0xc45d1df942711d9a, 0x924d692ca61be758,
+	0xda01ee641a708dea, 0xa26da3999aef774a, 0xf209787bb47d6b85,
+	0xb454e4a179dd1877, 0x865b86925b9bc5c2, 0xc83553c5c8965d3d,
+	0x952ab45cfa97a0b3, 0xde469fbd99a05fe3, 0xa59bc234db398c25,
+	0xf6c69a72a3989f5c, 0xb7dcbf5354e9bece, 0x88fcf317f22241e2,
+	0xcc20ce9bd35c78a5, 0x98165af37b2153df, 0xe2a0b5dc971f303a,
+	0xa8d9d1535ce3b396, 0xfb9b7cd9a4a7443c, 0xbb764c4ca7a44410,
+	0x8bab8eefb6409c1a, 0xd01fef10a657842c, 0x9b10a4e5e9913129,
+	0xe7109bfba19c0c9d, 0xac2820d9623bf429, 0x80444b5e7aa7cf85,
+	0xbf21e44003acdd2d, 0x8e679c2f5e44ff8f, 0xd433179d9c8cb841,
+	0x9e19db92b4e31ba9, 0xeb96bf6ebadf77d9, 0xaf87023b9bf0ee6b,
+};
+
+static const gint16 cachedPowersE[] = {
+	-1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+	-954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+	-688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+	-422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+	-157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+	109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+	375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+	641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+	907, 933, 960, 986, 1013, 1039, 1066,
+};
+
+static const guint64 pow10u64[] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+	1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+	100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+	1000000000000000000ULL, 10000000000000000000ULL
+};
+
+#define DP_SIGNIFICAND_MASK	0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT		0x0010000000000000ULL
+#define DP_EXPONENT_BIAS	1075		// 0x3FF + 52
+
+// "do it yourself" floating point: f × 2^e
+typedef struct {
+	guint64	f;
+	gint	e;
+} tDiyFp;
+
+static inline tDiyFp
+diyFpFromDouble( gdouble value ) {
+	union { gdouble d; guint64 u; } bits = { .d = value };
+	gint biasedExponent = (gint)((bits.u >> 52) & 0x7FF);
+	guint64 significand = bits.u & DP_SIGNIFICAND_MASK;
+
+	if( biasedExponent != 0 )
+		return (tDiyFp){ significand + DP_HIDDEN_BIT, biasedExponent - DP_EXPONENT_BIAS };
+	else
+		return (tDiyFp){ significand, 1 - DP_EXPONENT_BIAS };
+}
+
+static inline tDiyFp
+diyFpMultiply( tDiyFp x, tDiyFp y ) {
+	const guint64 M32 = 0xFFFFFFFFULL;
+	guint64 a = x.f >> 32, b = x.f & M32, c = y.f >> 32, d = y.f & M32;
+	guint64 ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+	guint64 tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+
+	tmp += 1U << 31;	// round
+	return (tDiyFp){ ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), x.e + y.e + 64 };
+}
+
+static inline tDiyFp
+diyFpNormalize( tDiyFp x ) {
+	gint shift = __builtin_clzll( x.f );
+	return (tDiyFp){ x.f << shift, x.e - shift };
+}
+
+/*!     \brief  Boundaries m- and m+ of the double (half way to its neighbours)
+ *
+ * \param v        the double as a tDiyFp
+ * \param pMinus   lower boundary (with the same exponent as the upper)
+ * \param pPlus    normalized upper boundary
+ */
+static inline void
+normalizedBoundaries( tDiyFp v, tDiyFp *pMinus, tDiyFp *pPlus ) {
+	tDiyFp plus = { (v.f << 1) + 1, v.e - 1 };
+	tDiyFp minus;
+
+	while( !(plus.f & (DP_HIDDEN_BIT << 1)) ) {
+		plus.f <<= 1;
+		plus.e--;
+	}
+	plus.f <<= (64 - 52 - 2);
+	plus.e -= (64 - 52 - 2);
+
+	if( v.f == DP_HIDDEN_BIT )
+		minus = (tDiyFp){ (v.f << 2) - 1, v.e - 2 };
+	else
+		minus = (tDiyFp){ (v.f << 1) - 1, v.e - 1 };
+	minus.f <<= minus.e - plus.e;
+	minus.e = plus.e;
+
+	*pMinus = minus;
+	*pPlus = plus;
+}
+
+/*!     \brief  Cached power of ten that brings the binary exponent into range
+ *
+ * \param e        binary exponent of the value to scale
+ * \param pK       returns the decimal exponent of the (inverse) cached power
+ * \return         the cached power
+ */
+static inline tDiyFp
+cachedPower( gint e, gint *pK ) {
+	gdouble dk = (-61 - e) * 0.30102999566398114 + 347;	// dk must be positive so can use ceiling
+	gint k = (gint)dk;
+	guint index;
+
+	if( k != dk )
+		k++;
+	index = (guint)((k >> 3) + 1);
+	*pK = -(-348 + (gint)(index << 3));
+	return (tDiyFp){ cachedPowersF[ index ], cachedPowersE[ index ] };
+}
+
+static inline void
+grisuRound( gchar *buffer, gint len, guint64 delta, guint64 rest, guint64 tenKappa, guint64 wpw ) {
+	while( rest < wpw && delta - rest >= tenKappa
+			&& (rest + tenKappa < wpw || wpw - rest > rest + tenKappa - wpw) ) {
+		buffer[ len - 1 ]--;
+		rest += tenKappa;
+	}
+}
+
+static inline gint
+countDecimalDigits( guint32 n ) {
+	gint digits = 1;
+	while( digits < 10 && n >= pow10u64[ digits ] )
+		digits++;
+	return digits;
+}
+
+/*!     \brief  Generate the shortest digits between the boundaries
+ *
+ * \param W        scaled value
+ * \param Mp       scaled upper boundary
+ * \param delta    distance between the scaled boundaries
+ * \param buffer   digit buffer
+ * \param pLen     returns number of digits
+ * \param pK       decimal exponent (adjusted)
+ */
+static void
+digitGen( tDiyFp W, tDiyFp Mp, guint64 delta, gchar *buffer, gint *pLen, gint *pK ) {
+	tDiyFp one = { 1ULL << -Mp.e, Mp.e };
+	guint64 wpw = Mp.f - W.f;
+	guint32 p1 = (guint32)(Mp.f >> -one.e);
+	guint64 p2 = Mp.f & (one.f - 1);
+	gint kappa = countDecimalDigits( p1 );
+
+	*pLen = 0;
+	while( kappa > 0 ) {
+		guint32 divisor = (guint32)pow10u64[ kappa - 1 ];
+		guint32 d = p1 / divisor;
+		guint64 tmp;
+
+		p1 %= divisor;
+		if( d || *pLen )
+			buffer[ (*pLen)++ ] = (gchar)('0' + d);
+		kappa--;
+		tmp = ((guint64)p1 << -one.e) + p2;
+		if( tmp <= delta ) {
+			*pK += kappa;
+			grisuRound( buffer, *pLen, delta, tmp, pow10u64[ kappa ] << -one.e, wpw );
+			return;
+		}
+	}
+
+	for( ;; ) {
+		gchar d;
+
+		p2 *= 10;
+		delta *= 10;
+		d = (gchar)(p2 >> -one.e);
+		if( d || *pLen )
+			buffer[ (*pLen)++ ] = (gchar)('0' + d);
+		p2 &= one.f - 1;
+		kappa--;
+		if( p2 < delta ) {
+			*pK += kappa;
+			grisuRound( buffer, *pLen, delta, p2, one.f, -kappa < 20 ? wpw * pow10u64[ -kappa ] : 0 );
+			return;
+		}
+	}
+}
+
+/*!     \brief  Write an unsigned integer
+ *
+ * \param value    the value
+ * \param buffer   destination
+ * \return         number of characters written
+ */
+static inline gint
+formatUnsigned( guint64 value, gchar *buffer ) {
+	gchar digits[ 20 ];
+	gint n = 0, len;
+
+	do {
+		digits[ n++ ] = (gchar)('0' + value % 10);
+		value /= 10;
+	} while( value );
+	for( len = 0; n > 0; )
+		buffer[ len++ ] = digits[ --n ];
+	return len;
+}
+
+/*!     \brief  Format a double as the shortest string that reads back as the same value
+ *
+ * The output is like "%.17lg" (fixed notation for moderate exponents, otherwise
+ * an exponent is used) but without superfluous digits.
+ * The buffer must have room for at least 25 characters (it is not NUL terminated).
+ *
+ * \param value    the value
+ * \param buffer   destination
+ * \return         number of characters written
+ */
+gint
+formatShortestDouble( gdouble value, gchar *buffer ) {
+	gchar digits[ 20 ];
+	gint nDigits, K, kk, len = 0;
+	tDiyFp v, wMinus, wPlus, cK, W, Wp, Wm;
+
+	if( isnan( value ) ) {
+		memcpy( buffer, "nan", 3 );
+		return 3;
+	}
+	if( signbit( value ) ) {
+		buffer[ len++ ] = '-';
+		value = -value;
+	}
+	if( isinf( value ) ) {
+		memcpy( buffer + len, "inf", 3 );
+		return len + 3;
+	}
+	if( value == 0.0 ) {
+		buffer[ len++ ] = '0';
+		return len;
+	}
+
+	// Grisu2
+	v = diyFpFromDouble( value );
+	normalizedBoundaries( v, &wMinus, &wPlus );
+	cK = cachedPower( wPlus.e, &K );
+	W = diyFpMultiply( diyFpNormalize( v ), cK );
+	Wp = diyFpMultiply( wPlus, cK );
+	Wm = diyFpMultiply( wMinus, cK );
+	Wm.f++;
+	Wp.f--;
+	digitGen( W, Wp, Wp.f - Wm.f, digits, &nDigits, &K );
+
+	// value = digits × 10^K ; the decimal point is kk digits from the start
+	kk = nDigits + K;
+	if( K >= 0 && kk <= 17 ) {
+		// integer
+		memcpy( buffer + len, digits, nDigits );
+		memset( buffer + len + nDigits, '0', K );
+		len += kk;
+	} else if( kk > 0 && kk <= 17 ) {
+		// 1234.5678
+		memcpy( buffer + len, digits, kk );
+		buffer[ len + kk ] = '.';
+		memcpy( buffer + len + kk + 1, digits + kk, nDigits - kk );
+		len += nDigits + 1;
+	} else if( kk > -4 && kk <= 0 ) {
+		// 0.00123
+		buffer[ len++ ] = '0';
+		buffer[ len++ ] = '.';
+		memset( buffer + len, '0', -kk );
+		len += -kk;
+		memcpy( buffer + len, digits, nDigits );
+		len += nDigits;
+	} else {
+		// 1.2345e-08
+		gint exponent = kk - 1;
+		buffer[ len++ ] = digits[ 0 ];
+		if( nDigits > 1 ) {
+			buffer[ len++ ] = '.';
+			memcpy( buffer + len, digits + 1, nDigits - 1 );
+			len += nDigits - 1;
+		}
+		buffer[ len++ ] = 'e';
+		if( exponent < 0 ) {
+			buffer[ len++ ] = '-';
+			exponent = -exponent;
+		} else {
+			buffer[ len++ ] = '+';
+		}
+		if( exponent < 10 )
+			buffer[ len++ ] = '0';
+		len += formatUnsigned( (guint64)exponent, buffer + len );
+	}
+	return len;
+}
+
+/*
+ * Buffered output
+ */
+#define EXPORT_BUFFER_SIZE		(256 * 1024)
+#define EXPORT_MAX_FIELD		64		// room for any formatted number (or short string)
+
+typedef struct {
+	FILE	*file;
+	gchar	*buffer;
+	gsize	used;
+	gboolean bError;
+	gint	errnum;			// errno of the first write that failed
+} tExportBuffer;
+
+static void
+flushExportBuffer( tExportBuffer *pOut ) {
+	if( pOut->used && !pOut->bError && fwrite( pOut->buffer, 1, pOut->used, pOut->file ) != pOut->used ) {
+		pOut->errnum = errno;
+		pOut->bError = TRUE;
+	}
+	pOut->used = 0;
+}
+
+static inline gchar *
+reserveExportBuffer( tExportBuffer *pOut, gsize length ) {
+	if( pOut->used + length > EXPORT_BUFFER_SIZE )
+		flushExportBuffer( pOut );
+	return pOut->buffer + pOut->used;
+}
+
+static inline void
+putString( tExportBuffer *pOut, const gchar *sString ) {
+	gsize length = strlen( sString );
+
+	if( length > EXPORT_BUFFER_SIZE ) {
+		flushExportBuffer( pOut );
+		if( !pOut->bError && fwrite( sString, 1, length, pOut->file ) != length ) {
+			pOut->errnum = errno;
+			pOut->bError = TRUE;
+		}
+		return;
+	}
+	memcpy( reserveExportBuffer( pOut, length ), sString, length );
+	pOut->used += length;
+}
+
+static inline void
+putChar( tExportBuffer *pOut, gchar c ) {
+	*reserveExportBuffer( pOut, 1 ) = c;
+	pOut->used++;
+}
+
+// separator (if not NUL) followed by the shortest representation of the number
+static inline void
+putDouble( tExportBuffer *pOut, gchar separator, gdouble value ) {
+	gchar *p = reserveExportBuffer( pOut, EXPORT_MAX_FIELD );
+
+	if( separator )
+		*p++ = separator, pOut->used++;
+	pOut->used += formatShortestDouble( value, p );
+}
+
+static gint
+openExportBuffer( tExportBuffer *pOut, const gchar *sFilename ) {
+	memset( pOut, 0, sizeof( tExportBuffer ) );
+	if( (pOut->file = fopen( sFilename, "w" )) == NULL )
+		return ERROR;
+	// we do our own buffering
+	setvbuf( pOut->file, NULL, _IONBF, 0 );
+	pOut->buffer = g_malloc( EXPORT_BUFFER_SIZE );
+	return OK;
+}
+
+static gint
+closeExportBuffer( tExportBuffer *pOut ) {
+	flushExportBuffer( pOut );
+	if( fclose( pOut->file ) != 0 && !pOut->bError ) {
+		pOut->errnum = errno;
+		pOut->bError = TRUE;
+	}
+	g_free( pOut->buffer );
+	// the caller reports the error of the write that failed
+	if( pOut->bError )
+		errno = pOut->errnum;
+	return pOut->bError ? ERROR : OK;
+}
+
+/*
+ * Touchstone
+ */
+static const gchar *touchstoneFormat[] = { "RI", "MA", "DB" };
+static const gchar *touchstoneUnit[] = { "Hz", "kHz", "MHz", "GHz" };
+static const gdouble touchstoneUnitScale[] = { 1.0, 1.0e3, 1.0e6, 1.0e9 };
+
+// S-parameter in the chosen format (RI, MA or DB)
+static inline void
+putSparameter( tExportBuffer *pOut, tTouchstoneFormat format, gdouble re, gdouble im ) {
+	gdouble magnitude;
+
+	switch( format ) {
+	case eTS_RI:
+	default:
+		putDouble( pOut, '\t', re );
+		putDouble( pOut, '\t', im );
+		break;
+	case eTS_MA:
+	case eTS_DB:
+		magnitude = hypot( re, im );
+		putDouble( pOut, '\t', format == eTS_MA ? magnitude : 20.0 * log10( magnitude ) );
+		putDouble( pOut, '\t', atan2( im, re ) * 180.0 / G_PI );
+		break;
+	}
+}
+
+/*!     \brief  Write the S2P or S1P (Touchstone) file
+ *
+ * May be called from any thread.
+ *
+ * \param sFilename    name of the file to write
+ * \param pS2P         pointer to the S-parameter data (S2P or S1P depending on SnPtype)
+ * \param pOptions     Touchstone version, format, frequency unit and reference impedance
+ * \return             OK or ERROR
+ */
+gint
+writeTouchstone( gchar *sFilename, tS2P *pS2P, tTouchstoneOptions *pOptions ) {
+	tExportBuffer out;
+	gdouble scale = touchstoneUnitScale[ pOptions->frequencyUnit ];
+	const gchar *sFormat = touchstoneFormat[ pOptions->format ];
+	gint nPorts = pS2P->SnPtype == S2P ? 2 : 1;
+	tS2Pparameter S1P = pS2P->SnPtype == S1P_S22 ? eS2P_S22 : eS2P_S11;
+	gchar sOptionLine[ 80 ], sValue[ EXPORT_MAX_FIELD ];
+
+	if( openExportBuffer( &out, sFilename ) != OK )
+		return ERROR;
+
+	sValue[ formatShortestDouble( pOptions->referenceImpedance, sValue ) ] = 0;
+	g_snprintf( sOptionLine, sizeof( sOptionLine ), "# %s S %s R %s\n",
+			touchstoneUnit[ pOptions->frequencyUnit ], sFormat, sValue );
+
+	if( nPorts == 2 )
+		putString( &out, "! 2-port S-paramater data, multiple frequency points\n" );
+	else
+		putString( &out, "! 1-port S-paramater data, multiple frequency points\n" );
+	putString( &out, "! from HP8753 Network analyzer\n" );
+
+	if( pOptions->bVersion2 ) {
+		putString( &out, "[Version] 2.0\n" );
+		putString( &out, sOptionLine );
+		putString( &out, nPorts == 2 ? "[Number of Ports] 2\n[Two-Port Data Order] 21_12\n" : "[Number of Ports] 1\n" );
+		g_snprintf( sOptionLine, sizeof( sOptionLine ), "[Number of Frequencies] %d\n", pS2P->nPoints );
+		putString( &out, sOptionLine );
+		putString( &out, "[Network Data]\n" );
+	} else {
+		putString( &out, sOptionLine );
+	}
+
+	if( nPorts == 2 ) {
+		putString( &out, pOptions->format == eTS_RI ? "! freq\tReS11\tImS11\tReS21\tImS21\tReS12\tImS12\tReS22\tImS22\n"
+				: pOptions->format == eTS_MA ? "! freq\tmagS11\tangS11\tmagS21\tangS21\tmagS12\tangS12\tmagS22\tangS22\n"
+				: "! freq\tdbS11\tangS11\tdbS21\tangS21\tdbS12\tangS12\tdbS22\tangS22\n" );
+		for( gint i = 0; i < pS2P->nPoints && !out.bError; i++ ) {
+			putDouble( &out, 0, pS2P->freq[ i ] / scale );
+			// the planes are in the order of the file (S11 S21 S12 S22)
+			for( tS2Pparameter sParam = eS2P_S11; sParam < eS2P_N_PARAMS; sParam++ )
+				putSparameter( &out, pOptions->format, pS2P->re[ sParam ][ i ], pS2P->im[ sParam ][ i ] );
+			putChar( &out, '\n' );
+		}
+	} else {
+		const gchar *sS = pS2P->SnPtype == S1P_S22 ? "S22" : "S11";
+		g_snprintf( sOptionLine, sizeof( sOptionLine ), "! freq\t%s%s\t%s%s\n",
+				pOptions->format == eTS_RI ? "Re" : pOptions->format == eTS_MA ? "mag" : "db", sS,
+				pOptions->format == eTS_RI ? "Im" : "ang", sS );
+		putString( &out, sOptionLine );
+		for( gint i = 0; i < pS2P->nPoints && !out.bError; i++ ) {
+			putDouble( &out, 0, pS2P->freq[ i ] / scale );
+			putSparameter( &out, pOptions->format, pS2P->re[ S1P ][ i ], pS2P->im[ S1P ][ i ] );
+			putChar( &out, '\n' );
+		}
+	}
+
+	if( pOptions->bVersion2 )
+		putString( &out, "[End]\n" );
+
+	return closeExportBuffer( &out );
+}
+
+/*!     \brief  Write the S3P or S4P (Touchstone) file
+ *
+ * Each row of the S-parameter matrix is written on its own line (the first
+ * follows the frequency). May be called from any thread.
+ *
+ * \param sFilename    name of the file to write
+ * \param pSnP         pointer to the N-port S-parameter data
+ * \param pOptions     Touchstone version, format, frequency unit and reference impedance
+ * \return             OK or ERROR
+ */
+gint
+writeSnPTouchstone( gchar *sFilename, tSnP *pSnP, tTouchstoneOptions *pOptions ) {
+	tExportBuffer out;
+	gdouble scale = touchstoneUnitScale[ pOptions->frequencyUnit ];
+	const gchar *sRe = pOptions->format == eTS_RI ? "Re" : pOptions->format == eTS_MA ? "mag" : "db";
+	const gchar *sIm = pOptions->format == eTS_RI ? "Im" : "ang";
+	gint nPorts = pSnP->nPorts;
+	gchar sLine[ 80 ], sValue[ EXPORT_MAX_FIELD ];
+
+	if( openExportBuffer( &out, sFilename ) != OK )
+		return ERROR;
+
+	g_snprintf( sLine, sizeof( sLine ), "! %d-port S-paramater data, multiple frequency points\n", nPorts );
+	putString( &out, sLine );
+	putString( &out, "! from HP8753 Network analyzer and switch matrix\n" );
+
+	sValue[ formatShortestDouble( pOptions->referenceImpedance, sValue ) ] = 0;
+	g_snprintf( sLine, sizeof( sLine ), "# %s S %s R %s\n",
+			touchstoneUnit[ pOptions->frequencyUnit ], touchstoneFormat[ pOptions->format ], sValue );
+	if( pOptions->bVersion2 ) {
+		putString( &out, "[Version] 2.0\n" );
+		putString( &out, sLine );
+		g_snprintf( sLine, sizeof( sLine ), "[Number of Ports] %d\n[Number of Frequencies] %d\n", nPorts, pSnP->nPoints );
+		putString( &out, sLine );
+		putString( &out, "[Matrix Format] Full\n[Network Data]\n" );
+	} else {
+		putString( &out, sLine );
+	}
+
+	for( gint row = 0; row < nPorts; row++ ) {
+		putString( &out, row == 0 ? "! freq" : "!" );
+		for( gint column = 0; column < nPorts; column++ ) {
+			g_snprintf( sLine, sizeof( sLine ), "\t%sS%d%d\t%sS%d%d", sRe, row + 1, column + 1, sIm, row + 1, column + 1 );
+			putString( &out, sLine );
+		}
+		putChar( &out, '\n' );
+	}
+
+	for( gint i = 0; i < pSnP->nPoints && !out.bError; i++ ) {
+		tComplex *pS = &pSnP->S[ i * nPorts * nPorts ];
+
+		putDouble( &out, 0, pSnP->freq[ i ] / scale );
+		for( gint row = 0; row < nPorts; row++ ) {
+			for( gint column = 0; column < nPorts; column++, pS++ )
+				putSparameter( &out, pOptions->format, pS->r, pS->i );
+			putChar( &out, '\n' );
+		}
+	}
+
+	if( pOptions->bVersion2 )
+		putString( &out, "[End]\n" );
+
+	return closeExportBuffer( &out );
+}
+
+/*
+ * CSV
+ */
+
+/*!     \brief  Write the CSV header
+ *
+ * The comma separated variabls (CSV) data file has a header line
+ * listing the data in each column.
+ *
+ * \param pOut         output buffer
+ * \param pHP8753      pointer to the trace data
+ */
+static void
+putCSVheader( tExportBuffer *pOut, tHP8753 *pHP8753 ) {
+	gboolean bDualChannel = pHP8753->flags.bDualChannel;
+
+	for( eChannel channel = eCH_ONE; channel < (bDualChannel ? eNUM_CH : eCH_TWO); channel++ ) {
+		tChannel *pChannel = &pHP8753->channels[ channel ];
+		const gchar *sMeasurement = optMeasurementType[ pChannel->measurementType ].desc;
+
+		if( channel == eCH_ONE || !pHP8753->flags.bSourceCoupled ) {
+			if( channel != eCH_ONE )
+				putChar( pOut, ',' );
+			putString( pOut, optSweepType[ pChannel->sweepType ].desc );
+		}
+		putChar( pOut, ',' );
+		putString( pOut, sMeasurement );
+		switch( pChannel->format ) {
+		case eFMT_SMITH:
+		case eFMT_POLAR:
+			putString( pOut, " (re)," );
+			putString( pOut, sMeasurement );
+			putString( pOut, " (im)" );
+			break;
+		default:
+			putString( pOut, " (" );
+			putString( pOut, formatSymbols[ pChannel->format ] );
+			putChar( pOut, ')' );
+			break;
+		}
+	}
+	putChar( pOut, '\n' );
+}
+
+// Smith and polar have real/imaginary pairs
+static inline gboolean
+isComplexFormat( tFormat format ) {
+	return format == eFMT_SMITH || format == eFMT_POLAR;
+}
+
+static inline void
+putCSVresponse( tExportBuffer *pOut, tFormat format, tComplex *pPoint ) {
+	putDouble( pOut, ',', pPoint->r );
+	if( isComplexFormat( format ) )
+		putDouble( pOut, ',', pPoint->i );
+}
+
+/*!     \brief  Write the trace data to a CSV file
+ *
+ * May be called from any thread.
+ *
+ * \param sFilename    name of the file to write
+ * \param pHP8753      pointer to the trace data
+ * \return             OK or ERROR
+ */
+gint
+writeCSV( gchar *sFilename, tHP8753 *pHP8753 ) {
+	tExportBuffer out;
+	tChannel *pCh1 = &pHP8753->channels[ eCH_ONE ], *pCh2 = &pHP8753->channels[ eCH_TWO ];
+
+	if( openExportBuffer( &out, sFilename ) != OK )
+		return ERROR;
+
+	putCSVheader( &out, pHP8753 );
+	if( pHP8753->flags.bDualChannel ) {
+		if( pHP8753->flags.bSourceCoupled ) {
+			for( gint i = 0; i < pCh1->nPoints && !out.bError; i++ ) {
+				putDouble( &out, 0, pCh1->stimulusPoints[ i ] );
+				putCSVresponse( &out, pCh1->format, &pCh1->responsePoints[ i ] );
+				putCSVresponse( &out, pCh2->format, &pCh2->responsePoints[ i ] );
+				putChar( &out, '\n' );
+			}
+		} else {
+			for( gint i = 0; (i < pCh1->nPoints || i < pCh2->nPoints) && !out.bError; i++ ) {
+				// empty columns where one channel has fewer points
+				if( i < pCh1->nPoints ) {
+					putDouble( &out, 0, pCh1->stimulusPoints[ i ] );
+					putCSVresponse( &out, pCh1->format, &pCh1->responsePoints[ i ] );
+				} else {
+					putString( &out, isComplexFormat( pCh1->format ) ? ",," : "," );
+				}
+				if( i < pCh2->nPoints ) {
+					putDouble( &out, ',', pCh2->stimulusPoints[ i ] );
+					putCSVresponse( &out, pCh2->format, &pCh2->responsePoints[ i ] );
+				} else {
+					putString( &out, isComplexFormat( pCh2->format ) ? ",,," : ",," );
+				}
+				putChar( &out, '\n' );
+			}
+		}
+	} else {
+		for( gint i = 0; i < pCh1->nPoints && !out.bError; i++ ) {
+			putDouble( &out, 0, pCh1->stimulusPoints[ i ] );
+			putCSVresponse( &out, pCh1->format, &pCh1->responsePoints[ i ] );
+			putChar( &out, '\n' );
+		}
+	}
+
+	return closeExportBuffer( &out );
+}
+
+// archived sweeps are written one row per point
+static gboolean
+putArchivedSweep( const tArchivedSweep *pSweep, gpointer pOut ) {
+	tExportBuffer *pBuffer = (tExportBuffer *)pOut;
+	gdouble time = pSweep->timestamp / (gdouble)G_USEC_PER_SEC;
+
+	for( gint i = 0; i < pSweep->nPoints && !pBuffer->bError; i++ ) {
+		putDouble( pBuffer, 0, time );
+		putChar( pBuffer, ',' );
+		putChar( pBuffer, pSweep->channel == eCH_ONE ? '1' : '2' );
+		putChar( pBuffer, ',' );
+		putString( pBuffer, optMeasurementType[ pSweep->measurementType ].desc );
+		putChar( pBuffer, ',' );
+		putString( pBuffer, optFormat[ pSweep->format ].desc );
+		if( pSweep->stimulusPoints )
+			putDouble( pBuffer, ',', pSweep->stimulusPoints[ i ] );
+		else
+			putChar( pBuffer, ',' );
+		putDouble( pBuffer, ',', pSweep->responsePoints[ i ].r );
+		putDouble( pBuffer, ',', pSweep->responsePoints[ i ].i );
+		putChar( pBuffer, '\n' );
+	}
+	return !pBuffer->bError;
+}
+
+/*!     \brief  Write the archived sweeps of a trace profile to a CSV file
+ *
+ * Each point of each sweep in the time series archive is a row, so the
+ * file can be read directly into a data frame for drift studies.
+ * Must be called from the main thread (it reads the database).
+ *
+ * \param sFilename    name of the file to write
+ * \param sProject     project name
+ * \param sName        trace profile identifier
+ * \param psError      set to the (g_malloced) reason on error (a file or database error)
+ * \return             number of sweeps written or ERROR
+ */
+gint
+writeTraceArchiveCSV( gchar *sFilename, gchar *sProject, gchar *sName, gchar **psError ) {
+	tExportBuffer out;
+	gint nSweeps;
+
+	*psError = NULL;
+	if( openExportBuffer( &out, sFilename ) != OK ) {
+		*psError = g_strdup( g_strerror( errno ) );
+		return ERROR;
+	}
+
+	putString( &out, "Time (s),Channel,Measurement,Format,Stimulus,Response (re),Response (im)\n" );
+	if( (nSweeps = queryTraceArchive( sProject, sName, eCH_BOTH, 0, G_MAXINT64, putArchivedSweep, &out )) == ERROR )
+		*psError = g_strdup( databaseErrorMessage() );
+
+	if( closeExportBuffer( &out ) != OK && *psError == NULL )
+		*psError = g_strdup( g_strerror( out.errnum ) );
+	return *psError ? ERROR : nSweeps;
+}
+
+/*
+ * Background export
+ */
+typedef enum { eEXPORT_SNP, eEXPORT_NPORT, eEXPORT_CSV } tExportType;
+
+typedef struct {
+	tExportType			type;
+	gchar				*sFilename;
+	tTouchstoneOptions	options;
+	tS2P				S2P;			// shared S-parameters (eEXPORT_SNP)
+	tSnP				SnP;			// copy of the N-port S-parameters (eEXPORT_NPORT)
+	tHP8753				*pHP8753;		// copy of the trace data (eEXPORT_CSV)
+} tExportJob;
+
+static GThreadPool *exportPool = NULL;
+
+static void
+freeExportJob( tExportJob *pJob ) {
+	freeS2P( &pJob->S2P );
+	g_free( pJob->SnP.freq );
+	g_free( pJob->SnP.S );
+	if( pJob->pHP8753 ) {
+		for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+			g_free( pJob->pHP8753->channels[ channel ].responsePoints );
+			g_free( pJob->pHP8753->channels[ channel ].stimulusPoints );
+			g_free( pJob->pHP8753->channels[ channel ].complexPoints );
+		}
+		g_free( pJob->pHP8753 );
+	}
+	g_free( pJob->sFilename );
+	g_free( pJob );
+}
+
+/*!     \brief  Write an export file (thread pool function)
+ *
+ * \param pJobData     pointer to the tExportJob (freed here)
+ * \param udata        unused
+ */
+static void
+exportThread( gpointer pJobData, gpointer udata ) {
+	tExportJob *pJob = (tExportJob *)pJobData;
+	gint rtn, errnum;
+
+	switch( pJob->type ) {
+	case eEXPORT_SNP:
+		if( g_str_has_suffix( pJob->sFilename, ".npz" ) )
+			rtn = writeS2PNumPy( pJob->sFilename, &pJob->S2P );
+		else
+			rtn = writeTouchstone( pJob->sFilename, &pJob->S2P, &pJob->options );
+		break;
+	case eEXPORT_NPORT:
+		rtn = writeSnPTouchstone( pJob->sFilename, &pJob->SnP, &pJob->options );
+		break;
+	case eEXPORT_CSV:
+	default:
+		rtn = writeCSV( pJob->sFilename, pJob->pHP8753 );
+		break;
+	}
+	errnum = errno;
+
+	if( rtn == OK ) {
+		postInfo( pJob->type == eEXPORT_CSV ? "CSV saved"
+				: pJob->type == eEXPORT_NPORT ? (pJob->SnP.nPorts == 3 ? "S3P saved" : "S4P saved")
+				: (pJob->S2P.SnPtype == S2P ? "S2P saved" : "S1P saved") );
+	} else {
+		gchar *sError = g_strdup_printf( "Cannot write: %s (%s)", pJob->sFilename, g_strerror( errnum ) );
+		postError( sError );
+		g_free( sError );
+	}
+	freeExportJob( pJob );
+}
+
+static void
+queueExportJob( tExportJob *pJob ) {
+	if( exportPool == NULL )
+		exportPool = g_thread_pool_new( exportThread, NULL, 1, FALSE, NULL );
+	g_thread_pool_push( exportPool, pJob, NULL );
+}
+
+/*!     \brief  Write the S2P or S1P file in the background
+ *
+ * The S-parameters are shared with the writer rather than copied; the caller may
+ * continue to use them and the next measurement (see reserveS2P) will not overwrite them.
+ * A file name ending in .npz is written as a NumPy archive.
+ *
+ * \param sFilename    name of the file to write
+ * \param pS2P         pointer to the S-parameter data
+ * \param pOptions     Touchstone version, format, frequency unit and reference impedance
+ */
+void
+exportTouchstoneInBackground( gchar *sFilename, tS2P *pS2P, tTouchstoneOptions *pOptions ) {
+	tExportJob *pJob = g_new0( tExportJob, 1 );
+
+	pJob->type = eEXPORT_SNP;
+	pJob->sFilename = g_strdup( sFilename );
+	pJob->options = *pOptions;
+	shareS2P( &pJob->S2P, pS2P );
+	queueExportJob( pJob );
+}
+
+/*!     \brief  Write the S3P or S4P file in the background
+ *
+ * The S-parameters are copied so the caller may free them.
+ *
+ * \param sFilename    name of the file to write
+ * \param pSnP         pointer to the N-port S-parameter data
+ * \param pOptions     Touchstone version, format, frequency unit and reference impedance
+ */
+void
+exportSnPinBackground( gchar *sFilename, tSnP *pSnP, tTouchstoneOptions *pOptions ) {
+	tExportJob *pJob = g_new0( tExportJob, 1 );
+
+	pJob->type = eEXPORT_NPORT;
+	pJob->sFilename = g_strdup( sFilename );
+	pJob->options = *pOptions;
+	pJob->SnP = *pSnP;
+	pJob->SnP.freq = g_memdup2( pSnP->freq, pSnP->nPoints * sizeof( gdouble ) );
+	pJob->SnP.S = g_memdup2( pSnP->S, pSnP->nPoints * pSnP->nPorts * pSnP->nPorts * sizeof( tComplex ) );
+	queueExportJob( pJob );
+}
+
+/*!     \brief  Write the trace data to a CSV file in the background
+ *
+ * The trace data is copied so the caller may continue to use (or replace) it.
+ *
+ * \param sFilename    name of the file to write
+ * \param pHP8753      pointer to the trace data
+ */
+void
+exportCSVinBackground( gchar *sFilename, tHP8753 *pHP8753 ) {
+	tExportJob *pJob = g_new0( tExportJob, 1 );
+
+	pJob->type = eEXPORT_CSV;
+	pJob->sFilename = g_strdup( sFilename );
+	pJob->pHP8753 = g_new0( tHP8753, 1 );
+	pJob->pHP8753->flags = pHP8753->flags;
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+		tChannel *pChannel = &pJob->pHP8753->channels[ channel ];
+
+		*pChannel = pHP8753->channels[ channel ];
+		pChannel->responsePoints = g_memdup2( pChannel->responsePoints, pChannel->nPoints * sizeof( tComplex ) );
+		pChannel->stimulusPoints = g_memdup2( pChannel->stimulusPoints, pChannel->nPoints * sizeof( gdouble ) );
+		pChannel->complexPoints = g_memdup2( pChannel->complexPoints, pChannel->nPoints * sizeof( tComplex ) );
+	}
+	queueExportJob( pJob );
+}
+
+/*!     \brief  Wait for the background exports to finish
+ *
+ * Called before the program ends
+ */
+void
+finishBackgroundExports( void ) {
+	if( exportPool ) {
+		g_thread_pool_free( exportPool, FALSE, TRUE );
+		exportPool = NULL;
+	}
+}
@@ -0,0 +1,638 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+#include "messageEvent.h"
+
+/*
+ * Trace data is exported as a NumPy .npz archive (an uncompressed zip of .npy arrays)
+ * so that it can be loaded with numpy.load() without any parsing.
+ * The arrays are written straight from the trace buffers in the byte order of this machine
+ * (which is recorded in the array header).
+ *
+ *   ch1/stimulus     float64   (nPoints,)
+ *   ch1/response     complex128 (nPoints,)
+ *   ch1/data         complex128 (nPoints,)      unformatted (if retrieved)
+ *   ch1/markers      float64   (MAX_MKRS, 3)   stimulus, real, imaginary
+ *   ch1/bandwidth    float64   (3,)            width, center, Q
+ *   ch1/segments     record    (nSegments,)    nPoints, start, stop
+ *   ch2/...                                    (if dual channel)
+ *   metadata         bytes     ()              setup as UTF-8 JSON
+ *
+ * When a whole project is exported, each array is prefixed with the trace profile name.
+ * Archives larger than 4 GiB (zip64) are not supported.
+ */
+
+#define NPY_PREAMBLE_SIZE		10		// magic, version and header length
+#define NPY_HEADER_ALIGNMENT	64
+#define NPY_BYTE_ORDER			(G_BYTE_ORDER == G_LITTLE_ENDIAN ? "<" : ">")
+
+#define ZIP_LOCAL_HEADER_SIG	0x04034b50
+#define ZIP_CENTRAL_HEADER_SIG	0x02014b50
+#define ZIP_END_SIG				0x06054b50
+#define ZIP_VERSION				20
+#define ZIP_MAX_ENTRIES			0xFFFF
+
+typedef struct {
+	FILE		*file;
+	guint64		offset;					// where the next local header will be written
+	GByteArray	*centralDirectory;
+	guint		nEntries;
+	guint16		dosTime, dosDate;
+	gboolean	bError;
+	gint		errnum;					// errno of the first write that failed
+} tNpzArchive;
+
+G_STATIC_ASSERT( sizeof( tMarker ) == 3 * sizeof( gdouble ) );
+
+/*
+ * CRC-32 (as used by zip)
+ */
+static guint32 crcTable[ 256 ];
+
+static void
+initializeCRCtable( void ) {
+	static gsize bInitialized = 0;
+
+	if( g_once_init_enter( &bInitialized ) ) {
+		for( guint32 n = 0; n < 256; n++ ) {
+			guint32 c = n;
+			for( gint k = 0; k < 8; k++ )
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			crcTable[ n ] = c;
+		}
+		g_once_init_leave( &bInitialized, 1 );
+	}
+}
+
+static guint32
+updateCRC( guint32 crc, gconstpointer data, gsize length ) {
+	const guchar *p = data;
+
+	crc = ~crc;
+	while( length-- )
+		crc = crcTable[ (crc ^ *p++) & 0xFF ] ^ (crc >> 8);
+	return ~crc;
+}
+
+/*
+ * Little endian zip header fields
+ */
+static inline void
+appendLE16( GByteArray *pBytes, guint16 value ) {
+	guint8 b[] = { value & 0xFF, value >> 8 };
+	g_byte_array_append( pBytes, b, sizeof( b ) );
+}
+
+static inline void
+appendLE32( GByteArray *pBytes, guint32 value ) {
+	guint8 b[] = { value & 0xFF, (value >> 8) & 0xFF, (value >> 16) & 0xFF, value >> 24 };
+	g_byte_array_append( pBytes, b, sizeof( b ) );
+}
+
+static void
+writeBytes( tNpzArchive *pArchive, gconstpointer data, gsize length ) {
+	if( length && !pArchive->bError && fwrite( data, 1, length, pArchive->file ) != length ) {
+		pArchive->errnum = errno;
+		pArchive->bError = TRUE;
+	}
+	pArchive->offset += length;
+}
+
+/*!     \brief  Create a .npz archive
+ *
+ * \param pArchive     pointer to the archive state to initialize
+ * \param sFilename    name of the file to create
+ * \return             OK or ERROR
+ */
+static gint
+openNpzArchive( tNpzArchive *pArchive, const gchar *sFilename ) {
+	GDateTime *now = g_date_time_new_now_local();
+
+	memset( pArchive, 0, sizeof( tNpzArchive ) );
+	if( (pArchive->file = fopen( sFilename, "wb" )) == NULL ) {
+		gint errnum = errno;
+
+		g_date_time_unref( now );
+		errno = errnum;
+		return ERROR;
+	}
+	pArchive->centralDirectory = g_byte_array_new();
+	pArchive->dosTime = (g_date_time_get_hour( now ) << 11) | (g_date_time_get_minute( now ) << 5)
+			| (g_date_time_get_second( now ) / 2);
+	pArchive->dosDate = ((MAX( g_date_time_get_year( now ), 1980 ) - 1980) << 9)
+			| (g_date_time_get_month( now ) << 5) | g_date_time_get_day_of_month( now );
+	g_date_time_unref( now );
+	initializeCRCtable();
+	return OK;
+}
+
+/*!     \brief  Add an array to a .npz archive
+ *
+ * The entry is stored (not compressed) so the array data is written directly
+ * from the caller's buffer.
+ *
+ * \param pArchive     pointer to the archive state
+ * \param sName        array name (.npy is appended)
+ * \param sDescr       NumPy type descriptor (without byte order for simple types)
+ * \param shape        array dimensions
+ * \param nDims        number of dimensions (0 for a scalar)
+ * \param data         pointer to the array data
+ * \param dataSize     number of bytes of array data
+ */
+static void
+addNpzArray( tNpzArchive *pArchive, const gchar *sName, const gchar *sDescr,
+		const gsize *shape, gint nDims, gconstpointer data, gsize dataSize ) {
+	GByteArray *pLocal;
+	GString *npyHeader, *sEntryName;
+	guint8 npyPreamble[ NPY_PREAMBLE_SIZE ] = { 0x93, 'N', 'U', 'M', 'P', 'Y', 1, 0 };
+	guint32 crc, entrySize;
+	guint64 localOffset = pArchive->offset;
+
+	if( pArchive->bError )
+		return;
+
+	// the .npy header (a python dictionary literal padded so the data is aligned)
+	npyHeader = g_string_new( "{'descr': " );
+	if( sDescr[0] == '[' )
+		g_string_append( npyHeader, sDescr );
+	else
+		g_string_append_printf( npyHeader, "'%s%s'", sDescr[0] == '|' ? "" : NPY_BYTE_ORDER, sDescr );
+	g_string_append( npyHeader, ", 'fortran_order': False, 'shape': (" );
+	for( gint i = 0; i < nDims; i++ )
+		g_string_append_printf( npyHeader, i ? ", %" G_GSIZE_FORMAT : "%" G_GSIZE_FORMAT, shape[ i ] );
+	g_string_append( npyHeader, nDims == 1 ? ",), }" : "), }" );
+	while( (NPY_PREAMBLE_SIZE + npyHeader->len + 1) % NPY_HEADER_ALIGNMENT )
+		g_string_append_c( npyHeader, ' ' );
+	g_string_append_c( npyHeader, '\n' );
+	npyPreamble[ 8 ] = npyHeader->len & 0xFF;		// version 1.0 header length (little endian)
+	npyPreamble[ 9 ] = npyHeader->len >> 8;
+
+	sEntryName = g_string_new( sName );
+	g_string_append( sEntryName, ".npy" );
+
+	if( pArchive->nEntries == ZIP_MAX_ENTRIES
+			|| localOffset + 30 + sEntryName->len + NPY_PREAMBLE_SIZE + npyHeader->len + dataSize > G_MAXUINT32 ) {
+		pArchive->errnum = EFBIG;
+		pArchive->bError = TRUE;
+		goto err;
+	}
+
+	entrySize = NPY_PREAMBLE_SIZE + npyHeader->len + dataSize;
+	crc = updateCRC( 0, npyPreamble, NPY_PREAMBLE_SIZE );
+	crc = updateCRC( crc, npyHeader->str, npyHeader->len );
+	crc = updateCRC( crc, data, dataSize );
+
+	pLocal = g_byte_array_sized_new( 30 + sEntryName->len );
+	appendLE32( pLocal, ZIP_LOCAL_HEADER_SIG );
+	appendLE16( pLocal, ZIP_VERSION );
+	appendLE16( pLocal, 0 );					// flags
+	appendLE16( pLocal, 0 );					// stored
+	appendLE16( pLocal, pArchive->dosTime );
+	appendLE16( pLocal, pArchive->dosDate );
+	appendLE32( pLocal, crc );
+	appendLE32( pLocal, entrySize );			// compressed size
+	appendLE32( pLocal, entrySize );			// uncompressed size
+	appendLE16( pLocal, sEntryName->len );
+	appendLE16( pLocal, 0 );					// extra field length
+	g_byte_array_append( pLocal, (guint8 *)sEntryName->str, sEntryName->len );
+
+	writeBytes( pArchive, pLocal->data, pLocal->len );
+	writeBytes( pArchive, npyPreamble, NPY_PREAMBLE_SIZE );
+	writeBytes( pArchive, npyHeader->str, npyHeader->len );
+	writeBytes( pArchive, data, dataSize );
+	g_byte_array_free( pLocal, TRUE );
+
+	appendLE32( pArchive->centralDirectory, ZIP_CENTRAL_HEADER_SIG );
+	appendLE16( pArchive->centralDirectory, ZIP_VERSION );		// made by
+	appendLE16( pArchive->centralDirectory, ZIP_VERSION );		// needed to extract
+	appendLE16( pArchive->centralDirectory, 0 );
+	appendLE16( pArchive->centralDirectory, 0 );
+	appendLE16( pArchive->centralDirectory, pArchive->dosTime );
+	appendLE16( pArchive->centralDirectory, pArchive->dosDate );
+	appendLE32( pArchive->centralDirectory, crc );
+	appendLE32( pArchive->centralDirectory, entrySize );
+	appendLE32( pArchive->centralDirectory, entrySize );
+	appendLE16( pArchive->centralDirectory, sEntryName->len );
+	appendLE16( pArchive->centralDirectory, 0 );				// extra field length
+	appendLE16( pArchive->centralDirectory, 0 );				// comment length
+	appendLE16( pArchive->centralDirectory, 0 );				// disk number
+	appendLE16( pArchive->centralDirectory, 0 );				// internal attributes
+	appendLE32( pArchive->centralDirectory, 0 );				// external attributes
+	appendLE32( pArchive->centralDirectory, (guint32)localOffset );
+	g_byte_array_append( pArchive->centralDirectory, (guint8 *)sEntryName->str, sEntryName->len );
+	pArchive->nEntries++;
+
+err:
+	g_string_free( sEntryName, TRUE );
+	g_string_free( npyHeader, TRUE );
+}
+
+/*!     \brief  Write the zip central directory and close the .npz archive
+ *
+ * \param pArchive     pointer to the archive state
+ * \return             OK or ERROR
+ */
+static gint
+closeNpzArchive( tNpzArchive *pArchive ) {
+	GByteArray *pEnd = g_byte_array_sized_new( 22 );
+	guint64 directoryOffset = pArchive->offset;
+
+	if( directoryOffset + pArchive->centralDirectory->len > G_MAXUINT32 && !pArchive->bError ) {
+		pArchive->errnum = EFBIG;
+		pArchive->bError = TRUE;
+	}
+	writeBytes( pArchive, pArchive->centralDirectory->data, pArchive->centralDirectory->len );
+
+	appendLE32( pEnd, ZIP_END_SIG );
+	appendLE16( pEnd, 0 );							// this disk
+	appendLE16( pEnd, 0 );							// disk with the central directory
+	appendLE16( pEnd, pArchive->nEntries );
+	appendLE16( pEnd, pArchive->nEntries );
+	appendLE32( pEnd, pArchive->centralDirectory->len );
+	appendLE32( pEnd, (guint32)directoryOffset );
+	appendLE16( pEnd, 0 );							// comment length
+	writeBytes( pArchive, pEnd->data, pEnd->len );
+
+	g_byte_array_free( pEnd, TRUE );
+	g_byte_array_free( pArchive->centralDirectory, TRUE );
+	if( fclose( pArchive->file ) != 0 && !pArchive->bError ) {
+		pArchive->errnum = errno;
+		pArchive->bError = TRUE;
+	}
+	// the caller reports the error of the write that failed
+	if( pArchive->bError )
+		errno = pArchive->errnum;
+	return pArchive->bError ? ERROR : OK;
+}
+
+/*
+ * Setup metadata (JSON)
+ */
+static void
+appendJSONstring( GString *json, const gchar *sKey, const gchar *sValue ) {
+	g_string_append_printf( json, "\"%s\": ", sKey );
+	if( sValue == NULL ) {
+		g_string_append( json, "null, " );
+		return;
+	}
+	g_string_append_c( json, '"' );
+	for( const guchar *p = (const guchar *)sValue; *p; p++ ) {
+		if( *p == '"' || *p == '\\' )
+			g_string_append_printf( json, "\\%c", *p );
+		else if( *p < 0x20 )
+			g_string_append_printf( json, "\\u%04x", *p );
+		else
+			g_string_append_c( json, *p );
+	}
+	g_string_append( json, "\", " );
+}
+
+static void
+appendJSONnumber( GString *json, const gchar *sKey, gdouble value ) {
+	gchar sNumber[ 32 ];
+
+	if( !isfinite( value ) ) {
+		g_string_append_printf( json, "\"%s\": null, ", sKey );
+		return;
+	}
+	sNumber[ formatShortestDouble( value, sNumber ) ] = 0;
+	g_string_append_printf( json, "\"%s\": %s, ", sKey, sNumber );
+}
+
+static void
+appendJSONinteger( GString *json, const gchar *sKey, gint value ) {
+	g_string_append_printf( json, "\"%s\": %d, ", sKey, value );
+}
+
+static void
+appendJSONboolean( GString *json, const gchar *sKey, gboolean value ) {
+	g_string_append_printf( json, "\"%s\": %s, ", sKey, value ? "true" : "false" );
+}
+
+// replace the trailing ", " of the last member with the closing bracket
+static void
+closeJSONobject( GString *json, gchar bracket ) {
+	if( g_str_has_suffix( json->str, ", " ) )
+		g_string_truncate( json, json->len - 2 );
+	g_string_append_c( json, bracket );
+}
+
+/*!     \brief  Describe the trace setup as a JSON object
+ *
+ * \param pHP8753      pointer to the trace data
+ * \param sName        trace profile name (or NULL)
+ * \param nChannels    number of channels exported
+ * \return             g_malloced JSON
+ */
+static gchar *
+traceMetadataJSON( tHP8753 *pHP8753, const gchar *sName, gint nChannels ) {
+	GString *json = g_string_new( "{" );
+
+	if( sName )
+		appendJSONstring( json, "name", sName );
+	appendJSONstring( json, "title", pHP8753->sTitle );
+	appendJSONstring( json, "note", pHP8753->sNote );
+	appendJSONstring( json, "time", pHP8753->dateTime );
+	appendJSONboolean( json, "dualChannel", pHP8753->flags.bDualChannel );
+	appendJSONboolean( json, "sourceCoupled", pHP8753->flags.bSourceCoupled );
+	appendJSONboolean( json, "markersCoupled", pHP8753->flags.bMarkersCoupled );
+	appendJSONinteger( json, "activeChannel", pHP8753->activeChannel + 1 );
+	g_string_append( json, "\"channels\": [" );
+	for( eChannel channel = eCH_ONE; channel < nChannels; channel++ ) {
+		tChannel *pChannel = &pHP8753->channels[ channel ];
+
+		g_string_append_c( json, '{' );
+		appendJSONinteger( json, "channel", channel + 1 );
+		appendJSONstring( json, "measurement", optMeasurementType[ pChannel->measurementType ].desc );
+		appendJSONstring( json, "format", optFormat[ pChannel->format ].desc );
+		appendJSONstring( json, "sweepType", optSweepType[ pChannel->sweepType ].desc );
+		appendJSONnumber( json, "sweepStart", pChannel->sweepStart );
+		appendJSONnumber( json, "sweepStop", pChannel->sweepStop );
+		appendJSONnumber( json, "CWfrequency", pChannel->CWfrequency );
+		appendJSONnumber( json, "IFbandwidth", pChannel->IFbandwidth );
+		appendJSONinteger( json, "nPoints", pChannel->nPoints );
+		appendJSONnumber( json, "scale", pChannel->scaleVal );
+		appendJSONnumber( json, "referencePosition", pChannel->scaleRefPos );
+		appendJSONnumber( json, "referenceValue", pChannel->scaleRefVal );
+		appendJSONboolean( json, "averaging", pChannel->chFlags.bAveraging );
+		appendJSONboolean( json, "admittanceSmith", pChannel->chFlags.bAdmitanceSmith );
+		appendJSONinteger( json, "markersOn", pChannel->chFlags.bbMkrs );
+		appendJSONinteger( json, "activeMarker", pChannel->activeMarker );
+		appendJSONboolean( json, "deltaMarkers", pChannel->chFlags.bMkrsDelta );
+		appendJSONinteger( json, "deltaMarker", pChannel->deltaMarker );
+		appendJSONinteger( json, "markerType", pChannel->mkrType );
+		appendJSONboolean( json, "bandwidthValid", pChannel->chFlags.bBandwidth );
+		appendJSONinteger( json, "nSegments", pChannel->chFlags.bValidSegments ? pChannel->nSegments : 0 );
+		closeJSONobject( json, '}' );
+		g_string_append( json, ", " );
+	}
+	closeJSONobject( json, ']' );
+	g_string_append_c( json, '}' );
+
+	return g_string_free( json, FALSE );
+}
+
+/*!     \brief  Form the name of an array in the archive
+ *
+ * \param sPrefix      trace profile name (or NULL)
+ * \param channel      channel of the array (or -1 for the whole trace)
+ * \param sArray       array name
+ * \return             g_malloced name
+ */
+static gchar *
+npzArrayName( const gchar *sPrefix, gint channel, const gchar *sArray ) {
+	GString *sName = g_string_new( NULL );
+
+	if( sPrefix )
+		g_string_append_printf( sName, "%s/", sPrefix );
+	if( channel >= 0 )
+		g_string_append_printf( sName, "ch%d/", channel + 1 );
+	g_string_append( sName, sArray );
+	return g_string_free( sName, FALSE );
+}
+
+/*!     \brief  Add quantities derived from a complex channel to a .npz archive
+ *
+ * The quantities are derived from the unformatted data if it was retrieved with the trace,
+ * otherwise from a Smith or polar trace. The unwrapped phase and group delay are always added;
+ * the SWR, return loss and impedance only for reflection measurements (S11 or S22).
+ *
+ * \param pArchive     pointer to the archive state
+ * \param pChannel     pointer to the channel data
+ * \param sPrefix      trace profile name (or NULL)
+ * \param channel      channel
+ */
+static void
+addDerivedToNpzArchive( tNpzArchive *pArchive, tChannel *pChannel, const gchar *sPrefix, eChannel channel ) {
+	static const struct {
+		tDerivedQuantity quantity;
+		gboolean bReflection;			// only meaningful for S11 / S22
+		const gchar *sName, *sName2;
+	} derived[] = {
+		{ eDERIVED_UNWRAPPED_PHASE,	FALSE,	"phase_unwrapped", NULL },
+		{ eDERIVED_DELAY,			FALSE,	"group_delay", NULL },
+		{ eDERIVED_SWR,				TRUE,	"swr", NULL },
+		{ eDERIVED_RETURN_LOSS,		TRUE,	"return_loss", NULL },
+		{ eDERIVED_IMPEDANCE,		TRUE,	"impedance_real", "impedance_imag" } };
+	gboolean bReflection = pChannel->measurementType == S11_MEAS || pChannel->measurementType == S22_MEAS;
+	tComplexTrace trace = complexTraceOfPoints( pChannel->complexPoints ? pChannel->complexPoints : pChannel->responsePoints,
+			pChannel->stimulusPoints, pChannel->nPoints );
+	gdouble *values = g_new( gdouble, pChannel->nPoints ), *values2 = g_new( gdouble, pChannel->nPoints );
+	gsize shape[ 1 ] = { pChannel->nPoints }, size = pChannel->nPoints * sizeof( gdouble );
+	gchar *sArrayName;
+
+	for( gint i = 0; i < G_N_ELEMENTS( derived ); i++ ) {
+		if( derived[ i ].bReflection && !bReflection )
+			continue;
+		// the group delay only has meaning against frequency
+		if( derived[ i ].quantity == eDERIVED_DELAY
+				&& (pChannel->sweepType == eSWP_CWTIME || pChannel->sweepType == eSWP_PWR) )
+			continue;
+		if( deriveTrace( derived[ i ].quantity, &trace, Z0, values, values2 ) != OK )
+			continue;
+		sArrayName = npzArrayName( sPrefix, channel, derived[ i ].sName );
+		addNpzArray( pArchive, sArrayName, "f8", shape, 1, values, size );
+		g_free( sArrayName );
+		if( derived[ i ].sName2 ) {
+			sArrayName = npzArrayName( sPrefix, channel, derived[ i ].sName2 );
+			addNpzArray( pArchive, sArrayName, "f8", shape, 1, values2, size );
+			g_free( sArrayName );
+		}
+	}
+	g_free( values );
+	g_free( values2 );
+}
+
+/*!     \brief  Add the arrays of one trace to a .npz archive
+ *
+ * \param pArchive     pointer to the archive state
+ * \param pHP8753      pointer to the trace data
+ * \param sName        trace profile name used to prefix the arrays (or NULL)
+ */
+static void
+addTraceToNpzArchive( tNpzArchive *pArchive, tHP8753 *pHP8753, const gchar *sName ) {
+	gint nChannels = pHP8753->flags.bDualChannel ? eNUM_CH : eCH_TWO;
+	gchar *sPrefix = NULL, *sArrayName, *sMetadata, *sDescr, *sPadding;
+	gchar *sSegmentDescr;
+	gsize shape[ 2 ], metadataSize;
+	gint padding = G_STRUCT_OFFSET( tSegment, startFreq ) - sizeof( gint );
+
+	// the archive member names are paths, so a '/' in a name would add a level
+	if( sName ) {
+		sPrefix = g_strdup( sName );
+		g_strdelimit( sPrefix, "/\\", '_' );
+	}
+
+	// tSegment is written as is, so describe its layout (including any alignment padding)
+	sPadding = padding > 0 ? g_strdup_printf( "('', '|V%d'), ", padding ) : g_strdup( "" );
+	sSegmentDescr = g_strdup_printf( "[('nPoints', '%si4'), %s('start', '%sf8'), ('stop', '%sf8')]",
+			NPY_BYTE_ORDER, sPadding, NPY_BYTE_ORDER, NPY_BYTE_ORDER );
+	g_free( sPadding );
+
+	for( eChannel channel = eCH_ONE; channel < nChannels; channel++ ) {
+		tChannel *pChannel = &pHP8753->channels[ channel ];
+		guint nPoints = (pChannel->responsePoints && pChannel->stimulusPoints) ? pChannel->nPoints : 0;
+		gint nSegments = pChannel->chFlags.bValidSegments ? CLAMP( pChannel->nSegments, 0, MAX_SEGMENTS ) : 0;
+
+		shape[0] = nPoints;
+		sArrayName = npzArrayName( sPrefix, channel, "stimulus" );
+		addNpzArray( pArchive, sArrayName, "f8", shape, 1, pChannel->stimulusPoints, nPoints * sizeof( gdouble ) );
+		g_free( sArrayName );
+		sArrayName = npzArrayName( sPrefix, channel, "response" );
+		addNpzArray( pArchive, sArrayName, "c16", shape, 1, pChannel->responsePoints, nPoints * sizeof( tComplex ) );
+		g_free( sArrayName );
+		// the unformatted data, if it was retrieved with the trace
+		if( nPoints > 0 && pChannel->complexPoints ) {
+			sArrayName = npzArrayName( sPrefix, channel, "data" );
+			addNpzArray( pArchive, sArrayName, "c16", shape, 1, pChannel->complexPoints, nPoints * sizeof( tComplex ) );
+			g_free( sArrayName );
+		}
+		if( nPoints > 0 && (pChannel->complexPoints || derivedQuantityOfFormat( pChannel->format ) == INVALID) )
+			addDerivedToNpzArchive( pArchive, pChannel, sPrefix, channel );
+
+		shape[0] = MAX_MKRS;
+		shape[1] = 3;
+		sArrayName = npzArrayName( sPrefix, channel, "markers" );
+		addNpzArray( pArchive, sArrayName, "f8", shape, 2,
+				pChannel->numberedMarkers, sizeof( pChannel->numberedMarkers ) );
+		g_free( sArrayName );
+
+		shape[0] = MAX_BW_ELEMENTS;
+		sArrayName = npzArrayName( sPrefix, channel, "bandwidth" );
+		addNpzArray( pArchive, sArrayName, "f8", shape, 1, pChannel->bandwidth, sizeof( pChannel->bandwidth ) );
+		g_free( sArrayName );
+
+		shape[0] = nSegments;
+		sArrayName = npzArrayName( sPrefix, channel, "segments" );
+		addNpzArray( pArchive, sArrayName, sSegmentDescr, shape, 1, pChannel->segments, nSegments * sizeof( tSegment ) );
+		g_free( sArrayName );
+	}
+
+	sMetadata = traceMetadataJSON( pHP8753, sName, nChannels );
+	metadataSize = strlen( sMetadata );
+	sDescr = g_strdup_printf( "|S%" G_GSIZE_FORMAT, metadataSize );
+	sArrayName = npzArrayName( sPrefix, -1, "metadata" );
+	addNpzArray( pArchive, sArrayName, sDescr, NULL, 0, sMetadata, metadataSize );
+
+	g_free( sArrayName );
+	g_free( sDescr );
+	g_free( sMetadata );
+	g_free( sSegmentDescr );
+	g_free( sPrefix );
+}
+
+/*!     \brief  Write the trace data to a NumPy .npz archive
+ *
+ * The arrays are written directly from the trace buffers (no copy is made),
+ * so this must be called from the thread that owns the data.
+ *
+ * \param sFilename    name of the file to write
+ * \param pHP8753      pointer to the trace data
+ * \return             OK or ERROR
+ */
+gint
+writeTraceNumPy( gchar *sFilename, tHP8753 *pHP8753 ) {
+	tNpzArchive archive;
+
+	if( openNpzArchive( &archive, sFilename ) != OK )
+		return ERROR;
+	addTraceToNpzArchive( &archive, pHP8753, NULL );
+	return closeNpzArchive( &archive );
+}
+
+/*!     \brief  Write the S-parameters to a NumPy .npz archive
+ *
+ * The frequency and the real and imaginary planes of each S-parameter are written
+ * directly from the S-parameter buffer as freq, S11_re, S11_im ... (only S11 or S22 for an S1P).
+ *
+ * \param sFilename    name of the file to write
+ * \param pS2P         pointer to the S-parameters
+ * \return             OK or ERROR
+ */
+gint
+writeS2PNumPy( gchar *sFilename, tS2P *pS2P ) {
+	static const gchar *sParamNames[ eS2P_N_PARAMS ] = { "S11", "S21", "S12", "S22" };
+	tNpzArchive archive;
+	gsize shape[ 1 ] = { pS2P->nPoints }, size = pS2P->nPoints * sizeof( gdouble );
+	gchar sArrayName[ 16 ];
+
+	if( openNpzArchive( &archive, sFilename ) != OK )
+		return ERROR;
+	addNpzArray( &archive, "freq", "f8", shape, 1, pS2P->freq, size );
+	for( tS2Pparameter sParam = eS2P_S11; sParam < eS2P_N_PARAMS; sParam++ ) {
+		if( (pS2P->SnPtype == S1P_S11 && sParam != eS2P_S11) || (pS2P->SnPtype == S1P_S22 && sParam != eS2P_S22) )
+			continue;
+		g_snprintf( sArrayName, sizeof( sArrayName ), "%s_re", sParamNames[ sParam ] );
+		addNpzArray( &archive, sArrayName, "f8", shape, 1, pS2P->re[ sParam ], size );
+		g_snprintf( sArrayName, sizeof( sArrayName ), "%s_im", sParamNames[ sParam ] );
+		addNpzArray( &archive, sArrayName, "f8", shape, 1, pS2P->im[ sParam ], size );
+	}
+	return closeNpzArchive( &archive );
+}
+
+/*!     \brief  Write all of the trace profiles of a project to a NumPy .npz archive
+ *
+ * Each trace profile is recovered from the database (or the recall cache) in turn
+ * and its arrays are added to the archive prefixed by the profile name.
+ *
+ * \param sProject     project name
+ * \param pTraceList   list of tHP8753traceAbstract (all projects)
+ * \param sFilename    name of the file to write
+ * \return             number of trace profiles written or ERROR
+ */
+gint
+exportProjectNumPy( gchar *sProject, GList *pTraceList, gchar *sFilename ) {
+	tNpzArchive archive;
+	tGlobal *pScratch;
+	gint nTraces = 0;
+
+	if( openNpzArchive( &archive, sFilename ) != OK )
+		return ERROR;
+
+	// the profiles are recovered into a scratch structure so the displayed trace is not disturbed
+	pScratch = g_new0( tGlobal, 1 );
+	for( GList *l = pTraceList; l != NULL && !archive.bError; l = l->next ) {
+		tProjectAndName *pProjectAndName = &((tHP8753traceAbstract *)l->data)->projectAndName;
+
+		if( g_strcmp0( pProjectAndName->sProject, sProject ) != 0 )
+			continue;
+		if( recoverTraceData( pScratch, pProjectAndName->sProject, pProjectAndName->sName ) != TRUE )
+			continue;
+		addTraceToNpzArchive( &archive, &pScratch->HP8753, pProjectAndName->sName );
+		nTraces++;
+	}
+
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+		g_free( pScratch->HP8753.channels[ channel ].responsePoints );
+		g_free( pScratch->HP8753.channels[ channel ].stimulusPoints );
+		g_free( pScratch->HP8753.channels[ channel ].complexPoints );
+	}
+	g_free( pScratch->HP8753.plotHPGL );
+	g_free( pScratch->HP8753.sTitle );
+	g_free( pScratch->HP8753.sNote );
+	g_free( pScratch->HP8753.dateTime );
+	g_free( pScratch );
+
+	return closeNpzArchive( &archive ) == OK ? nTraces : ERROR;
+}
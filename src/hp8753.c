@@ -26,6 +26,7 @@
 #include <math.h>
 #include <complex.h>
 #include <hp8753.h>
+#include <GPIBcomms.h>
 #include <gdk-pixbuf/gdk-pixbuf.h>
 
 #include "messageEvent.h"
@@ -100,6 +101,32 @@ keyHandler (GtkWidget *widget, GdkEventKey  *event, gpointer   user_data) {
           gtk_button_clicked( wGetTraceBtn );
           break;
 
+      case GDK_KEY_F4:
+          showSearchWindow( pGlobal );
+          break;
+
+      case GDK_KEY_F5:
+          if( modifier == GDK_SHIFT_MASK )
+              showImportProjectDialog( pGlobal );
+          else
+              showExportProjectDialog( pGlobal );
+          break;
+
+      case GDK_KEY_F6:
+          if( modifier == GDK_SHIFT_MASK )
+              showExportTraceArchiveDialog( pGlobal );
+          else
+              showExportProjectNumPyDialog( pGlobal );
+          break;
+
+      case GDK_KEY_F7:
+          showReferenceTraceDialog( pGlobal );
+          break;
+
+      case GDK_KEY_F8:
+          showMultiportCaptureDialog( pGlobal );
+          break;
+
       case GDK_KEY_KP_Add:
           if (wState & GDK_WINDOW_STATE_FULLSCREEN)
               break;
@@ -189,11 +216,38 @@ keyHandler (GtkWidget *widget, GdkEventKey  *event, gpointer   user_data) {
           visibilityFramePlot_B (pGlobal, gtk_widget_get_visible(wFramePlotB) | 0x02);
           break;
 
+      case GDK_KEY_F10:
+          // show the trace in another format (formatted here from the complex data)
+          // ... but not while a GPIB job (which may be reading the traces) is running
+          if( !gtk_widget_get_sensitive( GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable,
+                  (gconstpointer)"WID_Box_GetTrace" ) ) ) )
+              break;
+          if( modifier == GDK_CONTROL_MASK ) {
+              for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ )
+                  if( pGlobal->reformatCache[ channel ].nPoints != 0 )
+                      reformatChannel( pGlobal, channel, pGlobal->reformatCache[ channel ].acquiredFormat );
+          } else {
+              eChannel channel = (modifier == GDK_SHIFT_MASK) ? eCH_TWO : eCH_ONE;
+              if( cycleChannelFormat( pGlobal, channel ) == OK ) {
+                  gchar *sMessage = g_strdup_printf( "Channel %d: %s", channel + 1,
+                          optFormat[ pGlobal->HP8753.channels[ channel ].format ].desc );
+                  postInfo( sMessage );
+                  g_free( sMessage );
+              } else {
+                  postError( "No complex data retrieved with this trace" );
+              }
+          }
+          gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_DrawingArea_Plot_A" ) ) );
+          gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_DrawingArea_Plot_B" ) ) );
+          break;
+
       case GDK_KEY_F11:
           if( modifier == GDK_SHIFT_MASK )
               postDataToGPIBThread( TG_UTILITY, NULL );
           else if( modifier == GDK_MOD1_MASK )
               postDataToGPIBThread( TG_EXPERIMENT, NULL );
+          else if( modifier == GDK_CONTROL_MASK )
+              postDataToGPIBThread( TG_BENCHMARK_TRACE_FORMATS, NULL );
           break;
 
       case GDK_KEY_F12:
@@ -282,6 +336,12 @@ splashDestroy (gpointer *pGlobal)
 static gint     optDebug = 0;
 static gboolean bOptQuiet = 0;
 static gboolean bOptNoGPIBtimeout = 0;
+static gchar    *sOptRecordGPIB = NULL;
+static gchar    *sOptReplayGPIB = NULL;
+static gdouble  optReplaySpeed = 1.0;
+static gchar    *sOptImportLSindexes = NULL;
+static gchar    *sOptExportLSindexes = NULL;
+static gboolean bExitAfterStartup = FALSE;	// a command line utility (import/export) .. no GUI
 
 static gchar    **argsRemainder = NULL;
 
@@ -293,6 +353,16 @@ static const GOptionEntry optionEntries[] =
           &bOptQuiet, "No GUI sounds", NULL },
   { "noGPIBtimeout",   't', 0, G_OPTION_ARG_NONE,
 		          &bOptNoGPIBtimeout, "no GPIB timeout (for debug with HP59401A)", NULL },
+  { "record-gpib",     0,   0, G_OPTION_ARG_FILENAME,
+          &sOptRecordGPIB, "Record the GPIB session to a file", "FILE" },
+  { "replay-gpib",     0,   0, G_OPTION_ARG_FILENAME,
+          &sOptReplayGPIB, "Replay a recorded GPIB session in place of the HP8753", "FILE" },
+  { "replay-speed",    0,   0, G_OPTION_ARG_DOUBLE,
+          &optReplaySpeed, "Pace of the replay (1 as recorded, 10 ten times faster, 0 without waiting)", "N" },
+  { "import-ls-indexes", 0, 0, G_OPTION_ARG_FILENAME,
+          &sOptImportLSindexes, "Import learn string indexes (exported by another installation)", "FILE" },
+  { "export-ls-indexes", 0, 0, G_OPTION_ARG_FILENAME,
+          &sOptExportLSindexes, "Export the learn string indexes of all known firmware", "FILE" },
   { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_STRING_ARRAY, &argsRemainder, "", NULL },
   { NULL }
 };
@@ -324,6 +394,9 @@ on_activate (GApplication *app, gpointer udata)
 	GSList *widgetList;
 
 
+    if( bExitAfterStartup )
+        return;
+
     if ( pGlobal->flags.bRunning ) {
         // gtk_window_set_screen( GTK_WINDOW( MainWindow ),
         //                       unique_message_data_get_screen( message ) );
@@ -465,8 +538,17 @@ on_activate (GApplication *app, gpointer udata)
 
 	CB_Radio_Calibration ( GTK_RADIO_BUTTON( wRadioBtnCalibration ), pGlobal );
 
+	initializeFORM1exponentTable();
+
 	// Start the GPIB communication thread
 	pGlobal->pGThread = g_thread_new( "GPIBthread", threadGPIB, (gpointer)pGlobal );
+
+	// Database statistics on the options page & idle time maintenance
+	initializeDBstatisticsPanel( pGlobal );
+	initializeGPIBtracePanel( pGlobal );
+	initializeCaptureTimingPanel( pGlobal );
+	startDBmaintenance();
+	requestDBmaintenance( FALSE );
 }
 
 /*!     \brief  Clear traces
@@ -500,6 +582,8 @@ clearHP8753traces( tHP8753 *pHP8753 ) {
 		g_free( pHP8753->channels[channel].stimulusPoints );
 		pHP8753->channels[channel].responsePoints = NULL;
 		pHP8753->channels[channel].stimulusPoints = NULL;
+		g_free( pHP8753->channels[channel].complexPoints );
+		pHP8753->channels[channel].complexPoints = NULL;
 		pHP8753->channels[channel].nPoints = 0;
 		pHP8753->channels[channel].nSegments = 0;
 		for( gint seg=0; seg < MAX_SEGMENTS; seg++ ) {
@@ -553,9 +637,43 @@ on_startup (GApplication *app, gpointer udata)
 
     g_source_attach( globalData.messageEventSource, NULL );
 
+    // record the GPIB session or replay a recording (before the GPIB thread starts)
+    if( sOptReplayGPIB ) {
+        if( startGPIBsessionReplay( sOptReplayGPIB, optReplaySpeed ) != OK )
+            g_printerr( "Cannot replay the GPIB session in %s\n", sOptReplayGPIB );
+    } else if( sOptRecordGPIB ) {
+        if( startGPIBsessionRecording( sOptRecordGPIB ) != OK )
+            g_printerr( "Cannot record the GPIB session to %s\n", sOptRecordGPIB );
+    }
+
     clearHP8753traces( &pGlobal->HP8753 );
 
     openOrCreateDB();
+    // learned durations of HP8753 operations (used by the GPIB thread)
+    recoverTimingModel();
+    // learn string indexes of the firmware analyzed or imported before
+    recoverLearnStringIndexes();
+    if( sOptImportLSindexes ) {
+        gchar *sError = NULL;
+        gint nEntries = importLearnStringIndexes( sOptImportLSindexes, &sError );
+
+        if( nEntries == ERROR ) {
+            g_printerr( "Cannot import learn string indexes from %s: %s\n", sOptImportLSindexes, sError );
+        } else {
+            LOG( G_LOG_LEVEL_INFO, "%d learn string index entries imported from %s", nEntries, sOptImportLSindexes );
+            saveLearnStringIndexes();
+        }
+        g_free( sError );
+        bAbort = bExitAfterStartup = TRUE;
+    }
+    if( sOptExportLSindexes ) {
+        gchar *sError = NULL;
+
+        if( exportLearnStringIndexes( sOptExportLSindexes, &sError ) == ERROR )
+            g_printerr( "Cannot export learn string indexes to %s: %s\n", sOptExportLSindexes, sError );
+        g_free( sError );
+        bAbort = bExitAfterStartup = TRUE;
+    }
 
     for( int i=0; i < NUM_HPGL_PENS; i++ ) {
         HPGLpens[ i ] = HPGLpensFactory[ i ];
@@ -564,6 +682,7 @@ on_startup (GApplication *app, gpointer udata)
         plotElementColors[ i ] = plotElementColorsFactory[ i ];
     }
     pGlobal->PDFpaperSize = eLetter;
+    pGlobal->touchstoneOptions = (tTouchstoneOptions){ eTS_RI, eTS_MHZ, 50.0, FALSE };
 
 	if( bAbort )
 		g_application_quit (G_APPLICATION ( app ));
@@ -583,17 +702,20 @@ on_shutdown (GApplication *app, gpointer userData)
 	int i;
 
     // cleanup
-    messageEventData *messageData = g_malloc0( sizeof(messageEventData) );
-    messageData->command = TG_END;
-    g_async_queue_push( pGlobal->messageQueueToGPIB, messageData );
+    postDataToGPIBThread( TG_END, NULL );
 
-   saveProgramOptions( pGlobal );
+    // (the options were not recovered if there was no GUI)
+    if( pGlobal->flags.bRunning )
+        saveProgramOptions( pGlobal );
 
     if( pGlobal->pGThread ) {
         g_thread_join( pGlobal->pGThread );
         g_thread_unref( pGlobal->pGThread );
     }
+    endGPIBsession();
+    saveTimingModel();
 
+    finishBackgroundExports();
     closeDB();
 
     g_list_free_full ( g_steal_pointer (&pGlobal->pProjectList), (GDestroyNotify)g_free );
@@ -603,30 +725,32 @@ on_shutdown (GApplication *app, gpointer userData)
     g_free( pGlobal->HP8753cal.pHP8753_learn );
 	g_free( pGlobal->sLastDirectory );
 	g_free( pGlobal->sProject );
+	g_free( pGlobal->sCalKit );
 
     for( eChannel channel=0; channel < eNUM_CH; channel++ ) {
         for( i=0; i < MAX_CAL_ARRAYS; i++ )
         	g_free( pGlobal->HP8753cal.perChannelCal[channel].pCalArrays[i] );
     	g_free( pGlobal->HP8753.channels[ channel ].responsePoints );
     	g_free( pGlobal->HP8753.channels[ channel ].stimulusPoints );
+    	g_free( pGlobal->HP8753.channels[ channel ].complexPoints );
+    	invalidateReformatCache( pGlobal, channel );
     }
 
-    g_free( pGlobal->HP8753.S2P.freq );
-    g_free( pGlobal->HP8753.S2P.S11 );
-    g_free( pGlobal->HP8753.S2P.S21 );
-    g_free( pGlobal->HP8753.S2P.S22 );
-    g_free( pGlobal->HP8753.S2P.S12 );
+    freeS2P( &pGlobal->HP8753.S2P );
+    freeReferenceTrace( &pGlobal->referenceTrace );
 
     // Destroy queue and source
     g_async_queue_unref( pGlobal->messageQueueToMain );
     g_source_destroy( pGlobal->messageEventSource );
     g_source_unref ( pGlobal->messageEventSource );
 
-	g_hash_table_destroy( globalData.widgetHashTable );
+	if( globalData.widgetHashTable )
+		g_hash_table_destroy( globalData.widgetHashTable );
 
     LOG( G_LOG_LEVEL_INFO, "Ending");
 }
 
+#ifndef HP8753_BENCHMARK
 /*!     \brief  Start of program
  *
  * Start of program
@@ -658,4 +782,4 @@ main(int argc, char *argv[]) {
 
 	return EXIT_SUCCESS;
 }
-
+#endif /* HP8753_BENCHMARK */
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * The indexes of settings in the learn string (that cannot be queried) differ
+ * between firmware versions. They are kept here for each product and firmware:
+ * those compiled in below, those learned by analyze8753learnString (saved in the
+ * database) and those imported from a file exported by another installation.
+ *
+ * An index of 0 is not known. Only the missing indexes of a firmware need be
+ * found by analyzing the learn string (which presets the HP8753 several times).
+ */
+
+#define ANY_PRODUCT		"*"
+
+// Index to HP8753 learn string for items that we cannot
+// get with conventional queries.
+// This will no doubt be different for every firmware version, so if in doubt
+// we don't access markers
+static const tLearnStringIndexes builtInLSindexes[] = {
+		{
+		  .version        = 413,          // version valid for the data below
+		  .iActiveChannel = 1859,         // active channel (0x01 or 0x02)
+		  .iMarkersOn     = {2323, 2325}, // markers on     (bit or of 0x02 (marker 1) to 0x10 (marker 4) with 0x20 as all off)
+		  .iMarkerActive  = {1285, 1378}, // current marker (0x02 (marker 1) to 0x10 (marker 4))
+		  .iMarkerDelta   = {1286, 1379}, // (bit or of 0x02 (marker 1) to 0x10 (marker 4) with 0x20 (fixed) 0x40 as all off)
+		  .iStartStop     = {2383, 2385}, // stimulus start/stop or center/span (0x01 is start/stop)
+		  .iSmithMkrType  = {1289, 1382}, // Smith marker type 0x00 - Lin / 0x01 - Log / 0x02 - Re-Im / 0x04 - R+jX / 0x08 - G+jB
+		  .iPolarMkrType  = {1288, 1381}, // Polar marker type 0x10 - Lin / 0x20 - log / 0x40 - Re-Im
+		  .iNumSegments   = {2465, 2467}  // Number of segments defined (needed with 'all segments' sweep)
+		}
+};
+
+// The indexes (by name in the exported file)
+static const struct {
+	const gchar *sKey;
+	gsize offset;
+	gint nIndexes;
+} LSfields[] = {
+		{ "ActiveChannel",   G_STRUCT_OFFSET( tLearnStringIndexes, iActiveChannel ), 1 },
+		{ "StartStop",       G_STRUCT_OFFSET( tLearnStringIndexes, iStartStop ),     2 },
+		{ "MarkerActive",    G_STRUCT_OFFSET( tLearnStringIndexes, iMarkerActive ),  2 },
+		{ "MarkersOn",       G_STRUCT_OFFSET( tLearnStringIndexes, iMarkersOn ),     2 },
+		{ "MarkerDelta",     G_STRUCT_OFFSET( tLearnStringIndexes, iMarkerDelta ),   2 },
+		{ "SmithMarkerType", G_STRUCT_OFFSET( tLearnStringIndexes, iSmithMkrType ),  2 },
+		{ "PolarMarkerType", G_STRUCT_OFFSET( tLearnStringIndexes, iPolarMkrType ),  2 },
+		{ "Segments",        G_STRUCT_OFFSET( tLearnStringIndexes, iNumSegments ),   2 }
+};
+#define N_LS_FIELDS		(sizeof( LSfields ) / sizeof( LSfields[0] ))
+#define LS_FIELD( pLS, field )	((guint *)((guchar *)(pLS) + LSfields[ field ].offset))
+
+static GHashTable *registry = NULL;		// key "product\tfirmware"
+static GMutex registryMutex;
+
+/*!     \brief  Free a registry entry
+ *
+ * \param pEntry        pointer to the entry
+ */
+static void
+freeLearnStringRegistryEntry( tLearnStringRegistryEntry *pEntry ) {
+	g_free( pEntry->sProduct );
+	g_free( pEntry );
+}
+
+/*!     \brief  Create the registry with the compiled in indexes
+ *
+ * Called with the registry locked.
+ */
+static void
+initLearnStringRegistry( void ) {
+	tLearnStringRegistryEntry *pEntry;
+
+	if( registry != NULL )
+		return;
+	registry = g_hash_table_new_full( g_str_hash, g_str_equal, g_free,
+			(GDestroyNotify)freeLearnStringRegistryEntry );
+	for( gint i = 0; i < sizeof( builtInLSindexes ) / sizeof( tLearnStringIndexes ); i++ ) {
+		pEntry = g_new0( tLearnStringRegistryEntry, 1 );
+		pEntry->sProduct = g_strdup( ANY_PRODUCT );
+		pEntry->indexes = builtInLSindexes[ i ];
+		pEntry->bBuiltIn = TRUE;
+		g_hash_table_insert( registry, g_strdup_printf( "%s\t%d", ANY_PRODUCT, pEntry->indexes.version ), pEntry );
+	}
+}
+
+/*!     \brief  Find (or optionally create) the entry of a product and firmware
+ *
+ * Called with the registry locked.
+ *
+ * \param sProduct      product (or ANY_PRODUCT)
+ * \param version       firmware version (e.g. 413)
+ * \param bCreate       create the entry if it does not exist
+ * \return              pointer to the entry (or NULL)
+ */
+static tLearnStringRegistryEntry *
+findLearnStringRegistryEntry( const gchar *sProduct, gint version, gboolean bCreate ) {
+	tLearnStringRegistryEntry *pEntry;
+	gchar *sKey;
+
+	initLearnStringRegistry();
+	sKey = g_strdup_printf( "%s\t%d", sProduct, version );
+	if( (pEntry = g_hash_table_lookup( registry, sKey )) != NULL || !bCreate ) {
+		g_free( sKey );
+		return pEntry;
+	}
+
+	pEntry = g_new0( tLearnStringRegistryEntry, 1 );
+	pEntry->sProduct = g_strdup( sProduct );
+	pEntry->indexes.version = version;
+	g_hash_table_insert( registry, sKey, pEntry );
+	return pEntry;
+}
+
+/*!     \brief  Are all the learn string indexes known
+ *
+ * \param pLSindexes    pointer to the indexes
+ * \return              TRUE if none is missing
+ */
+gboolean
+learnStringIndexesComplete( tLearnStringIndexes *pLSindexes ) {
+	for( gint field = 0; field < N_LS_FIELDS; field++ )
+		for( gint i = 0; i < LSfields[ field ].nIndexes; i++ )
+			if( LS_FIELD( pLSindexes, field )[ i ] == 0 )
+				return FALSE;
+	return TRUE;
+}
+
+/*!     \brief  Find the learn string indexes of a product and firmware
+ *
+ * The indexes of the product are preferred to those for any product.
+ * The entries are not freed, so the pointer remains valid.
+ *
+ * \param sProduct      product (from the identity of the HP8753)
+ * \param version       firmware version (e.g. 413)
+ * \return              pointer to the indexes or NULL if none are known
+ */
+tLearnStringIndexes *
+lookupLearnStringIndexes( const gchar *sProduct, gint version ) {
+	tLearnStringRegistryEntry *pEntry;
+
+	g_mutex_lock( &registryMutex );
+	if( (pEntry = findLearnStringRegistryEntry( sProduct ? sProduct : ANY_PRODUCT, version, FALSE )) == NULL )
+		pEntry = findLearnStringRegistryEntry( ANY_PRODUCT, version, FALSE );
+	g_mutex_unlock( &registryMutex );
+
+	return pEntry ? &pEntry->indexes : NULL;
+}
+
+/*!     \brief  Add learn string indexes (analyzed, recovered or imported) to the registry
+ *
+ * Only the indexes that are known (not 0) replace those already registered.
+ *
+ * \param sProduct      product (NULL or "*" for any product)
+ * \param pLSindexes    pointer to the indexes (with the firmware version)
+ * \return              pointer to the registered indexes
+ */
+tLearnStringIndexes *
+registerLearnStringIndexes( const gchar *sProduct, tLearnStringIndexes *pLSindexes ) {
+	tLearnStringRegistryEntry *pEntry;
+
+	g_mutex_lock( &registryMutex );
+	pEntry = findLearnStringRegistryEntry( sProduct ? sProduct : ANY_PRODUCT, pLSindexes->version, TRUE );
+	for( gint field = 0; field < N_LS_FIELDS; field++ )
+		for( gint i = 0; i < LSfields[ field ].nIndexes; i++ )
+			if( LS_FIELD( pLSindexes, field )[ i ] != 0
+					&& LS_FIELD( pLSindexes, field )[ i ] != LS_FIELD( &pEntry->indexes, field )[ i ] ) {
+				LS_FIELD( &pEntry->indexes, field )[ i ] = LS_FIELD( pLSindexes, field )[ i ];
+				// (a compiled in entry that has been changed is saved like the others)
+				pEntry->bBuiltIn = FALSE;
+			}
+	g_mutex_unlock( &registryMutex );
+
+	return &pEntry->indexes;
+}
+
+/*!     \brief  Order registry entries by product and firmware
+ *
+ * \param a             entry
+ * \param b             entry
+ * \return              negative if a is first
+ */
+static gint
+compareLearnStringRegistryEntries( gconstpointer a, gconstpointer b ) {
+	const tLearnStringRegistryEntry *pA = a, *pB = b;
+	gint cmp = g_strcmp0( pA->sProduct, pB->sProduct );
+
+	return cmp != 0 ? cmp : pA->indexes.version - pB->indexes.version;
+}
+
+/*!     \brief  Copy the entries of the registry
+ *
+ * \param bIncludeBuiltIn   include the compiled in entries
+ * \return              list of copies of the entries (free with freeLearnStringRegistryEntries)
+ */
+GList *
+learnStringRegistryEntries( gboolean bIncludeBuiltIn ) {
+	GList *entries = NULL;
+	GHashTableIter iter;
+	tLearnStringRegistryEntry *pEntry;
+
+	g_mutex_lock( &registryMutex );
+	initLearnStringRegistry();
+	g_hash_table_iter_init( &iter, registry );
+	while( g_hash_table_iter_next( &iter, NULL, (gpointer *)&pEntry ) ) {
+		if( pEntry->bBuiltIn && !bIncludeBuiltIn )
+			continue;
+		tLearnStringRegistryEntry *pCopy = g_memdup2( pEntry, sizeof( tLearnStringRegistryEntry ) );
+		pCopy->sProduct = g_strdup( pEntry->sProduct );
+		entries = g_list_prepend( entries, pCopy );
+	}
+	g_mutex_unlock( &registryMutex );
+
+	return g_list_sort( entries, compareLearnStringRegistryEntries );
+}
+
+/*!     \brief  Free the list returned by learnStringRegistryEntries
+ *
+ * \param entries       list of entries
+ */
+void
+freeLearnStringRegistryEntries( GList *entries ) {
+	g_list_free_full( entries, (GDestroyNotify)freeLearnStringRegistryEntry );
+}
+
+/*!     \brief  Write the registry to a file (to import in another installation)
+ *
+ * Each product and firmware is a group of the key file, e.g.
+ *
+ *   [8753C 4.13]
+ *   Product=8753C
+ *   Firmware=413
+ *   ActiveChannel=1859
+ *   StartStop=2383;2385
+ *   ...
+ *
+ * Indexes that are not known are left out.
+ *
+ * \param sFilename     name of the file to write
+ * \param psError       returns the (malloced) reason if the file cannot be written
+ * \return              number of entries written or ERROR
+ */
+gint
+exportLearnStringIndexes( gchar *sFilename, gchar **psError ) {
+	GKeyFile *keyFile = g_key_file_new();
+	GList *entries = learnStringRegistryEntries( TRUE );
+	GError *err = NULL;
+	gint nEntries = 0;
+
+	*psError = NULL;
+	g_key_file_set_comment( keyFile, NULL, NULL, " HP8753 learn string indexes (by product and firmware)", NULL );
+	for( GList *l = entries; l != NULL; l = l->next, nEntries++ ) {
+		tLearnStringRegistryEntry *pEntry = l->data;
+		gchar *sGroup = g_strdup_printf( "%s %d.%02d", pEntry->sProduct,
+				pEntry->indexes.version / 100, pEntry->indexes.version % 100 );
+
+		g_key_file_set_string( keyFile, sGroup, "Product", pEntry->sProduct );
+		g_key_file_set_integer( keyFile, sGroup, "Firmware", pEntry->indexes.version );
+		for( gint field = 0; field < N_LS_FIELDS; field++ ) {
+			guint *pIndexes = LS_FIELD( &pEntry->indexes, field );
+			gint indexes[ 2 ] = { pIndexes[ 0 ], LSfields[ field ].nIndexes > 1 ? pIndexes[ 1 ] : 0 };
+
+			if( indexes[ 0 ] != 0 || indexes[ 1 ] != 0 )
+				g_key_file_set_integer_list( keyFile, sGroup, LSfields[ field ].sKey,
+						indexes, LSfields[ field ].nIndexes );
+		}
+		g_free( sGroup );
+	}
+	freeLearnStringRegistryEntries( entries );
+
+	if( !g_key_file_save_to_file( keyFile, sFilename, &err ) ) {
+		*psError = g_strdup( err->message );
+		g_clear_error( &err );
+		nEntries = ERROR;
+	}
+	g_key_file_free( keyFile );
+	return nEntries;
+}
+
+/*!     \brief  Add the learn string indexes in a file (exported by another installation)
+ *
+ * The whole file is read before any entry is registered, so a file with an
+ * error adds nothing.
+ *
+ * \param sFilename     name of the file to read
+ * \param psError       returns the (malloced) reason if the file cannot be used
+ * \return              number of entries imported or ERROR
+ */
+gint
+importLearnStringIndexes( gchar *sFilename, gchar **psError ) {
+	GKeyFile *keyFile = g_key_file_new();
+	gchar **sGroups = NULL, **sProducts = NULL;
+	tLearnStringIndexes *pLSindexes = NULL;
+	GError *err = NULL;
+	gint nEntries = ERROR, nGroups;
+
+	*psError = NULL;
+	if( !g_key_file_load_from_file( keyFile, sFilename, G_KEY_FILE_NONE, &err ) ) {
+		*psError = g_strdup( err->message );
+		g_clear_error( &err );
+		goto err;
+	}
+
+	sGroups = g_key_file_get_groups( keyFile, NULL );
+	nGroups = g_strv_length( sGroups );
+	sProducts = g_new0( gchar *, nGroups + 1 );
+	pLSindexes = g_new0( tLearnStringIndexes, nGroups );
+	for( gint i = 0; i < nGroups; i++ ) {
+		sProducts[ i ] = g_key_file_get_string( keyFile, sGroups[ i ], "Product", NULL );
+		pLSindexes[ i ].version = g_key_file_get_integer( keyFile, sGroups[ i ], "Firmware", NULL );
+		if( sProducts[ i ] == NULL || pLSindexes[ i ].version <= 0 ) {
+			*psError = g_strdup_printf( "[%s] needs the Product and Firmware", sGroups[ i ] );
+			goto err;
+		}
+		for( gint field = 0; field < N_LS_FIELDS; field++ ) {
+			gsize nIndexes = 0;
+			gint *indexes = g_key_file_get_integer_list( keyFile, sGroups[ i ], LSfields[ field ].sKey, &nIndexes, NULL );
+
+			for( gint n = 0; indexes && n < MIN( nIndexes, LSfields[ field ].nIndexes ); n++ )
+				LS_FIELD( &pLSindexes[ i ], field )[ n ] = MAX( indexes[ n ], 0 );
+			g_free( indexes );
+		}
+	}
+
+	for( nEntries = 0; nEntries < nGroups; nEntries++ )
+		registerLearnStringIndexes( sProducts[ nEntries ], &pLSindexes[ nEntries ] );
+
+err:
+	g_free( pLSindexes );
+	g_strfreev( sProducts );
+	g_strfreev( sGroups );
+	g_key_file_free( keyFile );
+	return nEntries;
+}
@@ -28,12 +28,267 @@ clearNotification( gpointer labelWidget ) {
 GSourceFuncs messageEventFunctions = { messageEventPrepare, messageEventCheck,
 		messageEventDispatch, NULL, };
 
+/*
+ * Messages from the GPIB thread to the main loop are copied into preallocated
+ * slots of a lock-free single producer / single consumer ring, so that posting
+ * status during an acquisition neither allocates nor takes a lock. Progress
+ * counts (postInfoWithCount) overwrite a single slot; the main loop shows only
+ * the latest. Messages from other threads use the queue. When the ring is full
+ * the GPIB thread's messages also go to the queue, and keep going there until the
+ * main loop has taken all of them, so that none can overtake another through the ring.
+ */
+typedef struct {
+	enum _threadmessage command;
+	guint		sequence;			// order of posting by the GPIB thread
+	void  *		data;
+	gboolean	bMessage;			// sMessage holds a string (rather than NULL)
+	gchar		sMessage[ MSG_STRING_SIZE ];
+} tMessageSlot;
+
+static tMessageSlot messageRing[ MESSAGE_RING_SIZE ];
+static guint ringHead = 0;			// slots filled (written only by the GPIB thread)
+static guint ringTail = 0;			// slots emptied (written only by the main loop)
+static GThread *ringProducer = NULL;
+static guint producerSequence = 0;	// GPIB thread only
+static guint ringOverflow = 0;		// GPIB thread messages in the queue (not yet handled)
+
+static struct {
+	guint		version;			// odd while being written
+	guint		sequence;
+	gchar		sMessage[ MSG_STRING_SIZE ];
+} progress;
+static guint shownProgressVersion = 0;	// main loop only
+static guint shownSequence = 0;			// sequence of the message on the status line
+
+/*!     \brief  Post messages from this thread through the message ring
+ *
+ * Called once at the start of the GPIB thread (the only producer).
+ */
+void
+claimMessageRing( void ) {
+	ringProducer = g_thread_self();
+}
+
+/*!     \brief  Drop a character cut short when a message was copied into a slot
+ *
+ * \param sMessage      : the (possibly truncated) message in a slot of MSG_STRING_SIZE
+ */
+static void
+trimPartialCharacter( gchar *sMessage ) {
+	gsize length = strlen( sMessage );
+	gchar *sLast;
+
+	if( length < MSG_STRING_SIZE - 1
+			|| (sLast = g_utf8_find_prev_char( sMessage, sMessage + length )) == NULL )
+		return;
+	if( g_utf8_get_char_validated( sLast, sMessage + length - sLast ) == (gunichar) -2 )
+		*sLast = 0;
+}
+
+/*!     \brief  Put a message into the ring
+ *
+ * \param Command       : enumerated state to indicate action
+ * \param sMessage      : message (or NULL)
+ * \param data          : data (ownership passes to the main loop)
+ * \return TRUE if posted or FALSE if it must be queued (not the producer thread or the ring is full or has overflowed)
+ */
+static gboolean
+postToMessageRing( enum _threadmessage Command, gchar *sMessage, void *data ) {
+	guint head = ringHead;
+	tMessageSlot *pSlot;
+
+	if( ringProducer != g_thread_self() || g_atomic_int_get( &ringOverflow ) != 0
+			|| head - g_atomic_int_get( &ringTail ) >= MESSAGE_RING_SIZE )
+		return FALSE;
+
+	pSlot = &messageRing[ head % MESSAGE_RING_SIZE ];
+	pSlot->command = Command;
+	pSlot->sequence = ++producerSequence;
+	pSlot->data = data;
+	pSlot->bMessage = (sMessage != NULL);
+	if( sMessage ) {
+		g_strlcpy( pSlot->sMessage, sMessage, MSG_STRING_SIZE );
+		trimPartialCharacter( pSlot->sMessage );
+	}
+	g_atomic_int_set( &ringHead, head + 1 );
+	g_main_context_wakeup( NULL );
+	return TRUE;
+}
+
+/*!     \brief  Count a message the GPIB thread could not put into the ring
+ *
+ * Until the main loop has handled it, the GPIB thread's messages follow it through the queue.
+ *
+ * \param message       : the message about to be queued
+ */
+static void
+queuedFromRingProducer( messageEventData *message ) {
+	if( ringProducer == g_thread_self() ) {
+		message->bOverflow = TRUE;
+		g_atomic_int_inc( &ringOverflow );
+	}
+}
+
+/*!     \brief  Are there messages or progress for the main loop to show
+ *
+ * \return TRUE if there is something to dispatch
+ */
+static gboolean
+messagesPending( void ) {
+	return g_atomic_int_get( &ringHead ) != ringTail
+			|| g_atomic_int_get( &progress.version ) != shownProgressVersion
+			|| g_async_queue_length( globalData.messageQueueToMain ) > 0;
+}
+
+/*!     \brief  Act on a message posted to the main loop
+ *
+ * \param pGlobal  : pointer to global data
+ * \param message  : the message (its string is freed by the caller)
+ */
+static void
+handleMessage( tGlobal *pGlobal, messageEventData *message ) {
+	GtkWidget *wBoxPlotType;
+
+	GtkLabel *wLabel = GTK_LABEL(
+			g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_Lbl_Status"));
+	gchar *sMarkup;
+
+	switch (message->command) {
+	case TM_INFO:
+	case TM_INFO_HIGHLIGHT:
+		if( clearTimerID != 0 )
+			g_source_remove( clearTimerID );
+		clearTimerID = g_timeout_add ( 10000, clearNotification, wLabel );
+
+		if( message->command == TM_INFO )
+			sMarkup = g_markup_printf_escaped("<i>%s</i>", message->sMessage);
+		else
+			sMarkup = g_markup_printf_escaped("<span color='darkgreen'><i>َ%s</i></span>", message->sMessage);
+		gtk_label_set_markup(wLabel, sMarkup);
+		g_free(sMarkup);
+//    		gtk_label_set_text( wLabel, message->sMessage);
+		break;
+
+	case TM_ERROR:
+		if( clearTimerID != 0 )
+			g_source_remove( clearTimerID );
+		clearTimerID = g_timeout_add ( 15000, clearNotification, wLabel );
+
+		sMarkup = g_markup_printf_escaped(
+				"<span color=\"darkred\">%s</span>", message->sMessage);
+		gtk_label_set_markup(wLabel, sMarkup);
+		g_free(sMarkup);
+
+		break;
+
+	case TM_SAVE_SETUPandCAL:
+		if( saveCalibrationAndSetup( pGlobal, pGlobal->sProject, (gchar *)message->data ) != ERROR ) {
+		    populateCalComboBoxWidget( pGlobal );
+		    showCalInfo( &(pGlobal->HP8753cal), pGlobal );
+		    gtk_widget_set_sensitive(
+		            GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Recall")),
+		            TRUE );
+		    gtk_widget_set_sensitive(
+		            GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Delete")),
+		            TRUE );
+		}
+		gtk_notebook_set_current_page ( GTK_NOTEBOOK( g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_Note")),
+				NPAGE_CALIBRATION);
+		g_free( message->data );
+		break;
+	case TM_SAVE_LEARN_STRING_ANALYSIS:
+		saveLearnStringAnalysis( pGlobal, (tLearnStringIndexes *)message->data );
+		saveLearnStringIndexes();
+		gchar *sFWlabel = g_strdup_printf( "Firmware %d.%d", pGlobal->HP8753.analyzedLSindexes.version/100,
+				pGlobal->HP8753.analyzedLSindexes.version % 100 );
+		gtk_label_set_label( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Lbl_Firmware"),
+				pGlobal->HP8753.analyzedLSindexes.version != 0 ? sFWlabel : "Firmware unknown");
+		g_free( sFWlabel );
+		break;
+
+	case TM_SAVE_S2P:
+	case TM_SAVE_S1P:
+		// the file is written by a background thread (which reports success or failure)
+		sensitiseControlsInUse( pGlobal, TRUE );
+		exportTouchstoneInBackground( (gchar *)message->data, &pGlobal->HP8753.S2P, &pGlobal->touchstoneOptions );
+		g_free( message->data );
+		break;
+	case TM_SAVE_SNP:
+		sensitiseControlsInUse( pGlobal, TRUE );
+		exportSnPinBackground( ((tSwitchSequence *)message->data)->sFilename,
+				&((tSwitchSequence *)message->data)->SnP, &pGlobal->touchstoneOptions );
+		freeSwitchSequence( (tSwitchSequence *)message->data );
+		break;
+	case TM_DB_STATISTICS:
+		showDBstatistics( pGlobal, (tDBstatistics *)message->data );
+		freeDBstatistics( (tDBstatistics *)message->data );
+		break;
+	case TM_CAPTURE_TIMING:
+		// a capture that was never drawn is saved without its redraw
+		if( pGlobal->pPendingCaptureTiming ) {
+			pGlobal->pPendingCaptureTiming->phaseStart = g_get_monotonic_time();
+			completeCaptureRedraw( pGlobal );
+		}
+		pGlobal->pPendingCaptureTiming = (tCaptureTiming *)message->data;
+		pGlobal->pPendingCaptureTiming->phaseStart = g_get_monotonic_time();
+		break;
+	case TM_COMPLETE_GPIB:
+		// the job may have read new traces
+		discardStaleReformatCache( pGlobal );
+		sensitiseControlsInUse( pGlobal, TRUE );
+		showGPIBtransactionStatistics( pGlobal );
+		break;
+	case TM_REFRESH_TRACE:
+		wBoxPlotType = g_hash_table_lookup(pGlobal->widgetHashTable,
+		                        (gconstpointer )"WID_BoxPlotType");
+		if( pGlobal->HP8753.plotHPGL == NULL )
+		    gtk_widget_hide (GTK_WIDGET( wBoxPlotType ));
+		else
+		    gtk_widget_show (GTK_WIDGET( wBoxPlotType ));
+
+		if (message->data == 0 ) {
+			gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup(pGlobal->widgetHashTable,
+									(gconstpointer )"WID_DrawingArea_Plot_A")));
+			if ( !globalData.HP8753.flags.bDualChannel
+					|| !pGlobal->HP8753.flags.bSplitChannels
+//						|| !pGlobal->HP8753.channels[ eCH_TWO ].chFlags.bValidData
+					|| ( pGlobal->HP8753.flags.bShowHPGLplot /* && pGlobal->HP8753.flags.bHPGLdataValid */ ) ) {
+				visibilityFramePlot_B( pGlobal, FALSE );
+			}
+		} else {
+			if ( // pGlobal->HP8753.channels[ eCH_TWO ].chFlags.bValidData &&
+					(globalData.HP8753.flags.bDualChannel && pGlobal->HP8753.flags.bSplitChannels) &&
+					! ( pGlobal->HP8753.flags.bShowHPGLplot /* && pGlobal->HP8753.flags.bHPGLdataValid */ ) ) {
+			    visibilityFramePlot_B( pGlobal, TRUE);
+				gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup(pGlobal->widgetHashTable,
+										(gconstpointer )"WID_DrawingArea_Plot_B")));
+			} else {
+				visibilityFramePlot_B( pGlobal, FALSE );
+			}
+		}
+		gtk_label_set_label ( GTK_LABEL( g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_LblTraceTime")),
+				globalData.HP8753.dateTime );
+
+		if( globalData.HP8753.channels[ eCH_ONE ].chFlags.bValidData
+				|| globalData.HP8753.channels[ eCH_TWO ].chFlags.bValidData)
+			gtk_widget_set_sensitive(
+				GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Save")),
+				TRUE );
+
+		break;
+	default:
+		break;
+	}
+}
+
 /*!     \brief  Dispatch message posted by a GPIB thread
  *
  * Only the main event loop can update screen widgets.
  * Other threads post messages that are accepted here.
  *
- * Display messages (strings) are individually pulled from a queue.
+ * Messages from the GPIB thread are taken from the ring (in order), then the
+ * latest progress is shown (unless a later message has replaced it) and then
+ * the messages from other threads are pulled from the queue.
  *
  * \param source   : GSource for the message event
  * \param callback : callback defined for this source (unused)
@@ -42,170 +297,41 @@ GSourceFuncs messageEventFunctions = { messageEventPrepare, messageEventCheck,
  */
 gboolean
 messageEventDispatch(GSource *source, GSourceFunc callback, gpointer udata) {
-	messageEventData *message;
-
+	messageEventData *message, ringMessage;
 	tGlobal *pGlobal = &globalData;
-	GtkWidget *wBoxPlotType;
-	FILE *fSXP;
+	guint tail, version;
 
-	GtkLabel *wLabel = GTK_LABEL(
-			g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_Lbl_Status"));
-	gchar *sMarkup;
+	for( tail = ringTail; tail != g_atomic_int_get( &ringHead ); tail++ ) {
+		tMessageSlot *pSlot = &messageRing[ tail % MESSAGE_RING_SIZE ];
 
-	while ((message = g_async_queue_try_pop(pGlobal->messageQueueToMain))) {
-		switch (message->command) {
-		case TM_INFO:
-		case TM_INFO_HIGHLIGHT:
-			if( clearTimerID != 0 )
-				g_source_remove( clearTimerID );
-			clearTimerID = g_timeout_add ( 10000, clearNotification, wLabel );
-
-			if( message->command == TM_INFO )
-				sMarkup = g_markup_printf_escaped("<i>%s</i>", message->sMessage);
-			else
-				sMarkup = g_markup_printf_escaped("<span color='darkgreen'><i>َ%s</i></span>", message->sMessage);
-			gtk_label_set_markup(wLabel, sMarkup);
-			g_free(sMarkup);
-//    		gtk_label_set_text( wLabel, message->sMessage);
-			break;
-
-		case TM_ERROR:
-			if( clearTimerID != 0 )
-				g_source_remove( clearTimerID );
-			clearTimerID = g_timeout_add ( 15000, clearNotification, wLabel );
-
-			sMarkup = g_markup_printf_escaped(
-					"<span color=\"darkred\">%s</span>", message->sMessage);
-			gtk_label_set_markup(wLabel, sMarkup);
-			g_free(sMarkup);
-
-			break;
-
-		case TM_SAVE_SETUPandCAL:
-			if( saveCalibrationAndSetup( pGlobal, pGlobal->sProject, (gchar *)message->data ) != ERROR ) {
-			    populateCalComboBoxWidget( pGlobal );
-	            showCalInfo( &(pGlobal->HP8753cal), pGlobal );
-	            gtk_widget_set_sensitive(
-	                    GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Recall")),
-	                    TRUE );
-	            gtk_widget_set_sensitive(
-	                    GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Delete")),
-	                    TRUE );
-			}
-			gtk_notebook_set_current_page ( GTK_NOTEBOOK( g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_Note")),
-					NPAGE_CALIBRATION);
-			g_free( message->data );
-			break;
-		case TM_SAVE_LEARN_STRING_ANALYSIS:
-			saveLearnStringAnalysis( pGlobal, (tLearnStringIndexes *)message->data );
-			gchar *sFWlabel = g_strdup_printf( "Firmware %d.%d", pGlobal->HP8753.analyzedLSindexes.version/100,
-					pGlobal->HP8753.analyzedLSindexes.version % 100 );
-			gtk_label_set_label( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Lbl_Firmware"),
-					pGlobal->HP8753.analyzedLSindexes.version != 0 ? sFWlabel : "Firmware unknown");
-			g_free( sFWlabel );
-			break;
-
-		case TM_SAVE_S2P:
-			sensitiseControlsInUse( pGlobal, TRUE );
-			if( (fSXP = fopen( message->data, "w" )) == NULL ) {
-				gchar *sError = g_strdup_printf( "Cannot write: %s", (gchar *)message->data);
-				postError( sError );
-				g_free( sError );
-			} else {
-				fprintf( fSXP,
-						"! 2-port S-paramater data, multiple frequency points\n"
-						"! from HP8753 Network analyzer\n"
-						"# MHz S RI R 50.0\n"
-						"! freq\tReS11\tImS11\tReS21\tImS21\tReS12\tImS12\tReS22\tImS22\n" );
-				for( int i=0; i < pGlobal->HP8753.S2P.nPoints; i++ ) {
-					fprintf( fSXP, "%.16lg\t%.16lg\t%.16lg\t%.16lg\t%.16lg\t%.16lg\t%.16lg\t%.16lg\t%.16lg\n",
-							pGlobal->HP8753.S2P.freq[i]/1.0e6,
-							pGlobal->HP8753.S2P.S11[i].r, pGlobal->HP8753.S2P.S11[i].i,
-							pGlobal->HP8753.S2P.S21[i].r, pGlobal->HP8753.S2P.S21[i].i,
-							pGlobal->HP8753.S2P.S12[i].r, pGlobal->HP8753.S2P.S12[i].i,
-							pGlobal->HP8753.S2P.S22[i].r, pGlobal->HP8753.S2P.S22[i].i );
-				}
-				fclose( fSXP );
-				postInfo( "S2P saved" );
-			}
-			g_free( message->data );
-			break;
-		case TM_SAVE_S1P:
-			sensitiseControlsInUse( pGlobal, TRUE );
-			if( (fSXP = fopen( message->data, "w" )) == NULL ) {
-				gchar *sError = g_strdup_printf( "Cannot write: %s", (gchar *)message->data);
-				postError( sError );
-				g_free( sError );
-			} else {
-				fprintf( fSXP,
-						"! 1-port S-paramater data, multiple frequency points\n"
-						"! from HP8753 Network analyzer\n"
-						"# MHz S RI R 50.0\n" );
-				if( pGlobal->HP8753.S2P.SnPtype == S1P_S11 ) {
-					fprintf( fSXP, "! freq\tReS11\tImS11\n" 	);
-					for( int i=0; i < pGlobal->HP8753.S2P.nPoints; i++ ) {
-						fprintf( fSXP, "%.16lg\t%.16lg\t%.16lg\n",
-								pGlobal->HP8753.S2P.freq[i]/1.0e6,
-								pGlobal->HP8753.S2P.S11[i].r, pGlobal->HP8753.S2P.S11[i].i );
-					}
-				} else {
-					fprintf( fSXP, "! freq\tReS22\tImS22\n" 	);
-					for( int i=0; i < pGlobal->HP8753.S2P.nPoints; i++ ) {
-						fprintf( fSXP, "%.16g\t%.16lg\t%.16lg\n",
-								pGlobal->HP8753.S2P.freq[i]/1.0e6,
-								pGlobal->HP8753.S2P.S22[i].r, pGlobal->HP8753.S2P.S22[i].i );
-					}
-				}
-				fclose( fSXP );
-				postInfo( "S2P saved" );
-			}
-			g_free( message->data );
-			break;
-		case TM_COMPLETE_GPIB:
-			sensitiseControlsInUse( pGlobal, TRUE );
-			break;
-		case TM_REFRESH_TRACE:
-            wBoxPlotType = g_hash_table_lookup(pGlobal->widgetHashTable,
-                                    (gconstpointer )"WID_BoxPlotType");
-            if( pGlobal->HP8753.plotHPGL == NULL )
-                gtk_widget_hide (GTK_WIDGET( wBoxPlotType ));
-            else
-                gtk_widget_show (GTK_WIDGET( wBoxPlotType ));
-
-			if (message->data == 0 ) {
-				gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup(pGlobal->widgetHashTable,
-										(gconstpointer )"WID_DrawingArea_Plot_A")));
-				if ( !globalData.HP8753.flags.bDualChannel
-						|| !pGlobal->HP8753.flags.bSplitChannels
-//						|| !pGlobal->HP8753.channels[ eCH_TWO ].chFlags.bValidData
-						|| ( pGlobal->HP8753.flags.bShowHPGLplot /* && pGlobal->HP8753.flags.bHPGLdataValid */ ) ) {
-					visibilityFramePlot_B( pGlobal, FALSE );
-				}
-			} else {
-				if ( // pGlobal->HP8753.channels[ eCH_TWO ].chFlags.bValidData &&
-						(globalData.HP8753.flags.bDualChannel && pGlobal->HP8753.flags.bSplitChannels) &&
-						! ( pGlobal->HP8753.flags.bShowHPGLplot /* && pGlobal->HP8753.flags.bHPGLdataValid */ ) ) {
-				    visibilityFramePlot_B( pGlobal, TRUE);
-					gtk_widget_queue_draw( GTK_WIDGET( g_hash_table_lookup(pGlobal->widgetHashTable,
-											(gconstpointer )"WID_DrawingArea_Plot_B")));
-				} else {
-					visibilityFramePlot_B( pGlobal, FALSE );
-				}
+		ringMessage = (messageEventData){ pSlot->command, pSlot->bMessage ? pSlot->sMessage : NULL, pSlot->data, 0 };
+		if( pSlot->command == TM_INFO || pSlot->command == TM_INFO_HIGHLIGHT || pSlot->command == TM_ERROR )
+			shownSequence = pSlot->sequence;
+		handleMessage( pGlobal, &ringMessage );
+		g_atomic_int_set( &ringTail, tail + 1 );
+	}
+
+	// the progress slot is rewritten without waiting for us ... try again if it changed while being copied
+	version = g_atomic_int_get( &progress.version );
+	if( version != shownProgressVersion && (version & 1) == 0 ) {
+		gchar sProgress[ MSG_STRING_SIZE ];
+		guint sequence = progress.sequence;
+
+		memcpy( sProgress, progress.sMessage, MSG_STRING_SIZE );
+		if( g_atomic_int_get( &progress.version ) == version ) {
+			shownProgressVersion = version;
+			if( sequence > shownSequence ) {
+				shownSequence = sequence;
+				ringMessage = (messageEventData){ TM_INFO, sProgress, NULL, 0 };
+				handleMessage( pGlobal, &ringMessage );
 			}
-			gtk_label_set_label ( GTK_LABEL( g_hash_table_lookup(pGlobal->widgetHashTable, (gconstpointer )"WID_LblTraceTime")),
-					globalData.HP8753.dateTime );
-
-			if( globalData.HP8753.channels[ eCH_ONE ].chFlags.bValidData
-					|| globalData.HP8753.channels[ eCH_TWO ].chFlags.bValidData)
-				gtk_widget_set_sensitive(
-					GTK_WIDGET( g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_Save")),
-					TRUE );
-
-			break;
-		default:
-			break;
 		}
+	}
 
+	while ((message = g_async_queue_try_pop(pGlobal->messageQueueToMain))) {
+		handleMessage( pGlobal, message );
+		if( message->bOverflow )
+			g_atomic_int_add( &ringOverflow, -1 );
 		g_free(message->sMessage);
 		g_free(message);
 	}
@@ -225,7 +351,10 @@ messageEventDispatch(GSource *source, GSourceFunc callback, gpointer udata) {
  */
 gboolean messageEventPrepare(GSource *source, gint *pTimeout) {
 	*pTimeout = -1;
-	return g_async_queue_length(globalData.messageQueueToMain) > 0;
+	// poll again soon if the progress was being written
+	if( g_atomic_int_get( &progress.version ) & 1 )
+		*pTimeout = 10;
+	return messagesPending();
 }
 
 /*!     \brief  Check source event
@@ -238,7 +367,7 @@ gboolean messageEventPrepare(GSource *source, gint *pTimeout) {
  * \return TRUE if we have a message to dispatch
  */
 gboolean messageEventCheck(GSource *source) {
-	return g_async_queue_length(globalData.messageQueueToMain) > 0;
+	return messagesPending();
 }
 
 /*!     \brief  Send status state from thread to the main loop
@@ -253,10 +382,14 @@ postMessageToMainLoop(enum _threadmessage Command, gchar *sMessage) {
 	// sMesaage can be a pointer to a string or a small gint up to PM_MAX (notification message)
 
 	messageEventData *messageData;   // g_free() in threadEventsDispatch
-	messageData = g_malloc0(sizeof(messageEventData));
 
+	if( postToMessageRing( Command, sMessage, NULL ) )
+		return;
+
+	messageData = g_malloc0(sizeof(messageEventData));
 	messageData->sMessage = g_strdup(sMessage); // g_free() in threadEventsDispatch
 	messageData->command = Command;
+	queuedFromRingProducer( messageData );
 
 	g_async_queue_push(globalData.messageQueueToMain, messageData);
 	g_main_context_wakeup( NULL);
@@ -264,18 +397,27 @@ postMessageToMainLoop(enum _threadmessage Command, gchar *sMessage) {
 
 /*!     \brief  Send message with number from thread to the main loop
  *
- * Send message with number to the main loop
+ * Send progress (a message with numbers) to the main loop.
+ * From the GPIB thread this replaces any progress not yet shown.
  *
- * \param Command	enumerated state to indicate action
  * \param sMessageWithFormat message with printf formatting
  * \param number
+ * \param number2
  */
 void
 postInfoWithCount(gchar *sMessageWithFormat, gint number, gint number2) {
-	gchar *sLabel = g_strdup_printf( sMessageWithFormat, number, number2 );
-	postMessageToMainLoop( TM_INFO, sLabel );
-	g_free (sLabel);
-
+	if( ringProducer == g_thread_self() && g_atomic_int_get( &ringOverflow ) == 0 ) {
+		g_atomic_int_inc( &progress.version );
+		g_snprintf( progress.sMessage, MSG_STRING_SIZE, sMessageWithFormat, number, number2 );
+		trimPartialCharacter( progress.sMessage );
+		progress.sequence = ++producerSequence;
+		g_atomic_int_inc( &progress.version );
+		g_main_context_wakeup( NULL);
+	} else {
+		gchar *sLabel = g_strdup_printf( sMessageWithFormat, number, number2 );
+		postMessageToMainLoop( TM_INFO, sLabel );
+		g_free (sLabel);
+	}
 }
 
 
@@ -290,10 +432,15 @@ void postDataToMainLoop(enum _threadmessage Command, void *data) {
 	// sMesaage can be a pointer to a string or a small gint up to PM_MAX (notification message)
 
 	messageEventData *messageData;   // g_free() in threadEventsDispatch
+
+	if( postToMessageRing( Command, NULL, data ) )
+		return;
+
 	messageData = g_malloc0(sizeof(messageEventData));
 
 	messageData->data = data;
 	messageData->command = Command;
+	queuedFromRingProducer( messageData );
 
 	g_async_queue_push(globalData.messageQueueToMain, messageData);
 	g_main_context_wakeup( NULL);
@@ -315,5 +462,6 @@ void postDataToGPIBThread(enum _threadmessage Command, void *data) {
 	messageData->data = data;
 	messageData->command = Command;
 
-	g_async_queue_push(globalData.messageQueueToGPIB, messageData);
+	// sorted by priority (a duplicate of a queued capture is dropped)
+	queueGPIBjob(globalData.messageQueueToGPIB, messageData);
 }
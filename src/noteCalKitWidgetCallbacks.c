@@ -217,6 +217,9 @@ CB_BtnSendCalKit(GtkButton *wButton, tGlobal *pGlobal) {
 		if( recoverCalibrationKit(pGlobal, sLabel) == 0 ) {
 			postDataToGPIBThread (TG_SEND_CALKIT_to_HP8753, NULL);
 			sensitiseControlsInUse( pGlobal, FALSE );
+			// calibrations saved from now on use this kit
+			g_free( pGlobal->sCalKit );
+			pGlobal->sCalKit = g_strdup( sLabel );
 		} else {
 			postError( "Cannot recover calibration kit");
 		}
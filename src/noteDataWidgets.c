@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <cairo/cairo.h>
 #include <cairo/cairo-pdf.h>
@@ -27,6 +28,52 @@
 
 #include "messageEvent.h"
 
+static const gchar *versionIDs[] = { "1.1", "2.0", NULL };
+static const gchar *versionLabels[] = { "version 1.1", "version 2.0", NULL };
+static const gchar *formatIDs[] = { "RI", "MA", "DB", NULL };	// order of tTouchstoneFormat
+static const gchar *formatLabels[] = { "real / imaginary", "magnitude / angle", "dB / angle", NULL };
+static const gchar *unitIDs[] = { "Hz", "kHz", "MHz", "GHz", NULL };	// order of tTouchstoneUnit
+static const gchar *impedanceIDs[] = { "50", "75", NULL };
+static const gchar *impedanceLabels[] = { "50 Ω", "75 Ω", NULL };
+
+/*!     \brief  Add the Touchstone options to a file chooser
+ *
+ * \param  chooser  the file chooser
+ * \param  pGlobal  pointer to data
+ */
+static void
+addTouchstoneChoices( GtkFileChooser *chooser, tGlobal *pGlobal )
+{
+	gtk_file_chooser_add_choice( chooser, "version", "Touchstone", (const gchar **)versionIDs, (const gchar **)versionLabels );
+	gtk_file_chooser_set_choice( chooser, "version", versionIDs[ pGlobal->touchstoneOptions.bVersion2 ? 1 : 0 ] );
+	gtk_file_chooser_add_choice( chooser, "format", "Format", (const gchar **)formatIDs, (const gchar **)formatLabels );
+	gtk_file_chooser_set_choice( chooser, "format", formatIDs[ pGlobal->touchstoneOptions.format ] );
+	gtk_file_chooser_add_choice( chooser, "unit", "Frequency", (const gchar **)unitIDs, (const gchar **)unitIDs );
+	gtk_file_chooser_set_choice( chooser, "unit", unitIDs[ pGlobal->touchstoneOptions.frequencyUnit ] );
+	gtk_file_chooser_add_choice( chooser, "impedance", "Z₀", (const gchar **)impedanceIDs, (const gchar **)impedanceLabels );
+	gtk_file_chooser_set_choice( chooser, "impedance",
+			pGlobal->touchstoneOptions.referenceImpedance == 75.0 ? impedanceIDs[ 1 ] : impedanceIDs[ 0 ] );
+}
+
+/*!     \brief  Remember the Touchstone options chosen
+ *
+ * \param  chooser  the file chooser
+ * \param  pGlobal  pointer to data
+ */
+static void
+getTouchstoneChoices( GtkFileChooser *chooser, tGlobal *pGlobal )
+{
+	pGlobal->touchstoneOptions.bVersion2 = g_strcmp0( gtk_file_chooser_get_choice( chooser, "version" ), versionIDs[ 1 ] ) == 0;
+	for( gint i = 0; i < eTS_N_FORMATS; i++ )
+		if( g_strcmp0( gtk_file_chooser_get_choice( chooser, "format" ), formatIDs[ i ] ) == 0 )
+			pGlobal->touchstoneOptions.format = i;
+	for( gint i = 0; i < eTS_N_UNITS; i++ )
+		if( g_strcmp0( gtk_file_chooser_get_choice( chooser, "unit" ), unitIDs[ i ] ) == 0 )
+			pGlobal->touchstoneOptions.frequencyUnit = i;
+	pGlobal->touchstoneOptions.referenceImpedance =
+			g_ascii_strtod( gtk_file_chooser_get_choice( chooser, "impedance" ), NULL );
+}
+
 /*!     \brief  Write the S2P or S1P file
  *
  * Determine the filename to use for the SXP data file and
@@ -67,6 +114,8 @@ BtnSXP (GtkButton *wButton, tGlobal *pGlobal, gboolean S2PnotS1P )
 
 	gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
 
+	addTouchstoneChoices( chooser, pGlobal );
+
 	if( lastFilename )
 		sFilename = g_strdup( lastFilename);
 	else
@@ -85,10 +134,13 @@ BtnSXP (GtkButton *wButton, tGlobal *pGlobal, gboolean S2PnotS1P )
 		g_free( pGlobal->sLastDirectory );
 		pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
 
+		getTouchstoneChoices( chooser, pGlobal );
+
 		GString *sFilename = g_string_new( filename );
 		g_free( filename );	// don't need this
 		extPos = g_strrstr( sFilename->str, S2PnotS1P ? ".s2p" : ".s1p" );
-		if( !extPos )
+		// a .npz name saves the S-parameters to a NumPy archive instead
+		if( !extPos && !g_str_has_suffix( sFilename->str, ".npz" ) )
 			g_string_append( sFilename, S2PnotS1P ? ".s2p" : ".s1p" );
 
 		g_free( lastFilename );
@@ -142,78 +194,123 @@ CB_BtnS1P (GtkButton *wButton, tGlobal *pGlobal)
 }
 
 
-/*!     \brief  Write the CSV header to the file
- *
- * The comma separated variabls (CSV) data file has a header lin
- * listing the data in each column.
- *
- * \param  file    	file pointer to the open, writable file
- * \param  sweepCh1	channel 1 sweep type
- * \param  sweepCh2	channel 2 sweep type
- * \param  fmtCh1	channel 1 format
- * \param  fmtCh2	channel 2 format
- * \param  measCh1	measurement channel 1 (S11, S21, SWR etc)
- * \param  measCh2	measurement channel 2
- * \param  bCoupled	boolean indicating if channels coupled
- * \param  bCoupled	boolean indicating if there is data for two channels
- *
- */
-void
-writeCSVheader( FILE *file,
-		tSweepType sweepCh1, tSweepType sweepCh2,
-		tFormat fmtCh1, tFormat fmtCh2,
-		tMeasurement measCh1, tMeasurement measCh2,
-		gboolean bCoupled, gboolean bDualChannel ) {
-	fprintf( file, "%s", optSweepType[ sweepCh1 ].desc );
-	switch( fmtCh1 ) {
-	case eFMT_SMITH:
-	case eFMT_POLAR:
-		fprintf( file, ",%s (re),%s (im)", optMeasurementType[ measCh1 ].desc,  optMeasurementType[ measCh1 ].desc );
-		break;
-	default:
-		fprintf( file, ",%s (%s)", optMeasurementType[ measCh1 ].desc, formatSymbols[ fmtCh1 ] );
-		break;
-	}
-	if( bDualChannel ) {
-		if( !bCoupled )
-			fprintf( file, ",%s", optSweepType[ sweepCh2 ].desc );
-		switch( fmtCh2 ) {
-		case eFMT_SMITH:
-		case eFMT_POLAR:
-			fprintf( file, ",%s (re),%s (im)", optMeasurementType[ measCh2 ].desc,  optMeasurementType[ measCh2 ].desc );
-			break;
-		default:
-			fprintf( file, ",%s (%s)", optMeasurementType[ measCh2 ].desc, formatSymbols[ fmtCh2 ] );
-			break;
-		}
-	}
-	fprintf( file, "\n" );
-}
-
-/*!     \brief  Write a CSV data point
+/*!     \brief  Measure a 3 or 4 port device through a switch matrix
  *
- * The comma separated variabls (CSV) data file has a header lin
- * listing the data in each column.
- *
- * \param  file    	file pointer to the open, writable file
- * \param  tFormat	type of data - (Smith/Polar) has real/imaginary pairs
- * \param  point	complex data point
- * \param  bLF  	add a line feed
+ * Choose the switch matrix sequence and the S3P / S4P file, then
+ * send a message to the HP8753 comms thread to make the measurements.
+ * On completion, a message to the main thread will write the data to the file.
+ * This is initiated by pressing F8
  *
+ * \param  pGlobal  pointer to data
  */
 void
-writeCSVpoint( FILE *file, tFormat format, tComplex *point, gboolean bLF ) {
-	switch( format ) {
-	case eFMT_SMITH:
-	case eFMT_POLAR:
-		fprintf( file, ",%.16lg,%.16lg", point->r,  point->i );
-		break;
-	default:
-		fprintf( file, ",%.16lg", point->r );
-		break;
-	}
-	if( bLF )
-		fprintf( file, "\n" );
+showMultiportCaptureDialog( tGlobal *pGlobal )
+{
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    GtkFileFilter *filter;
+    GtkWindow *wMain = GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) );
+    static gchar *sLastSequence = NULL;
+    tSwitchSequence *pSequence = NULL;
+    gchar *sError = NULL, *sMessage, *sExtension, *sSuggestedName;
+    GDateTime *now;
+
+    if( !gtk_widget_get_sensitive( GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_S2P" ) ) ) ) {
+        postInfo( "Wait for the HP8753 to finish" );
+        return;
+    }
+
+    // the switch matrix sequence
+    dialog = gtk_file_chooser_dialog_new ("Switch matrix sequence for S3P / S4P measurement",
+                    wMain, GTK_FILE_CHOOSER_ACTION_OPEN,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Open", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, "Switch sequence (.ini)" );
+    gtk_file_filter_add_pattern (filter, "*.[iI][nN][iI]");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+    if( sLastSequence )
+        gtk_file_chooser_set_filename( chooser, sLastSequence );
+    else if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        if( (pSequence = loadSwitchSequence( sChosenFilename, &sError )) == NULL ) {
+            sMessage = g_strdup_printf( "Switch sequence: %s", sError );
+            postError( sMessage );
+            g_free( sMessage );
+            g_free( sError );
+        }
+        g_free( sLastSequence );
+        sLastSequence = sChosenFilename;
+    }
+    gtk_widget_destroy (dialog);
+
+    if( pSequence == NULL )
+        return;
+
+    // the S3P / S4P file
+    sExtension = g_strdup_printf( ".s%dp", pSequence->nPorts );
+    dialog = gtk_file_chooser_dialog_new ("Acquire S-paramater data and save to Touchstone file",
+                    wMain, GTK_FILE_CHOOSER_ACTION_SAVE,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Save", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    chooser = GTK_FILE_CHOOSER (dialog);
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, sExtension );
+    sMessage = g_strdup_printf( "*.[sS][%d][pP]", pSequence->nPorts );
+    gtk_file_filter_add_pattern (filter, sMessage);
+    g_free( sMessage );
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+    gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
+    addTouchstoneChoices( chooser, pGlobal );
+
+    now = g_date_time_new_now_local ();
+    sMessage = g_date_time_format( now, "HP8753.%d%b%y.%H%M%S" );
+    sSuggestedName = g_strconcat( sMessage, sExtension, NULL );
+    gtk_file_chooser_set_current_name (chooser, sSuggestedName);
+    g_free( sSuggestedName );
+    g_free( sMessage );
+    g_date_time_unref( now );
+    if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+
+    if (gtk_dialog_run (GTK_DIALOG (dialog)) == GTK_RESPONSE_ACCEPT) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser);
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+        getTouchstoneChoices( chooser, pGlobal );
+
+        if( g_str_has_suffix( sChosenFilename, sExtension ) ) {
+            pSequence->sFilename = sChosenFilename;
+        } else {
+            pSequence->sFilename = g_strconcat( sChosenFilename, sExtension, NULL );
+            g_free( sChosenFilename );
+        }
+
+        sensitiseControlsInUse( pGlobal, FALSE );
+        // the sequence is freed once the file is written
+        postDataToGPIBThread( TG_MEASURE_and_RETRIEVE_SNP_from_HP8753, pSequence );
+    } else {
+        freeSwitchSequence( pSequence );
+    }
+
+    g_free( sExtension );
+    gtk_widget_destroy (dialog);
 }
 
 void
@@ -225,24 +322,19 @@ CB_BtnSaveCSV (GtkButton *wButton, tGlobal *pGlobal)
     GDateTime *now = g_date_time_new_now_local ();
     static gchar *lastFilename = NULL;
     static gboolean bUsedSuggested = FALSE;
+    static gboolean bLastNumPy = FALSE;
+    static const gchar *typeIDs[] = { "csv", "npz", NULL };
+    static const gchar *typeLabels[] = { "CSV text", "NumPy archive", NULL };
 
     gchar *sFilename = NULL;
-    gchar *sSuggestedFilename = g_date_time_format( now, "HP8753.%d%b%y.%H%M%S.csv");
-
-    FILE *fCSV = NULL;
-    tFormat	fmtCh1 = pGlobal->HP8753.channels[ eCH_ONE ].format,
-    		fmtCh2 = pGlobal->HP8753.channels[ eCH_TWO ].format;
-    tSweepType sweepCh1 = pGlobal->HP8753.channels[ eCH_ONE ].sweepType,
-    		   sweepCh2 = pGlobal->HP8753.channels[ eCH_TWO ].sweepType;
-    tMeasurement measCh1 = pGlobal->HP8753.channels[ eCH_ONE ].measurementType,
-    		     measCh2 = pGlobal->HP8753.channels[ eCH_TWO ].measurementType;
+    gchar *sSuggestedFilename = g_date_time_format( now, bLastNumPy ? "HP8753.%d%b%y.%H%M%S.npz" : "HP8753.%d%b%y.%H%M%S.csv");
 
 	if( !pGlobal->HP8753.channels[ eCH_ONE ].chFlags.bValidData ) {
 		postError( "No trace data to export!" );
 		return;
 	}
 
-	dialog = gtk_file_chooser_dialog_new ("Save trace data to CSV file",
+	dialog = gtk_file_chooser_dialog_new ("Save trace data to CSV or NumPy file",
 					NULL,
 					GTK_FILE_CHOOSER_ACTION_SAVE,
 					"_Cancel", GTK_RESPONSE_CANCEL,
@@ -256,10 +348,18 @@ CB_BtnSaveCSV (GtkButton *wButton, tGlobal *pGlobal)
 	gtk_file_chooser_add_filter ( chooser, filter );
 	//gtk_file_chooser_set_filter ( chooser, filter );
     filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, ".npz" );
+    gtk_file_filter_add_pattern (filter, "*.[nN][pP][zZ]");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
     gtk_file_filter_set_name (filter, "All files");
     gtk_file_filter_add_pattern (filter, "*");
     gtk_file_chooser_add_filter (chooser, filter);
 
+    gtk_file_chooser_add_choice( chooser, "type", "File type:",
+            (const gchar **)typeIDs, (const gchar **)typeLabels );
+    gtk_file_chooser_set_choice( chooser, "type", bLastNumPy ? "npz" : "csv" );
+
 	gtk_file_chooser_set_do_overwrite_confirmation (chooser, TRUE);
 
 	if( lastFilename && !bUsedSuggested) {
@@ -286,64 +386,32 @@ CB_BtnSaveCSV (GtkButton *wButton, tGlobal *pGlobal)
 		g_free( pGlobal->sLastDirectory );
 		pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
 
-		// now do high resolution smith charts
-		// create two filenames from the provided name 'name.1.png and name.2.png'
+		// a .npz name selects the NumPy archive whatever the choice
 		GString *strFilename = g_string_new( sChosenFilename );
 		g_free( sChosenFilename );
-		extPos = g_strrstr( strFilename->str, ".csv" );
+		bLastNumPy = g_str_has_suffix( strFilename->str, ".npz" )
+				|| (g_strcmp0( gtk_file_chooser_get_choice( chooser, "type" ), "npz" ) == 0
+						&& !g_str_has_suffix( strFilename->str, ".csv" ));
+		extPos = g_strrstr( strFilename->str, bLastNumPy ? ".npz" : ".csv" );
 		if( !extPos )
-			g_string_append( strFilename, ".csv");
+			g_string_append( strFilename, bLastNumPy ? ".npz" : ".csv");
 
 		g_free( lastFilename );
 		lastFilename = g_strdup( strFilename->str );
 
-		// todo ... save CSV data
-		if( (fCSV = fopen( strFilename->str, "w" )) == NULL ) {
-			gchar *sError = g_strdup_printf( "Cannot write: %s", (gchar *)strFilename->str);
-			postError( sError );
-			g_free( sError );
-		} else {
-			writeCSVheader( fCSV,  sweepCh1, sweepCh2, fmtCh1, fmtCh2, measCh1, measCh2,
-					pGlobal->HP8753.flags.bSourceCoupled, pGlobal->HP8753.flags.bDualChannel );
-			if( pGlobal->HP8753.flags.bDualChannel ) {
-				if( pGlobal->HP8753.flags.bSourceCoupled ) {
-					for( int i=0; i < pGlobal->HP8753.channels[ eCH_ONE ].nPoints; i++ ) {
-						fprintf( fCSV, "%.0lf",
-								pGlobal->HP8753.channels[ eCH_ONE ].stimulusPoints[i] );
-						writeCSVpoint( fCSV, fmtCh1, &pGlobal->HP8753.channels[ eCH_ONE ].responsePoints[i], FALSE );
-						writeCSVpoint( fCSV, fmtCh2, &pGlobal->HP8753.channels[ eCH_TWO ].responsePoints[i], TRUE );
-					}
-				} else {
-					for( int i=0; i < pGlobal->HP8753.channels[ eCH_ONE ].nPoints
-									|| i < pGlobal->HP8753.channels[ eCH_TWO ].nPoints; i++ ) {
-						if( i < pGlobal->HP8753.channels[ eCH_ONE ].nPoints ) {
-							fprintf( fCSV, "%.0lf",
-									pGlobal->HP8753.channels[ eCH_ONE ].stimulusPoints[i] );
-							writeCSVpoint( fCSV, fmtCh1, &pGlobal->HP8753.channels[ eCH_ONE ].responsePoints[i], FALSE );
-						} else {
-							fprintf( fCSV, ",,,");
-						}
-						if( i < pGlobal->HP8753.channels[ eCH_TWO ].nPoints ) {
-							fprintf( fCSV, ",%.0lf",
-									pGlobal->HP8753.channels[ eCH_TWO ].stimulusPoints[i] );
-							writeCSVpoint( fCSV, fmtCh2, &pGlobal->HP8753.channels[ eCH_TWO ].responsePoints[i], TRUE );
-						} else {
-							fprintf( fCSV, ",,\n");
-						}
-					}
-				}
+		if( bLastNumPy ) {
+			// binary arrays are written straight from the trace buffers
+			if( writeTraceNumPy( strFilename->str, &pGlobal->HP8753 ) == OK ) {
+				postInfo( "NumPy archive saved" );
 			} else {
-				for( int i=0; i < pGlobal->HP8753.channels[ eCH_ONE ].nPoints; i++ ) {
-					fprintf( fCSV, "%.0lf",
-							pGlobal->HP8753.channels[ eCH_ONE ].stimulusPoints[i] );
-					writeCSVpoint( fCSV, fmtCh1, &pGlobal->HP8753.channels[ eCH_ONE ].responsePoints[i], TRUE );
-				}
+				gchar *sError = g_strdup_printf( "Cannot write: %s (%s)", strFilename->str, g_strerror( errno ) );
+				postError( sError );
+				g_free( sError );
 			}
-			fclose( fCSV );
-			postInfo( "CSV saved" );
+		} else {
+			// the file is written by a background thread (which reports success or failure)
+			exportCSVinBackground( strFilename->str, &pGlobal->HP8753 );
 		}
-
-		postInfo( "Traces saved to csv file");
 		g_string_free (strFilename, TRUE);
 	}
 
@@ -353,3 +421,73 @@ CB_BtnSaveCSV (GtkButton *wButton, tGlobal *pGlobal)
 	gtk_widget_destroy (dialog);
 }
 
+
+/*!     \brief  Select a Touchstone file to show as a reference with the traces
+ *
+ * The S-parameter in the file that matches each channel's measurement is drawn
+ * (dashed) in the channel's format over the measured trace.
+ * This is initiated by pressing F7
+ *
+ * \param  pGlobal  pointer to global data
+ */
+void
+showReferenceTraceDialog( tGlobal *pGlobal )
+{
+    GtkWidget *dialog;
+    GtkFileChooser *chooser;
+    GtkFileFilter *filter;
+    gint response;
+
+    dialog = gtk_file_chooser_dialog_new ("Show Touchstone file as reference trace",
+                    GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+                    GTK_FILE_CHOOSER_ACTION_OPEN,
+                    "_Cancel", GTK_RESPONSE_CANCEL,
+                    "_Show", GTK_RESPONSE_ACCEPT,
+                    NULL);
+    if( pGlobal->referenceTrace.sFilename )
+        gtk_dialog_add_button( GTK_DIALOG( dialog ), "_Remove Reference", GTK_RESPONSE_REJECT );
+    chooser = GTK_FILE_CHOOSER (dialog);
+
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name ( filter, "Touchstone (.s1p, .s2p ...)" );
+    gtk_file_filter_add_pattern (filter, "*.[sS][1-9][pP]");
+    gtk_file_filter_add_pattern (filter, "*.[sS][1-9][0-9][pP]");
+    gtk_file_chooser_add_filter ( chooser, filter );
+    filter = gtk_file_filter_new ();
+    gtk_file_filter_set_name (filter, "All files");
+    gtk_file_filter_add_pattern (filter, "*");
+    gtk_file_chooser_add_filter (chooser, filter);
+
+    if( pGlobal->referenceTrace.sFilename )
+        gtk_file_chooser_set_filename( chooser, pGlobal->referenceTrace.sFilename );
+    else if( pGlobal->sLastDirectory )
+        gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+
+    response = gtk_dialog_run (GTK_DIALOG (dialog));
+    if ( response == GTK_RESPONSE_ACCEPT ) {
+        gchar *sChosenFilename = gtk_file_chooser_get_filename (chooser), *sError = NULL, *sMessage;
+
+        g_free( pGlobal->sLastDirectory );
+        pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+        if( loadReferenceTrace( &pGlobal->referenceTrace, sChosenFilename, &sError ) == OK ) {
+            gchar *sBaseName = g_path_get_basename( sChosenFilename );
+            sMessage = g_strdup_printf( "Reference: %s (%d points)", sBaseName, pGlobal->referenceTrace.S2P.nPoints );
+            postInfo( sMessage );
+            g_free( sMessage );
+            g_free( sBaseName );
+        } else {
+            postError( sError );
+            g_free( sError );
+        }
+        g_free( sChosenFilename );
+    } else if ( response == GTK_RESPONSE_REJECT ) {
+        freeReferenceTrace( &pGlobal->referenceTrace );
+        postInfo( "Reference trace removed" );
+    }
+
+    gtk_widget_destroy (dialog);
+
+    gtk_widget_queue_draw(GTK_WIDGET(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_DrawingArea_Plot_A")));
+    gtk_widget_queue_draw(GTK_WIDGET(g_hash_table_lookup ( pGlobal->widgetHashTable, (gconstpointer)"WID_DrawingArea_Plot_B")));
+}
@@ -24,6 +24,7 @@
 #include <glib-2.0/glib.h>
 #include "hp8753.h"
 #include "calibrationKit.h"
+#include "GPIBcomms.h"
 
 #include "messageEvent.h"
 
@@ -106,3 +107,382 @@ CB_Spin_GPIB_HP8753_PID (GtkSpinButton* wSpin, tGlobal *pGlobal) {
 	postDataToGPIBThread (TG_SETUP_GPIB, NULL);
 }
 
+
+/*!     \brief  Callback / GPIB page / "Refresh" GtkButton in the bus transactions panel
+ *
+ * \param  wButton      pointer to the button widget
+ * \param  tGlobal	    pointer global data
+ */
+static void
+CB_Btn_GPIBtraceRefresh( GtkButton *wButton, tGlobal *pGlobal ) {
+	showGPIBtransactionStatistics( pGlobal );
+}
+
+/*!     \brief  Callback / GPIB page / "Reset" GtkButton in the bus transactions panel
+ *
+ * \param  wButton      pointer to the button widget
+ * \param  tGlobal	    pointer global data
+ */
+static void
+CB_Btn_GPIBtraceReset( GtkButton *wButton, tGlobal *pGlobal ) {
+	resetGPIBtransactionStatistics();
+	showGPIBtransactionStatistics( pGlobal );
+}
+
+/*!     \brief  Callback / GPIB page / "Export" GtkButton in the bus transactions panel
+ *
+ * Save the recorded transactions as JSON (with the statistics) or in the
+ * Chrome trace event format.
+ *
+ * \param  wButton      pointer to the button widget
+ * \param  tGlobal	    pointer global data
+ */
+static void
+CB_Btn_GPIBtraceExport( GtkButton *wButton, tGlobal *pGlobal ) {
+	static const gchar *formatIDs[] = { "json", "chrome", NULL };
+	static const gchar *formatLabels[] = { "JSON with statistics", "Chrome trace", NULL };
+	GtkWidget *dialog;
+	GtkFileChooser *chooser;
+	GtkFileFilter *filter;
+	gchar *sMessage;
+	gint nExported;
+
+	dialog = gtk_file_chooser_dialog_new( "Export GPIB Transactions",
+			GTK_WINDOW( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_hp8753c_main" ) ),
+			GTK_FILE_CHOOSER_ACTION_SAVE,
+			"_Cancel", GTK_RESPONSE_CANCEL,
+			"_Export", GTK_RESPONSE_ACCEPT,
+			NULL );
+	chooser = GTK_FILE_CHOOSER( dialog );
+	gtk_file_chooser_set_do_overwrite_confirmation( chooser, TRUE );
+	filter = gtk_file_filter_new();
+	gtk_file_filter_set_name( filter, ".json" );
+	gtk_file_filter_add_pattern( filter, "*.[jJ][sS][oO][nN]" );
+	gtk_file_chooser_add_filter( chooser, filter );
+	gtk_file_chooser_add_choice( chooser, "format", "Format:", formatIDs, formatLabels );
+	gtk_file_chooser_set_choice( chooser, "format", "json" );
+	if( pGlobal->sLastDirectory )
+		gtk_file_chooser_set_current_folder( chooser, pGlobal->sLastDirectory );
+	gtk_file_chooser_set_current_name( chooser, "GPIBtransactions.json" );
+
+	if( gtk_dialog_run( GTK_DIALOG( dialog ) ) == GTK_RESPONSE_ACCEPT ) {
+		gchar *sChosenFilename = gtk_file_chooser_get_filename( chooser );
+		gboolean bChromeTrace = g_strcmp0( gtk_file_chooser_get_choice( chooser, "format" ), "chrome" ) == 0;
+
+		g_free( pGlobal->sLastDirectory );
+		pGlobal->sLastDirectory = gtk_file_chooser_get_current_folder( chooser );
+
+		if( (nExported = exportGPIBtransactions( sChosenFilename, bChromeTrace )) != ERROR ) {
+			sMessage = g_strdup_printf( "Exported %d GPIB transactions", nExported );
+			postInfo( sMessage );
+		} else {
+			sMessage = g_strdup_printf( "Cannot write: %s", sChosenFilename );
+			postError( sMessage );
+		}
+		g_free( sMessage );
+		g_free( sChosenFilename );
+	}
+
+	gtk_widget_destroy( dialog );
+}
+
+/*!     \brief  Add the bus transactions panel to the "GPIB" notebook page
+ *
+ * The panel shows the time taken by each HP8753 command (writes, the reads that
+ * answer it, SRQ waits and the clears that follow failures). It is refreshed
+ * when a GPIB operation completes.
+ *
+ * \param  tGlobal	    pointer global data
+ */
+void
+initializeGPIBtracePanel( tGlobal *pGlobal ) {
+	static gchar *statisticsColumns[] = { "Command", "Type", "Calls", "Bytes", "Total (ms)",
+			"Median (ms)", "95% (ms)", "Max (ms)", "Timeouts" };
+	static struct {
+		gchar *sLabel, *sTooltip;
+		GCallback callback;
+	} buttons[] = {
+			{ "Refresh", "Collect the latest transactions", G_CALLBACK( CB_Btn_GPIBtraceRefresh ) },
+			{ "Reset", "Start the statistics again", G_CALLBACK( CB_Btn_GPIBtraceReset ) },
+			{ "Export ...", "Save the recent transactions as JSON\nor as a Chrome trace (chrome://tracing)",
+					G_CALLBACK( CB_Btn_GPIBtraceExport ) }
+	};
+	// the GPIB page is the box holding the box with the HP8753 identifier frame
+	GtkWidget *wBoxGPIB = gtk_widget_get_parent( gtk_widget_get_parent(
+			GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_Frm_GPIB_HP8753_Identifier" ) ) ) );
+	GtkWidget *wFrame, *wBox, *wButtonBox, *wLabel, *wScrolled, *wTreeView, *wButton;
+	GtkListStore *statisticsStore;
+
+	wFrame = gtk_frame_new( "Bus transactions" );
+	gtk_widget_set_margin_start( wFrame, 4 );
+	gtk_widget_set_margin_end( wFrame, 4 );
+	wBox = gtk_box_new( GTK_ORIENTATION_VERTICAL, 2 );
+	gtk_container_set_border_width( GTK_CONTAINER( wBox ), 4 );
+	gtk_container_add( GTK_CONTAINER( wFrame ), wBox );
+
+	wLabel = gtk_label_new( "-" );
+	gtk_label_set_xalign( GTK_LABEL( wLabel ), 0.0 );
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_Lbl_GPIB_TraceSummary", wLabel );
+	gtk_box_pack_start( GTK_BOX( wBox ), wLabel, FALSE, TRUE, 0 );
+
+	statisticsStore = gtk_list_store_new( 9, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT, G_TYPE_INT64,
+			G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_UINT );
+	wTreeView = gtk_tree_view_new_with_model( GTK_TREE_MODEL( statisticsStore ) );
+	g_object_unref( statisticsStore );
+	for( gint i = 0; i < G_N_ELEMENTS( statisticsColumns ); i++ ) {
+		GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+		GtkTreeViewColumn *column;
+		if( i > 1 )
+			g_object_set( renderer, "xalign", 1.0, NULL );
+		column = gtk_tree_view_column_new_with_attributes( statisticsColumns[ i ], renderer, "text", i, NULL );
+		gtk_tree_view_column_set_expand( column, i == 0 );
+		gtk_tree_view_append_column( GTK_TREE_VIEW( wTreeView ), column );
+	}
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_TreeView_GPIB_Transactions", wTreeView );
+
+	wScrolled = gtk_scrolled_window_new( NULL, NULL );
+	gtk_scrolled_window_set_policy( GTK_SCROLLED_WINDOW( wScrolled ), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC );
+	gtk_scrolled_window_set_min_content_height( GTK_SCROLLED_WINDOW( wScrolled ), 160 );
+	gtk_container_add( GTK_CONTAINER( wScrolled ), wTreeView );
+	gtk_box_pack_start( GTK_BOX( wBox ), wScrolled, TRUE, TRUE, 0 );
+
+	wButtonBox = gtk_box_new( GTK_ORIENTATION_HORIZONTAL, 4 );
+	for( gint i = 0; i < G_N_ELEMENTS( buttons ); i++ ) {
+		wButton = gtk_button_new_with_label( buttons[ i ].sLabel );
+		gtk_widget_set_tooltip_text( wButton, buttons[ i ].sTooltip );
+		g_signal_connect( wButton, "clicked", buttons[ i ].callback, pGlobal );
+		gtk_box_pack_start( GTK_BOX( wButtonBox ), wButton, FALSE, FALSE, 0 );
+	}
+	gtk_box_pack_start( GTK_BOX( wBox ), wButtonBox, FALSE, FALSE, 0 );
+
+	gtk_box_pack_start( GTK_BOX( wBoxGPIB ), wFrame, TRUE, TRUE, 0 );
+	gtk_widget_show_all( wFrame );
+}
+
+/*!     \brief  Show the GPIB transaction statistics on the "GPIB" notebook page
+ *
+ * \param  tGlobal	    pointer global data
+ */
+void
+showGPIBtransactionStatistics( tGlobal *pGlobal ) {
+	GtkListStore *statisticsStore;
+	GtkTreeIter iter;
+	GList *statisticsList = GPIBtransactionStatistics();
+	gint64 totalTime = 0;
+	guint nCalls = 0;
+	gchar *sLabel;
+	GString *sJobs = g_string_new( NULL );
+	tGPIBjobStatistics jobStatistics[ eJOB_NUM_PRIORITIES ];
+	guint nCoalesced = 0, nCancelled = 0;
+
+	statisticsStore = GTK_LIST_STORE( gtk_tree_view_get_model( GTK_TREE_VIEW(
+			g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_TreeView_GPIB_Transactions" ) ) ) );
+	gtk_list_store_clear( statisticsStore );
+	for( GList *l = statisticsList; l != NULL; l = l->next ) {
+		tGPIBmnemonicStatistics *pStats = l->data;
+		gchar *sTotal = g_strdup_printf( "%.1f", pStats->totalTime / 1.0e3 );
+		gchar *sMedian = g_strdup_printf( "%.2f", GPIBstatisticsPercentile( pStats, 0.50 ) / 1.0e3 );
+		gchar *s95 = g_strdup_printf( "%.2f", GPIBstatisticsPercentile( pStats, 0.95 ) / 1.0e3 );
+		gchar *sMax = g_strdup_printf( "%.2f", pStats->maxTime / 1.0e3 );
+
+		gtk_list_store_insert_with_values( statisticsStore, &iter, -1,
+				0, pStats->sMnemonic, 1, GPIBtransactionTypeNames[ pStats->type ], 2, pStats->nCalls,
+				3, pStats->nBytes, 4, sTotal, 5, sMedian, 6, s95, 7, sMax, 8, pStats->nTimeouts, -1 );
+		totalTime += pStats->totalTime;
+		nCalls += pStats->nCalls;
+		g_free( sTotal );
+		g_free( sMedian );
+		g_free( s95 );
+		g_free( sMax );
+	}
+	g_list_free( statisticsList );
+
+	// and the jobs of the GPIB thread (by priority)
+	GPIBjobStatistics( jobStatistics );
+	for( tGPIBjobPriority priority = 0; priority < eJOB_NUM_PRIORITIES; priority++ ) {
+		tGPIBjobStatistics *pJobs = &jobStatistics[ priority ];
+		nCoalesced += pJobs->nCoalesced;
+		nCancelled += pJobs->nCancelled;
+		if( pJobs->nJobs == 0 )
+			continue;
+		g_string_append_printf( sJobs, "%s%u %s (wait %.0f / %.0f ms, run %.0f / %.0f ms)",
+				sJobs->len ? ", " : "", pJobs->nJobs, GPIBjobPriorityNames[ priority ],
+				pJobs->totalWait / 1.0e3 / pJobs->nJobs, pJobs->maxWait / 1.0e3,
+				pJobs->totalRun / 1.0e3 / pJobs->nJobs, pJobs->maxRun / 1.0e3 );
+	}
+
+	sLabel = g_strdup_printf( "%u transactions taking %.2f s (the latencies are estimated from a log₂ histogram)\n"
+			"Jobs (mean / maximum): %s; %u queued, %u duplicates dropped, %u cancelled",
+			nCalls, totalTime / (gdouble)G_USEC_PER_SEC, sJobs->len ? sJobs->str : "none",
+			GPIBjobQueueDepth(), nCoalesced, nCancelled );
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_GPIB_TraceSummary" ) ), sLabel );
+	g_free( sLabel );
+	g_string_free( sJobs, TRUE );
+}
+
+/*!     \brief  Fill the capture timing table with the statistics of an instrument
+ *
+ * \param  tGlobal	    pointer global data
+ * \param  sProduct     product
+ * \param  firmware     firmware version
+ */
+static void
+fillCaptureTimingTable( tGlobal *pGlobal, gchar *sProduct, gint firmware ) {
+	GtkListStore *timingStore = GTK_LIST_STORE( gtk_tree_view_get_model( GTK_TREE_VIEW(
+			g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_TreeView_CaptureTiming" ) ) ) );
+	GtkTreeIter iter;
+	tCaptureTiming *timings = NULL;
+	gint nTimings = recoverCaptureTimings( sProduct, firmware, CAPTURE_HISTORY, &timings );
+	gchar *sLabel;
+
+	gtk_list_store_clear( timingStore );
+	if( nTimings > 0 ) {
+		// the phases and then the total
+		for( tCapturePhase phase = 0; phase <= eCAPTURE_NUM_PHASES; phase++ ) {
+			gint64 last = phase == eCAPTURE_NUM_PHASES ?
+					captureTimingTotal( &timings[ 0 ] ) : timings[ 0 ].phaseTime[ phase ];
+			gchar *sLast = g_strdup_printf( "%.1f", last / 1.0e3 );
+			gchar *sMean = g_strdup_printf( "%.1f",
+					capturePhaseMean( timings, nTimings, phase, CAPTURE_ROLLING_AVERAGE ) / 1.0e3 );
+			gchar *sMedian = g_strdup_printf( "%.1f", capturePhasePercentile( timings, nTimings, phase, 0.50 ) / 1.0e3 );
+			gchar *s90 = g_strdup_printf( "%.1f", capturePhasePercentile( timings, nTimings, phase, 0.90 ) / 1.0e3 );
+			gchar *sMax = g_strdup_printf( "%.1f", capturePhasePercentile( timings, nTimings, phase, 1.0 ) / 1.0e3 );
+
+			gtk_list_store_insert_with_values( timingStore, &iter, -1,
+					0, phase == eCAPTURE_NUM_PHASES ? "Total" : capturePhaseNames[ phase ],
+					1, sLast, 2, sMean, 3, sMedian, 4, s90, 5, sMax, -1 );
+			g_free( sLast );
+			g_free( sMean );
+			g_free( sMedian );
+			g_free( s90 );
+			g_free( sMax );
+		}
+		sLabel = g_strdup_printf( "%d captures (last: %d points%s)", nTimings,
+				timings[ 0 ].nPoints, timings[ 0 ].bDualChannel ? ", dual channel" : "" );
+	} else {
+		sLabel = g_strdup( "No captures timed" );
+	}
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_CaptureTimingSummary" ) ), sLabel );
+	g_free( sLabel );
+	g_free( timings );
+}
+
+static gboolean bUpdatingCaptureInstruments = FALSE;
+
+/*!     \brief  Callback / GPIB page / instrument GtkComboBoxText in the capture timing panel
+ *
+ * \param  wCombo       pointer to the combo box widget
+ * \param  tGlobal	    pointer global data
+ */
+static void
+CB_Cbx_CaptureTimingInstrument( GtkComboBox *wCombo, tGlobal *pGlobal ) {
+	const gchar *sID = gtk_combo_box_get_active_id( wCombo );
+	gchar **fields;
+
+	if( bUpdatingCaptureInstruments || sID == NULL )
+		return;
+	fields = g_strsplit( sID, "\t", 2 );
+	if( g_strv_length( fields ) == 2 )
+		fillCaptureTimingTable( pGlobal, fields[ 0 ], atoi( fields[ 1 ] ) );
+	g_strfreev( fields );
+}
+
+/*!     \brief  Show the capture timing statistics on the "GPIB" notebook page
+ *
+ * The instruments with timed captures are listed and the statistics of the
+ * chosen one (or the most recently used if none is given) are shown.
+ *
+ * \param  tGlobal	    pointer global data
+ * \param  sProduct     product (or NULL)
+ * \param  firmware     firmware version
+ */
+void
+showCaptureTimingStatistics( tGlobal *pGlobal, gchar *sProduct, gint firmware ) {
+	GtkComboBoxText *wCombo = GTK_COMBO_BOX_TEXT( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Cbx_CaptureTimingInstrument" ) );
+	GList *instruments = inventoryCaptureTimingInstruments();
+	gchar *sActiveID;
+
+	bUpdatingCaptureInstruments = TRUE;
+	gtk_combo_box_text_remove_all( wCombo );
+	for( GList *l = instruments; l != NULL; l = l->next ) {
+		gchar **fields = g_strsplit( (gchar *)l->data, "\t", 2 );
+		gint version = g_strv_length( fields ) == 2 ? atoi( fields[ 1 ] ) : 0;
+		gchar *sText = g_strdup_printf( "%s (firmware %d.%02d)", fields[ 0 ], version / 100, version % 100 );
+
+		gtk_combo_box_text_append( wCombo, (gchar *)l->data, sText );
+		g_free( sText );
+		g_strfreev( fields );
+	}
+	if( sProduct )
+		sActiveID = g_strdup_printf( "%s\t%d", sProduct, firmware );
+	else
+		sActiveID = g_strdup( instruments ? (gchar *)instruments->data : "" );
+	bUpdatingCaptureInstruments = FALSE;
+	g_list_free_full( instruments, g_free );
+
+	// selecting the instrument fills the table
+	if( !gtk_combo_box_set_active_id( GTK_COMBO_BOX( wCombo ), sActiveID ) )
+		fillCaptureTimingTable( pGlobal, "", 0 );
+	g_free( sActiveID );
+}
+
+/*!     \brief  Add the capture timing panel to the "GPIB" notebook page
+ *
+ * The panel shows how long each phase of retrieving traces takes, from the
+ * configuration queries to the plot being redrawn, for the last capture and
+ * over the recent captures of the chosen instrument.
+ *
+ * \param  tGlobal	    pointer global data
+ */
+void
+initializeCaptureTimingPanel( tGlobal *pGlobal ) {
+	static gchar *timingColumns[] = { "Phase", "Last (ms)", "Mean of last 10 (ms)",
+			"Median (ms)", "90% (ms)", "Max (ms)" };
+	GtkWidget *wBoxGPIB = gtk_widget_get_parent( gtk_widget_get_parent(
+			GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_Frm_GPIB_HP8753_Identifier" ) ) ) );
+	GtkWidget *wFrame, *wBox, *wHBox, *wLabel, *wCombo, *wTreeView;
+	GtkListStore *timingStore;
+
+	wFrame = gtk_frame_new( "Capture timing" );
+	gtk_widget_set_margin_start( wFrame, 4 );
+	gtk_widget_set_margin_end( wFrame, 4 );
+	wBox = gtk_box_new( GTK_ORIENTATION_VERTICAL, 2 );
+	gtk_container_set_border_width( GTK_CONTAINER( wBox ), 4 );
+	gtk_container_add( GTK_CONTAINER( wFrame ), wBox );
+
+	wHBox = gtk_box_new( GTK_ORIENTATION_HORIZONTAL, 8 );
+	wCombo = gtk_combo_box_text_new();
+	gtk_widget_set_tooltip_text( wCombo, "Instrument (product and firmware)" );
+	g_signal_connect( wCombo, "changed", G_CALLBACK( CB_Cbx_CaptureTimingInstrument ), pGlobal );
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_Cbx_CaptureTimingInstrument", wCombo );
+	gtk_box_pack_start( GTK_BOX( wHBox ), wCombo, FALSE, FALSE, 0 );
+	wLabel = gtk_label_new( "-" );
+	gtk_label_set_xalign( GTK_LABEL( wLabel ), 0.0 );
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_Lbl_CaptureTimingSummary", wLabel );
+	gtk_box_pack_start( GTK_BOX( wHBox ), wLabel, TRUE, TRUE, 0 );
+	gtk_box_pack_start( GTK_BOX( wBox ), wHBox, FALSE, TRUE, 0 );
+
+	timingStore = gtk_list_store_new( 6, G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING,
+			G_TYPE_STRING, G_TYPE_STRING, G_TYPE_STRING );
+	wTreeView = gtk_tree_view_new_with_model( GTK_TREE_MODEL( timingStore ) );
+	g_object_unref( timingStore );
+	for( gint i = 0; i < G_N_ELEMENTS( timingColumns ); i++ ) {
+		GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+		GtkTreeViewColumn *column;
+		if( i > 0 )
+			g_object_set( renderer, "xalign", 1.0, NULL );
+		column = gtk_tree_view_column_new_with_attributes( timingColumns[ i ], renderer, "text", i, NULL );
+		gtk_tree_view_column_set_expand( column, i == 0 );
+		gtk_tree_view_append_column( GTK_TREE_VIEW( wTreeView ), column );
+	}
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_TreeView_CaptureTiming", wTreeView );
+	gtk_box_pack_start( GTK_BOX( wBox ), wTreeView, FALSE, TRUE, 0 );
+
+	gtk_box_pack_start( GTK_BOX( wBoxGPIB ), wFrame, FALSE, TRUE, 0 );
+	gtk_widget_show_all( wFrame );
+
+	showCaptureTimingStatistics( pGlobal, NULL, 0 );
+}
@@ -85,6 +85,42 @@ CB_ChkBtn_DoNotRetrieveHPGL(GtkCheckButton *wCheckBtn, tGlobal *pGlobal) {
 	pGlobal->flags.bDoNotRetrieveHPGLdata = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( wCheckBtn ) );
 }
 
+/*!     \brief  Callback - Option also retrieve complex trace data
+ *
+ * Callback when the "Also retrieve complex trace data" GtkChkButton is changed
+ *
+ * \param  wCheckBtn    pointer to check button widget
+ * \param  tGlobal	    pointer global data
+ */
+void
+CB_ChkBtn_CaptureComplex(GtkCheckButton *wCheckBtn, tGlobal *pGlobal) {
+	pGlobal->flags.bCaptureComplexData = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( wCheckBtn ) );
+}
+
+/*!     \brief  Callback - Option fast (FORM1) trace transfer
+ *
+ * Callback when the "Fast trace transfer (FORM1)" GtkChkButton is changed
+ *
+ * \param  wCheckBtn    pointer to check button widget
+ * \param  tGlobal	    pointer global data
+ */
+void
+CB_ChkBtn_FORM1traces(GtkCheckButton *wCheckBtn, tGlobal *pGlobal) {
+	pGlobal->flags.bFORM1traces = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( wCheckBtn ) );
+}
+
+/*!     \brief  Callback - Option archive saved traces
+ *
+ * Callback when the "Archive saved traces" GtkChkButton is changed
+ *
+ * \param  wCheckBtn    pointer to check button widget
+ * \param  tGlobal	    pointer global data
+ */
+void
+CB_ChkBtn_ArchiveTraces(GtkCheckButton *wCheckBtn, tGlobal *pGlobal) {
+	pGlobal->flags.bArchiveTraces = gtk_toggle_button_get_active( GTK_TOGGLE_BUTTON( wCheckBtn ) );
+}
+
 /*!     \brief  Callback / Options page / "Analyze Learn String" GtkButton
  *
  * Callback when the "Analyze Learn String" GtkButton on the "Options" notebook page is pressed
@@ -131,3 +167,163 @@ CB_ChkBtn_ShowHPlogo (GtkCheckButton *wButton, tGlobal *pGlobal)
     gtk_widget_queue_draw(GTK_WIDGET(g_hash_table_lookup ( pGlobal->widgetHashTable,
             (gconstpointer)"WID_DrawingArea_Plot_B")));
 }
+
+/*!     \brief  Callback / Options page / "Maintain Now" GtkButton
+ *
+ * Callback when the "Maintain Now" GtkButton in the database panel on the "Options" notebook page is pressed
+ *
+ * \param  wButton      pointer to the button widget
+ * \param  tGlobal	    pointer global data
+ */
+static void
+CB_Btn_DBmaintainNow( GtkButton *wButton, tGlobal *pGlobal ) {
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Maintenance" ) ), "in progress ..." );
+	requestDBmaintenance( TRUE );
+}
+
+/*!     \brief  Add the database statistics panel to the "Options" notebook page
+ *
+ * The panel is filled in by showDBstatistics() when the maintenance thread posts
+ * its results.
+ *
+ * \param  tGlobal	    pointer global data
+ */
+void
+initializeDBstatisticsPanel( tGlobal *pGlobal ) {
+	static gchar *statisticsLabels[][2] = {
+			{ "Size:",				"WID_Lbl_DB_Size" },
+			{ "Profiles:",			"WID_Lbl_DB_Profiles" },
+			{ "Trace archive:",		"WID_Lbl_DB_Archive" },
+			{ "Integrity:",			"WID_Lbl_DB_Integrity" },
+			{ "Last maintenance:",	"WID_Lbl_DB_Maintenance" }
+	};
+	static gchar *timingColumns[] = { "Statement", "Calls", "Mean (ms)", "Max (ms)" };
+	// the options page is the box holding the "Analyze Learn String" button box
+	GtkWidget *wBoxOptions = gtk_widget_get_parent( gtk_widget_get_parent(
+			GTK_WIDGET( g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_Btn_AnalyzeLS" ) ) ) );
+	GtkWidget *wFrame, *wBox, *wGrid, *wLabel, *wExpander, *wScrolled, *wTreeView, *wButton;
+	GtkListStore *timingStore;
+
+	wFrame = gtk_frame_new( "Database" );
+	gtk_widget_set_margin_start( wFrame, 4 );
+	gtk_widget_set_margin_end( wFrame, 4 );
+	wBox = gtk_box_new( GTK_ORIENTATION_VERTICAL, 2 );
+	gtk_container_set_border_width( GTK_CONTAINER( wBox ), 4 );
+	gtk_container_add( GTK_CONTAINER( wFrame ), wBox );
+
+	wGrid = gtk_grid_new();
+	gtk_grid_set_column_spacing( GTK_GRID( wGrid ), 8 );
+	for( gint i = 0; i < G_N_ELEMENTS( statisticsLabels ); i++ ) {
+		wLabel = gtk_label_new( statisticsLabels[ i ][ 0 ] );
+		gtk_label_set_xalign( GTK_LABEL( wLabel ), 1.0 );
+		gtk_grid_attach( GTK_GRID( wGrid ), wLabel, 0, i, 1, 1 );
+		wLabel = gtk_label_new( "-" );
+		gtk_label_set_xalign( GTK_LABEL( wLabel ), 0.0 );
+		gtk_label_set_ellipsize( GTK_LABEL( wLabel ), PANGO_ELLIPSIZE_END );
+		gtk_widget_set_hexpand( wLabel, TRUE );
+		gtk_grid_attach( GTK_GRID( wGrid ), wLabel, 1, i, 1, 1 );
+		g_hash_table_insert( pGlobal->widgetHashTable, statisticsLabels[ i ][ 1 ], wLabel );
+	}
+	gtk_box_pack_start( GTK_BOX( wBox ), wGrid, FALSE, TRUE, 0 );
+
+	// the slowest statements on the main connection (by mean time)
+	timingStore = gtk_list_store_new( 4, G_TYPE_STRING, G_TYPE_UINT, G_TYPE_STRING, G_TYPE_STRING );
+	wTreeView = gtk_tree_view_new_with_model( GTK_TREE_MODEL( timingStore ) );
+	g_object_unref( timingStore );
+	for( gint i = 0; i < G_N_ELEMENTS( timingColumns ); i++ ) {
+		GtkCellRenderer *renderer = gtk_cell_renderer_text_new();
+		GtkTreeViewColumn *column;
+		if( i == 0 ) {
+			g_object_set( renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL );
+		} else {
+			g_object_set( renderer, "xalign", 1.0, NULL );
+		}
+		column = gtk_tree_view_column_new_with_attributes( timingColumns[ i ], renderer, "text", i, NULL );
+		gtk_tree_view_column_set_expand( column, i == 0 );
+		gtk_tree_view_append_column( GTK_TREE_VIEW( wTreeView ), column );
+	}
+	gtk_widget_set_has_tooltip( wTreeView, TRUE );
+	gtk_tree_view_set_tooltip_column( GTK_TREE_VIEW( wTreeView ), 0 );
+	g_hash_table_insert( pGlobal->widgetHashTable, "WID_TreeView_DB_Timings", wTreeView );
+
+	wScrolled = gtk_scrolled_window_new( NULL, NULL );
+	gtk_scrolled_window_set_policy( GTK_SCROLLED_WINDOW( wScrolled ), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC );
+	gtk_scrolled_window_set_min_content_height( GTK_SCROLLED_WINDOW( wScrolled ), 120 );
+	gtk_container_add( GTK_CONTAINER( wScrolled ), wTreeView );
+	wExpander = gtk_expander_new( "Slowest statements" );
+	gtk_container_add( GTK_CONTAINER( wExpander ), wScrolled );
+	gtk_box_pack_start( GTK_BOX( wBox ), wExpander, FALSE, TRUE, 0 );
+
+	wButton = gtk_button_new_with_label( "Maintain Now" );
+	gtk_widget_set_tooltip_text( wButton, "Release unused space, update the query\n"
+			"statistics and check the integrity of the database" );
+	gtk_widget_set_halign( wButton, GTK_ALIGN_START );
+	g_signal_connect( wButton, "clicked", G_CALLBACK( CB_Btn_DBmaintainNow ), pGlobal );
+	gtk_box_pack_start( GTK_BOX( wBox ), wButton, FALSE, FALSE, 0 );
+
+	gtk_box_pack_start( GTK_BOX( wBoxOptions ), wFrame, FALSE, TRUE, 0 );
+	gtk_widget_show_all( wFrame );
+}
+
+/*!     \brief  Show the database statistics on the "Options" notebook page
+ *
+ * \param  tGlobal	    pointer global data
+ * \param  pStats	    pointer to the statistics posted by the maintenance thread
+ */
+void
+showDBstatistics( tGlobal *pGlobal, tDBstatistics *pStats ) {
+	GtkListStore *timingStore;
+	GtkTreeIter iter;
+	gchar *sLabel, *sSize;
+
+	sSize = g_format_size( pStats->fileSize );
+	sLabel = g_strdup_printf( "%s (%" G_GINT64_FORMAT " of %" G_GINT64_FORMAT " pages free)",
+			sSize, pStats->nFreePages, pStats->nPages );
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Size" ) ), sLabel );
+	g_free( sSize );
+	g_free( sLabel );
+
+	sLabel = g_strdup_printf( "%" G_GINT64_FORMAT " calibration, %" G_GINT64_FORMAT " trace in %" G_GINT64_FORMAT
+			" projects; %" G_GINT64_FORMAT " calibration kits",
+			pStats->nCalibrations, pStats->nTraces, pStats->nProjects, pStats->nCalKits );
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Profiles" ) ), sLabel );
+	g_free( sLabel );
+
+	sLabel = g_strdup_printf( "%" G_GINT64_FORMAT " sweeps", pStats->nArchivedSweeps );
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Archive" ) ), sLabel );
+	g_free( sLabel );
+
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Integrity" ) ), pStats->sIntegrity ? pStats->sIntegrity : "not yet checked" );
+
+	if( pStats->lastMaintenance ) {
+		GDateTime *dateTime = g_date_time_new_from_unix_local( pStats->lastMaintenance / G_USEC_PER_SEC );
+		gchar *sDateTime = g_date_time_format( dateTime, "%x %X" );
+		sLabel = g_strdup_printf( "%s (%.1f s, %" G_GINT64_FORMAT " pages released)",
+				sDateTime, pStats->maintenanceTime / (gdouble)G_USEC_PER_SEC, pStats->nPagesReclaimed );
+		g_free( sDateTime );
+		g_date_time_unref( dateTime );
+	} else {
+		sLabel = g_strdup( "not yet run" );
+	}
+	gtk_label_set_text( GTK_LABEL( g_hash_table_lookup( pGlobal->widgetHashTable,
+			(gconstpointer)"WID_Lbl_DB_Maintenance" ) ), sLabel );
+	g_free( sLabel );
+
+	timingStore = GTK_LIST_STORE( gtk_tree_view_get_model( GTK_TREE_VIEW(
+			g_hash_table_lookup( pGlobal->widgetHashTable, (gconstpointer)"WID_TreeView_DB_Timings" ) ) ) );
+	gtk_list_store_clear( timingStore );
+	for( gint i = 0; i < pStats->nQueryTimings; i++ ) {
+		tDBqueryTiming *pTiming = &pStats->queryTimings[ i ];
+		gchar *sMean = g_strdup_printf( "%.3f", pTiming->totalTime / 1.0e6 / pTiming->nCalls );
+		gchar *sMax = g_strdup_printf( "%.3f", pTiming->maxTime / 1.0e6 );
+		gtk_list_store_insert_with_values( timingStore, &iter, -1,
+				0, pTiming->sSQL, 1, pTiming->nCalls, 2, sMean, 3, sMax, -1 );
+		g_free( sMean );
+		g_free( sMax );
+	}
+}
@@ -209,9 +209,10 @@ plotCartesianTrace (cairo_t *cr, tGridParameters *pGrid, eChannel channel, tGlob
 	gint i;
 	gdouble x, y, yl, yu, sweepValue = 0, xlabel, ylabel, xMouse, xFract;
 	gdouble logFreqStart, logFreqStop;
-	gint xl, xu, npoints, seg;
+	gint xl, xu, npoints, seg, segStart;
 	gchar *sLabel = 0, sNote[ BUFFER_SIZE_100 ], *sPrefix="";
 	tChannel *pChannel = &pGlobal->HP8753.channels[channel];
+	tComplex *pReferencePoints;
     GdkRGBA solidCursorRGBA = plotElementColors[ eColorLiveMkrCursor ];
     solidCursorRGBA.alpha = 1.0;
 
@@ -292,6 +293,39 @@ plotCartesianTrace (cairo_t *cr, tGridParameters *pGrid, eChannel channel, tGlob
 			}
 			cairo_stroke (cr);
 
+			// reference trace (from a Touchstone file) dashed over the measured trace
+			if( (pReferencePoints = referenceTracePoints( pGlobal, channel )) != NULL ) {
+				gdouble dashes[] = { pGrid->areaWidth / 200.0, pGrid->areaWidth / 400.0 };
+				gboolean bPenDown = FALSE, bAllSegments = (pChannel->sweepType == eSWP_LSTFREQ
+						&& pChannel->chFlags.bAllSegments && pChannel->sweepStart != pChannel->sweepStop);
+
+				cairo_set_dash( cr, dashes, G_N_ELEMENTS( dashes ), 0.0 );
+				for ( i=0, seg=0, segStart=0; i < npoints; i++) {
+					if( bAllSegments ) {
+						x = (gdouble)pGrid->gridWidth * (pChannel->stimulusPoints[ i ] - pChannel->sweepStart)
+								/ (pChannel->sweepStop - pChannel->sweepStart);
+						// each segment is drawn separately
+						if( i == segStart && seg < pChannel->nSegments ) {
+							bPenDown = FALSE;
+							segStart += pChannel->segments[ seg++ ].nPoints;
+						}
+					} else {
+						x = i * sweepScale;
+					}
+					y = pReferencePoints[i].r - refVal;
+					if( isnan( y ) ) {
+						bPenDown = FALSE;
+					} else if( bPenDown ) {
+						cairo_line_to(cr, x, y * levelScale);
+					} else {
+						cairo_move_to(cr, x, y * levelScale);
+						bPenDown = TRUE;
+					}
+				}
+				cairo_stroke (cr);
+				cairo_set_dash( cr, NULL, 0, 0.0 );
+			}
+
 			cairo_reset_clip( cr );
 	        drawMarkers( cr, pGlobal, pGrid, channel, refVal, levelScale );
 
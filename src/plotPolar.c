@@ -188,9 +188,10 @@ showPolarCursorInfo(
 	gdouble xTextPos, yTextPos;
 	gchar *label;
 	gchar sValue[ BUFFER_SIZE_100 ], *sPrefix="";
+	tComplexTrace point = { &real, &imag, 1, NULL, 1 };
 
-	mag = sqrt( SQU( real ) + SQU( imag ) );
-	angle = 180.0 * atan2( imag, real) / G_PI;
+	deriveTrace( eDERIVED_LINM, &point, Z0, &mag, NULL );
+	deriveTrace( eDERIVED_PHASE, &point, Z0, &angle, NULL );
 
 	// We use this font because it has the relevant Unicode glyphs for gamma and degrees
 	cairo_select_font_face(cr, CURSOR_FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
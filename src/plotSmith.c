@@ -340,26 +340,26 @@ showSmithCursorInfo(
 
 	gdouble VSWR;
 	gdouble gammaMag, gammaAngle, returnLoss;
-	gdouble xTextPos, yTextPos, CapacitanceOrInductance;
-	gdouble r, x, g, b;
+	gdouble xTextPos, yTextPos, inductance, capacitance;
+	gdouble R, X, G, B;
 	gchar *label;
 	gchar sValue[ BUFFER_SIZE_100 ], *sPrefix="", *sUnit;
 
 	gdouble CWfrequency = pGlobal->HP8753.channels[ channel ].CWfrequency;
 	gboolean bUseCWfrequncy = pGlobal->HP8753.channels[ channel ].sweepType == eSWP_CWTIME
 	        || pGlobal->HP8753.channels[ channel ].sweepType == eSWP_PWR;
-
-	gammaMag = sqrt( SQU( gammaReal ) + SQU( gammaImag ) );
-	returnLoss = -20.0 * log10( gammaMag );
-	VSWR = (1+gammaMag)/(1-gammaMag);
-
-	gammaAngle = 180.0 * atan2( gammaImag, gammaReal) / G_PI;
-
-	r = (1.0 - SQU( gammaReal ) - SQU( gammaImag )) / (SQU( 1.0 - gammaReal ) + SQU( gammaImag ));
-	x = (2.0 * gammaImag ) / (SQU( 1 - gammaReal ) + SQU( gammaImag ));
-
-	g = (1.0 - SQU( gammaReal ) - SQU( gammaImag )) / (1.0 + SQU( gammaReal ) + (2.0 * gammaReal ) + SQU( gammaImag ));
-	b = (-2.0 * gammaImag ) / (1.0 + SQU( gammaReal ) + (2.0 * gammaReal ) + SQU( gammaImag ));
+	gdouble LCfrequency = bUseCWfrequncy ? CWfrequency : frequency;
+	tComplexTrace gamma = { &gammaReal, &gammaImag, 1, &LCfrequency, 1 };
+
+	// the same calculations as for a whole trace, for the single point under the cursor
+	deriveTrace( eDERIVED_LINM, &gamma, Z0, &gammaMag, NULL );
+	deriveTrace( eDERIVED_RETURN_LOSS, &gamma, Z0, &returnLoss, NULL );
+	deriveTrace( eDERIVED_SWR, &gamma, Z0, &VSWR, NULL );
+	deriveTrace( eDERIVED_PHASE, &gamma, Z0, &gammaAngle, NULL );
+	deriveTrace( eDERIVED_IMPEDANCE, &gamma, Z0, &R, &X );
+	deriveTrace( eDERIVED_ADMITTANCE, &gamma, Z0, &G, &B );
+	deriveTrace( pGlobal->flags.bAdmitanceSmith ? eDERIVED_PARALLEL_LC : eDERIVED_SERIES_LC,
+			&gamma, Z0, &inductance, &capacitance );
 
 	// We use this font because it has the relevant Unicode glyphs for gamma and degrees
 	cairo_select_font_face(cr, CURSOR_FONT, CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
@@ -380,31 +380,25 @@ showSmithCursorInfo(
 
 	setTraceColor( cr, pGrid->overlay.bAny, channel );
 
-	if( x < 0 ) {
-		if( !pGlobal->flags.bAdmitanceSmith )
-			CapacitanceOrInductance = 1.0 / ((-x * Z0) * 2.0 * G_PI * (bUseCWfrequncy ? CWfrequency : frequency));
-		else
-			CapacitanceOrInductance = (b / Z0) / (2.0 * G_PI * (bUseCWfrequncy ? CWfrequency : frequency));
+	// one of the equivalent inductance and capacitance is NAN
+	if( isnan( inductance ) ) {
+		label = engNotation( capacitance, 2, eENG_SEPARATE, &sPrefix );
 		sUnit = "F";
 	} else {
-		if( !pGlobal->flags.bAdmitanceSmith )
-			CapacitanceOrInductance = (x * Z0) / (2.0 * G_PI * (bUseCWfrequncy ? CWfrequency : frequency));
-		else
-			CapacitanceOrInductance = 1.0 / ((-b / Z0) * (2.0 * G_PI * (bUseCWfrequncy ? CWfrequency : frequency)));
+		label = engNotation( inductance, 2, eENG_SEPARATE, &sPrefix );
 		sUnit = "H";
 	}
-	label = engNotation( CapacitanceOrInductance, 2, eENG_SEPARATE, &sPrefix );
 	if( !pGlobal->flags.bAdmitanceSmith )
-		g_snprintf( sValue, BUFFER_SIZE_100, " %.2f Ω + %s %s%s", r * Z0, label, sPrefix, sUnit);
+		g_snprintf( sValue, BUFFER_SIZE_100, " %.2f Ω + %s %s%s", R, label, sPrefix, sUnit);
 	else
-		g_snprintf( sValue, BUFFER_SIZE_100, " %.2f Ω ∥ %s %s%s", Z0 / g, label, sPrefix, sUnit);
+		g_snprintf( sValue, BUFFER_SIZE_100, " %.2f Ω ∥ %s %s%s", 1.0 / G, label, sPrefix, sUnit);
 	filmCreditsCairoText( cr, "", sValue, 0,  xTextPos,  yTextPos, eBottomLeft );
 	g_free( label );
 
 	if( pGlobal->flags.bAdmitanceSmith )
-		label = g_strdup_printf( x >= 0.0 ? " %.2f mS + j %.2f mS" : " %.2f mS - j %.2f mS", g * 1000.0 / Z0, fabs(b * 1000.0 / Z0));
+		label = g_strdup_printf( B >= 0.0 ? " %.2f mS + j %.2f mS" : " %.2f mS - j %.2f mS", G * 1000.0, fabs(B * 1000.0));
 	else
-		label = g_strdup_printf( x >= 0.0 ? " %.2f + j %.2f Ω" : " %.2f - j %.2f Ω", r * Z0, fabs(x * Z0));
+		label = g_strdup_printf( X >= 0.0 ? " %.2f + j %.2f Ω" : " %.2f - j %.2f Ω", R, fabs(X));
 	filmCreditsCairoText( cr, pGlobal->flags.bAdmitanceSmith ? "Y =" : "Z =", label, 1,  xTextPos,  yTextPos, eBottomLeft );
 	g_free( label );
 
@@ -472,6 +466,7 @@ plotSmithAndPolarTrace (cairo_t *cr, tGridParameters *pGrid, eChannel channel, t
 	gboolean bValidSample = FALSE;
 
 	tChannel *pChannel = &pGlobal->HP8753.channels[channel];
+	tComplex *pReferencePoints;
     GdkRGBA solidCursorRGBA = plotElementColors[ eColorLiveMkrCursor ];
     solidCursorRGBA.alpha = 1.0;
 
@@ -552,6 +547,35 @@ plotSmithAndPolarTrace (cairo_t *cr, tGridParameters *pGrid, eChannel channel, t
 				}
 			}
 
+			// reference trace (from a Touchstone file) dashed over the measured trace
+			if( (pReferencePoints = referenceTracePoints( pGlobal, channel )) != NULL ) {
+				gdouble dashes[] = { UNIT_CIRCLE * gammaScale / 50.0, UNIT_CIRCLE * gammaScale / 100.0 };
+				gboolean bPenDown = FALSE, bAllSegments = (pChannel->sweepType == eSWP_LSTFREQ
+						&& pChannel->chFlags.bAllSegments);
+
+				cairo_new_path( cr );
+				cairo_set_dash( cr, dashes, G_N_ELEMENTS( dashes ), 0.0 );
+				for ( int i=0, seg=0, segStart=0; i < npoints; i++ ) {
+					// each segment is drawn separately
+					if( bAllSegments && i == segStart && seg < pChannel->nSegments ) {
+						bPenDown = FALSE;
+						segStart += pChannel->segments[ seg++ ].nPoints;
+					}
+					gammaReal = pReferencePoints[i].r;
+					gammaImag = pReferencePoints[i].i;
+					if( isnan( gammaReal ) ) {
+						bPenDown = FALSE;
+					} else if( bPenDown ) {
+						cairo_line_to(cr, gammaReal, gammaImag);
+					} else {
+						cairo_move_to(cr, gammaReal, gammaImag);
+						bPenDown = TRUE;
+					}
+				}
+				cairo_stroke (cr);
+				cairo_set_dash( cr, NULL, 0, 0.0 );
+			}
+
 			// If the mouse cursor has an X co-ordinate that is between the start and stop stimulus
 		    // on the stimulus legend, then highlight the corresponding response point on the trace
 
@@ -0,0 +1,390 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/wait.h>
+
+#include <glib-2.0/glib.h>
+#include <gpib/ib.h>
+#include <errno.h>
+#include <hp8753.h>
+#include <GPIBcomms.h>
+#include <hp8753comms.h>
+
+#include "messageEvent.h"
+
+/*
+ * Multi-port (S3P / S4P) measurements through an external switch matrix
+ *
+ * A switch matrix connects two ports of the device to the analyzer at a time (the
+ * other ports are terminated by the switch). A 2-port measurement is made for each
+ * connection in the sequence and the results are assembled into the N-port matrix.
+ *
+ * The sequence is described in a key file:
+ *
+ *   [Switch]
+ *   Ports=4                  number of device ports (3 or 4)
+ *   Device=switch            GPIB device name of the switch (gpib.conf) or ...
+ *   Address=9                ... its primary address on the same controller as the HP8753
+ *   Script=false             if true, the commands are run on this computer instead
+ *   Settle=0.05              seconds allowed for the switch to settle
+ *
+ *   [1-2]                    device port on analyzer port 1 - device port on analyzer port 2
+ *   Command=CLOSE (@101,202)
+ *   [1-3]
+ *   Command=...
+ *
+ * The switch is set for the next connection as soon as the analyzer has finished
+ * sweeping, so it settles while the data of the previous connection is read.
+ */
+
+#define SWITCH_GROUP	"Switch"
+
+// S-parameter (row, column) of point n in the N-port matrix
+#define SNP_INDEX( pSnP, n, row, column )	(((n) * (pSnP)->nPorts + (row)) * (pSnP)->nPorts + (column))
+
+typedef struct {
+	tSwitchSequence	*pSequence;
+	gint			descSwitch;		// GPIB descriptor of the switch (or INVALID)
+	GPid			pid;			// switch script still running (or 0)
+	gint64			switchedTime;	// monotonic time the switch was set
+	guint			nextPath;		// connection to make when the sweeps are complete
+	gboolean		bError;
+} tSwitchState;
+
+/*!     \brief  Free the switch sequence
+ *
+ * \param pSequence    pointer to the sequence (may be NULL)
+ */
+void
+freeSwitchSequence( tSwitchSequence *pSequence ) {
+	if( pSequence == NULL )
+		return;
+	if( pSequence->paths ) {
+		for( guint i = 0; i < pSequence->paths->len; i++ )
+			g_free( g_array_index( pSequence->paths, tSwitchPath, i ).sCommand );
+		g_array_free( pSequence->paths, TRUE );
+	}
+	g_free( pSequence->sDevice );
+	g_free( pSequence->sFilename );
+	g_free( pSequence->SnP.freq );
+	g_free( pSequence->SnP.S );
+	g_free( pSequence );
+}
+
+/*!     \brief  Read the switch matrix sequence from a key file
+ *
+ * Every pair of device ports must be connected to the analyzer by at least one
+ * of the connections so that all of the S-parameters are measured.
+ *
+ * \param sFilename    name of the sequence file
+ * \param psError      returns the (malloced) reason if the file cannot be used
+ * \return             the sequence or NULL on error
+ */
+tSwitchSequence *
+loadSwitchSequence( gchar *sFilename, gchar **psError ) {
+	GKeyFile *keyFile = g_key_file_new();
+	tSwitchSequence *pSequence = NULL;
+	gboolean bConnected[ MAX_SWITCHED_PORTS ][ MAX_SWITCHED_PORTS ] = {{ FALSE }};
+	gchar **sGroups = NULL;
+	GError *err = NULL;
+
+	*psError = NULL;
+	if( !g_key_file_load_from_file( keyFile, sFilename, G_KEY_FILE_NONE, &err ) ) {
+		*psError = g_strdup( err->message );
+		goto err;
+	}
+
+	pSequence = g_new0( tSwitchSequence, 1 );
+	pSequence->paths = g_array_new( FALSE, TRUE, sizeof( tSwitchPath ) );
+	pSequence->nPorts = g_key_file_get_integer( keyFile, SWITCH_GROUP, "Ports", NULL );
+	if( pSequence->nPorts < 3 || pSequence->nPorts > MAX_SWITCHED_PORTS ) {
+		*psError = g_strdup_printf( "[%s] Ports must be 3 or 4", SWITCH_GROUP );
+		goto err;
+	}
+	pSequence->sDevice = g_key_file_get_string( keyFile, SWITCH_GROUP, "Device", NULL );
+	if( g_key_file_has_key( keyFile, SWITCH_GROUP, "Address", NULL ) )
+		pSequence->address = g_key_file_get_integer( keyFile, SWITCH_GROUP, "Address", NULL );
+	else
+		pSequence->address = INVALID;
+	pSequence->bScript = g_key_file_get_boolean( keyFile, SWITCH_GROUP, "Script", NULL );
+	if( g_key_file_has_key( keyFile, SWITCH_GROUP, "Settle", NULL ) )
+		pSequence->settleTime = g_key_file_get_double( keyFile, SWITCH_GROUP, "Settle", NULL );
+	if( !pSequence->bScript && pSequence->sDevice == NULL && pSequence->address == INVALID ) {
+		*psError = g_strdup_printf( "[%s] needs the Device or Address of the switch", SWITCH_GROUP );
+		goto err;
+	}
+
+	// every other group is a connection (in the order they are to be made)
+	sGroups = g_key_file_get_groups( keyFile, NULL );
+	for( gint i = 0; sGroups[ i ]; i++ ) {
+		tSwitchPath path = { 0 };
+		gint nChars = 0;
+
+		if( g_strcmp0( sGroups[ i ], SWITCH_GROUP ) == 0 )
+			continue;
+		if( sscanf( sGroups[ i ], "%d-%d%n", &path.port1, &path.port2, &nChars ) != 2
+				|| sGroups[ i ][ nChars ] != 0
+				|| path.port1 < 1 || path.port1 > pSequence->nPorts
+				|| path.port2 < 1 || path.port2 > pSequence->nPorts
+				|| path.port1 == path.port2 ) {
+			*psError = g_strdup_printf( "[%s] is not a pair of device ports (like [1-2])", sGroups[ i ] );
+			goto err;
+		}
+		path.port1--;
+		path.port2--;
+		if( (path.sCommand = g_key_file_get_string( keyFile, sGroups[ i ], "Command", NULL )) == NULL ) {
+			*psError = g_strdup_printf( "[%s] has no Command", sGroups[ i ] );
+			goto err;
+		}
+		g_array_append_val( pSequence->paths, path );
+		bConnected[ path.port1 ][ path.port2 ] = bConnected[ path.port2 ][ path.port1 ] = TRUE;
+	}
+
+	for( gint row = 0; row < pSequence->nPorts; row++ ) {
+		for( gint column = row + 1; column < pSequence->nPorts; column++ ) {
+			if( !bConnected[ row ][ column ] ) {
+				*psError = g_strdup_printf( "No connection measures ports %d and %d", row + 1, column + 1 );
+				goto err;
+			}
+		}
+	}
+
+	g_strfreev( sGroups );
+	g_key_file_free( keyFile );
+	return pSequence;
+
+err:
+	g_clear_error( &err );
+	g_strfreev( sGroups );
+	g_key_file_free( keyFile );
+	freeSwitchSequence( pSequence );
+	return NULL;
+}
+
+/*!     \brief  Set the switch matrix for a connection
+ *
+ * The GPIB string is sent to the switch or the script is started (and not waited for).
+ *
+ * \param pState       pointer to the sequence state
+ * \param path         the connection to make
+ * \return             OK or ERROR
+ */
+static gint
+setSwitchMatrix( tSwitchState *pState, guint path ) {
+	tSwitchSequence *pSequence = pState->pSequence;
+	tSwitchPath *pPath = &g_array_index( pSequence->paths, tSwitchPath, path );
+	gchar *sMessage;
+
+	sMessage = g_strdup_printf( "Switch device ports %d & %d to the analyzer", pPath->port1 + 1, pPath->port2 + 1 );
+	postInfo( sMessage );
+	g_free( sMessage );
+
+	if( pSequence->bScript ) {
+		gchar **argv = NULL;
+		GError *err = NULL;
+
+		if( !g_shell_parse_argv( pPath->sCommand, NULL, &argv, &err )
+				|| !g_spawn_async( NULL, argv, NULL, G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+						NULL, NULL, &pState->pid, &err ) ) {
+			sMessage = g_strdup_printf( "Cannot run switch script: %s", err->message );
+			postError( sMessage );
+			g_free( sMessage );
+			g_error_free( err );
+			g_strfreev( argv );
+			pState->pid = 0;
+			return ERROR;
+		}
+		g_strfreev( argv );
+	} else {
+		gint GPIBstatus = 0;
+
+		if( GPIBasyncWrite( pState->descSwitch, pPath->sCommand, &GPIBstatus, 10 * TIMEOUT_RW_1SEC ) != eRDWT_OK ) {
+			postError( "Cannot command the switch matrix" );
+			return ERROR;
+		}
+	}
+	pState->switchedTime = g_get_monotonic_time();
+	return OK;
+}
+
+/*!     \brief  Wait until the switch matrix has settled
+ *
+ * Wait for the switch script to finish, then for whatever remains of the settling time.
+ *
+ * \param pState       pointer to the sequence state
+ * \return             OK or ERROR (if the script failed)
+ */
+static gint
+waitForSwitchMatrix( tSwitchState *pState ) {
+	gint64 remaining;
+
+	if( pState->pid != 0 ) {
+		gint waitStatus = 0;
+
+		waitpid( pState->pid, &waitStatus, 0 );
+		g_spawn_close_pid( pState->pid );
+		pState->pid = 0;
+		pState->switchedTime = g_get_monotonic_time();
+		if( !WIFEXITED( waitStatus ) || WEXITSTATUS( waitStatus ) != 0 ) {
+			postError( "The switch script failed" );
+			return ERROR;
+		}
+	}
+
+	remaining = (gint64)(pState->pSequence->settleTime * G_USEC_PER_SEC)
+			- (g_get_monotonic_time() - pState->switchedTime);
+	if( remaining > 0 )
+		g_usleep( remaining );
+	return OK;
+}
+
+/*!     \brief  The analyzer no longer needs the device; set the next connection
+ *
+ * Called by measureHP8753_S2P() after the last sweep.
+ *
+ * \param pUserData    pointer to the sequence state
+ */
+static void
+switchToNextPath( gpointer pUserData ) {
+	tSwitchState *pState = (tSwitchState *)pUserData;
+
+	if( setSwitchMatrix( pState, pState->nextPath ) != OK )
+		pState->bError = TRUE;
+}
+
+/*!     \brief  Add a 2-port measurement to the N-port matrix
+ *
+ * Reflection parameters measured by more than one connection are taken from the first.
+ *
+ * \param pSnP         pointer to the N-port S-parameters
+ * \param pS2P         pointer to the 2-port measurement
+ * \param pPath        the connection measured
+ * \param bMeasured    which of the N-port S-parameters have been stored
+ */
+static void
+storeSwitchedS2P( tSnP *pSnP, tS2P *pS2P, tSwitchPath *pPath,
+		gboolean bMeasured[ MAX_SWITCHED_PORTS ][ MAX_SWITCHED_PORTS ] ) {
+	struct {
+		gint row, column;
+		tS2Pparameter sParam;
+	} parameters[] = {
+		{ pPath->port1, pPath->port1, eS2P_S11 },
+		{ pPath->port2, pPath->port1, eS2P_S21 },
+		{ pPath->port1, pPath->port2, eS2P_S12 },
+		{ pPath->port2, pPath->port2, eS2P_S22 } };
+
+	for( gint i = 0; i < G_N_ELEMENTS( parameters ); i++ ) {
+		gint row = parameters[ i ].row, column = parameters[ i ].column;
+		gdouble *re = pS2P->re[ parameters[ i ].sParam ], *im = pS2P->im[ parameters[ i ].sParam ];
+
+		if( bMeasured[ row ][ column ] )
+			continue;
+		for( gint n = 0; n < pSnP->nPoints; n++ ) {
+			pSnP->S[ SNP_INDEX( pSnP, n, row, column ) ].r = re[ n ];
+			pSnP->S[ SNP_INDEX( pSnP, n, row, column ) ].i = im[ n ];
+		}
+		bMeasured[ row ][ column ] = TRUE;
+	}
+}
+
+/*!     \brief  Measure a 3 or 4 port device through a switch matrix
+ *
+ * Make a 2-port measurement for each connection of the switch matrix sequence and
+ * assemble the N-port S-parameters (in pSequence->SnP).
+ *
+ * \param  descGPIB_HP8753  GPIB descriptor for HP8753 device
+ * \param  pGlobal          Gloabl data
+ * \param  pSequence        the switch matrix sequence
+ * \param  pGPIBstatus      pointer to GPIB status
+ * \return OK on success or ERROR
+ */
+gint
+getHP8753_SnP( gint descGPIB_HP8753, tGlobal *pGlobal, tSwitchSequence *pSequence, gint *pGPIBstatus ) {
+	tSwitchState state = { .pSequence = pSequence, .descSwitch = INVALID };
+	gboolean bMeasured[ MAX_SWITCHED_PORTS ][ MAX_SWITCHED_PORTS ] = {{ FALSE }};
+	tSnP *pSnP = &pSequence->SnP;
+	tS2P *pS2P = &pGlobal->HP8753.S2P;
+	guint nPaths = pSequence->paths->len;
+	gchar *sMessage;
+	gint rtn = ERROR;
+
+	if( !pSequence->bScript ) {
+		if( pSequence->sDevice ) {
+			state.descSwitch = GPIBfind( pSequence->sDevice );
+		} else {
+			gint GPIBcontrollerIndex = 0;
+
+			GPIBask( descGPIB_HP8753, IbaBNA, &GPIBcontrollerIndex );
+			state.descSwitch = GPIBdev( GPIBcontrollerIndex, pSequence->address, 0, T3s, GPIB_EOI, GPIB_EOS_NONE );
+		}
+		if( state.descSwitch < 0 ) {
+			state.descSwitch = INVALID;
+			postError( "Cannot find the switch matrix" );
+			return ERROR;
+		}
+		// so that an SRQ it asserts is polled (and cleared) while we wait for the HP8753
+		registerSRQdevice( state.descSwitch );
+	}
+
+	if( setSwitchMatrix( &state, 0 ) != OK )
+		goto cleanup;
+
+	for( guint path = 0; path < nPaths; path++ ) {
+		tSwitchPath *pPath = &g_array_index( pSequence->paths, tSwitchPath, path );
+
+		if( waitForSwitchMatrix( &state ) != OK )
+			goto cleanup;
+
+		sMessage = g_strdup_printf( "Measure device ports %d & %d (%d of %d)",
+				pPath->port1 + 1, pPath->port2 + 1, path + 1, nPaths );
+		postInfo( sMessage );
+		g_free( sMessage );
+
+		// the next connection is made while this one's data is read
+		state.nextPath = path + 1;
+		if( measureHP8753_S2P( descGPIB_HP8753, pGlobal,
+				state.nextPath < nPaths ? switchToNextPath : NULL, &state, pGPIBstatus ) != OK
+				|| state.bError )
+			goto cleanup;
+
+		if( path == 0 ) {
+			pSnP->nPorts = pSequence->nPorts;
+			pSnP->nPoints = pS2P->nPoints;
+			pSnP->freq = g_memdup2( pS2P->freq, pS2P->nPoints * sizeof( gdouble ) );
+			pSnP->S = g_new0( tComplex, pSnP->nPoints * pSnP->nPorts * pSnP->nPorts );
+		} else if( pS2P->nPoints != pSnP->nPoints ) {
+			postError( "The number of points changed during the sequence" );
+			goto cleanup;
+		}
+		storeSwitchedS2P( pSnP, pS2P, pPath, bMeasured );
+	}
+	rtn = OK;
+
+cleanup:
+	if( state.pid != 0 ) {
+		waitpid( state.pid, NULL, 0 );
+		g_spawn_close_pid( state.pid );
+	}
+	if( state.descSwitch != INVALID ) {
+		unregisterSRQdevice( state.descSwitch );
+		GPIBonl( state.descSwitch, 0 );
+	}
+	return rtn;
+}
@@ -0,0 +1,192 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * The time the HP8753 takes to complete an operation (signalled by SRQ) is learned
+ * for each instrument (product and firmware), operation and setup variant.
+ *
+ * Each duration is divided by what we expect it to be (the sweep time the HP8753
+ * reports, the number of calibration arrays ... or just 1) and the ratio is smoothed
+ * as TCP smooths round trip times: the mean with a gain of 1/8 and the mean
+ * deviation with a gain of 1/4. Once there are enough samples the timeout is the
+ * mean plus four deviations (and a little grace) instead of the fixed, generous,
+ * timeout, so an instrument that has stopped responding is noticed in seconds.
+ *
+ * The model is recovered from the database before the GPIB thread starts, only
+ * used by the GPIB thread and saved after it ends.
+ */
+
+#define MEAN_GAIN		0.125
+#define DEVIATION_GAIN	0.25
+#define TIMEOUT_DEVIATIONS	4.0
+
+static GHashTable *timingModel = NULL;		// key "product\tfirmware\toperation\tvariant"
+
+/*!     \brief  Free a timing model entry
+ *
+ * \param pEntry        pointer to the entry
+ */
+void
+freeTimingModelEntry( tTimingModelEntry *pEntry ) {
+	if( pEntry ) {
+		g_free( pEntry->sProduct );
+		g_free( pEntry );
+	}
+}
+
+/*!     \brief  Find (or optionally create) the model of an operation
+ *
+ * \param sProduct      product
+ * \param firmware      firmware version
+ * \param operation     operation timed
+ * \param variant       setup variant
+ * \param bCreate       create the entry if it does not exist
+ * \return              pointer to the entry (or NULL)
+ */
+static tTimingModelEntry *
+findTimingModelEntry( gchar *sProduct, gint firmware, tTimedOperation operation, gint variant, gboolean bCreate ) {
+	tTimingModelEntry *pEntry;
+	gchar *sKey;
+
+	if( timingModel == NULL )
+		timingModel = g_hash_table_new_full( g_str_hash, g_str_equal, g_free, (GDestroyNotify)freeTimingModelEntry );
+
+	sKey = g_strdup_printf( "%s\t%d\t%d\t%d", sProduct ? sProduct : "HP8753", firmware, operation, variant );
+	if( (pEntry = g_hash_table_lookup( timingModel, sKey )) != NULL || !bCreate ) {
+		g_free( sKey );
+		return pEntry;
+	}
+
+	pEntry = g_new0( tTimingModelEntry, 1 );
+	pEntry->sProduct = g_strdup( sProduct ? sProduct : "HP8753" );
+	pEntry->firmwareVersion = firmware;
+	pEntry->operation = operation;
+	pEntry->variant = variant;
+	g_hash_table_insert( timingModel, sKey, pEntry );
+	return pEntry;
+}
+
+/*!     \brief  Estimated duration of an operation
+ *
+ * \param pHP8753       pointer to the analyzer (for its identity)
+ * \param operation     operation timed
+ * \param variant       setup variant
+ * \param expected      expected duration (in the units the operation is learned in)
+ * \return              estimated seconds or 0 if not yet learned
+ */
+gdouble
+timingModelEstimate( tHP8753 *pHP8753, tTimedOperation operation, gint variant, gdouble expected ) {
+	tTimingModelEntry *pEntry = findTimingModelEntry( pHP8753->sProduct, pHP8753->firmwareVersion,
+			operation, variant, FALSE );
+
+	if( pEntry == NULL || pEntry->nSamples < TIMING_MODEL_MIN_SAMPLES || expected <= 0.0 )
+		return 0.0;
+	return pEntry->mean * expected;
+}
+
+/*!     \brief  Timeout for an operation
+ *
+ * \param pHP8753       pointer to the analyzer (for its identity)
+ * \param operation     operation timed
+ * \param variant       setup variant
+ * \param expected      expected duration (in the units the operation is learned in)
+ * \param defaultTimeout timeout (s) to use until enough has been learned
+ * \return              timeout (s)
+ */
+gdouble
+timingModelTimeout( tHP8753 *pHP8753, tTimedOperation operation, gint variant,
+		gdouble expected, gdouble defaultTimeout ) {
+	tTimingModelEntry *pEntry = findTimingModelEntry( pHP8753->sProduct, pHP8753->firmwareVersion,
+			operation, variant, FALSE );
+
+	if( pEntry == NULL || pEntry->nSamples < TIMING_MODEL_MIN_SAMPLES || expected <= 0.0 )
+		return defaultTimeout;
+	return (pEntry->mean + TIMEOUT_DEVIATIONS * pEntry->deviation) * expected + TIMING_MODEL_GRACE;
+}
+
+/*!     \brief  Learn from the time an operation took
+ *
+ * If the operation timed out on the learned timeout, the deviation is doubled
+ * (so that an instrument that has become slower is given longer next time).
+ *
+ * \param pHP8753       pointer to the analyzer (for its identity)
+ * \param operation     operation timed
+ * \param variant       setup variant
+ * \param expected      expected duration (in the units the operation is learned in)
+ * \param seconds       time taken
+ * \param bTimedOut     the operation did not complete
+ */
+void
+timingModelLearn( tHP8753 *pHP8753, tTimedOperation operation, gint variant,
+		gdouble expected, gdouble seconds, gboolean bTimedOut ) {
+	tTimingModelEntry *pEntry;
+	gdouble ratio;
+
+	if( expected <= 0.0 || pHP8753->firmwareVersion <= 0 )
+		return;
+
+	pEntry = findTimingModelEntry( pHP8753->sProduct, pHP8753->firmwareVersion, operation, variant, !bTimedOut );
+	if( pEntry == NULL )
+		return;
+
+	if( bTimedOut ) {
+		if( pEntry->nSamples >= TIMING_MODEL_MIN_SAMPLES )
+			pEntry->deviation = MAX( 2.0 * pEntry->deviation, pEntry->mean / TIMEOUT_DEVIATIONS );
+		return;
+	}
+
+	ratio = seconds / expected;
+	if( pEntry->nSamples++ == 0 ) {
+		pEntry->mean = ratio;
+		pEntry->deviation = ratio / 2.0;
+	} else {
+		pEntry->deviation += DEVIATION_GAIN * (fabs( ratio - pEntry->mean ) - pEntry->deviation);
+		pEntry->mean += MEAN_GAIN * (ratio - pEntry->mean);
+	}
+	DBG( eDEBUG_INFO, "Timing model %d/%d: %.2f s (expected %.2f) mean %.3f deviation %.3f",
+			operation, variant, seconds, expected, pEntry->mean, pEntry->deviation );
+}
+
+/*!     \brief  Restore an entry of the model (recovered from the database)
+ *
+ * \param pEntry        pointer to the entry
+ */
+void
+timingModelRestore( tTimingModelEntry *pEntry ) {
+	tTimingModelEntry *pModel = findTimingModelEntry( pEntry->sProduct, pEntry->firmwareVersion,
+			pEntry->operation, pEntry->variant, TRUE );
+
+	pModel->mean = pEntry->mean;
+	pModel->deviation = pEntry->deviation;
+	pModel->nSamples = pEntry->nSamples;
+}
+
+/*!     \brief  Get the entries of the model (to save)
+ *
+ * \return              list of the entries (owned by the model)
+ */
+GList *
+timingModelEntries( void ) {
+	return timingModel ? g_hash_table_get_values( timingModel ) : NULL;
+}
@@ -0,0 +1,532 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * Touchstone (.s1p / .s2p ... version 1.x and 2.0) reader.
+ * The file is read in large blocks and each line is split and converted in place,
+ * so nothing is allocated per line or per number. Only S-parameter data in full
+ * matrix format is supported; for more than two ports the S11, S12, S21 and S22 terms are kept.
+ */
+
+#define TS_READ_BUFFER_SIZE		(64 * 1024)
+#define TS_INITIAL_POINTS		1024
+
+typedef struct {
+	FILE	*file;
+	gchar	*buffer;
+	gsize	length;			// bytes in the buffer
+	gsize	position;		// start of the next line
+	gint	lineNumber;
+	gboolean bEOF;
+} tLineReader;
+
+/*!     \brief  Get the next line of the file
+ *
+ * The line is NUL terminated in place in the read buffer and is valid
+ * until the next call.
+ *
+ * \param pReader      pointer to the line reader
+ * \return             pointer to the line or NULL at the end of the file (or if the line is too long)
+ */
+static gchar *
+readLine( tLineReader *pReader ) {
+	gchar *sLine, *pEOL;
+
+	for( ;; ) {
+		sLine = pReader->buffer + pReader->position;
+		pEOL = memchr( sLine, '\n', pReader->length - pReader->position );
+		if( pEOL || (pReader->bEOF && pReader->position < pReader->length) ) {
+			if( pEOL == NULL )
+				pEOL = pReader->buffer + pReader->length;
+			*pEOL = 0;
+			pReader->position = pEOL - pReader->buffer + 1;
+			pReader->lineNumber++;
+			return sLine;
+		}
+		if( pReader->bEOF )
+			return NULL;
+		// move the partial line to the start of the buffer and fill the rest
+		memmove( pReader->buffer, sLine, pReader->length - pReader->position );
+		pReader->length -= pReader->position;
+		pReader->position = 0;
+		if( pReader->length == TS_READ_BUFFER_SIZE ) {
+			errno = EFBIG;
+			return NULL;
+		}
+		pReader->length += fread( pReader->buffer + pReader->length, 1,
+				TS_READ_BUFFER_SIZE - pReader->length, pReader->file );
+		// keep room for the NUL terminator of the last line
+		if( pReader->length < TS_READ_BUFFER_SIZE )
+			pReader->bEOF = TRUE;
+	}
+}
+
+// split off the next whitespace separated token (in place)
+static gchar *
+nextToken( gchar **ppLine ) {
+	gchar *p = *ppLine, *sToken;
+
+	while( *p == ' ' || *p == '\t' || *p == '\r' || *p == ',' )
+		p++;
+	if( *p == 0 )
+		return NULL;
+	sToken = p;
+	while( *p && *p != ' ' && *p != '\t' && *p != '\r' && *p != ',' )
+		p++;
+	if( *p )
+		*p++ = 0;
+	*ppLine = p;
+	return sToken;
+}
+
+typedef struct {
+	gint		version;			// 1 or 2
+	gint		nPorts;
+	tTouchstoneFormat format;
+	gdouble		frequencyScale;
+	gdouble		referenceImpedance;
+	gboolean	bOrder12_21;		// two-port data order is S11 S12 S21 S22
+	gboolean	bOptionLine;
+	gboolean	bNetworkData;		// in the network data
+	gboolean	bDone;
+	gint		nValues;			// numbers per frequency
+	gint		nValuesRead;		// numbers of the current frequency read so far
+	gdouble		*values;
+	gint		nExpected;			// from [Number of Frequencies] (0 if not given)
+} tTouchstoneParser;
+
+static const gchar *touchstoneUnitNames[] = { "HZ", "KHZ", "MHZ", "GHZ" };
+static const gdouble touchstoneUnitScales[] = { 1.0, 1.0e3, 1.0e6, 1.0e9 };
+static const gchar *touchstoneFormatNames[] = { "RI", "MA", "DB" };
+
+/*!     \brief  Parse the option line "# <unit> <parameter> <format> R <impedance>"
+ *
+ * \param pParser      pointer to the parser state
+ * \param sLine        the line following the '#'
+ * \return             NULL or a static error message
+ */
+static const gchar *
+parseOptionLine( tTouchstoneParser *pParser, gchar *sLine ) {
+	gchar *sToken, *end;
+
+	if( pParser->bOptionLine )
+		return NULL;	// only the first option line counts
+	pParser->bOptionLine = TRUE;
+
+	while( (sToken = nextToken( &sLine )) != NULL ) {
+		gint i;
+
+		for( i = 0; i < eTS_N_UNITS && g_ascii_strcasecmp( sToken, touchstoneUnitNames[ i ] ) != 0; i++ );
+		if( i < eTS_N_UNITS ) {
+			pParser->frequencyScale = touchstoneUnitScales[ i ];
+			continue;
+		}
+		for( i = 0; i < eTS_N_FORMATS && g_ascii_strcasecmp( sToken, touchstoneFormatNames[ i ] ) != 0; i++ );
+		if( i < eTS_N_FORMATS ) {
+			pParser->format = i;
+			continue;
+		}
+		if( g_ascii_strcasecmp( sToken, "S" ) == 0 )
+			continue;
+		if( g_ascii_strcasecmp( sToken, "R" ) == 0 ) {
+			if( (sToken = nextToken( &sLine )) == NULL )
+				return "Missing reference impedance";
+			pParser->referenceImpedance = g_ascii_strtod( sToken, &end );
+			if( *end || pParser->referenceImpedance <= 0.0 )
+				return "Invalid reference impedance";
+			continue;
+		}
+		if( strchr( "YZHGyzhg", sToken[0] ) && sToken[1] == 0 )
+			return "Only S-parameter files can be read";
+		return "Unrecognized option";
+	}
+	return NULL;
+}
+
+/*!     \brief  Parse a Touchstone 2.0 keyword line "[keyword] value"
+ *
+ * \param pParser      pointer to the parser state
+ * \param sLine        the line (starting with '[')
+ * \return             NULL or a static error message
+ */
+static const gchar *
+parseKeyword( tTouchstoneParser *pParser, gchar *sLine ) {
+	gchar *sValue = strchr( sLine, ']' );
+
+	if( sValue == NULL )
+		return "Invalid keyword";
+	*sValue++ = 0;
+	g_strstrip( sValue );
+	sLine++;
+
+	if( g_ascii_strcasecmp( sLine, "Version" ) == 0 ) {
+		pParser->version = (gint)g_ascii_strtod( sValue, NULL );
+		if( pParser->version != 2 )
+			return "Unsupported Touchstone version";
+	} else if( g_ascii_strcasecmp( sLine, "Number of Ports" ) == 0 ) {
+		pParser->nPorts = atoi( sValue );
+		if( pParser->nPorts < 1 )
+			return "Invalid number of ports";
+	} else if( g_ascii_strcasecmp( sLine, "Two-Port Data Order" ) == 0 ) {
+		pParser->bOrder12_21 = (g_ascii_strcasecmp( sValue, "12_21" ) == 0);
+	} else if( g_ascii_strcasecmp( sLine, "Number of Frequencies" ) == 0 ) {
+		gint nFrequencies = atoi( sValue );
+		if( nFrequencies > pParser->nExpected )
+			pParser->nExpected = nFrequencies;
+	} else if( g_ascii_strcasecmp( sLine, "Matrix Format" ) == 0 ) {
+		if( g_ascii_strcasecmp( sValue, "Full" ) != 0 )
+			return "Only the full matrix format is supported";
+	} else if( g_ascii_strcasecmp( sLine, "Network Data" ) == 0 ) {
+		pParser->bNetworkData = TRUE;
+	} else if( g_ascii_strcasecmp( sLine, "Noise Data" ) == 0 || g_ascii_strcasecmp( sLine, "End" ) == 0 ) {
+		pParser->bDone = TRUE;
+	}
+	// others ([Reference], [Mixed-Mode Order] ...) do not change how S-parameters are read
+	return NULL;
+}
+
+static inline void
+storeTouchstonePair( tTouchstoneFormat format, const gdouble *pair, tS2P *pS2P, tS2Pparameter sParam, gint i ) {
+	gdouble a = pair[0], b = pair[1];
+
+	switch( format ) {
+	case eTS_RI:
+	default:
+		pS2P->re[ sParam ][ i ] = a;
+		pS2P->im[ sParam ][ i ] = b;
+		break;
+	case eTS_DB:
+		a = DBtoRATIO( a );
+		// fall through
+	case eTS_MA:
+		pS2P->re[ sParam ][ i ] = a * cos( DEG2RAD( b ) );
+		pS2P->im[ sParam ][ i ] = a * sin( DEG2RAD( b ) );
+		break;
+	}
+}
+
+/*!     \brief  Store the frequency and S-parameters just read
+ *
+ * \param pParser      pointer to the parser state
+ * \param pS2P         S-parameters being read
+ * \return             OK or ERROR (out of memory)
+ */
+static gint
+storeFrequencyPoint( tTouchstoneParser *pParser, tS2P *pS2P ) {
+	gdouble *v = pParser->values;
+	gint n = pParser->nPorts, i = pS2P->nPoints;
+	gint i12, i21;
+
+	// the planes grow by doubling (unless [Number of Frequencies] told us how many)
+	if( pS2P->pBuffer == NULL || i == pS2P->nAllocated ) {
+		if( reserveS2P( pS2P, pS2P->pBuffer == NULL ? MAX( pParser->nExpected, TS_INITIAL_POINTS ) : pS2P->nAllocated * 2 ) != OK )
+			return ERROR;
+	}
+
+	pS2P->freq[ i ] = v[0] * pParser->frequencyScale;
+	v++;
+	storeTouchstonePair( pParser->format, &v[0], pS2P, eS2P_S11, i );
+	if( n > 1 ) {
+		// version 1 (and 2.0 with [Two-Port Data Order] 21_12) two-ports are S11 S21 S12 S22,
+		// otherwise the matrix is listed row by row
+		if( n == 2 && !pParser->bOrder12_21 ) {
+			i21 = 1;
+			i12 = 2;
+		} else {
+			i12 = 1;
+			i21 = n;
+		}
+		storeTouchstonePair( pParser->format, &v[ 2 * i12 ], pS2P, eS2P_S12, i );
+		storeTouchstonePair( pParser->format, &v[ 2 * i21 ], pS2P, eS2P_S21, i );
+		storeTouchstonePair( pParser->format, &v[ 2 * (n + 1) ], pS2P, eS2P_S22, i );
+	}
+	pS2P->nPoints++;
+	return OK;
+}
+
+/*!     \brief  Guess the number of ports from the file extension (.sNp)
+ *
+ * \param sFilename    file name
+ * \return             number of ports (0 if unknown)
+ */
+static gint
+portsFromFilename( const gchar *sFilename ) {
+	const gchar *sExtension = strrchr( sFilename, '.' );
+	gchar *end;
+	gint nPorts;
+
+	if( sExtension == NULL || g_ascii_tolower( sExtension[1] ) != 's' )
+		return 0;
+	nPorts = strtol( sExtension + 2, &end, 10 );
+	return (g_ascii_tolower( *end ) == 'p' && end[1] == 0) ? nPorts : 0;
+}
+
+/*!     \brief  Read S-parameters from a Touchstone file
+ *
+ * Version 1.x and 2.0 files with any number of ports are read; the S11 (and for
+ * two or more ports S21, S12 and S22) terms are returned in the tS2P structure.
+ *
+ * \param sFilename    name of the Touchstone file
+ * \param pS2P         pointer to the S-parameters to fill (any existing data is freed)
+ * \param pReferenceImpedance          pointer to the reference impedance to fill
+ * \param psError      pointer to a g_malloced error message (if ERROR)
+ * \return             OK or ERROR
+ */
+gint
+readTouchstone( gchar *sFilename, tS2P *pS2P, gdouble *pReferenceImpedance, gchar **psError ) {
+	tLineReader reader = { 0 };
+	tTouchstoneParser parser = { .version = 1, .format = eTS_MA, .frequencyScale = 1.0e9,
+			.referenceImpedance = 50.0, .bOrder12_21 = FALSE };
+	const gchar *sError = NULL;
+	gchar *sLine, *sToken, *end;
+
+	freeS2P( pS2P );
+	*psError = NULL;
+
+	if( (reader.file = fopen( sFilename, "r" )) == NULL ) {
+		*psError = g_strdup_printf( "Cannot open %s (%s)", sFilename, g_strerror( errno ) );
+		return ERROR;
+	}
+	reader.buffer = g_malloc( TS_READ_BUFFER_SIZE + 1 );
+	parser.nPorts = portsFromFilename( sFilename );
+
+	while( !parser.bDone && sError == NULL && (sLine = readLine( &reader )) != NULL ) {
+		gchar *sComment = strchr( sLine, '!' );
+
+		if( sComment )
+			*sComment = 0;
+		while( *sLine == ' ' || *sLine == '\t' )
+			sLine++;
+
+		if( *sLine == '#' ) {
+			sError = parseOptionLine( &parser, sLine + 1 );
+			continue;
+		}
+		if( *sLine == '[' ) {
+			sError = parseKeyword( &parser, sLine );
+			continue;
+		}
+
+		while( sError == NULL && !parser.bDone && (sToken = nextToken( &sLine )) != NULL ) {
+			if( parser.values == NULL ) {
+				// the first number ... we must know the layout of the data by now
+				if( !parser.bOptionLine ) {
+					sError = "Missing option line";
+					break;
+				}
+				if( parser.version == 2 && !parser.bNetworkData ) {
+					sError = "Data before [Network Data]";
+					break;
+				}
+				if( parser.nPorts < 1 ) {
+					sError = "Unknown number of ports (the file name should end in .sNp)";
+					break;
+				}
+				parser.nValues = 1 + 2 * parser.nPorts * parser.nPorts;
+				parser.values = g_new( gdouble, parser.nValues );
+			}
+			parser.values[ parser.nValuesRead ] = g_ascii_strtod( sToken, &end );
+			if( *end ) {
+				sError = "Invalid number";
+				break;
+			}
+			// version 1 two-port files may be followed by noise data (the frequency starts again)
+			if( parser.nValuesRead == 0 && pS2P->nPoints > 0
+					&& parser.values[ 0 ] * parser.frequencyScale <= pS2P->freq[ pS2P->nPoints - 1 ] ) {
+				if( parser.version == 1 && parser.nPorts == 2 )
+					parser.bDone = TRUE;
+				else
+					sError = "Frequencies are not increasing";
+				break;
+			}
+			if( ++parser.nValuesRead == parser.nValues ) {
+				if( storeFrequencyPoint( &parser, pS2P ) != OK ) {
+					sError = "Out of memory";
+					break;
+				}
+				parser.nValuesRead = 0;
+			}
+		}
+	}
+
+	if( sError == NULL && ferror( reader.file ) )
+		sError = g_strerror( errno );
+	if( sError == NULL && parser.nValuesRead != 0 )
+		sError = "Incomplete data for the last frequency";
+	if( sError == NULL && pS2P->nPoints == 0 )
+		sError = "No network data";
+	if( sError == NULL && !parser.bDone && !reader.bEOF )
+		sError = "Line too long";
+
+	if( sError ) {
+		*psError = g_strdup_printf( "%s: %s (line %d)", sFilename, sError, reader.lineNumber );
+		freeS2P( pS2P );
+	} else {
+		pS2P->SnPtype = parser.nPorts == 1 ? S1P_S11 : S2P;
+		*pReferenceImpedance = parser.referenceImpedance;
+	}
+
+	g_free( parser.values );
+	g_free( reader.buffer );
+	fclose( reader.file );
+	return sError ? ERROR : OK;
+}
+
+/*
+ * Reference trace
+ */
+
+/*!     \brief  Load a reference trace from a Touchstone file
+ *
+ * \param pReference   pointer to the reference trace
+ * \param sFilename    name of the Touchstone file
+ * \param psError      pointer to a g_malloced error message (if ERROR)
+ * \return             OK or ERROR
+ */
+gint
+loadReferenceTrace( tReferenceTrace *pReference, gchar *sFilename, gchar **psError ) {
+	tS2P S2P = { 0 };
+	gdouble referenceImpedance;
+
+	if( readTouchstone( sFilename, &S2P, &referenceImpedance, psError ) != OK )
+		return ERROR;
+
+	freeReferenceTrace( pReference );
+	pReference->S2P = S2P;
+	pReference->referenceImpedance = referenceImpedance;
+	pReference->sFilename = g_strdup( sFilename );
+	return OK;
+}
+
+/*!     \brief  Remove the reference trace
+ *
+ * \param pReference   pointer to the reference trace
+ */
+void
+freeReferenceTrace( tReferenceTrace *pReference ) {
+	freeS2P( &pReference->S2P );
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ )
+		g_free( pReference->cache[ channel ].points );
+	g_free( pReference->sFilename );
+	memset( pReference, 0, sizeof( tReferenceTrace ) );
+}
+
+/*!     \brief  Find the reference S-parameter that corresponds to the measurement
+ *
+ * \param pS2P         pointer to the reference S-parameters
+ * \param measurement  index into optMeasurementType
+ * \return             the tS2Pparameter or INVALID if not in the reference
+ */
+static gint
+referenceParameter( tS2P *pS2P, gint measurement ) {
+	gint sParam = S2PparameterOfMeasurement( measurement );
+
+	if( (pS2P->SnPtype == S1P_S11 && sParam != eS2P_S11) || (pS2P->SnPtype == S1P_S22 && sParam != eS2P_S22) )
+		return INVALID;
+	return sParam;
+}
+
+/*!     \brief  Get the reference trace points for a channel
+ *
+ * The reference S-parameter matching the channel measurement is linearly interpolated
+ * onto the channel's stimulus points and converted to the channel's display format.
+ * The result is kept and only recalculated when the stimulus, format or measurement change,
+ * so redrawing costs no more than drawing the trace itself.
+ * Points outside the frequency range of the reference are NAN.
+ *
+ * \param pGlobal      pointer to global data
+ * \param channel      channel
+ * \return             array of nPoints values (as responsePoints) or NULL if there is no reference
+ */
+tComplex *
+referenceTracePoints( tGlobal *pGlobal, eChannel channel ) {
+	tReferenceTrace *pReference = &pGlobal->referenceTrace;
+	tReferenceCache *pCache = &pReference->cache[ channel ];
+	tChannel *pChannel = &pGlobal->HP8753.channels[ channel ];
+	tS2P *pS2P = &pReference->S2P;
+	gdouble *stimulus = pChannel->stimulusPoints, *re, *im;
+	gint sParam, quantity;
+	guint nPoints = pChannel->nPoints;
+
+	if( pS2P->nPoints == 0 || nPoints == 0 || stimulus == NULL || pChannel->responsePoints == NULL )
+		return NULL;
+	if( pChannel->sweepType == eSWP_CWTIME || pChannel->sweepType == eSWP_PWR )
+		return NULL;
+	if( (sParam = referenceParameter( pS2P, pChannel->measurementType )) == INVALID )
+		return NULL;
+	re = pS2P->re[ sParam ];
+	im = pS2P->im[ sParam ];
+
+	if( pCache->points && pCache->nPoints == nPoints
+			&& pCache->format == pChannel->format && pCache->measurementType == pChannel->measurementType
+			&& pCache->stimulusStart == stimulus[ 0 ] && pCache->stimulusMiddle == stimulus[ nPoints / 2 ]
+			&& pCache->stimulusStop == stimulus[ nPoints - 1 ] )
+		return pCache->points;
+
+	if( pCache->nPoints != nPoints || pCache->points == NULL ) {
+		g_free( pCache->points );
+		pCache->points = g_new( tComplex, nPoints );
+	}
+
+	// resample (the stimulus is increasing, so the search continues from the last point)
+	for( guint i = 0, j = 0; i < nPoints; i++ ) {
+		gdouble f = stimulus[ i ];
+
+		while( j + 1 < pS2P->nPoints && pS2P->freq[ j + 1 ] < f )
+			j++;
+		if( f < pS2P->freq[ 0 ] || f > pS2P->freq[ pS2P->nPoints - 1 ] ) {
+			pCache->points[ i ].r = pCache->points[ i ].i = NAN;
+		} else if( j + 1 == pS2P->nPoints || f <= pS2P->freq[ j ] ) {
+			pCache->points[ i ].r = re[ j ];
+			pCache->points[ i ].i = im[ j ];
+		} else {
+			gdouble fraction = (f - pS2P->freq[ j ]) / (pS2P->freq[ j + 1 ] - pS2P->freq[ j ]);
+			pCache->points[ i ].r = LIN_INTERP( re[ j ], re[ j + 1 ], fraction );
+			pCache->points[ i ].i = LIN_INTERP( im[ j ], im[ j + 1 ], fraction );
+		}
+	}
+
+	// convert to the display format (the Smith and polar formats show the S-parameter itself)
+	if( (quantity = derivedQuantityOfFormat( pChannel->format )) != INVALID ) {
+		tComplexTrace trace = complexTraceOfPoints( pCache->points, stimulus, nPoints );
+		gdouble *values = g_new( gdouble, nPoints );
+
+		deriveTrace( quantity, &trace, Z0, values, NULL );
+		for( guint i = 0; i < nPoints; i++ ) {
+			pCache->points[ i ].r = values[ i ];
+			pCache->points[ i ].i = 0.0;
+		}
+		g_free( values );
+	}
+
+	pCache->nPoints = nPoints;
+	pCache->format = pChannel->format;
+	pCache->measurementType = pChannel->measurementType;
+	pCache->stimulusStart = stimulus[ 0 ];
+	pCache->stimulusMiddle = stimulus[ nPoints / 2 ];
+	pCache->stimulusStop = stimulus[ nPoints - 1 ];
+
+	return pCache->points;
+}
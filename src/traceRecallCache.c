@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <hp8753.h>
+
+/*
+ * The most recently recalled trace profiles are kept decoded in memory
+ * (least recently used are discarded when the memory budget is exceeded)
+ * so that flipping between saved traces does not go back to the database.
+ */
+
+typedef struct {
+	gchar		*sKey;
+	guint		channelMask;		// bit set for each channel recovered
+	tChannel	channels[ eNUM_CH ];	// response, stimulus and complex arrays are owned by the cache
+	void		*plotHPGL;
+	gchar		*sTitle;
+	gchar		*sNote;
+	gchar		*dateTime;
+	guint16		generalFlags;
+	gsize		size;				// bytes of array data held
+} tTraceCacheEntry;
+
+static GHashTable	*traceCacheIndex = NULL;	// key -> GList link in traceCacheLRU
+static GQueue		traceCacheLRU = G_QUEUE_INIT;	// head is most recently used
+static gsize		traceCacheSize = 0;
+static gsize		traceCacheBudget = TRACE_CACHE_BUDGET;
+
+/*!     \brief  Form the cache key from the project and name
+ *
+ * \param sProject     project name (may be NULL)
+ * \param sName        trace profile name
+ * \return             g_malloced key
+ */
+static gchar *
+traceCacheKey( gchar *sProject, gchar *sName ) {
+	return g_strdup_printf( "%s%c%s", sProject ? sProject : "", ETX, sName ? sName : "" );
+}
+
+/*!     \brief  Free a cache entry
+ *
+ * \param pEntry       pointer to the cache entry
+ */
+static void
+freeTraceCacheEntry( tTraceCacheEntry *pEntry ) {
+	for( eChannel channel = 0; channel < eNUM_CH; channel++ ) {
+		g_free( pEntry->channels[ channel ].responsePoints );
+		g_free( pEntry->channels[ channel ].stimulusPoints );
+		g_free( pEntry->channels[ channel ].complexPoints );
+	}
+	g_free( pEntry->plotHPGL );
+	g_free( pEntry->sTitle );
+	g_free( pEntry->sNote );
+	g_free( pEntry->dateTime );
+	g_free( pEntry->sKey );
+	g_free( pEntry );
+}
+
+/*!     \brief  Remove an entry from the cache
+ *
+ * \param link         GList link of the entry in the LRU queue
+ */
+static void
+evictTraceCacheLink( GList *link ) {
+	tTraceCacheEntry *pEntry = link->data;
+
+	g_hash_table_remove( traceCacheIndex, pEntry->sKey );
+	g_queue_delete_link( &traceCacheLRU, link );
+	traceCacheSize -= pEntry->size;
+	freeTraceCacheEntry( pEntry );
+}
+
+/*!     \brief  Copy an array into a destination buffer (reusing it if the same size)
+ *
+ * \param pOld         existing buffer (freed if not reused)
+ * \param oldNpoints   number of points in the existing buffer
+ * \param pSource      source array (or NULL)
+ * \param nPoints      number of points in the source
+ * \param elementSize  size of each point
+ * \return             pointer to buffer holding copy (or NULL)
+ */
+static gpointer
+copyIntoBuffer( gpointer pOld, guint oldNpoints, gconstpointer pSource, guint nPoints, gsize elementSize ) {
+	if( pSource == NULL || nPoints == 0 ) {
+		g_free( pOld );
+		return NULL;
+	}
+	if( pOld != NULL && oldNpoints == nPoints ) {
+		memcpy( pOld, pSource, nPoints * elementSize );
+		return pOld;
+	}
+	g_free( pOld );
+	return g_memdup2( pSource, nPoints * elementSize );
+}
+
+/*!     \brief  Recall a trace profile from the cache
+ *
+ * If the trace profile is in the cache, it is copied into the tHP8753 structure
+ * in the same way as recoverTraceData() would have recovered it from the database.
+ * Existing response, stimulus and complex buffers are reused when the number of points is unchanged.
+ *
+ * \param pHP8753      pointer to tHP8753 structure to restore into
+ * \param sProject     project name
+ * \param sName        trace profile name
+ * \return             TRUE if found in the cache
+ */
+gboolean
+recallTraceFromCache( tHP8753 *pHP8753, gchar *sProject, gchar *sName ) {
+	tTraceCacheEntry *pEntry;
+	GList *link;
+	gchar *sKey;
+
+	if( traceCacheIndex == NULL )
+		return FALSE;
+
+	sKey = traceCacheKey( sProject, sName );
+	link = g_hash_table_lookup( traceCacheIndex, sKey );
+	g_free( sKey );
+	if( link == NULL )
+		return FALSE;
+
+	// most recently used goes to the head of the queue
+	g_queue_unlink( &traceCacheLRU, link );
+	g_queue_push_head_link( &traceCacheLRU, link );
+	pEntry = link->data;
+
+	for( eChannel channel = 0; channel < eNUM_CH; channel++ ) {
+		tChannel *pChannel = &pHP8753->channels[ channel ];
+		tComplex *responsePoints = pChannel->responsePoints;
+		gdouble *stimulusPoints = pChannel->stimulusPoints;
+		tComplex *complexPoints = pChannel->complexPoints;
+		guint oldNpoints = pChannel->nPoints;
+
+		if( !(pEntry->channelMask & (1 << channel)) )
+			continue;
+
+		*pChannel = pEntry->channels[ channel ];
+		pChannel->responsePoints = copyIntoBuffer( responsePoints, oldNpoints,
+				pEntry->channels[ channel ].responsePoints, pChannel->nPoints, sizeof( tComplex ) );
+		pChannel->stimulusPoints = copyIntoBuffer( stimulusPoints, oldNpoints,
+				pEntry->channels[ channel ].stimulusPoints, pChannel->nPoints, sizeof( gdouble ) );
+		pChannel->complexPoints = copyIntoBuffer( complexPoints, oldNpoints,
+				pEntry->channels[ channel ].complexPoints, pChannel->nPoints, sizeof( tComplex ) );
+		if( pChannel->responsePoints == NULL )
+			pChannel->nPoints = 0;
+	}
+
+	g_free( pHP8753->plotHPGL );
+	pHP8753->plotHPGL = pEntry->plotHPGL ? g_memdup2( pEntry->plotHPGL, *(guint *)pEntry->plotHPGL ) : NULL;
+
+	if( pEntry->channelMask & (1 << eCH_ONE) ) {
+		g_free( pHP8753->sTitle );
+		pHP8753->sTitle = g_strdup( pEntry->sTitle );
+		g_free( pHP8753->sNote );
+		pHP8753->sNote = g_strdup( pEntry->sNote );
+		memcpy( &pHP8753->flags, &pEntry->generalFlags, sizeof( guint16 ) );
+		g_free( pHP8753->dateTime );
+		pHP8753->dateTime = g_strdup( pEntry->dateTime );
+	}
+
+	return TRUE;
+}
+
+/*!     \brief  Add a trace profile just recovered from the database to the cache
+ *
+ * Take a copy of the recovered trace data. The least recently used entries are discarded
+ * to keep the cache within its memory budget.
+ *
+ * \param pHP8753      pointer to tHP8753 structure holding the recovered profile
+ * \param channelMask  bit set for each channel recovered
+ * \param sProject     project name
+ * \param sName        trace profile name
+ */
+void
+storeTraceInCache( tHP8753 *pHP8753, guint channelMask, gchar *sProject, gchar *sName ) {
+	tTraceCacheEntry *pEntry;
+	GList *link;
+
+	if( traceCacheIndex == NULL )
+		traceCacheIndex = g_hash_table_new( g_str_hash, g_str_equal );
+
+	invalidateTraceCache( sProject, sName );
+
+	pEntry = g_new0( tTraceCacheEntry, 1 );
+	pEntry->sKey = traceCacheKey( sProject, sName );
+	pEntry->channelMask = channelMask;
+
+	for( eChannel channel = 0; channel < eNUM_CH; channel++ ) {
+		tChannel *pChannel = &pHP8753->channels[ channel ];
+
+		if( !(channelMask & (1 << channel)) )
+			continue;
+
+		pEntry->channels[ channel ] = *pChannel;
+		pEntry->channels[ channel ].responsePoints =
+				g_memdup2( pChannel->responsePoints, pChannel->nPoints * sizeof( tComplex ) );
+		pEntry->channels[ channel ].stimulusPoints =
+				g_memdup2( pChannel->stimulusPoints, pChannel->nPoints * sizeof( gdouble ) );
+		pEntry->channels[ channel ].complexPoints =
+				g_memdup2( pChannel->complexPoints, pChannel->nPoints * sizeof( tComplex ) );
+		if( pEntry->channels[ channel ].responsePoints )
+			pEntry->size += pChannel->nPoints * sizeof( tComplex );
+		if( pEntry->channels[ channel ].stimulusPoints )
+			pEntry->size += pChannel->nPoints * sizeof( gdouble );
+		if( pEntry->channels[ channel ].complexPoints )
+			pEntry->size += pChannel->nPoints * sizeof( tComplex );
+	}
+
+	if( pHP8753->plotHPGL ) {
+		pEntry->plotHPGL = g_memdup2( pHP8753->plotHPGL, *(guint *)pHP8753->plotHPGL );
+		pEntry->size += *(guint *)pHP8753->plotHPGL;
+	}
+	pEntry->sTitle = g_strdup( pHP8753->sTitle );
+	pEntry->sNote = g_strdup( pHP8753->sNote );
+	pEntry->dateTime = g_strdup( pHP8753->dateTime );
+	memcpy( &pEntry->generalFlags, &pHP8753->flags, sizeof( guint16 ) );
+	pEntry->size += sizeof( tTraceCacheEntry );
+
+	// a single profile bigger than the whole budget is not worth keeping
+	if( pEntry->size > traceCacheBudget ) {
+		freeTraceCacheEntry( pEntry );
+		return;
+	}
+
+	g_queue_push_head( &traceCacheLRU, pEntry );
+	g_hash_table_insert( traceCacheIndex, pEntry->sKey, g_queue_peek_head_link( &traceCacheLRU ) );
+	traceCacheSize += pEntry->size;
+
+	// discard the least recently used until we are within budget
+	while( traceCacheSize > traceCacheBudget && (link = g_queue_peek_tail_link( &traceCacheLRU )) != NULL )
+		evictTraceCacheLink( link );
+}
+
+/*!     \brief  Invalidate cached trace profile(s)
+ *
+ * Called when a trace profile is saved, deleted, renamed, moved or copied
+ *
+ * \param sProject     project name
+ * \param sName        trace profile name (if NULL, the whole cache is emptied)
+ */
+void
+invalidateTraceCache( gchar *sProject, gchar *sName ) {
+	GList *link;
+	gchar *sKey;
+
+	if( traceCacheIndex == NULL )
+		return;
+
+	if( sName == NULL ) {
+		while( (link = g_queue_peek_tail_link( &traceCacheLRU )) != NULL )
+			evictTraceCacheLink( link );
+		return;
+	}
+
+	sKey = traceCacheKey( sProject, sName );
+	if( (link = g_hash_table_lookup( traceCacheIndex, sKey )) != NULL )
+		evictTraceCacheLink( link );
+	g_free( sKey );
+}
+
+/*!     \brief  Set the memory budget of the trace recall cache
+ *
+ * \param budget       maximum number of bytes to hold (0 disables the cache)
+ */
+void
+setTraceCacheBudget( gsize budget ) {
+	GList *link;
+
+	traceCacheBudget = budget;
+	while( traceCacheSize > traceCacheBudget && (link = g_queue_peek_tail_link( &traceCacheLRU )) != NULL )
+		evictTraceCacheLink( link );
+}
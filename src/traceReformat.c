@@ -0,0 +1,283 @@
+/*
+ * Copyright (c) 2022 Michael G. Katzmann
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <glib-2.0/glib.h>
+#include "hp8753.h"
+
+/*
+ * When the corrected complex data (OUTPDATA) is retrieved with a trace, the trace
+ * can be shown in any format without the HP8753. Each format is calculated once and
+ * kept until the channel data changes; the HP8753's own formatted trace is kept for
+ * the format in which it was acquired so that returning to it shows the original data.
+ *
+ * The host formatted view is only for display. A trace is saved (and archived) as it was
+ * acquired, so the channels are returned to that format while it is written.
+ */
+
+/*!     \brief  Discard the host formatted views of a channel
+ *
+ * Called whenever the channel's trace data is replaced.
+ *
+ * \param pGlobal      pointer to global data
+ * \param channel      channel
+ */
+void
+invalidateReformatCache( tGlobal *pGlobal, eChannel channel ) {
+	tReformatCache *pCache = &pGlobal->reformatCache[ channel ];
+
+	for( tFormat format = 0; format < NUM_FORMATS; format++ ) {
+		g_free( pCache->points[ format ] );
+		pCache->points[ format ] = NULL;
+	}
+	pCache->nPoints = 0;
+}
+
+/*!     \brief  Check that the host formatted views are of the channel's trace
+ *
+ * The trace being shown is always one of the views, so a trace read (or recalled)
+ * since the views were made is detected by its data as well as its size.
+ *
+ * \param pGlobal      pointer to global data
+ * \param channel      channel
+ * \return             TRUE if the views are of the current trace
+ */
+static gboolean
+reformatCacheValid( tGlobal *pGlobal, eChannel channel ) {
+	tChannel *pChannel = &pGlobal->HP8753.channels[ channel ];
+	tReformatCache *pCache = &pGlobal->reformatCache[ channel ];
+
+	return pCache->nPoints != 0 && pCache->nPoints == pChannel->nPoints
+			&& pChannel->responsePoints != NULL && pChannel->format < NUM_FORMATS
+			&& pCache->points[ pChannel->format ] != NULL
+			&& memcmp( pChannel->responsePoints, pCache->points[ pChannel->format ],
+					pChannel->nPoints * sizeof( tComplex ) ) == 0;
+}
+
+/*!     \brief  Discard the host formatted views of traces that have been replaced
+ *
+ * Called on the main thread when a GPIB job (which may have read new traces) is complete.
+ *
+ * \param pGlobal      pointer to global data
+ */
+void
+discardStaleReformatCache( tGlobal *pGlobal ) {
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ )
+		if( pGlobal->reformatCache[ channel ].nPoints != 0 && !reformatCacheValid( pGlobal, channel ) )
+			invalidateReformatCache( pGlobal, channel );
+}
+
+/*!     \brief  Round up to the next 1, 2, 5 x 10^n value
+ *
+ * \param value        positive value
+ * \return             smallest 1, 2 or 5 x 10^n not less than value
+ */
+static gdouble
+roundUp125( gdouble value ) {
+	gdouble decade = pow( 10.0, floor( log10( value ) ) );
+
+	if( value <= decade )
+		return decade;
+	else if( value <= 2.0 * decade )
+		return 2.0 * decade;
+	else if( value <= 5.0 * decade )
+		return 5.0 * decade;
+	else
+		return 10.0 * decade;
+}
+
+/*!     \brief  Choose the scaling to show the whole of a host formatted trace
+ *
+ * \param pChannel     pointer to channel (with the formatted trace)
+ */
+static void
+scaleToFit( tChannel *pChannel ) {
+	gdouble min = INFINITY, max = -INFINITY, maxMagnitude = 0.0, span;
+
+	for( guint i = 0; i < pChannel->nPoints; i++ ) {
+		tComplex *pPoint = &pChannel->responsePoints[ i ];
+
+		if( pChannel->format == eFMT_POLAR ) {
+			gdouble magnitude = sqrt( SQU( pPoint->r ) + SQU( pPoint->i ) );
+			if( isfinite( magnitude ) && magnitude > maxMagnitude )
+				maxMagnitude = magnitude;
+		} else if( isfinite( pPoint->r ) ) {
+			min = MIN( min, pPoint->r );
+			max = MAX( max, pPoint->r );
+		}
+	}
+
+	switch( pChannel->format ) {
+	case eFMT_SMITH:
+		pChannel->scaleVal = 1.0;
+		break;
+	case eFMT_POLAR:
+		pChannel->scaleVal = maxMagnitude > 0.0 ? roundUp125( maxMagnitude ) : 1.0;
+		break;
+	default:
+		if( min > max ) {
+			pChannel->scaleVal = 10.0;
+			pChannel->scaleRefPos = NVGRIDS / 2;
+			pChannel->scaleRefVal = 0.0;
+			break;
+		}
+		// a flat trace is shown over a small span around its value
+		span = MAX( max - min, 0.01 * MAX( fabs( max ), fabs( min ) ) );
+		// leave a division spare because the reference value is rounded to a whole division
+		pChannel->scaleVal = span > 0.0 ? roundUp125( span / (NVGRIDS - 1) ) : 1.0;
+		pChannel->scaleRefPos = NVGRIDS / 2;
+		pChannel->scaleRefVal = round( (max + min) / 2.0 / pChannel->scaleVal ) * pChannel->scaleVal;
+		break;
+	}
+}
+
+/*!     \brief  Calculate a channel's trace in a format from its complex data
+ *
+ * \param pChannel     pointer to channel (with complex data)
+ * \param format       format to calculate
+ * \return             g_malloced array of nPoints formatted as responsePoints
+ */
+static tComplex *
+formatComplexPoints( tChannel *pChannel, tFormat format ) {
+	tComplex *points = g_new( tComplex, pChannel->nPoints );
+	gint quantity = derivedQuantityOfFormat( format );
+
+	// the Smith and polar formats show the complex data itself
+	if( quantity == INVALID ) {
+		memcpy( points, pChannel->complexPoints, pChannel->nPoints * sizeof( tComplex ) );
+	} else {
+		tComplexTrace trace = complexTraceOfPoints( pChannel->complexPoints,
+				pChannel->stimulusPoints, pChannel->nPoints );
+		gdouble *values = g_new( gdouble, pChannel->nPoints );
+
+		deriveTrace( quantity, &trace, Z0, values, NULL );
+		for( guint i = 0; i < pChannel->nPoints; i++ ) {
+			points[ i ].r = values[ i ];
+			points[ i ].i = 0.0;
+		}
+		g_free( values );
+	}
+	return points;
+}
+
+/*!     \brief  Show a channel's trace in another format
+ *
+ * The trace is formatted on the host from the complex data retrieved (or recovered) with it.
+ * Scaling is chosen to show the whole trace and the markers are hidden; both are
+ * restored on returning to the format in which the trace was acquired.
+ *
+ * \param pGlobal      pointer to global data
+ * \param channel      channel
+ * \param format       new format
+ * \return             OK or ERROR if the trace has no complex data (or delay is asked of a non frequency sweep)
+ */
+gint
+reformatChannel( tGlobal *pGlobal, eChannel channel, tFormat format ) {
+	tChannel *pChannel = &pGlobal->HP8753.channels[ channel ];
+	tReformatCache *pCache = &pGlobal->reformatCache[ channel ];
+
+	if( !pChannel->chFlags.bValidData || pChannel->nPoints == 0 || pChannel->responsePoints == NULL
+			|| pChannel->complexPoints == NULL || pChannel->stimulusPoints == NULL )
+		return ERROR;
+	if( format == eFMT_DELAY && (pChannel->sweepType == eSWP_CWTIME || pChannel->sweepType == eSWP_PWR) )
+		return ERROR;
+	if( format == pChannel->format )
+		return OK;
+
+	// first change of format since the trace was read ... keep the original
+	if( !reformatCacheValid( pGlobal, channel ) ) {
+		invalidateReformatCache( pGlobal, channel );
+		pCache->nPoints = pChannel->nPoints;
+		pCache->acquiredFormat = pChannel->format;
+		pCache->points[ pChannel->format ] = g_memdup2( pChannel->responsePoints, pChannel->nPoints * sizeof( tComplex ) );
+		pCache->scaleVal = pChannel->scaleVal;
+		pCache->scaleRefPos = pChannel->scaleRefPos;
+		pCache->scaleRefVal = pChannel->scaleRefVal;
+		pCache->bbMkrs = pChannel->chFlags.bbMkrs;
+		pCache->bMkrsDelta = pChannel->chFlags.bMkrsDelta;
+	}
+
+	if( pCache->points[ format ] == NULL )
+		pCache->points[ format ] = formatComplexPoints( pChannel, format );
+	memcpy( pChannel->responsePoints, pCache->points[ format ], pChannel->nPoints * sizeof( tComplex ) );
+	pChannel->format = format;
+
+	if( format == pCache->acquiredFormat ) {
+		pChannel->scaleVal = pCache->scaleVal;
+		pChannel->scaleRefPos = pCache->scaleRefPos;
+		pChannel->scaleRefVal = pCache->scaleRefVal;
+		pChannel->chFlags.bbMkrs = pCache->bbMkrs;
+		pChannel->chFlags.bMkrsDelta = pCache->bMkrsDelta;
+	} else {
+		scaleToFit( pChannel );
+		pChannel->chFlags.bbMkrs = 0;
+		pChannel->chFlags.bMkrsDelta = FALSE;
+	}
+
+	return OK;
+}
+
+/*!     \brief  Return the channels to the format in which their traces were acquired
+ *
+ * Used before the trace data is saved. The formats being shown are returned
+ * so that restoreChannelFormats() can show them again afterwards.
+ *
+ * \param pGlobal      pointer to global data
+ * \param shownFormats formats being shown (returned)
+ */
+void
+showAcquiredFormats( tGlobal *pGlobal, tFormat shownFormats[ eNUM_CH ] ) {
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ ) {
+		shownFormats[ channel ] = pGlobal->HP8753.channels[ channel ].format;
+		if( reformatCacheValid( pGlobal, channel ) )
+			reformatChannel( pGlobal, channel, pGlobal->reformatCache[ channel ].acquiredFormat );
+	}
+}
+
+/*!     \brief  Show the channels in the formats shown before showAcquiredFormats()
+ *
+ * \param pGlobal      pointer to global data
+ * \param shownFormats formats to show
+ */
+void
+restoreChannelFormats( tGlobal *pGlobal, tFormat shownFormats[ eNUM_CH ] ) {
+	for( eChannel channel = eCH_ONE; channel < eNUM_CH; channel++ )
+		if( reformatCacheValid( pGlobal, channel ) )
+			reformatChannel( pGlobal, channel, shownFormats[ channel ] );
+}
+
+/*!     \brief  Show a channel's trace in the next format
+ *
+ * Step through the formats in the order of the HP8753 format menu
+ * (skipping delay for CW time and power sweeps).
+ *
+ * \param pGlobal      pointer to global data
+ * \param channel      channel
+ * \return             OK or ERROR if the trace has no complex data
+ */
+gint
+cycleChannelFormat( tGlobal *pGlobal, eChannel channel ) {
+	tChannel *pChannel = &pGlobal->HP8753.channels[ channel ];
+	tFormat format = (pChannel->format + 1) % NUM_FORMATS;
+
+	if( format == eFMT_DELAY && (pChannel->sweepType == eSWP_CWTIME || pChannel->sweepType == eSWP_PWR) )
+		format++;
+	return reformatChannel( pGlobal, channel, format );
+}
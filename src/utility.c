@@ -29,6 +29,8 @@
 #include <glib-2.0/glib.h>
 #include <hp8753.h>
 #include <math.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/utsname.h>
 #include <errno.h>
 
@@ -415,3 +417,106 @@ cloneTraceProfileAbstract( tHP8753traceAbstract *pOrigTraceAbstract, gchar *newP
 
     return pNewTraceAbstract;
 }
+
+// Start of the tS2P allocation (the planes follow at S2P_ALIGNMENT)
+typedef struct {
+    gatomicrefcount refCount;
+} tS2Pbuffer;
+
+static void
+releaseS2Pbuffer( tS2Pbuffer *pBuffer ) {
+    if( pBuffer && g_atomic_ref_count_dec( &pBuffer->refCount ) )
+        free( pBuffer );
+}
+
+/*!     \brief  Make room in the S-parameter data for a number of points
+ *
+ * The frequency and the real and imaginary parts of the four S-parameters are held
+ * in planes of one allocation, each aligned to S2P_ALIGNMENT bytes.
+ * The allocation is reused if it is large enough and not shared with an export
+ * still being written; otherwise a new one is made and the points already
+ * stored (up to nPoints) are copied to it.
+ *
+ * \param pS2P         pointer to the S-parameters
+ * \param nPoints      number of points needed
+ * \return             OK or ERROR
+ */
+gint
+reserveS2P( tS2P *pS2P, gint nPoints ) {
+    tS2P previous = *pS2P;
+    tS2Pbuffer *pBuffer = pS2P->pBuffer;
+    gsize planeSize;
+    gpointer pAllocation;
+    gint nKeep;
+
+    if( pBuffer && nPoints <= pS2P->nAllocated && g_atomic_ref_count_compare( &pBuffer->refCount, 1 ) )
+        return OK;
+
+    planeSize = ((gsize)MAX( nPoints, 1 ) * sizeof( gdouble ) + S2P_ALIGNMENT - 1) & ~(gsize)(S2P_ALIGNMENT - 1);
+    if( posix_memalign( &pAllocation, S2P_ALIGNMENT, S2P_ALIGNMENT + planeSize * (1 + 2 * eS2P_N_PARAMS) ) != 0 )
+        return ERROR;
+    pBuffer = pAllocation;
+    g_atomic_ref_count_init( &pBuffer->refCount );
+
+    pS2P->pBuffer = pBuffer;
+    pS2P->nAllocated = planeSize / sizeof( gdouble );
+    pS2P->freq = (gdouble *)((guint8 *)pAllocation + S2P_ALIGNMENT);
+    for( tS2Pparameter sParam = eS2P_S11; sParam < eS2P_N_PARAMS; sParam++ ) {
+        pS2P->re[ sParam ] = pS2P->freq + (1 + 2 * sParam) * pS2P->nAllocated;
+        pS2P->im[ sParam ] = pS2P->freq + (2 + 2 * sParam) * pS2P->nAllocated;
+    }
+
+    nKeep = MIN( previous.nPoints, nPoints );
+    if( previous.pBuffer && nKeep > 0 ) {
+        memcpy( pS2P->freq, previous.freq, nKeep * sizeof( gdouble ) );
+        for( tS2Pparameter sParam = eS2P_S11; sParam < eS2P_N_PARAMS; sParam++ ) {
+            memcpy( pS2P->re[ sParam ], previous.re[ sParam ], nKeep * sizeof( gdouble ) );
+            memcpy( pS2P->im[ sParam ], previous.im[ sParam ], nKeep * sizeof( gdouble ) );
+        }
+    }
+    pS2P->nPoints = nKeep;
+    releaseS2Pbuffer( previous.pBuffer );
+    return OK;
+}
+
+/*!     \brief  Share the S-parameter data without copying it
+ *
+ * The destination refers to the same allocation as the source (which is freed
+ * when both have been freed with freeS2P). The source will not write over the data
+ * because reserveS2P allocates again while the data is shared.
+ *
+ * \param pDestination pointer to the (empty) S-parameters to fill
+ * \param pSource      pointer to the S-parameters to share
+ */
+void
+shareS2P( tS2P *pDestination, tS2P *pSource ) {
+    *pDestination = *pSource;
+    if( pSource->pBuffer )
+        g_atomic_ref_count_inc( &((tS2Pbuffer *)pSource->pBuffer)->refCount );
+}
+
+/*!     \brief  Free the S-parameter data
+ *
+ * \param pS2P         pointer to the S-parameters
+ */
+void
+freeS2P( tS2P *pS2P ) {
+    releaseS2Pbuffer( pS2P->pBuffer );
+    memset( pS2P, 0, sizeof( tS2P ) );
+}
+
+/*!     \brief  The S-parameter plane of a measurement
+ *
+ * \param measurement  index into optMeasurementType
+ * \return             the tS2Pparameter or INVALID if the measurement is not an S-parameter
+ */
+gint
+S2PparameterOfMeasurement( gint measurement ) {
+    switch( measurement ) {
+    case S11_MEAS:  return eS2P_S11;
+    case eMEAS_S12: return eS2P_S12;
+    case eMEAS_S21: return eS2P_S21;
+    case S22_MEAS:  return eS2P_S22;
+    default:        return INVALID;
+    }
+}